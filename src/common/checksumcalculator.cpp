@@ -6,54 +6,143 @@
 
 #include <zlib.h>
 
-#include <QCryptographicHash>
+#include <openssl/evp.h>
+
 #include <QFile>
 #include <QLoggingCategory>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define OCC_ADLER32_SSSE3
+#include <immintrin.h>
+#endif
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#endif
+
 namespace
 {
-constexpr qint64 bufSize = 500 * 1024;
+constexpr qint64 bufSize = 1024 * 1024;
+
+struct EvpMdContextDeleter
+{
+    void operator()(EVP_MD_CTX *context) const { EVP_MD_CTX_free(context); }
+};
+
+#ifdef OCC_ADLER32_SSSE3
+// Sums 32 bytes per step: s1 with _mm_sad_epu8 and the position weighted s2
+// with _mm_maddubs_epi16. The sums are reduced modulo 65521 after at most
+// 5552 bytes, where zlib does it too, so they cannot overflow.
+__attribute__((target("ssse3"))) quint32 adler32Ssse3(quint32 adler, const uchar *data, qint64 length)
+{
+    constexpr quint32 base = 65521;
+    constexpr qint64 blockSize = 32;
+    constexpr qint64 maxBlocks = 5552 / blockSize;
+
+    auto s1 = adler & 0xffff;
+    auto s2 = adler >> 16;
+    auto blocks = length / blockSize;
+    length -= blocks * blockSize;
+
+    const auto tap1 = _mm_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17);
+    const auto tap2 = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+    const auto zero = _mm_setzero_si128();
+    const auto ones = _mm_set1_epi16(1);
+
+    while (blocks > 0) {
+        auto n = qMin(blocks, maxBlocks);
+        blocks -= n;
+        // s1 of the previous blocks is added to s2 once per byte of each block
+        auto previousS1 = _mm_set_epi32(0, 0, 0, static_cast<int>(s1 * n));
+        auto vs2 = _mm_set_epi32(0, 0, 0, static_cast<int>(s2));
+        auto vs1 = zero;
+        do {
+            const auto bytes1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+            const auto bytes2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 16));
+            previousS1 = _mm_add_epi32(previousS1, vs1);
+            vs1 = _mm_add_epi32(vs1, _mm_sad_epu8(bytes1, zero));
+            vs2 = _mm_add_epi32(vs2, _mm_madd_epi16(_mm_maddubs_epi16(bytes1, tap1), ones));
+            vs1 = _mm_add_epi32(vs1, _mm_sad_epu8(bytes2, zero));
+            vs2 = _mm_add_epi32(vs2, _mm_madd_epi16(_mm_maddubs_epi16(bytes2, tap2), ones));
+            data += blockSize;
+        } while (--n);
+        vs2 = _mm_add_epi32(vs2, _mm_slli_epi32(previousS1, 5));
+
+        vs1 = _mm_add_epi32(vs1, _mm_shuffle_epi32(vs1, _MM_SHUFFLE(2, 3, 0, 1)));
+        vs1 = _mm_add_epi32(vs1, _mm_shuffle_epi32(vs1, _MM_SHUFFLE(1, 0, 3, 2)));
+        s1 += static_cast<quint32>(_mm_cvtsi128_si32(vs1));
+        vs2 = _mm_add_epi32(vs2, _mm_shuffle_epi32(vs2, _MM_SHUFFLE(2, 3, 0, 1)));
+        vs2 = _mm_add_epi32(vs2, _mm_shuffle_epi32(vs2, _MM_SHUFFLE(1, 0, 3, 2)));
+        s2 = static_cast<quint32>(_mm_cvtsi128_si32(vs2));
+        s1 %= base;
+        s2 %= base;
+    }
+
+    adler = s1 | (s2 << 16);
+    if (length > 0) {
+        adler = static_cast<quint32>(::adler32(adler, data, static_cast<uInt>(length)));
+    }
+    return adler;
+}
+#endif
+
+quint32 updateAdler32(quint32 adler, const char *data, qint64 length)
+{
+    const auto bytes = reinterpret_cast<const uchar *>(data);
+#ifdef OCC_ADLER32_SSSE3
+    static const auto hasSsse3 = __builtin_cpu_supports("ssse3");
+    if (hasSsse3) {
+        return adler32Ssse3(adler, bytes, length);
+    }
+#endif
+    return static_cast<quint32>(::adler32(adler, bytes, static_cast<uInt>(length)));
+}
 }
 
 namespace OCC {
 
 Q_LOGGING_CATEGORY(lcChecksumCalculator, "nextcloud.common.checksumcalculator", QtInfoMsg)
 
-static QCryptographicHash::Algorithm algorithmTypeToQCryptoHashAlgorithm(ChecksumCalculator::AlgorithmType algorithmType)
+struct ChecksumCalculator::Algorithm
+{
+    AlgorithmType type = AlgorithmType::Undefined;
+    std::unique_ptr<EVP_MD_CTX, EvpMdContextDeleter> context;
+    quint32 adlerHash = 0;
+};
+
+static const EVP_MD *algorithmTypeToEvpMd(ChecksumCalculator::AlgorithmType algorithmType)
 {
     switch (algorithmType) {
     case ChecksumCalculator::AlgorithmType::Undefined:
     case ChecksumCalculator::AlgorithmType::Adler32:
         qCWarning(lcChecksumCalculator) << "Invalid algorithm type" << static_cast<int>(algorithmType);
-        return static_cast<QCryptographicHash::Algorithm>(-1);
+        return nullptr;
     case ChecksumCalculator::AlgorithmType::MD5:
-        return QCryptographicHash::Algorithm::Md5;
+        return EVP_md5();
     case ChecksumCalculator::AlgorithmType::SHA1:
-        return QCryptographicHash::Algorithm::Sha1;
+        return EVP_sha1();
     case ChecksumCalculator::AlgorithmType::SHA256:
-        return QCryptographicHash::Algorithm::Sha256;
+        return EVP_sha256();
     case ChecksumCalculator::AlgorithmType::SHA3_256:
-        return QCryptographicHash::Algorithm::Sha3_256;
+        return EVP_sha3_256();
     }
-    return static_cast<QCryptographicHash::Algorithm>(-1);
+    return nullptr;
 }
 
 ChecksumCalculator::ChecksumCalculator(const QString &filePath, const QByteArray &checksumTypeName)
-    : _device(new QFile(filePath))
+    : ChecksumCalculator(std::make_unique<QFile>(filePath), checksumTypeName)
 {
-    if (checksumTypeName == checkSumMD5C) {
-        _algorithmType = AlgorithmType::MD5;
-    } else if (checksumTypeName == checkSumSHA1C) {
-        _algorithmType = AlgorithmType::SHA1;
-    } else if (checksumTypeName == checkSumSHA2C) {
-        _algorithmType = AlgorithmType::SHA256;
-    } else if (checksumTypeName == checkSumSHA3C) {
-        _algorithmType = AlgorithmType::SHA3_256;
-    } else if (checksumTypeName == checkSumAdlerC) {
-        _algorithmType = AlgorithmType::Adler32;
-    }
+}
 
-    initChecksumAlgorithm();
+ChecksumCalculator::ChecksumCalculator(std::unique_ptr<QIODevice> device, const QByteArray &checksumTypeName)
+    : ChecksumCalculator(std::move(device), QList<QByteArray>{checksumTypeName})
+{
+}
+
+ChecksumCalculator::ChecksumCalculator(std::unique_ptr<QIODevice> device, const QList<QByteArray> &checksumTypeNames)
+    : _device(device.release())
+{
+    initChecksumAlgorithms(checksumTypeNames);
 }
 
 ChecksumCalculator::~ChecksumCalculator()
@@ -64,12 +153,33 @@ ChecksumCalculator::~ChecksumCalculator()
     }
 }
 
+ChecksumCalculator::AlgorithmType ChecksumCalculator::algorithmType(const QByteArray &checksumTypeName)
+{
+    if (checksumTypeName == checkSumMD5C) {
+        return AlgorithmType::MD5;
+    } else if (checksumTypeName == checkSumSHA1C) {
+        return AlgorithmType::SHA1;
+    } else if (checksumTypeName == checkSumSHA2C) {
+        return AlgorithmType::SHA256;
+    } else if (checksumTypeName == checkSumSHA3C) {
+        return AlgorithmType::SHA3_256;
+    } else if (checksumTypeName == checkSumAdlerC) {
+        return AlgorithmType::Adler32;
+    }
+    return AlgorithmType::Undefined;
+}
+
 QByteArray ChecksumCalculator::calculate()
 {
-    QByteArray result;
+    return calculateAll().value(0);
+}
+
+QList<QByteArray> ChecksumCalculator::calculateAll()
+{
+    const QList<QByteArray> failed(static_cast<qsizetype>(_algorithms.size()));
 
     if (!_isInitialized) {
-        return result;
+        return failed;
     }
 
     Q_ASSERT(!_device->isOpen());
@@ -83,24 +193,27 @@ QByteArray ChecksumCalculator::calculate()
         } else {
             qCWarning(lcChecksumCalculator) << "Could not open device" << _device.data() << "for reading to compute a checksum" << _device->errorString();
         }
-        return result;
+        return failed;
     }
 
+#ifdef Q_OS_LINUX
+    // The file is read once from start to end, let the kernel read ahead further
+    if (auto file = qobject_cast<QFile *>(_device.data()); file && file->handle() >= 0) {
+        posix_fadvise(file->handle(), 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+#endif
+
+    QByteArray buf(bufSize, Qt::Uninitialized);
     for (;;) {
         QMutexLocker locker(&_deviceMutex);
         if (!_device->isOpen() || _device->atEnd()) {
             break;
         }
-        const auto toRead = qMin(_device->bytesAvailable(), bufSize);
-        if (toRead <= 0) {
-            break;
-        }
-        QByteArray buf(toRead, Qt::Uninitialized);
-        const auto sizeRead = _device->read(buf.data(), toRead);
+        const auto sizeRead = _device->read(buf.data(), bufSize);
         if (sizeRead <= 0) {
             break;
         }
-        if (!addChunk(buf, sizeRead)) {
+        if (!addChunk(buf.constData(), sizeRead)) {
             break;
         }
     }
@@ -108,16 +221,26 @@ QByteArray ChecksumCalculator::calculate()
     {
         QMutexLocker locker(&_deviceMutex);
         if (!_device->isOpen()) {
-            return result;
+            return failed;
         }
     }
 
-    if (_algorithmType == AlgorithmType::Adler32) {
-        result = QByteArray::number(_adlerHash, 16);
-    } else {
-        Q_ASSERT(_cryptographicHash);
-        if (_cryptographicHash) {
-            result = _cryptographicHash->result().toHex();
+    QList<QByteArray> result;
+    result.reserve(static_cast<qsizetype>(_algorithms.size()));
+    for (const auto &algorithm : _algorithms) {
+        if (algorithm.type == AlgorithmType::Undefined) {
+            result.append(QByteArray());
+        } else if (algorithm.type == AlgorithmType::Adler32) {
+            result.append(QByteArray::number(algorithm.adlerHash, 16));
+        } else {
+            unsigned char digest[EVP_MAX_MD_SIZE];
+            unsigned int digestSize = 0;
+            if (EVP_DigestFinal_ex(algorithm.context.get(), digest, &digestSize)) {
+                result.append(QByteArray(reinterpret_cast<const char *>(digest), static_cast<qsizetype>(digestSize)).toHex());
+            } else {
+                qCWarning(lcChecksumCalculator) << "Could not finish the checksum of type" << static_cast<int>(algorithm.type);
+                result.append(QByteArray());
+            }
         }
     }
 
@@ -131,41 +254,45 @@ QByteArray ChecksumCalculator::calculate()
     return result;
 }
 
-void ChecksumCalculator::initChecksumAlgorithm()
+void ChecksumCalculator::initChecksumAlgorithms(const QList<QByteArray> &checksumTypeNames)
 {
-    if (_algorithmType == AlgorithmType::Undefined) {
-        qCWarning(lcChecksumCalculator) << "_algorithmType is Undefined, impossible to init Checksum Algorithm";
-        return;
-    }
+    _algorithms.resize(checksumTypeNames.size());
+    for (qsizetype i = 0; i < checksumTypeNames.size(); ++i) {
+        auto &algorithm = _algorithms[i];
+        algorithm.type = algorithmType(checksumTypeNames.at(i));
+        if (algorithm.type == AlgorithmType::Undefined) {
+            qCWarning(lcChecksumCalculator) << "Unknown checksum type" << checksumTypeNames.at(i) << ", impossible to init Checksum Algorithm";
+            continue;
+        }
 
-    if (_algorithmType == AlgorithmType::Adler32) {
-        _adlerHash = adler32(0L, Z_NULL, 0);
-    } else {
-        _cryptographicHash.reset(new QCryptographicHash(algorithmTypeToQCryptoHashAlgorithm(_algorithmType)));
+        if (algorithm.type == AlgorithmType::Adler32) {
+            algorithm.adlerHash = static_cast<quint32>(::adler32(0L, Z_NULL, 0));
+        } else {
+            algorithm.context.reset(EVP_MD_CTX_new());
+            if (!algorithm.context || !EVP_DigestInit_ex(algorithm.context.get(), algorithmTypeToEvpMd(algorithm.type), nullptr)) {
+                qCWarning(lcChecksumCalculator) << "Could not init the checksum of type" << checksumTypeNames.at(i);
+                algorithm.type = AlgorithmType::Undefined;
+                algorithm.context.reset();
+                continue;
+            }
+        }
+        // Types that could not be set up get an empty result, the others are still computed
+        _isInitialized = true;
     }
-
-    _isInitialized = true;
 }
 
-bool ChecksumCalculator::addChunk(const QByteArray &chunk, const qint64 size)
+bool ChecksumCalculator::addChunk(const char *data, const qint64 size)
 {
-    Q_ASSERT(_algorithmType != AlgorithmType::Undefined);
-    if (_algorithmType == AlgorithmType::Undefined) {
-        qCWarning(lcChecksumCalculator) << "_algorithmType is Undefined, impossible to add a chunk!";
-        return false;
-    }
-
-    if (_algorithmType == AlgorithmType::Adler32) {
-        _adlerHash = adler32(_adlerHash, (const Bytef *)chunk.data(), size);
-        return true;
-    } else {
-        Q_ASSERT(_cryptographicHash);
-        if (_cryptographicHash) {
-            _cryptographicHash->addData(chunk);
-            return true;
+    // Every algorithm goes over the buffer while it is still in the cache
+    for (auto &algorithm : _algorithms) {
+        if (algorithm.type == AlgorithmType::Adler32) {
+            algorithm.adlerHash = updateAdler32(algorithm.adlerHash, data, size);
+        } else if (algorithm.type != AlgorithmType::Undefined && !EVP_DigestUpdate(algorithm.context.get(), data, static_cast<size_t>(size))) {
+            qCWarning(lcChecksumCalculator) << "Could not add a chunk to the checksum of type" << static_cast<int>(algorithm.type);
+            return false;
         }
     }
-    return false;
+    return true;
 }
 
 }
@@ -12,12 +12,21 @@
 #include <QObject>
 #include <QByteArray>
 #include <QFutureWatcher>
+#include <QList>
 #include <QMutex>
 #include <QScopedPointer>
 
-class QCryptographicHash;
+#include <memory>
+#include <vector>
 
 namespace OCC {
+
+/**
+ * @brief Computes one or more checksums of a file in a single read pass
+ *
+ * The cryptographic hashes go through OpenSSL, which picks SHA-NI or AVX2
+ * code paths at runtime, and Adler-32 uses SSSE3 where the CPU has it.
+ */
 class OCSYNC_EXPORT ChecksumCalculator
 {
     Q_DISABLE_COPY(ChecksumCalculator)
@@ -33,17 +42,27 @@ public:
     };
 
     ChecksumCalculator(const QString &filePath, const QByteArray &checksumTypeName);
+    /// Reads the data from device, which must not be open yet
+    ChecksumCalculator(std::unique_ptr<QIODevice> device, const QByteArray &checksumTypeName);
+    /// Reads the data from device once and computes a checksum for each of checksumTypeNames
+    ChecksumCalculator(std::unique_ptr<QIODevice> device, const QList<QByteArray> &checksumTypeNames);
     ~ChecksumCalculator();
+
+    /// The checksum of the first type, empty on failure
     [[nodiscard]] QByteArray calculate();
+    /// The checksums in the order of the types given to the constructor, all empty on failure
+    [[nodiscard]] QList<QByteArray> calculateAll();
+
+    [[nodiscard]] static AlgorithmType algorithmType(const QByteArray &checksumTypeName);
 
 private:
-    void initChecksumAlgorithm();
-    bool addChunk(const QByteArray &chunk, const qint64 size);
+    struct Algorithm;
+
+    void initChecksumAlgorithms(const QList<QByteArray> &checksumTypeNames);
+    bool addChunk(const char *data, const qint64 size);
     QScopedPointer<QIODevice> _device;
-    QScopedPointer<QCryptographicHash> _cryptographicHash;
-    unsigned int _adlerHash = 0;
+    std::vector<Algorithm> _algorithms;
     bool _isInitialized = false;
-    AlgorithmType _algorithmType = AlgorithmType::Undefined;
     QMutex _deviceMutex;
 };
 }
@@ -12,6 +12,9 @@
 #include <QLoggingCategory>
 #include <qtconcurrentrun.h>
 #include <QCryptographicHash>
+#include <QFile>
+#include <QThread>
+#include <QThreadPool>
 
 #ifdef ZLIB_FOUND
 #include <zlib.h>
@@ -94,6 +97,25 @@ QByteArray calcSha256(const QByteArray &data)
     return calcCryptoHash(data, QCryptographicHash::Sha256);
 }
 
+Q_GLOBAL_STATIC(QThreadPool, checksumPool)
+
+QThreadPool *checksumThreadPool()
+{
+    static const auto maxThreadCount = [] {
+        // More concurrent reads than this only make a disk seek between the files
+        auto count = qBound(1, QThread::idealThreadCount(), 4);
+        bool ok = false;
+        const auto configured = qEnvironmentVariableIntValue("OWNCLOUD_CHECKSUM_THREADS", &ok);
+        if (ok && configured > 0) {
+            count = configured;
+        }
+        checksumPool()->setMaxThreadCount(count);
+        return count;
+    }();
+    Q_UNUSED(maxThreadCount)
+    return checksumPool();
+}
+
 QByteArray makeChecksumHeader(const QByteArray &checksumType, const QByteArray &checksum)
 {
     if (checksumType.isEmpty() || checksum.isEmpty())
@@ -179,29 +201,47 @@ ComputeChecksum::~ComputeChecksum() = default;
 
 void ComputeChecksum::setChecksumType(const QByteArray &type)
 {
-    _checksumType = type;
+    _checksumTypes = {type};
+}
+
+void ComputeChecksum::setChecksumTypes(const QList<QByteArray> &types)
+{
+    _checksumTypes = types;
 }
 
 QByteArray ComputeChecksum::checksumType() const
 {
-    return _checksumType;
+    return _checksumTypes.value(0);
+}
+
+QByteArray ComputeChecksum::checksum(const QByteArray &type) const
+{
+    const auto index = _checksumTypes.indexOf(type);
+    return index < 0 ? QByteArray() : _checksums.value(index);
 }
 
 void ComputeChecksum::start(const QString &filePath)
 {
-    qCDebug(lcChecksums) << "Computing" << checksumType() << "checksum of" << filePath << "in a thread";
-    startImpl(filePath);
+    qCDebug(lcChecksums) << "Computing" << _checksumTypes << "checksum of" << filePath << "in a thread";
+    startImpl(std::make_unique<ChecksumCalculator>(std::make_unique<QFile>(filePath), _checksumTypes));
+}
+
+void ComputeChecksum::start(std::unique_ptr<QIODevice> device)
+{
+    qCDebug(lcChecksums) << "Computing" << _checksumTypes << "checksum of device" << device.get() << "in a thread";
+    startImpl(std::make_unique<ChecksumCalculator>(std::move(device), _checksumTypes));
 }
 
-void ComputeChecksum::startImpl(const QString &filePath)
+void ComputeChecksum::startImpl(std::unique_ptr<ChecksumCalculator> checksumCalculator)
 {
     connect(&_watcher, &QFutureWatcherBase::finished,
         this, &ComputeChecksum::slotCalculationDone,
         Qt::UniqueConnection);
 
-    _checksumCalculator.reset(new ChecksumCalculator(filePath, _checksumType));
-    _watcher.setFuture(QtConcurrent::run([this]() {
-        return _checksumCalculator->calculate();
+    _checksumCalculator.reset(checksumCalculator.release());
+    _checksums.clear();
+    _watcher.setFuture(QtConcurrent::run(checksumThreadPool(), [this]() {
+        return _checksumCalculator->calculateAll();
     }));
 }
 
@@ -223,9 +263,10 @@ QByteArray ComputeChecksum::computeNow(const QString &filePath, const QByteArray
 
 void ComputeChecksum::slotCalculationDone()
 {
-    QByteArray checksum = _watcher.future().result();
+    _checksums = _watcher.future().result();
+    const auto checksum = _checksums.value(0);
     if (!checksum.isNull()) {
-        emit done(_checksumType, checksum);
+        emit done(checksumType(), checksum);
     } else {
         emit done(QByteArray(), QByteArray());
     }
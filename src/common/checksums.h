@@ -12,10 +12,13 @@
 #include <QObject>
 #include <QByteArray>
 #include <QFutureWatcher>
+#include <QList>
 
 #include <memory>
 
 class QFile;
+class QIODevice;
+class QThreadPool;
 
 namespace OCC {
 
@@ -46,6 +49,14 @@ OCSYNC_EXPORT bool uploadChecksumEnabled();
 
 OCSYNC_EXPORT QByteArray calcSha256(const QByteArray &data);
 
+/**
+ * The pool that computes checksums, see OWNCLOUD_CHECKSUM_THREADS.
+ *
+ * Checksumming is mostly limited by reading the files, so it gets a small
+ * pool of its own instead of competing for the global one.
+ */
+OCSYNC_EXPORT QThreadPool *checksumThreadPool();
+
 /**
  * Computes the checksum of a file.
  * \ingroup libsync
@@ -62,8 +73,20 @@ public:
      */
     void setChecksumType(const QByteArray &type);
 
+    /**
+     * Sets several checksum types that are computed while reading the file once.
+     *
+     * done() reports the first one, the others are available from checksum() afterwards.
+     */
+    void setChecksumTypes(const QList<QByteArray> &types);
+
     QByteArray checksumType() const;
 
+    /**
+     * The checksum of type once done() was emitted, empty if it was not computed.
+     */
+    [[nodiscard]] QByteArray checksum(const QByteArray &type) const;
+
     /**
      * Computes the checksum for the given file path.
      *
@@ -71,6 +94,13 @@ public:
      */
     void start(const QString &filePath);
 
+    /**
+     * Computes the checksum of the data of device, which must not be open yet.
+     *
+     * done() is emitted when the calculation finishes.
+     */
+    void start(std::unique_ptr<QIODevice> device);
+
     /**
      * Computes the checksum synchronously.
      */
@@ -88,12 +118,13 @@ private slots:
     void slotCalculationDone();
 
 private:
-    void startImpl(const QString &filePath);
+    void startImpl(std::unique_ptr<ChecksumCalculator> checksumCalculator);
 
-    QByteArray _checksumType;
+    QList<QByteArray> _checksumTypes;
+    QList<QByteArray> _checksums;
 
     // watcher for the checksum calculation thread
-    QFutureWatcher<QByteArray> _watcher;
+    QFutureWatcher<QList<QByteArray>> _watcher;
 
     QScopedPointer<ChecksumCalculator> _checksumCalculator;
 };
@@ -0,0 +1,153 @@
+/*
+ * SPDX-FileCopyrightText: 2026 Nextcloud GmbH and Nextcloud contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "contentdefinedchunker.h"
+
+#include <QIODevice>
+#include <QLoggingCategory>
+#include <QtEndian>
+
+#include <array>
+#include <limits>
+#include <utility>
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcContentDefinedChunker, "nextcloud.common.contentdefinedchunker", QtInfoMsg)
+
+namespace {
+
+constexpr qint64 readBufferSize = 1024 * 1024;
+constexpr int sha1Size = 20;
+
+// Random values for each byte, fixed so that chunks stay comparable between runs
+const std::array<quint64, 256> &gearTable()
+{
+    static const auto table = [] {
+        std::array<quint64, 256> values{};
+        quint64 state = 0x9E3779B97F4A7C15ull;
+        for (auto &value : values) {
+            // splitmix64
+            state += 0x9E3779B97F4A7C15ull;
+            auto z = state;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            value = z ^ (z >> 31);
+        }
+        return values;
+    }();
+    return table;
+}
+
+// The gear hash shifts left, so its top bits depend on the most bytes
+quint64 topBitsMask(int bits)
+{
+    return bits <= 0 ? 0 : ~quint64(0) << (64 - bits);
+}
+
+}
+
+ContentDefinedChunker::ContentDefinedChunker(qint64 minSize, qint64 averageSize, qint64 maxSize)
+    : _minSize(minSize)
+    , _averageSize(averageSize)
+    , _maxSize(maxSize)
+{
+    Q_ASSERT(minSize > 0 && minSize <= averageSize && averageSize <= maxSize);
+    Q_ASSERT((averageSize & (averageSize - 1)) == 0);
+    Q_ASSERT(maxSize <= std::numeric_limits<quint32>::max());
+
+    int bits = 0;
+    while ((qint64(1) << bits) < averageSize) {
+        ++bits;
+    }
+    _smallMask = topBitsMask(bits + 2);
+    _largeMask = topBitsMask(bits - 2);
+}
+
+void ContentDefinedChunker::addData(const char *data, qint64 length)
+{
+    const auto &gear = gearTable();
+    qint64 sliceStart = 0;
+    for (qint64 i = 0; i < length; ++i) {
+        ++_chunkSize;
+        // No boundary can be in the first minSize bytes, they are not hashed
+        if (_chunkSize <= _minSize) {
+            continue;
+        }
+        _hash = (_hash << 1) + gear[static_cast<uchar>(data[i])];
+        const auto mask = _chunkSize < _averageSize ? _smallMask : _largeMask;
+        if ((_hash & mask) == 0 || _chunkSize >= _maxSize) {
+            _chunkHash.addData(QByteArrayView(data + sliceStart, i + 1 - sliceStart));
+            sliceStart = i + 1;
+            endChunk();
+        }
+    }
+    _chunkHash.addData(QByteArrayView(data + sliceStart, length - sliceStart));
+}
+
+void ContentDefinedChunker::endChunk()
+{
+    _chunks.append({_chunkSize, _chunkHash.result()});
+    _chunkHash.reset();
+    _chunkSize = 0;
+    _hash = 0;
+}
+
+QVector<ContentDefinedChunker::Chunk> ContentDefinedChunker::finish()
+{
+    if (_chunkSize > 0) {
+        endChunk();
+    }
+    return std::exchange(_chunks, {});
+}
+
+std::optional<QVector<ContentDefinedChunker::Chunk>> ContentDefinedChunker::chunkDevice(QIODevice *device)
+{
+    QByteArray buffer(readBufferSize, Qt::Uninitialized);
+    while (true) {
+        const auto read = device->read(buffer.data(), buffer.size());
+        if (read < 0) {
+            qCWarning(lcContentDefinedChunker) << "Could not read" << device << device->errorString();
+            finish();
+            return {};
+        }
+        if (read == 0) {
+            break;
+        }
+        addData(buffer.constData(), read);
+    }
+    return finish();
+}
+
+QByteArray ContentDefinedChunker::serialize(const QVector<Chunk> &chunks)
+{
+    QByteArray data;
+    data.reserve(chunks.size() * (4 + sha1Size));
+    for (const auto &chunk : chunks) {
+        Q_ASSERT(chunk.hash.size() == sha1Size);
+        char size[4];
+        qToBigEndian(static_cast<quint32>(chunk.size), size);
+        data.append(size, sizeof(size));
+        data.append(chunk.hash);
+    }
+    return data;
+}
+
+QVector<ContentDefinedChunker::Chunk> ContentDefinedChunker::deserialize(const QByteArray &data)
+{
+    QVector<Chunk> chunks;
+    constexpr auto entrySize = 4 + sha1Size;
+    if (data.size() % entrySize != 0) {
+        qCWarning(lcContentDefinedChunker) << "Ignoring malformed chunk list of" << data.size() << "bytes";
+        return chunks;
+    }
+    chunks.reserve(data.size() / entrySize);
+    for (qsizetype i = 0; i < data.size(); i += entrySize) {
+        chunks.append({qFromBigEndian<quint32>(data.constData() + i), data.mid(i + 4, sha1Size)});
+    }
+    return chunks;
+}
+
+}
@@ -0,0 +1,72 @@
+/*
+ * SPDX-FileCopyrightText: 2026 Nextcloud GmbH and Nextcloud contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include "ocsynclib.h"
+
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QVector>
+
+#include <optional>
+
+class QIODevice;
+
+namespace OCC {
+
+/**
+ * @brief Splits data into chunks at boundaries chosen by the content
+ *
+ * A boundary is placed where a rolling gear hash of the last bytes matches a
+ * mask (FastCDC with normalized chunking). Inserting or removing bytes only
+ * moves the boundaries close to the edit, so the chunks of an edited file
+ * mostly keep their hashes and only the ones around the edit differ.
+ *
+ * @ingroup libsync
+ */
+class OCSYNC_EXPORT ContentDefinedChunker
+{
+public:
+    struct Chunk
+    {
+        qint64 size = 0;
+        /// SHA-1 of the chunk data
+        QByteArray hash;
+
+        friend bool operator==(const Chunk &lhs, const Chunk &rhs) { return lhs.size == rhs.size && lhs.hash == rhs.hash; }
+    };
+
+    /// Chunks are between minSize and maxSize bytes, averageSize must be a power of two
+    ContentDefinedChunker(qint64 minSize, qint64 averageSize, qint64 maxSize);
+
+    void addData(const char *data, qint64 length);
+    /// Ends the last chunk and returns all of them, the chunker is reset afterwards
+    [[nodiscard]] QVector<Chunk> finish();
+
+    /// Chunks everything device can read from its current position, nullopt on a read error
+    [[nodiscard]] std::optional<QVector<Chunk>> chunkDevice(QIODevice *device);
+
+    /// Packs chunks into the form stored in the journal and back
+    [[nodiscard]] static QByteArray serialize(const QVector<Chunk> &chunks);
+    [[nodiscard]] static QVector<Chunk> deserialize(const QByteArray &data);
+
+private:
+    void endChunk();
+
+    qint64 _minSize;
+    qint64 _averageSize;
+    qint64 _maxSize;
+    /// Harder to match mask used before averageSize, easier one after
+    quint64 _smallMask;
+    quint64 _largeMask;
+
+    quint64 _hash = 0;
+    qint64 _chunkSize = 0;
+    QCryptographicHash _chunkHash{QCryptographicHash::Sha1};
+    QVector<Chunk> _chunks;
+};
+
+}
@@ -145,7 +145,7 @@ bool SqlDatabase::openOrCreateReadWrite(const QString &filename)
     return true;
 }
 
-bool SqlDatabase::openReadOnly(const QString &filename)
+bool SqlDatabase::openReadOnly(const QString &filename, bool checkConsistency)
 {
     if (isOpen()) {
         return true;
@@ -155,7 +155,7 @@ bool SqlDatabase::openReadOnly(const QString &filename)
         return false;
     }
 
-    if (checkDb() != CheckDbResult::Ok) {
+    if (checkConsistency && checkDb() != CheckDbResult::Ok) {
         qCWarning(lcSql) << "Consistency check failed in readonly mode, giving up" << filename;
         close();
         return false;
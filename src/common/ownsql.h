@@ -34,7 +34,12 @@ public:
 
     bool isOpen();
     bool openOrCreateReadWrite(const QString &filename);
-    bool openReadOnly(const QString &filename);
+    /** Opens an existing database read-only
+     *
+     * The consistency check can be skipped for additional connections to a
+     * database that was already checked when it was opened for writing.
+     */
+    bool openReadOnly(const QString &filename, bool checkConsistency = true);
     bool transaction();
     bool commit();
     void close();
@@ -55,6 +55,7 @@ public:
         GetAllFilesQuery,
         ListFilesInPathQuery,
         SetFileRecordQuery,
+        SetFileRecordBatchQuery,
         SetFileRecordChecksumQuery,
         SetFileRecordLocalMetadataQuery,
         GetDownloadInfoQuery,
@@ -64,6 +65,7 @@ public:
         SetUploadInfoQuery,
         DeleteUploadInfoQuery,
         DeleteFileRecordPhash,
+        DeleteFileRecordPhashBatch,
         DeleteFileRecordRecursively,
         GetErrorBlacklistQuery,
         SetErrorBlacklistQuery,
@@ -98,6 +100,13 @@ public:
         ListAllTopLevelE2eeFoldersStatusLessThanQuery,
         FolderUpdateInvalidEncryptionStatus,
         FileUpdateInvalidEncryptionStatus,
+        GetDeltaChunksQuery,
+        SetDeltaChunksQuery,
+        DeleteDeltaChunksQuery,
+        GetE2EeFolderMetadataCacheQuery,
+        SetE2EeFolderMetadataCacheQuery,
+        DeleteE2EeFolderMetadataCacheQuery,
+        DeleteE2EeFolderMetadataCacheRecursivelyQuery,
 
         PreparedQueryCount
     };
@@ -71,6 +71,26 @@ template <typename T>
 RemotePermissions RemotePermissions::internalFromServerString(const QString &value,
                                                               const T&otherProperties,
                                                               MountedPermissionAlgorithm algorithm)
+{
+    QString shareAttributes;
+    if (otherProperties.contains(QStringLiteral("share-attributes"))) {
+        if constexpr (std::is_same<T, QMap<QString, QString>>::value) {
+            shareAttributes = otherProperties.value(QStringLiteral("share-attributes"));
+        } else if constexpr (std::is_same<T, QVariantMap>::value) {
+            shareAttributes = otherProperties.value(QStringLiteral("share-attributes")).toString();
+        }
+    }
+
+    const auto isMountRoot = otherProperties.contains(QStringLiteral("is-mount-root"))
+        && !(otherProperties.value(QStringLiteral("is-mount-root")) == QStringLiteral("false"));
+
+    return fromServerString(QStringView{value}, algorithm, QStringView{shareAttributes}, isMountRoot);
+}
+
+RemotePermissions RemotePermissions::fromServerString(QStringView value,
+                                                      MountedPermissionAlgorithm algorithm,
+                                                      QStringView shareAttributes,
+                                                      bool isMountRoot)
 {
     constexpr auto shareAttributesDecoder = [] (const auto &shareAttributes, RemotePermissions &perm) -> void {
         auto missingDownloadPermission = false;
@@ -94,27 +114,26 @@ RemotePermissions RemotePermissions::internalFromServerString(const QString &val
     };
 
     RemotePermissions perm;
-    perm.fromArray(value.utf16());
+    perm._value = notNullMask;
+    for (const auto c : value) {
+        if (c.isNull()) {
+            break;
+        }
+        if (auto res = std::strchr(letters, static_cast<char>(c.unicode())))
+            perm._value |= (1 << (res - letters));
+    }
     Q_ASSERT(perm.hasPermission(RemotePermissions::CanRead));
 
-    if (otherProperties.contains(QStringLiteral("share-attributes"))) {
-        const auto shareAttributesRawValue = otherProperties.value(QStringLiteral("share-attributes"));
-
-        if constexpr (std::is_same<T, QMap<QString, QString>>::value) {
-            const auto &shareAttributes = QJsonDocument::fromJson(otherProperties.value(QStringLiteral("share-attributes")).toUtf8());
-            shareAttributesDecoder(shareAttributes, perm);
-        } else if constexpr (std::is_same<T, QVariantMap>::value) {
-            const auto &shareAttributes = QJsonDocument::fromJson(otherProperties.value(QStringLiteral("share-attributes")).toString().toUtf8());
-            shareAttributesDecoder(shareAttributes, perm);
-        }
+    if (!shareAttributes.isEmpty()) {
+        const auto &shareAttributesJson = QJsonDocument::fromJson(shareAttributes.toUtf8());
+        shareAttributesDecoder(shareAttributesJson, perm);
     }
 
     if (algorithm == MountedPermissionAlgorithm::WildGuessMountedSubProperty) {
         return perm;
     }
 
-    if ((otherProperties.contains(QStringLiteral("is-mount-root")) && otherProperties.value(QStringLiteral("is-mount-root")) == QStringLiteral("false") && perm.hasPermission(RemotePermissions::IsMounted)) ||
-        (!otherProperties.contains(QStringLiteral("is-mount-root")) && perm.hasPermission(RemotePermissions::IsMounted))) {
+    if (!isMountRoot && perm.hasPermission(RemotePermissions::IsMounted)) {
         /* All the entries in a external storage have 'M' in their permission. However, for all
            purposes in the desktop client, we only need to know about the mount points.
            So replace the 'M' by a 'm' for every sub entries in an external storage */
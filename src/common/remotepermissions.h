@@ -75,6 +75,16 @@ public:
                                               MountedPermissionAlgorithm algorithm,
                                               const QVariantMap &otherProperties = {});
 
+    /** read a permissions string received from the server, never null
+     *
+     * Takes the values of the share-attributes property (empty if missing) and
+     * whether the is-mount-root property is set instead of the whole property map.
+     */
+    static RemotePermissions fromServerString(QStringView value,
+                                              MountedPermissionAlgorithm algorithm,
+                                              QStringView shareAttributes,
+                                              bool isMountRoot);
+
     [[nodiscard]] bool hasPermission(Permissions p) const
     {
         return _value & (1 << static_cast<int>(p));
@@ -7,12 +7,16 @@
 #include <QCryptographicHash>
 #include <QFile>
 #include <QLoggingCategory>
+#include <QSet>
 #include <QStringList>
 #include <QElapsedTimer>
 #include <QUrl>
 #include <QDir>
+#include <QThread>
 #include <sqlite3.h>
 #include <cstring>
+#include <utility>
+#include <vector>
 
 #include "common/syncjournaldb.h"
 #include "version.h"
@@ -45,6 +49,67 @@ Q_LOGGING_CATEGORY(lcDb, "nextcloud.sync.database", QtInfoMsg)
         " FROM metadata" \
         "  LEFT JOIN checksumtype as contentchecksumtype ON metadata.contentChecksumTypeId == contentchecksumtype.id"
 
+// The columns setFileRecord() writes, pathSortKey is computed from path
+#define FILE_RECORD_COLUMNS \
+        "phash, pathlen, path, inode, uid, gid, mode, modtime, type, md5, fileid, remotePerm, filesize, ignoredChildrenRemote, " \
+        "contentChecksum, contentChecksumTypeId, e2eMangledName, isE2eEncrypted, e2eCertificateFingerprint, lock, lockType, lockOwnerDisplayName, lockOwnerId, " \
+        "lockOwnerEditor, lockTime, lockTimeout, lockToken, isShared, lastShareStateFetchedTimestmap, sharedByMe, isLivePhoto, livePhotoFile, quotaBytesUsed, quotaBytesAvailable, " \
+        "parentPhash, pathSortKey"
+
+namespace {
+
+// The bound values of one row of FILE_RECORD_COLUMNS, see SyncJournalDb::bindFileRecord()
+constexpr auto fileRecordColumnCount = 35;
+
+// Rows per multi-row statement, staying below the 999 variables older sqlite allows
+constexpr auto fileRecordBatchSize = 25;
+constexpr auto deleteBatchSize = 250;
+
+// Queued metadata writes are flushed when this many accumulated
+constexpr auto maxPendingWrites = 1000;
+
+QByteArray fileRecordUpsertSql(int rows)
+{
+    QByteArray sql = "INSERT OR REPLACE INTO metadata (" FILE_RECORD_COLUMNS ") VALUES ";
+    for (int row = 0; row < rows; ++row) {
+        const auto offset = row * fileRecordColumnCount;
+        sql += row > 0 ? ", (" : "(";
+        for (int column = 1; column <= fileRecordColumnCount; ++column) {
+            sql += '?' + QByteArray::number(offset + column) + ", ";
+        }
+        sql += '?' + QByteArray::number(offset + 3) + " || '/')";
+    }
+    return sql + ';';
+}
+
+// Runs when the thread exits, whether it is a QThread or not
+struct ThreadExitCallbacks
+{
+    ~ThreadExitCallbacks()
+    {
+        for (const auto &callback : callbacks) {
+            callback();
+        }
+    }
+    std::vector<std::function<void()>> callbacks;
+};
+thread_local ThreadExitCallbacks threadExitCallbacks;
+
+}
+
+// Lets queries group entries by directory, see ListFilesInPathQuery
+static void registerParentHashFunction(SqlDatabase &db)
+{
+    sqlite3_create_function(db.sqliteDb(), "parent_hash", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, nullptr,
+                                [] (sqlite3_context *ctx,int, sqlite3_value **argv) {
+                                    auto text = reinterpret_cast<const char*>(sqlite3_value_text(argv[0]));
+                                    const char *end = std::strrchr(text, '/');
+                                    if (!end) end = text;
+                                    sqlite3_result_int64(ctx, c_jhash64(reinterpret_cast<const uint8_t*>(text),
+                                                                        end - text, 0));
+                                }, nullptr, nullptr);
+}
+
 static void fillFileRecordFromGetQuery(SyncJournalFileRecord &rec, SqlQuery &query)
 {
     rec._path = query.baValue(0);
@@ -290,6 +355,21 @@ bool SyncJournalDb::sqlFail(const QString &log, const SqlQuery &query)
 }
 
 bool SyncJournalDb::checkConnect()
+{
+    if (!connectDatabase()) {
+        return false;
+    }
+    if (const auto result = flushPendingWrites(); !result) {
+        qCWarning(lcDb) << "Could not write the queued file records:" << result.error();
+        // Rows that failed on their own are set aside, only a failing database is fatal
+        if (!_pendingWrites.isEmpty()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SyncJournalDb::connectDatabase()
 {
     if (autotestFailCounter >= 0) {
         if (!autotestFailCounter--) {
@@ -335,24 +415,31 @@ bool SyncJournalDb::checkConnect()
         qCInfo(lcDb) << "sqlite3 version" << pragma1.stringValue(0);
     }
 
-    // Set locking mode to avoid issues with WAL on Windows
-    static QByteArray locking_mode_env = qgetenv("OWNCLOUD_SQLITE_LOCKING_MODE");
-    if (locking_mode_env.isEmpty())
-        locking_mode_env = "EXCLUSIVE";
-    pragma1.prepare("PRAGMA locking_mode=" + locking_mode_env + ";");
+    // Set locking mode to avoid issues with WAL on Windows. Read connections of
+    // other threads need the normal locking mode, see setReadConnectionsEnabled().
+    static const QByteArray locking_mode_env = qgetenv("OWNCLOUD_SQLITE_LOCKING_MODE");
+    auto lockingModeToSet = locking_mode_env;
+    if (lockingModeToSet.isEmpty()) {
+        lockingModeToSet = _readConnectionsEnabled ? QByteArrayLiteral("NORMAL") : QByteArrayLiteral("EXCLUSIVE");
+    }
+    pragma1.prepare("PRAGMA locking_mode=" + lockingModeToSet + ";");
+    QString lockingMode;
     if (!pragma1.exec()) {
         return sqlFail(QStringLiteral("Set PRAGMA locking_mode"), pragma1);
     } else {
         pragma1.next();
-        qCInfo(lcDb) << "sqlite3 locking_mode=" << pragma1.stringValue(0);
+        lockingMode = pragma1.stringValue(0);
+        qCInfo(lcDb) << "sqlite3 locking_mode=" << lockingMode;
     }
 
     pragma1.prepare("PRAGMA journal_mode=" + _journalMode + ";");
+    QString journalMode;
     if (!pragma1.exec()) {
         return sqlFail(QStringLiteral("Set PRAGMA journal_mode"), pragma1);
     } else {
         pragma1.next();
-        qCInfo(lcDb) << "sqlite3 journal_mode=" << pragma1.stringValue(0);
+        journalMode = pragma1.stringValue(0);
+        qCInfo(lcDb) << "sqlite3 journal_mode=" << journalMode;
     }
 
     // For debugging purposes, allow temp_store to be set
@@ -382,14 +469,7 @@ bool SyncJournalDb::checkConnect()
         return sqlFail(QStringLiteral("Set PRAGMA case_sensitivity"), pragma1);
     }
 
-    sqlite3_create_function(_db.sqliteDb(), "parent_hash", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, nullptr,
-                                [] (sqlite3_context *ctx,int, sqlite3_value **argv) {
-                                    auto text = reinterpret_cast<const char*>(sqlite3_value_text(argv[0]));
-                                    const char *end = std::strrchr(text, '/');
-                                    if (!end) end = text;
-                                    sqlite3_result_int64(ctx, c_jhash64(reinterpret_cast<const uint8_t*>(text),
-                                                                        end - text, 0));
-                                }, nullptr, nullptr);
+    registerParentHashFunction(_db);
 
     /* Because insert is so slow, we do everything in a transaction, and only need one call to commit */
     startTransaction();
@@ -449,6 +529,7 @@ bool SyncJournalDb::checkConnect()
                         "tmpfile VARCHAR(4096),"
                         "etag VARCHAR(32),"
                         "errorcount INTEGER,"
+                        "segments TEXT,"
                         "PRIMARY KEY(path)"
                         ");");
 
@@ -471,6 +552,17 @@ bool SyncJournalDb::checkConnect()
         return sqlFail(QStringLiteral("Create table uploadinfo"), createQuery);
     }
 
+    createQuery.prepare("CREATE TABLE IF NOT EXISTS deltachunks("
+                        "path TEXT PRIMARY KEY,"
+                        "etag VARCHAR(32),"
+                        "size INTEGER(8),"
+                        "chunks BLOB"
+                        ");");
+
+    if (!createQuery.exec()) {
+        return sqlFail(QStringLiteral("Create table deltachunks"), createQuery);
+    }
+
     // create the blacklist table.
     createQuery.prepare("CREATE TABLE IF NOT EXISTS blacklist ("
                         "path VARCHAR(4096),"
@@ -573,6 +665,17 @@ bool SyncJournalDb::checkConnect()
         return sqlFail(QStringLiteral("Create table e2EeLockedFolders"), createQuery);
     }
 
+    // create the e2EeFolderMetadataCache table.
+    createQuery.prepare(
+        "CREATE TABLE IF NOT EXISTS e2EeFolderMetadataCache("
+        "folderId VARCHAR(128) PRIMARY KEY,"
+        "etag VARCHAR(128),"
+        "metadata BLOB"
+        ");");
+    if (!createQuery.exec()) {
+        return sqlFail(QStringLiteral("Create table e2EeFolderMetadataCache"), createQuery);
+    }
+
     bool forceRemoteDiscovery = false;
 
     SqlQuery versionQuery("SELECT major, minor, patch FROM version;", _db);
@@ -681,6 +784,11 @@ bool SyncJournalDb::checkConnect()
     // thereby speeding up the initial discovery significantly.
     _metadataTableIsEmpty = (getFileRecordCount() == 0);
 
+    // Other connections can only read next to the writer with WAL and without an exclusive lock
+    _readConnectionsAllowed = rc
+        && journalMode.compare(QStringLiteral("wal"), Qt::CaseInsensitive) == 0
+        && lockingMode.compare(QStringLiteral("normal"), Qt::CaseInsensitive) == 0;
+
     // Hide 'em all!
     FileSystem::setFileHidden(databaseFilePath(), true);
     FileSystem::setFileHidden(databaseFilePath() + QStringLiteral("-wal"), true);
@@ -695,8 +803,15 @@ void SyncJournalDb::close()
     QMutexLocker locker(&_mutex);
     qCInfo(lcDb) << "Closing DB" << _dbFile;
 
+    requeueFailedWrites();
+    if (const auto result = flushPendingWrites(); !result) {
+        qCWarning(lcDb) << "Could not write the queued file records:" << result.error();
+    }
+    _pendingWrites.clear();
+    _failedWrites.clear();
     commitTransaction();
 
+    closeReadConnections();
     _db.close();
     clearEtagStorageFilter();
     _metadataTableIsEmpty = false;
@@ -807,15 +922,6 @@ bool SyncJournalDb::updateMetadataTableStructure()
         commitInternal(QStringLiteral("update database structure: add path index"));
     }
 
-    if (true) {
-        SqlQuery query(_db);
-        query.prepare("CREATE INDEX IF NOT EXISTS metadata_parent ON metadata(parent_hash(path));");
-        if (!query.exec()) {
-            sqlFail(QStringLiteral("updateMetadataTableStructure: create index parent"), query);
-            re = false;
-        }
-        commitInternal(QStringLiteral("update database structure: add parent index"));
-    }
 
     addColumn(QStringLiteral("ignoredChildrenRemote"), QStringLiteral("INT"));
     addColumn(QStringLiteral("contentChecksum"), QStringLiteral("TEXT"));
@@ -840,6 +946,19 @@ bool SyncJournalDb::updateMetadataTableStructure()
         commitInternal(QStringLiteral("update database structure: add contentChecksum col for uploadinfo"));
     }
 
+    auto downloadInfoColumns = tableColumns("downloadinfo");
+    if (downloadInfoColumns.isEmpty())
+        return false;
+    if (!downloadInfoColumns.contains("segments")) {
+        SqlQuery query(_db);
+        query.prepare("ALTER TABLE downloadinfo ADD COLUMN segments TEXT;");
+        if (!query.exec()) {
+            sqlFail(QStringLiteral("updateMetadataTableStructure: add segments column"), query);
+            re = false;
+        }
+        commitInternal(QStringLiteral("update database structure: add segments col for downloadinfo"));
+    }
+
     auto conflictsColumns = tableColumns("conflicts");
     if (conflictsColumns.isEmpty())
         return false;
@@ -890,6 +1009,40 @@ bool SyncJournalDb::updateMetadataTableStructure()
     addColumn(QStringLiteral("isLivePhoto"), QStringLiteral("INTEGER"));
     addColumn(QStringLiteral("livePhotoFile"), QStringLiteral("TEXT"));
 
+    // The parent hash and the sort key are stored, so that directory listings and
+    // subtree scans are index range scans without calling parent_hash() per row
+    addColumn(QStringLiteral("parentPhash"), QStringLiteral("INTEGER"));
+    addColumn(QStringLiteral("pathSortKey"), QStringLiteral("TEXT"));
+
+    if (true) {
+        SqlQuery query(_db);
+        // Rows from before the columns existed, or written by an older client
+        query.prepare("UPDATE metadata SET parentPhash = parent_hash(path), pathSortKey = path || '/' WHERE pathSortKey IS NULL;");
+        if (!query.exec()) {
+            sqlFail(QStringLiteral("updateMetadataTableStructure: fill parentPhash and pathSortKey"), query);
+            re = false;
+        }
+
+        query.prepare("DROP INDEX IF EXISTS metadata_parent;");
+        if (!query.exec()) {
+            sqlFail(QStringLiteral("updateMetadataTableStructure: drop index parent"), query);
+            re = false;
+        }
+
+        query.prepare("CREATE INDEX IF NOT EXISTS metadata_parent_phash ON metadata(parentPhash, pathSortKey);");
+        if (!query.exec()) {
+            sqlFail(QStringLiteral("updateMetadataTableStructure: create index parentPhash"), query);
+            re = false;
+        }
+
+        query.prepare("CREATE INDEX IF NOT EXISTS metadata_path_sort_key ON metadata(pathSortKey);");
+        if (!query.exec()) {
+            sqlFail(QStringLiteral("updateMetadataTableStructure: create index pathSortKey"), query);
+            re = false;
+        }
+        commitInternal(QStringLiteral("update database structure: add parentPhash and pathSortKey indexes"));
+    }
+
     {
         const auto quotaBytesUsed =  QStringLiteral("quotaBytesUsed");
         const auto quotaBytesAvailable =  QStringLiteral("quotaBytesAvailable");
@@ -1051,14 +1204,35 @@ Result<void, QString> SyncJournalDb::setFileRecord(const SyncJournalFileRecord &
 
     Q_ASSERT(!record.path().isEmpty());
 
-    const qint64 phash = getPHash(record._path);
-    if (!checkConnect()) {
+    if (!connectDatabase()) {
         qCWarning(lcDb) << "Failed to connect database.";
         return tr("Failed to connect database."); // checkConnect failed.
     }
 
-    int plen = record._path.length();
+    // Queued in the form it reads back in, for getFileRecord() before the flush
+    QByteArray checksumType, checksum;
+    parseChecksumHeader(record._checksumHeader, &checksumType, &checksum);
+    record._checksumHeader = checksumType.isEmpty() ? QByteArray() : QByteArray(checksumType + ':' + checksum);
+    record._remotePerm = RemotePermissions::fromDbValue(record._remotePerm.toDbValue());
+    _pendingWrites.insert(getPHash(record._path), {PendingWrite::Upsert, record});
+
+    // Can't be true anymore.
+    _metadataTableIsEmpty = false;
 
+    return flushPendingWritesIfFull();
+}
+
+Result<void, QString> SyncJournalDb::flushPendingWritesIfFull()
+{
+    if (_pendingWrites.size() < maxPendingWrites) {
+        return {};
+    }
+    return flushPendingWrites();
+}
+
+void SyncJournalDb::bindFileRecord(SqlQuery &query, int offset, const SyncJournalFileRecord &record)
+{
+    const auto parentEnd = record._path.lastIndexOf('/');
     QByteArray etag(record._etag);
     if (etag.isEmpty()) {
         etag = "";
@@ -1067,65 +1241,213 @@ Result<void, QString> SyncJournalDb::setFileRecord(const SyncJournalFileRecord &
     if (fileId.isEmpty()) {
         fileId = "";
     }
-    QByteArray remotePerm = record._remotePerm.toDbValue();
     QByteArray checksumType, checksum;
     parseChecksumHeader(record._checksumHeader, &checksumType, &checksum);
-    int contentChecksumTypeId = mapChecksumType(checksumType);
 
-    const auto query = _queryManager.get(PreparedSqlQueryManager::SetFileRecordQuery, QByteArrayLiteral("INSERT OR REPLACE INTO metadata "
-                                                                                                        "(phash, pathlen, path, inode, uid, gid, mode, modtime, type, md5, fileid, remotePerm, filesize, ignoredChildrenRemote, "
-                                                                                                        "contentChecksum, contentChecksumTypeId, e2eMangledName, isE2eEncrypted, e2eCertificateFingerprint, lock, lockType, lockOwnerDisplayName, lockOwnerId, "
-                                                                                                        "lockOwnerEditor, lockTime, lockTimeout, lockToken, isShared, lastShareStateFetchedTimestmap, sharedByMe, isLivePhoto, livePhotoFile, quotaBytesUsed, quotaBytesAvailable) "
-                                                                                                        "VALUES (?1 , ?2, ?3 , ?4 , ?5 , ?6 , ?7,  ?8 , ?9 , ?10, ?11, ?12, ?13, ?14, ?15, ?16, ?17, ?18, ?19, ?20, ?21, ?22, ?23, ?24, ?25, ?26, ?27, ?28, ?29, ?30, ?31, ?32, ?33, ?34);"),
-        _db);
-    if (!query) {
-        qCWarning(lcDb) << "database error:" << query->error();
-        return query->error();
+    query.bindValue(offset + 1, getPHash(record._path));
+    query.bindValue(offset + 2, record._path.length());
+    query.bindValue(offset + 3, record._path);
+    query.bindValue(offset + 4, record._inode);
+    query.bindValue(offset + 5, 0); // uid Not used
+    query.bindValue(offset + 6, 0); // gid Not used
+    query.bindValue(offset + 7, 0); // mode Not used
+    query.bindValue(offset + 8, record._modtime);
+    query.bindValue(offset + 9, record._type);
+    query.bindValue(offset + 10, etag);
+    query.bindValue(offset + 11, fileId);
+    query.bindValue(offset + 12, record._remotePerm.toDbValue());
+    query.bindValue(offset + 13, record._fileSize);
+    query.bindValue(offset + 14, record._serverHasIgnoredFiles ? 1 : 0);
+    query.bindValue(offset + 15, checksum);
+    query.bindValue(offset + 16, mapChecksumType(checksumType));
+    query.bindValue(offset + 17, record._e2eMangledName);
+    query.bindValue(offset + 18, static_cast<int>(record._e2eEncryptionStatus));
+    query.bindValue(offset + 19, {}); // e2eCertificateFingerprint, not part of SyncJournalFileRecord
+    query.bindValue(offset + 20, record._lockstate._locked ? 1 : 0);
+    query.bindValue(offset + 21, record._lockstate._lockOwnerType);
+    query.bindValue(offset + 22, record._lockstate._lockOwnerDisplayName);
+    query.bindValue(offset + 23, record._lockstate._lockOwnerId);
+    query.bindValue(offset + 24, record._lockstate._lockEditorApp);
+    query.bindValue(offset + 25, record._lockstate._lockTime);
+    query.bindValue(offset + 26, record._lockstate._lockTimeout);
+    query.bindValue(offset + 27, record._lockstate._lockToken);
+    query.bindValue(offset + 28, record._isShared);
+    query.bindValue(offset + 29, record._lastShareStateFetchedTimestamp);
+    query.bindValue(offset + 30, record._sharedByMe);
+    query.bindValue(offset + 31, record._isLivePhoto);
+    query.bindValue(offset + 32, record._livePhotoFile);
+    query.bindValue(offset + 33, record._folderQuota.bytesUsed);
+    query.bindValue(offset + 34, record._folderQuota.bytesAvailable);
+    query.bindValue(offset + 35, getPHash(parentEnd > 0 ? record._path.left(parentEnd) : QByteArray()));
+}
+
+void SyncJournalDb::requeueFailedWrites()
+{
+    for (auto it = _failedWrites.cbegin(); it != _failedWrites.cend(); ++it) {
+        if (!_pendingWrites.contains(it.key())) {
+            _pendingWrites.insert(it.key(), *it);
+        }
+    }
+    _failedWrites.clear();
+}
+
+Result<void, QString> SyncJournalDb::flushPendingWrites()
+{
+    if (_pendingWrites.isEmpty()) {
+        return {};
+    }
+    if (!_db.isOpen()) {
+        return tr("Failed to connect database.");
+    }
+
+    // Every write touches only the row of its phash, so their order doesn't matter.
+    // A batch that fails is written again row by row, so that a row that can't be
+    // written doesn't hold back the others: it is set aside in _failedWrites.
+    const auto pendingWrites = _pendingWrites;
+    QVector<std::pair<qint64, const SyncJournalFileRecord *>> upserts;
+    QVector<qint64> deletes;
+    QVector<std::pair<qint64, const SyncJournalFileRecord *>> localMetadataUpdates;
+    for (auto it = pendingWrites.cbegin(); it != pendingWrites.cend(); ++it) {
+        switch (it->kind) {
+        case PendingWrite::Upsert:
+            upserts.append({it.key(), &it->record});
+            break;
+        case PendingWrite::Delete:
+            deletes.append(it.key());
+            break;
+        case PendingWrite::LocalMetadata:
+            localMetadataUpdates.append({it.key(), &it->record});
+            break;
+        }
     }
+    qCDebug(lcDb) << "Writing" << upserts.size() << "file records," << deletes.size() << "deletions and"
+                  << localMetadataUpdates.size() << "local metadata updates";
 
-    query->bindValue(1, phash);
-    query->bindValue(2, plen);
-    query->bindValue(3, record._path);
-    query->bindValue(4, record._inode);
-    query->bindValue(5, 0); // uid Not used
-    query->bindValue(6, 0); // gid Not used
-    query->bindValue(7, 0); // mode Not used
-    query->bindValue(8, record._modtime);
-    query->bindValue(9, record._type);
-    query->bindValue(10, etag);
-    query->bindValue(11, fileId);
-    query->bindValue(12, remotePerm);
-    query->bindValue(13, record._fileSize);
-    query->bindValue(14, record._serverHasIgnoredFiles ? 1 : 0);
-    query->bindValue(15, checksum);
-    query->bindValue(16, contentChecksumTypeId);
-    query->bindValue(17, record._e2eMangledName);
-    query->bindValue(18, static_cast<int>(record._e2eEncryptionStatus));
-    query->bindValue(19, {});
-    query->bindValue(20, record._lockstate._locked ? 1 : 0);
-    query->bindValue(21, record._lockstate._lockOwnerType);
-    query->bindValue(22, record._lockstate._lockOwnerDisplayName);
-    query->bindValue(23, record._lockstate._lockOwnerId);
-    query->bindValue(24, record._lockstate._lockEditorApp);
-    query->bindValue(25, record._lockstate._lockTime);
-    query->bindValue(26, record._lockstate._lockTimeout);
-    query->bindValue(27, record._lockstate._lockToken);
-    query->bindValue(28, record._isShared);
-    query->bindValue(29, record._lastShareStateFetchedTimestamp);
-    query->bindValue(30, record._sharedByMe);
-    query->bindValue(31, record._isLivePhoto);
-    query->bindValue(32, record._livePhotoFile);
-    query->bindValue(33, record._folderQuota.bytesUsed);
-    query->bindValue(34, record._folderQuota.bytesAvailable);
+    QSet<qint64> failed;
+    QString lastError;
+    auto execute = [&lastError](SqlQuery &query) {
+        const auto ok = query.exec();
+        if (!ok) {
+            qCWarning(lcDb) << "database error:" << query.error();
+            lastError = query.error();
+        }
+        query.reset_and_clear_bindings();
+        return ok;
+    };
 
-    if (!query->exec()) {
-        qCWarning(lcDb) << "database error:" << query->error();
-        return query->error();
+    const auto singleUpsertQuery = _queryManager.get(PreparedSqlQueryManager::SetFileRecordQuery, fileRecordUpsertSql(1), _db);
+    if (!singleUpsertQuery) {
+        qCWarning(lcDb) << "database error:" << singleUpsertQuery->error();
+        return singleUpsertQuery->error();
     }
+    auto writeUpserts = [&](qsizetype from, qsizetype to) {
+        for (auto i = from; i < to; ++i) {
+            bindFileRecord(*singleUpsertQuery, 0, *upserts.at(i).second);
+            if (!execute(*singleUpsertQuery)) {
+                failed.insert(upserts.at(i).first);
+            }
+        }
+    };
+    qsizetype done = 0;
+    if (upserts.size() >= fileRecordBatchSize) {
+        const auto query = _queryManager.get(PreparedSqlQueryManager::SetFileRecordBatchQuery, fileRecordUpsertSql(fileRecordBatchSize), _db);
+        if (!query) {
+            qCWarning(lcDb) << "database error:" << query->error();
+            return query->error();
+        }
+        for (; done + fileRecordBatchSize <= upserts.size(); done += fileRecordBatchSize) {
+            for (int row = 0; row < fileRecordBatchSize; ++row) {
+                bindFileRecord(*query, row * fileRecordColumnCount, *upserts.at(done + row).second);
+            }
+            if (!execute(*query)) {
+                writeUpserts(done, done + fileRecordBatchSize);
+            }
+        }
+    }
+    writeUpserts(done, upserts.size());
 
-    // Can't be true anymore.
-    _metadataTableIsEmpty = false;
+    const auto singleDeleteQuery = _queryManager.get(PreparedSqlQueryManager::DeleteFileRecordPhash, QByteArrayLiteral("DELETE FROM metadata WHERE phash=?1"), _db);
+    if (!singleDeleteQuery) {
+        qCWarning(lcDb) << "database error:" << singleDeleteQuery->error();
+        return singleDeleteQuery->error();
+    }
+    auto writeDeletes = [&](qsizetype from, qsizetype to) {
+        for (auto i = from; i < to; ++i) {
+            singleDeleteQuery->bindValue(1, deletes.at(i));
+            if (!execute(*singleDeleteQuery)) {
+                failed.insert(deletes.at(i));
+            }
+        }
+    };
+    done = 0;
+    if (deletes.size() >= deleteBatchSize) {
+        QByteArray sql = "DELETE FROM metadata WHERE phash IN (?1";
+        for (int i = 2; i <= deleteBatchSize; ++i) {
+            sql += ", ?" + QByteArray::number(i);
+        }
+        const auto query = _queryManager.get(PreparedSqlQueryManager::DeleteFileRecordPhashBatch, sql + ")", _db);
+        if (!query) {
+            qCWarning(lcDb) << "database error:" << query->error();
+            return query->error();
+        }
+        for (; done + deleteBatchSize <= deletes.size(); done += deleteBatchSize) {
+            for (int i = 0; i < deleteBatchSize; ++i) {
+                query->bindValue(i + 1, deletes.at(done + i));
+            }
+            if (!execute(*query)) {
+                writeDeletes(done, done + deleteBatchSize);
+            }
+        }
+    }
+    writeDeletes(done, deletes.size());
 
+    if (!localMetadataUpdates.isEmpty()) {
+        const auto query = _queryManager.get(PreparedSqlQueryManager::SetFileRecordLocalMetadataQuery, QByteArrayLiteral("UPDATE metadata"
+                                                                                                                         " SET inode=?2, modtime=?3, filesize=?4, lock=?5, lockType=?6,"
+                                                                                                                         " lockOwnerDisplayName=?7, lockOwnerId=?8, lockOwnerEditor = ?9,"
+                                                                                                                         " lockTime=?10, lockTimeout=?11, lockToken=?12"
+                                                                                                                         " WHERE phash == ?1;"),
+            _db);
+        if (!query) {
+            qCWarning(lcDb) << "database error:" << query->error();
+            return query->error();
+        }
+        for (const auto &[phash, record] : std::as_const(localMetadataUpdates)) {
+            const auto &lockInfo = record->_lockstate;
+            query->bindValue(1, phash);
+            query->bindValue(2, record->_inode);
+            query->bindValue(3, record->_modtime);
+            query->bindValue(4, record->_fileSize);
+            query->bindValue(5, lockInfo._locked ? 1 : 0);
+            query->bindValue(6, lockInfo._lockOwnerType);
+            query->bindValue(7, lockInfo._lockOwnerDisplayName);
+            query->bindValue(8, lockInfo._lockOwnerId);
+            query->bindValue(9, lockInfo._lockEditorApp);
+            query->bindValue(10, lockInfo._lockTime);
+            query->bindValue(11, lockInfo._lockTimeout);
+            query->bindValue(12, lockInfo._lockToken);
+            if (!execute(*query)) {
+                failed.insert(phash);
+            }
+        }
+    }
+
+    // Only what was written is dropped, a write queued meanwhile for the same row stays
+    for (auto it = pendingWrites.cbegin(); it != pendingWrites.cend(); ++it) {
+        const auto current = _pendingWrites.constFind(it.key());
+        if (current == _pendingWrites.cend() || !(*current == *it)) {
+            continue;
+        }
+        if (failed.contains(it.key())) {
+            _failedWrites.insert(it.key(), *it);
+        }
+        _pendingWrites.erase(current);
+    }
+
+    if (!failed.isEmpty()) {
+        qCWarning(lcDb) << failed.size() << "file records could not be written, they are tried again with the next commit";
+        return lastError;
+    }
     return {};
 }
 
@@ -1175,7 +1497,7 @@ bool SyncJournalDb::listAllE2eeFoldersWithEncryptionStatusLessThan(const int sta
     if (!checkConnect())
         return false;
     const auto query = _queryManager.get(PreparedSqlQueryManager::ListAllTopLevelE2eeFoldersStatusLessThanQuery,
-                                         QByteArrayLiteral(GET_FILE_RECORD_QUERY " WHERE type == 2 AND isE2eEncrypted >= ?1 AND isE2eEncrypted < ?2 ORDER BY path||'/' ASC"),
+                                         QByteArrayLiteral(GET_FILE_RECORD_QUERY " WHERE type == 2 AND isE2eEncrypted >= ?1 AND isE2eEncrypted < ?2 ORDER BY pathSortKey ASC"),
                                          _db);
     if (!query) {
         qCWarning(lcDb) << "database error:" << query->error();
@@ -1306,10 +1628,37 @@ bool SyncJournalDb::deleteFileRecord(const QString &filename, bool recursively)
 {
     QMutexLocker locker(&_mutex);
 
+    if (!recursively) {
+        if (!connectDatabase()) {
+            qCWarning(lcDb) << "Failed to connect database.";
+            return false; // checkConnect failed.
+        }
+        _pendingWrites.insert(getPHash(filename.toUtf8()), {PendingWrite::Delete, {}});
+        return static_cast<bool>(flushPendingWritesIfFull());
+    }
+
     if (checkConnect()) {
         // if (!recursively) {
         // always delete the actual file.
 
+        {
+            // The cached metadata of the removed encrypted folders, while their file ids are known
+            const auto query = _queryManager.get(PreparedSqlQueryManager::DeleteE2EeFolderMetadataCacheRecursivelyQuery,
+                                                 QByteArrayLiteral("DELETE FROM e2EeFolderMetadataCache WHERE folderId IN "
+                                                                   "(SELECT fileid FROM metadata WHERE " IS_PREFIX_PATH_OR_EQUAL("?1", "path") ");"),
+                                                 _db);
+            if (!query) {
+                qCWarning(lcDb) << "database error:" << query->error();
+                return false;
+            }
+
+            query->bindValue(1, filename);
+            if (!query->exec()) {
+                qCWarning(lcDb) << "database error:" << query->error();
+                return false;
+            }
+        }
+
         {
             const auto query = _queryManager.get(PreparedSqlQueryManager::DeleteFileRecordPhash, QByteArrayLiteral("DELETE FROM metadata WHERE phash=?1"), _db);
             if (!query) {
@@ -1349,46 +1698,86 @@ bool SyncJournalDb::deleteFileRecord(const QString &filename, bool recursively)
 
 bool SyncJournalDb::getFileRecord(const QByteArray &filename, SyncJournalFileRecord *rec)
 {
-    QMutexLocker locker(&_mutex);
-
     // Reset the output var in case the caller is reusing it.
     Q_ASSERT(rec);
     rec->_path.clear();
     Q_ASSERT(!rec->isValid());
 
+    if (const auto reader = readConnection()) {
+        if (filename.isEmpty()) {
+            return true;
+        }
+        if (!queryFileRecord(reader->db, reader->queryManager, filename, rec)) {
+            dropReadConnection();
+            return false;
+        }
+        return true;
+    }
+
+    QMutexLocker locker(&_mutex);
+
+    // Queued writes are answered without flushing them, as are the ones that failed
+    const PendingWrite *pending = nullptr;
+    if ((!_pendingWrites.isEmpty() || !_failedWrites.isEmpty()) && !filename.isEmpty()) {
+        const auto phash = getPHash(filename);
+        if (const auto it = _pendingWrites.constFind(phash); it != _pendingWrites.constEnd()) {
+            pending = &it.value();
+        } else if (const auto failed = _failedWrites.constFind(phash); failed != _failedWrites.constEnd()) {
+            pending = &failed.value();
+        }
+    }
+    if (pending && pending->kind == PendingWrite::Upsert) {
+        *rec = pending->record;
+        return true;
+    }
+    if (pending && pending->kind == PendingWrite::Delete) {
+        return true;
+    }
+
     if (_metadataTableIsEmpty) {
         return true; // no error, yet nothing found (rec->isValid() == false)
     }
 
-    if (!checkConnect()) {
+    if (!connectDatabase()) {
         return false;
     }
 
-    if (!filename.isEmpty()) {
-        const auto query = _queryManager.get(PreparedSqlQueryManager::GetFileRecordQuery, QByteArrayLiteral(GET_FILE_RECORD_QUERY " WHERE phash=?1"), _db);
-        if (!query) {
-            qCWarning(lcDb) << "database error:" << query->error();
-            return false;
-        }
+    if (!filename.isEmpty() && !queryFileRecord(_db, _queryManager, filename, rec)) {
+        close();
+        return false;
+    }
+    if (pending && rec->isValid()) {
+        rec->_inode = pending->record._inode;
+        rec->_modtime = pending->record._modtime;
+        rec->_fileSize = pending->record._fileSize;
+        rec->_lockstate = pending->record._lockstate;
+    }
+    return true;
+}
 
-        query->bindValue(1, getPHash(filename));
+bool SyncJournalDb::queryFileRecord(SqlDatabase &db, PreparedSqlQueryManager &queryManager, const QByteArray &filename, SyncJournalFileRecord *rec)
+{
+    const auto query = queryManager.get(PreparedSqlQueryManager::GetFileRecordQuery, QByteArrayLiteral(GET_FILE_RECORD_QUERY " WHERE phash=?1"), db);
+    if (!query) {
+        qCWarning(lcDb) << "database error:" << query->error();
+        return false;
+    }
 
-        if (!query->exec()) {
-            qCWarning(lcDb) << "database error:" << query->error();
-            close();
-            return false;
-        }
+    query->bindValue(1, getPHash(filename));
 
-        auto next = query->next();
-        if (!next.ok) {
-            QString err = query->error();
-            qCWarning(lcDb) << "No journal entry found for" << filename << "Error:" << err;
-            close();
-            return false;
-        }
-        if (next.hasData) {
-            fillFileRecordFromGetQuery(*rec, *query);
-        }
+    if (!query->exec()) {
+        qCWarning(lcDb) << "database error:" << query->error();
+        return false;
+    }
+
+    auto next = query->next();
+    if (!next.ok) {
+        QString err = query->error();
+        qCWarning(lcDb) << "No journal entry found for" << filename << "Error:" << err;
+        return false;
+    }
+    if (next.hasData) {
+        fillFileRecordFromGetQuery(*rec, *query);
     }
     return true;
 }
@@ -1527,6 +1916,14 @@ bool SyncJournalDb::getFileRecordsByFileId(const QByteArray &fileId, const std::
 
 bool SyncJournalDb::getFilesBelowPath(const QByteArray &path, const std::function<void(const SyncJournalFileRecord&)> &rowCallback)
 {
+    if (const auto reader = readConnection()) {
+        if (!queryFilesBelowPath(reader->db, reader->queryManager, path, rowCallback)) {
+            dropReadConnection();
+            return false;
+        }
+        return true;
+    }
+
     QMutexLocker locker(&_mutex);
 
     if (_metadataTableIsEmpty)
@@ -1535,6 +1932,11 @@ bool SyncJournalDb::getFilesBelowPath(const QByteArray &path, const std::functio
     if (!checkConnect())
         return false;
 
+    return queryFilesBelowPath(_db, _queryManager, path, rowCallback);
+}
+
+bool SyncJournalDb::queryFilesBelowPath(SqlDatabase &db, PreparedSqlQueryManager &queryManager, const QByteArray &path, const std::function<void(const SyncJournalFileRecord&)> &rowCallback)
+{
     auto _exec = [&rowCallback](SqlQuery &query) {
         if (!query.exec()) {
             qCWarning(lcDb) << "database error:" << query.error();
@@ -1564,7 +1966,7 @@ bool SyncJournalDb::getFilesBelowPath(const QByteArray &path, const std::functio
         // and find nothing. So, unfortunately, we have to use a different query for
         // retrieving the whole tree.
 
-        const auto query = _queryManager.get(PreparedSqlQueryManager::GetAllFilesQuery, QByteArrayLiteral(GET_FILE_RECORD_QUERY " ORDER BY path||'/' ASC"), _db);
+        const auto query = queryManager.get(PreparedSqlQueryManager::GetAllFilesQuery, QByteArrayLiteral(GET_FILE_RECORD_QUERY " ORDER BY pathSortKey ASC"), db);
         if (!query) {
             qCWarning(lcDb) << "database error:" << query->error();
             return false;
@@ -1573,15 +1975,15 @@ bool SyncJournalDb::getFilesBelowPath(const QByteArray &path, const std::functio
     } else {
         // This query is used to skip discovery and fill the tree from the
         // database instead
-        const auto query = _queryManager.get(PreparedSqlQueryManager::GetFilesBelowPathQuery, QByteArrayLiteral(GET_FILE_RECORD_QUERY " WHERE " IS_PREFIX_PATH_OF("?1", "path")
+        const auto query = queryManager.get(PreparedSqlQueryManager::GetFilesBelowPathQuery, QByteArrayLiteral(GET_FILE_RECORD_QUERY " WHERE " IS_PREFIX_PATH_OF("?1", "pathSortKey")
                                                                                                                 " OR " IS_PREFIX_PATH_OF("?1", "e2eMangledName")
                                                                                                                 // We want to ensure that the contents of a directory are sorted
                                                                                                                 // directly behind the directory itself. Without this ORDER BY
                                                                                                                 // an ordering like foo, foo-2, foo/file would be returned.
-                                                                                                                // With the trailing /, we get foo-2, foo, foo/file. This property
-                                                                                                                // is used in fill_tree_from_db().
-                                                                                                                " ORDER BY path||'/' ASC"),
-            _db);
+                                                                                                                // pathSortKey is path||'/', so we get foo-2, foo, foo/file. This
+                                                                                                                // property is used in fill_tree_from_db().
+                                                                                                                " ORDER BY pathSortKey ASC"),
+            db);
         if (!query) {
             qCWarning(lcDb) << "database error:" << query->error();
             return false;
@@ -1594,6 +1996,14 @@ bool SyncJournalDb::getFilesBelowPath(const QByteArray &path, const std::functio
 bool SyncJournalDb::listFilesInPath(const QByteArray& path,
                                     const std::function<void (const SyncJournalFileRecord &)>& rowCallback)
 {
+    if (const auto reader = readConnection()) {
+        if (!queryFilesInPath(reader->db, reader->queryManager, path, rowCallback)) {
+            dropReadConnection();
+            return false;
+        }
+        return true;
+    }
+
     QMutexLocker locker(&_mutex);
 
     if (_metadataTableIsEmpty) {
@@ -1604,7 +2014,12 @@ bool SyncJournalDb::listFilesInPath(const QByteArray& path,
         return false;
     }
 
-    const auto query = _queryManager.get(PreparedSqlQueryManager::ListFilesInPathQuery, QByteArrayLiteral(GET_FILE_RECORD_QUERY " WHERE parent_hash(path) = ?1 ORDER BY path||'/' ASC"), _db);
+    return queryFilesInPath(_db, _queryManager, path, rowCallback);
+}
+
+bool SyncJournalDb::queryFilesInPath(SqlDatabase &db, PreparedSqlQueryManager &queryManager, const QByteArray &path, const std::function<void(const SyncJournalFileRecord&)> &rowCallback)
+{
+    const auto query = queryManager.get(PreparedSqlQueryManager::ListFilesInPathQuery, QByteArrayLiteral(GET_FILE_RECORD_QUERY " WHERE parentPhash = ?1 ORDER BY pathSortKey ASC"), db);
     if (!query) {
         qCWarning(lcDb) << "database error:" << query->error();
         return false;
@@ -1639,10 +2054,80 @@ bool SyncJournalDb::listFilesInPath(const QByteArray& path,
     return true;
 }
 
+void SyncJournalDb::setReadConnectionsEnabled(bool enabled)
+{
+    QMutexLocker locker(&_mutex);
+    _readConnectionsEnabled = enabled;
+}
+
+std::shared_ptr<SyncJournalDb::ReadConnection> SyncJournalDb::readConnection()
+{
+    // The owning thread must see its own uncommitted writes
+    if (!_readConnectionsAllowed || QThread::currentThread() == thread()) {
+        return {};
+    }
+
+    const auto currentThread = QThread::currentThreadId();
+    QMutexLocker locker(&_readConnections->mutex);
+    if (const auto it = _readConnections->byThread.constFind(currentThread); it != _readConnections->byThread.cend()) {
+        return it.value();
+    }
+
+    auto connection = std::make_shared<ReadConnection>();
+    // The writer already checked the consistency when opening the database
+    if (!connection->db.openReadOnly(_dbFile, false)) {
+        qCWarning(lcDb) << "Could not open read-only connection, reading through the writer connection:" << connection->db.error();
+        return {};
+    }
+    SqlQuery pragma(connection->db);
+    pragma.prepare("PRAGMA case_sensitive_like = ON;");
+    if (!pragma.exec()) {
+        qCWarning(lcDb) << "Could not set up read-only connection:" << pragma.error();
+        return {};
+    }
+    registerParentHashFunction(connection->db);
+
+    // Pooled threads come and go, don't keep connections of finished ones around.
+    // A connection dropped after an error is reopened on the same thread, watch it only once.
+    if (!_readConnections->watchedThreads.contains(currentThread)) {
+        _readConnections->watchedThreads.insert(currentThread);
+        threadExitCallbacks.callbacks.push_back([readConnections = std::weak_ptr<ReadConnections>(_readConnections), currentThread] {
+            if (const auto connections = readConnections.lock()) {
+                QMutexLocker locker(&connections->mutex);
+                connections->byThread.remove(currentThread);
+                connections->watchedThreads.remove(currentThread);
+            }
+        });
+    }
+
+    _readConnections->byThread.insert(currentThread, connection);
+    return connection;
+}
+
+void SyncJournalDb::dropReadConnection()
+{
+    // Opened again on the next read, like checkConnect() does for the writer
+    QMutexLocker locker(&_readConnections->mutex);
+    _readConnections->byThread.remove(QThread::currentThreadId());
+}
+
+void SyncJournalDb::closeReadConnections()
+{
+    _readConnectionsAllowed = false;
+    QMutexLocker locker(&_readConnections->mutex);
+    // Connections still in use are closed by their last user
+    _readConnections->byThread.clear();
+}
+
 int SyncJournalDb::getFileRecordCount()
 {
     QMutexLocker locker(&_mutex);
 
+    if (const auto result = flushPendingWrites(); !result) {
+        qCWarning(lcDb) << "Could not write the queued file records:" << result.error();
+        return -1;
+    }
+
     SqlQuery query(_db);
     query.prepare("SELECT COUNT(*) FROM metadata");
 
@@ -1734,39 +2219,25 @@ bool SyncJournalDb::updateLocalMetadata(const QString &filename,
     qCInfo(lcDb) << "Updating local metadata for:" << filename << modtime << size << inode;
 
     const qint64 phash = getPHash(filename.toUtf8());
-    if (!checkConnect()) {
+    if (!connectDatabase()) {
         qCWarning(lcDb) << "Failed to connect database.";
         return false;
     }
 
-    const auto query = _queryManager.get(PreparedSqlQueryManager::SetFileRecordLocalMetadataQuery, QByteArrayLiteral("UPDATE metadata"
-                                                                                                                     " SET inode=?2, modtime=?3, filesize=?4, lock=?5, lockType=?6,"
-                                                                                                                     " lockOwnerDisplayName=?7, lockOwnerId=?8, lockOwnerEditor = ?9,"
-                                                                                                                     " lockTime=?10, lockTimeout=?11, lockToken=?12"
-                                                                                                                     " WHERE phash == ?1;"),
-        _db);
-    if (!query) {
-        qCWarning(lcDb) << "database error:" << query->error();
-        return false;
+    auto pending = _pendingWrites.find(phash);
+    if (pending == _pendingWrites.end()) {
+        pending = _pendingWrites.insert(phash, {PendingWrite::LocalMetadata, {}});
+    } else if (pending->kind == PendingWrite::Delete) {
+        // Updating a deleted row does nothing
+        return true;
     }
+    // Applies to a queued record as well as to the stored row
+    pending->record._inode = inode;
+    pending->record._modtime = modtime;
+    pending->record._fileSize = size;
+    pending->record._lockstate = lockInfo;
 
-    query->bindValue(1, phash);
-    query->bindValue(2, inode);
-    query->bindValue(3, modtime);
-    query->bindValue(4, size);
-    query->bindValue(5, lockInfo._locked ? 1 : 0);
-    query->bindValue(6, lockInfo._lockOwnerType);
-    query->bindValue(7, lockInfo._lockOwnerDisplayName);
-    query->bindValue(8, lockInfo._lockOwnerId);
-    query->bindValue(9, lockInfo._lockEditorApp);
-    query->bindValue(10, lockInfo._lockTime);
-    query->bindValue(11, lockInfo._lockTimeout);
-    query->bindValue(12, lockInfo._lockToken);
-    if (!query->exec()) {
-        qCWarning(lcDb) << "database error:" << query->error();
-        return false;
-    }
-    return true;
+    return static_cast<bool>(flushPendingWritesIfFull());
 }
 
 Optional<SyncJournalDb::HasHydratedDehydrated> SyncJournalDb::hasHydratedOrDehydratedFiles(const QByteArray &filename)
@@ -1812,12 +2283,50 @@ Optional<SyncJournalDb::HasHydratedDehydrated> SyncJournalDb::hasHydratedOrDehyd
     return result;
 }
 
+// Stored as "start-end:received" for each segment, separated by ';'
+static QByteArray serializeDownloadSegments(const QVector<SyncJournalDb::DownloadSegment> &segments)
+{
+    QByteArrayList entries;
+    entries.reserve(segments.size());
+    for (const auto &segment : segments) {
+        entries.append(QByteArray::number(segment._start) + '-' + QByteArray::number(segment._end) + ':' + QByteArray::number(segment._received));
+    }
+    return entries.join(';');
+}
+
+static QVector<SyncJournalDb::DownloadSegment> parseDownloadSegments(const QByteArray &data)
+{
+    QVector<SyncJournalDb::DownloadSegment> segments;
+    if (data.isEmpty()) {
+        return segments;
+    }
+    for (const auto &entry : data.split(';')) {
+        const auto dash = entry.indexOf('-');
+        const auto colon = entry.indexOf(':', dash);
+        bool startOk = false;
+        bool endOk = false;
+        bool receivedOk = false;
+        SyncJournalDb::DownloadSegment segment;
+        segment._start = entry.left(dash).toLongLong(&startOk);
+        segment._end = entry.mid(dash + 1, colon - dash - 1).toLongLong(&endOk);
+        segment._received = entry.mid(colon + 1).toLongLong(&receivedOk);
+        if (dash < 0 || colon < 0 || !startOk || !endOk || !receivedOk
+            || segment._start > segment._end || segment._received < 0 || segment._received > segment._end - segment._start) {
+            qCWarning(lcDb) << "Ignoring invalid download segments" << data;
+            return {};
+        }
+        segments.append(segment);
+    }
+    return segments;
+}
+
 static void toDownloadInfo(SqlQuery &query, SyncJournalDb::DownloadInfo *res)
 {
     bool ok = true;
     res->_tmpfile = query.stringValue(0);
     res->_etag = query.baValue(1);
     res->_errorCount = query.intValue(2);
+    res->_segments = parseDownloadSegments(query.baValue(3));
     res->_valid = ok;
 }
 
@@ -1844,7 +2353,7 @@ SyncJournalDb::DownloadInfo SyncJournalDb::getDownloadInfo(const QString &file)
     DownloadInfo res;
 
     if (checkConnect()) {
-        const auto query = _queryManager.get(PreparedSqlQueryManager::GetDownloadInfoQuery, QByteArrayLiteral("SELECT tmpfile, etag, errorcount FROM downloadinfo WHERE path=?1"), _db);
+        const auto query = _queryManager.get(PreparedSqlQueryManager::GetDownloadInfoQuery, QByteArrayLiteral("SELECT tmpfile, etag, errorcount, segments FROM downloadinfo WHERE path=?1"), _db);
         if (!query) {
             qCWarning(lcDb) << "database error:" << query->error();
             return res;
@@ -1875,8 +2384,8 @@ void SyncJournalDb::setDownloadInfo(const QString &file, const SyncJournalDb::Do
 
     if (i._valid) {
         const auto query = _queryManager.get(PreparedSqlQueryManager::SetDownloadInfoQuery, QByteArrayLiteral("INSERT OR REPLACE INTO downloadinfo "
-                                                                                                              "(path, tmpfile, etag, errorcount) "
-                                                                                                              "VALUES ( ?1 , ?2, ?3, ?4 )"),
+                                                                                                              "(path, tmpfile, etag, errorcount, segments) "
+                                                                                                              "VALUES ( ?1 , ?2, ?3, ?4, ?5 )"),
             _db);
         if (!query) {
             qCWarning(lcDb) << "database error:" << query->error();
@@ -1886,6 +2395,7 @@ void SyncJournalDb::setDownloadInfo(const QString &file, const SyncJournalDb::Do
         query->bindValue(2, i._tmpfile);
         query->bindValue(3, i._etag);
         query->bindValue(4, i._errorCount);
+        query->bindValue(5, serializeDownloadSegments(i._segments));
         if (!query->exec()) {
             qCWarning(lcDb) << "database error:" << query->error();
         }
@@ -1913,7 +2423,7 @@ QVector<SyncJournalDb::DownloadInfo> SyncJournalDb::getAndDeleteStaleDownloadInf
 
     SqlQuery query(_db);
     // The selected values *must* match the ones expected by toDownloadInfo().
-    query.prepare("SELECT tmpfile, etag, errorcount, path FROM downloadinfo");
+    query.prepare("SELECT tmpfile, etag, errorcount, segments, path FROM downloadinfo");
 
     if (!query.exec()) {
         qCWarning(lcDb) << "database error:" << query.error();
@@ -1924,7 +2434,7 @@ QVector<SyncJournalDb::DownloadInfo> SyncJournalDb::getAndDeleteStaleDownloadInf
     QVector<SyncJournalDb::DownloadInfo> deleted_entries;
 
     while (query.next().hasData) {
-        const QString file = query.stringValue(3); // path
+        const QString file = query.stringValue(4); // path
         if (!keep.contains(file)) {
             superfluousPaths.append(file);
             DownloadInfo info;
@@ -2077,6 +2587,77 @@ QVector<uint> SyncJournalDb::deleteStaleUploadInfos(const QSet<QString> &keep)
     return ids;
 }
 
+SyncJournalDb::DeltaChunks SyncJournalDb::getDeltaChunks(const QString &file)
+{
+    QMutexLocker locker(&_mutex);
+
+    DeltaChunks res;
+
+    if (checkConnect()) {
+        const auto query = _queryManager.get(PreparedSqlQueryManager::GetDeltaChunksQuery, QByteArrayLiteral("SELECT etag, size, chunks FROM deltachunks WHERE path=?1"), _db);
+        if (!query) {
+            qCWarning(lcDb) << "database error:" << query->error();
+            return res;
+        }
+        query->bindValue(1, file);
+
+        if (!query->exec()) {
+            qCWarning(lcDb) << "database error:" << query->error();
+            return res;
+        }
+
+        if (query->next().hasData) {
+            res._etag = query->baValue(0);
+            res._size = query->int64Value(1);
+            res._chunks = ContentDefinedChunker::deserialize(query->baValue(2));
+        }
+    }
+    return res;
+}
+
+void SyncJournalDb::setDeltaChunks(const QString &file, const DeltaChunks &chunks)
+{
+    QMutexLocker locker(&_mutex);
+
+    if (!checkConnect()) {
+        return;
+    }
+
+    if (chunks.isValid()) {
+        const auto query = _queryManager.get(PreparedSqlQueryManager::SetDeltaChunksQuery, QByteArrayLiteral("INSERT OR REPLACE INTO deltachunks "
+                                                                                                             "(path, etag, size, chunks) "
+                                                                                                             "VALUES (?1, ?2, ?3, ?4)"),
+            _db);
+        if (!query) {
+            qCWarning(lcDb) << "database error:" << query->error();
+            return;
+        }
+
+        query->bindValue(1, file);
+        query->bindValue(2, chunks._etag);
+        query->bindValue(3, chunks._size);
+        query->bindValue(4, ContentDefinedChunker::serialize(chunks._chunks));
+
+        if (!query->exec()) {
+            qCWarning(lcDb) << "database error:" << query->error();
+            return;
+        }
+    } else {
+        const auto query = _queryManager.get(PreparedSqlQueryManager::DeleteDeltaChunksQuery, QByteArrayLiteral("DELETE FROM deltachunks WHERE path=?1"), _db);
+        if (!query) {
+            qCWarning(lcDb) << "database error:" << query->error();
+            return;
+        }
+
+        query->bindValue(1, file);
+
+        if (!query->exec()) {
+            qCWarning(lcDb) << "database error:" << query->error();
+            return;
+        }
+    }
+}
+
 SyncJournalErrorBlacklistRecord SyncJournalDb::errorBlacklistEntry(const QString &file)
 {
     QMutexLocker locker(&_mutex);
@@ -2156,6 +2737,18 @@ void SyncJournalDb::deleteStaleFlagsEntries()
     }
 }
 
+void SyncJournalDb::deleteStaleDeltaChunks()
+{
+    QMutexLocker locker(&_mutex);
+    if (!checkConnect())
+        return;
+
+    SqlQuery delQuery("DELETE FROM deltachunks WHERE path NOT IN (SELECT path from metadata);", _db);
+    if (!delQuery.exec()) {
+        sqlFail(QStringLiteral("deleteStaleDeltaChunks"), delQuery);
+    }
+}
+
 int SyncJournalDb::errorBlackListEntryCount()
 {
     int re = 0;
@@ -2470,6 +3063,56 @@ void SyncJournalDb::schedulePathForRemoteDiscovery(const QByteArray &fileName)
     _etagStorageFilter.append(argument);
 }
 
+int SyncJournalDb::scheduleFileIdsForRemoteDiscovery(const QList<qint64> &fileIds)
+{
+    QMutexLocker locker(&_mutex);
+
+    if (fileIds.isEmpty() || _metadataTableIsEmpty || !checkConnect()) {
+        return 0;
+    }
+
+    // The full ids are the numeric id, padded to 8 digits, followed by the instance id
+    SqlQuery query(_db);
+    query.prepare("SELECT fileid FROM metadata WHERE fileid GLOB '[0-9]*' LIMIT 1;");
+    if (!query.exec()) {
+        qCWarning(lcDb) << "database error:" << query.error();
+        return 0;
+    }
+    const auto next = query.next();
+    if (!next.ok || !next.hasData) {
+        return 0;
+    }
+    SyncJournalFileRecord knownRecord;
+    knownRecord._fileId = query.baValue(0);
+    const auto instanceId = knownRecord._fileId.mid(knownRecord.numericFileId().size());
+
+    int matched = 0;
+    QSet<QByteArray> paths;
+    for (const auto fileId : fileIds) {
+        const QByteArray fullFileId = QByteArray::number(fileId).rightJustified(8, '0') + instanceId;
+        auto found = false;
+        const auto ok = getFileRecordsByFileId(fullFileId, [&found, &paths](const SyncJournalFileRecord &record) {
+            found = true;
+            if (record.isDirectory()) {
+                paths.insert(record._path);
+            } else if (const auto slash = record._path.lastIndexOf('/'); slash > 0) {
+                paths.insert(record._path.left(slash));
+            }
+        });
+        if (!ok) {
+            break;
+        }
+        if (found) {
+            ++matched;
+        }
+    }
+
+    for (const auto &path : std::as_const(paths)) {
+        schedulePathForRemoteDiscovery(path);
+    }
+    return matched;
+}
+
 void SyncJournalDb::clearEtagStorageFilter()
 {
     _etagStorageFilter.clear();
@@ -2862,6 +3505,8 @@ QByteArray SyncJournalDb::conflictFileBaseName(const QByteArray &conflictName)
 void SyncJournalDb::clearFileTable()
 {
     QMutexLocker lock(&_mutex);
+    _pendingWrites.clear();
+    _failedWrites.clear();
     SqlQuery query(_db);
     query.prepare("DELETE FROM metadata;");
 
@@ -2994,6 +3639,90 @@ void SyncJournalDb::deleteE2EeLockedFolder(const QByteArray &folderId)
     }
 }
 
+QByteArray SyncJournalDb::e2EeFolderMetadataCache(const QByteArray &folderId, const QByteArray &etag)
+{
+    QMutexLocker locker(&_mutex);
+    if (!checkConnect()) {
+        return {};
+    }
+    const auto query = _queryManager.get(PreparedSqlQueryManager::GetE2EeFolderMetadataCacheQuery,
+                                         QByteArrayLiteral("SELECT metadata FROM e2EeFolderMetadataCache WHERE folderId=?1 AND etag=?2;"),
+                                         _db);
+    if (!query) {
+        qCWarning(lcDb) << "database error:" << query->error();
+        return {};
+    }
+    query->bindValue(1, folderId);
+    query->bindValue(2, etag);
+    if (!query->exec()) {
+        qCWarning(lcDb) << "database error:" << query->error();
+        return {};
+    }
+    if (!query->next().hasData) {
+        return {};
+    }
+
+    return query->baValue(0);
+}
+
+void SyncJournalDb::setE2EeFolderMetadataCache(const QByteArray &folderId, const QByteArray &etag, const QByteArray &metadata)
+{
+    QMutexLocker locker(&_mutex);
+    if (!checkConnect()) {
+        return;
+    }
+
+    const auto query = _queryManager.get(PreparedSqlQueryManager::SetE2EeFolderMetadataCacheQuery,
+                                         QByteArrayLiteral("INSERT OR REPLACE INTO e2EeFolderMetadataCache "
+                                                           "(folderId, etag, metadata) "
+                                                           "VALUES (?1, ?2, ?3);"),
+                                         _db);
+    if (!query) {
+        qCWarning(lcDb) << "database error:" << query->error();
+        return;
+    }
+    query->bindValue(1, folderId);
+    query->bindValue(2, etag);
+    query->bindValue(3, metadata);
+    if (!query->exec()) {
+        qCWarning(lcDb) << "database error:" << query->error();
+    }
+}
+
+void SyncJournalDb::deleteE2EeFolderMetadataCache(const QByteArray &folderId)
+{
+    QMutexLocker locker(&_mutex);
+    if (!checkConnect()) {
+        return;
+    }
+
+    const auto query = _queryManager.get(PreparedSqlQueryManager::DeleteE2EeFolderMetadataCacheQuery,
+                                         QByteArrayLiteral("DELETE FROM e2EeFolderMetadataCache WHERE folderId=?1;"),
+                                         _db);
+    if (!query) {
+        qCWarning(lcDb) << "database error:" << query->error();
+        return;
+    }
+    query->bindValue(1, folderId);
+    if (!query->exec()) {
+        qCWarning(lcDb) << "database error:" << query->error();
+    }
+}
+
+void SyncJournalDb::clearE2EeFolderMetadataCache()
+{
+    QMutexLocker locker(&_mutex);
+    if (!checkConnect()) {
+        return;
+    }
+
+    SqlQuery query(_db);
+    query.prepare("DELETE FROM e2EeFolderMetadataCache;");
+    if (!query.exec()) {
+        qCWarning(lcDb) << "database error:" << query.error();
+    }
+}
+
 Optional<PinState> SyncJournalDb::PinStateInterface::rawForPath(const QByteArray &path)
 {
     QMutexLocker lock(&_db->_mutex);
@@ -3186,10 +3915,10 @@ SyncJournalDb::PinStateInterface SyncJournalDb::internalPinStates()
     return PinStateInterface{this};
 }
 
-void SyncJournalDb::commit(const QString &context, bool startTrans)
+bool SyncJournalDb::commit(const QString &context, bool startTrans)
 {
     QMutexLocker lock(&_mutex);
-    commitInternal(context, startTrans);
+    return commitInternal(context, startTrans);
 }
 
 void SyncJournalDb::commitIfNeededAndStartNewTransaction(const QString &context)
@@ -3214,14 +3943,21 @@ bool SyncJournalDb::isOpen()
     return _db.isOpen();
 }
 
-void SyncJournalDb::commitInternal(const QString &context, bool startTrans)
+bool SyncJournalDb::commitInternal(const QString &context, bool startTrans)
 {
     qCDebug(lcDb) << "Transaction commit" << context << (startTrans ? "and starting new transaction" : "");
+    // Whatever was queued becomes durable with this commit, as if written right away
+    requeueFailedWrites();
+    const auto result = flushPendingWrites();
+    if (!result) {
+        qCWarning(lcDb) << "Could not write the queued file records:" << result.error();
+    }
     commitTransaction();
 
     if (startTrans) {
         startTransaction();
     }
+    return static_cast<bool>(result);
 }
 
 SyncJournalDb::~SyncJournalDb()
@@ -3232,13 +3968,22 @@ SyncJournalDb::~SyncJournalDb()
 }
 
 
+bool operator==(const SyncJournalDb::DownloadSegment &lhs,
+    const SyncJournalDb::DownloadSegment &rhs)
+{
+    return lhs._start == rhs._start
+        && lhs._end == rhs._end
+        && lhs._received == rhs._received;
+}
+
 bool operator==(const SyncJournalDb::DownloadInfo &lhs,
     const SyncJournalDb::DownloadInfo &rhs)
 {
     return lhs._errorCount == rhs._errorCount
         && lhs._etag == rhs._etag
         && lhs._tmpfile == rhs._tmpfile
-        && lhs._valid == rhs._valid;
+        && lhs._valid == rhs._valid
+        && lhs._segments == rhs._segments;
 }
 
 bool operator==(const SyncJournalDb::UploadInfo &lhs,
@@ -12,9 +12,12 @@
 #include <QHash>
 #include <QMutex>
 #include <QVariant>
+#include <atomic>
 #include <functional>
+#include <memory>
 
 #include "common/utility.h"
+#include "common/contentdefinedchunker.h"
 #include "common/ownsql.h"
 #include "common/preparedsqlquerymanager.h"
 #include "common/syncjournalfilerecord.h"
@@ -29,7 +32,11 @@ class SyncJournalFileRecord;
 /**
  * @brief Class that handles the sync database
  *
- * This class is thread safe. All public functions lock the mutex.
+ * This class is thread safe. All public functions lock the mutex, except for
+ * getFileRecord(), getFilesBelowPath() and listFilesInPath() when called from
+ * another thread than the one owning the journal: with setReadConnectionsEnabled()
+ * and the database in WAL mode those read through a read-only connection of
+ * their own, so they don't wait for the writer. Such readers only see committed data.
  * @ingroup libsync
  */
 class OCSYNC_EXPORT SyncJournalDb : public QObject
@@ -54,11 +61,28 @@ public:
     // To verify that the record could be found check with SyncJournalFileRecord::isValid()
     [[nodiscard]] bool getFileRecord(const QString &filename, SyncJournalFileRecord *rec) { return getFileRecord(filename.toUtf8(), rec); }
     [[nodiscard]] bool getFileRecord(const QByteArray &filename, SyncJournalFileRecord *rec);
+
+    /** Let other threads read through read-only connections of their own.
+     *
+     * This needs the NORMAL SQLite locking mode instead of EXCLUSIVE. That relies on the
+     * -shm shared memory file, which is unreliable on network file systems, and no longer
+     * keeps a second client from opening the same journal, hence it is opt-in. Takes
+     * effect when the database is opened. OWNCLOUD_SQLITE_LOCKING_MODE still overrides
+     * the locking mode.
+     */
+    void setReadConnectionsEnabled(bool enabled);
     [[nodiscard]] bool getFileRecordByE2eMangledName(const QString &mangledName, SyncJournalFileRecord *rec);
     [[nodiscard]] bool getFileRecordByInode(quint64 inode, SyncJournalFileRecord *rec);
     [[nodiscard]] bool getFileRecordsByFileId(const QByteArray &fileId, const std::function<void(const SyncJournalFileRecord &)> &rowCallback);
     [[nodiscard]] bool getFilesBelowPath(const QByteArray &path, const std::function<void(const SyncJournalFileRecord&)> &rowCallback);
     [[nodiscard]] bool listFilesInPath(const QByteArray &path, const std::function<void(const SyncJournalFileRecord&)> &rowCallback);
+    /** Queues the record to be written.
+     *
+     * Like deleteFileRecord() without recursion and updateLocalMetadata(), the write
+     * is executed with others in multi-row statements: once enough writes are queued,
+     * before any other query of this connection and before every commit. getFileRecord()
+     * sees queued writes right away, readers on other threads see committed data only.
+     */
     [[nodiscard]] Result<void, QString> setFileRecord(const SyncJournalFileRecord &record);
     [[nodiscard]] bool getRootE2eFolderRecord(const QString &remoteFolderPath, SyncJournalFileRecord *rec);
     [[nodiscard]] bool listAllE2eeFoldersWithEncryptionStatusLessThan(const int status, const std::function<void(const SyncJournalFileRecord &)> &rowCallback);
@@ -99,12 +123,26 @@ public:
     [[nodiscard]] int wipeErrorBlacklist();
     int errorBlackListEntryCount();
 
+    struct DownloadSegment
+    {
+        qint64 _start = 0;
+        qint64 _end = 0; // exclusive
+        qint64 _received = 0; // bytes written to the temporary file after _start
+
+        [[nodiscard]] bool isComplete() const { return _start + _received >= _end; }
+    };
     struct DownloadInfo
     {
         QString _tmpfile;
         QByteArray _etag;
         int _errorCount = 0;
         bool _valid = false;
+        /**
+         * Set if the file is downloaded with several ranged requests, the
+         * temporary file then has the full size from the start and only the
+         * received part of each segment is valid.
+         */
+        QVector<DownloadSegment> _segments;
     };
     struct UploadInfo
     {
@@ -123,6 +161,20 @@ public:
         [[nodiscard]] bool isChunked() const { return _transferid != 0; }
     };
 
+    /**
+     * Content defined chunks of a file as it was last uploaded, used to only
+     * upload the chunks that changed the next time. They are only valid while
+     * the server still has the version with the etag.
+     */
+    struct DeltaChunks
+    {
+        QByteArray _etag;
+        qint64 _size = 0;
+        QVector<ContentDefinedChunker::Chunk> _chunks;
+
+        [[nodiscard]] bool isValid() const { return !_etag.isEmpty() && !_chunks.isEmpty(); }
+    };
+
     struct PollInfo
     {
         QString _file; // The relative path of a file
@@ -141,11 +193,17 @@ public:
     // Return the list of transfer ids that were removed.
     QVector<uint> deleteStaleUploadInfos(const QSet<QString> &keep);
 
+    DeltaChunks getDeltaChunks(const QString &file);
+    /// Stores the chunks of file, or removes them if chunks is not valid
+    void setDeltaChunks(const QString &file, const DeltaChunks &chunks);
+
     SyncJournalErrorBlacklistRecord errorBlacklistEntry(const QString &);
     [[nodiscard]] bool deleteStaleErrorBlacklistEntries(const QSet<QString> &keep);
 
     /// Delete flags table entries that have no metadata correspondent
     void deleteStaleFlagsEntries();
+    /// Delete the delta chunks of files that are no longer in the metadata table
+    void deleteStaleDeltaChunks();
 
     void avoidRenamesOnNextSync(const QString &path) { avoidRenamesOnNextSync(path.toUtf8()); }
     void avoidRenamesOnNextSync(const QByteArray &path);
@@ -196,6 +254,17 @@ public:
     void schedulePathForRemoteDiscovery(const QString &fileName) { schedulePathForRemoteDiscovery(fileName.toUtf8()); }
     void schedulePathForRemoteDiscovery(const QByteArray &fileName);
 
+    /**
+     * Calls schedulePathForRemoteDiscovery() for the folders with the given
+     * numeric file ids and for the folders containing the files with them.
+     *
+     * Push notifications only carry the numeric part of the file ids, the
+     * suffix identifying the server instance is taken from the known records.
+     *
+     * Returns the number of ids that matched a record.
+     */
+    int scheduleFileIdsForRemoteDiscovery(const QList<qint64> &fileIds);
+
     /**
      * Wipe _etagStorageFilter. Also done implicitly on close().
      */
@@ -210,8 +279,11 @@ public:
 
     /* Because sqlite transactions are really slow, we encapsulate everything in big transactions
      * Commit will actually commit the transaction and create a new one.
+     *
+     * Returns false if the queued file record writes failed. They stay
+     * queued and are tried again with the next commit.
      */
-    void commit(const QString &context, bool startTrans = true);
+    bool commit(const QString &context, bool startTrans = true);
     void commitIfNeededAndStartNewTransaction(const QString &context);
 
     /** Open the db if it isn't already.
@@ -292,6 +364,13 @@ public:
     QList<QPair<QByteArray, QByteArray>> e2EeLockedFolders();
     void deleteE2EeLockedFolder(const QByteArray &folderId);
 
+    /// The cached metadata of an encrypted folder, empty unless it was stored for this etag of the folder
+    QByteArray e2EeFolderMetadataCache(const QByteArray &folderId, const QByteArray &etag);
+    void setE2EeFolderMetadataCache(const QByteArray &folderId, const QByteArray &etag, const QByteArray &metadata);
+    void deleteE2EeFolderMetadataCache(const QByteArray &folderId);
+    /// Forget the cached metadata of all encrypted folders, when the end-to-end encryption is reset
+    void clearE2EeFolderMetadataCache();
+
     /** Grouping for all functions relating to pin states,
      *
      * Use internalPinStates() to get at them.
@@ -408,15 +487,54 @@ private:
     [[nodiscard]] bool removeColumn(const QString &columnName);
     [[nodiscard]] bool hasDefaultValue(const QString &columnName);
     bool sqlFail(const QString &log, const SqlQuery &query);
-    void commitInternal(const QString &context, bool startTrans = true);
+    bool commitInternal(const QString &context, bool startTrans = true);
     void startTransaction();
     void commitTransaction();
     QVector<QByteArray> tableColumns(const QByteArray &table);
+    /// Opens the db if needed and executes the queued writes
     bool checkConnect();
+    /// Opens the db if needed, leaving queued writes queued
+    bool connectDatabase();
+
+    Result<void, QString> flushPendingWrites();
+    Result<void, QString> flushPendingWritesIfFull();
+    /// Queues the writes that failed again, for a commit to retry them
+    void requeueFailedWrites();
+    void bindFileRecord(SqlQuery &query, int offset, const SyncJournalFileRecord &record);
 
     // Same as forceRemoteDiscoveryNextSync but without acquiring the lock
     void forceRemoteDiscoveryNextSyncLocked();
 
+    /// A read-only connection used by a single thread
+    struct ReadConnection
+    {
+        SqlDatabase db;
+        PreparedSqlQueryManager queryManager;
+    };
+
+    /// The read-only connections by thread, the threads drop theirs when they exit
+    struct ReadConnections
+    {
+        QMutex mutex; // never held while querying
+        QHash<Qt::HANDLE, std::shared_ptr<ReadConnection>> byThread;
+        QSet<Qt::HANDLE> watchedThreads; // threads that drop their connection on exit
+    };
+
+    /** The read-only connection of the calling thread, opened on first use.
+     *
+     * Returns nullptr if reads have to use the writer connection: on the thread
+     * owning the journal, if read connections are not enabled or the database
+     * can't be shared (not WAL, exclusive locking) or if opening failed.
+     */
+    [[nodiscard]] std::shared_ptr<ReadConnection> readConnection();
+    void dropReadConnection();
+    void closeReadConnections();
+
+    // The queries behind the public read functions, for the writer and the read-only connections
+    [[nodiscard]] static bool queryFileRecord(SqlDatabase &db, PreparedSqlQueryManager &queryManager, const QByteArray &filename, SyncJournalFileRecord *rec);
+    [[nodiscard]] static bool queryFilesBelowPath(SqlDatabase &db, PreparedSqlQueryManager &queryManager, const QByteArray &path, const std::function<void(const SyncJournalFileRecord&)> &rowCallback);
+    [[nodiscard]] static bool queryFilesInPath(SqlDatabase &db, PreparedSqlQueryManager &queryManager, const QByteArray &path, const std::function<void(const SyncJournalFileRecord&)> &rowCallback);
+
     // Returns the integer id of the checksum type
     //
     // Returns 0 on failure and for empty checksum types.
@@ -429,6 +547,25 @@ private:
     int _transaction = 0;
     bool _metadataTableIsEmpty = false;
 
+    /// A queued metadata write, see setFileRecord()
+    struct PendingWrite
+    {
+        enum Kind {
+            Upsert,
+            Delete,
+            LocalMetadata,
+        };
+        Kind kind = Upsert;
+        /// The whole record for Upsert, only the local metadata fields for LocalMetadata
+        SyncJournalFileRecord record;
+
+        bool operator==(const PendingWrite &other) const { return kind == other.kind && record == other.record; }
+    };
+    /// The latest write per phash, each write only touches that row
+    QHash<qint64, PendingWrite> _pendingWrites;
+    /// Writes the database refused, they are only tried again by the next commit
+    QHash<qint64, PendingWrite> _failedWrites;
+
     /* Storing etags to these folders, or their parent folders, is filtered out.
      *
      * When schedulePathForRemoteDiscovery() is called some etags to _invalid_ in the
@@ -453,9 +590,17 @@ private:
 
     PreparedSqlQueryManager _queryManager;
 
+    // Whether the database allows readers next to the writer, set by checkConnect()
+    std::atomic<bool> _readConnectionsAllowed{false};
+    std::shared_ptr<ReadConnections> _readConnections = std::make_shared<ReadConnections>();
+    bool _readConnectionsEnabled = false;
+
     friend class ::TestSyncJournalDB;
 };
 
+bool OCSYNC_EXPORT
+operator==(const SyncJournalDb::DownloadSegment &lhs,
+    const SyncJournalDb::DownloadSegment &rhs);
 bool OCSYNC_EXPORT
 operator==(const SyncJournalDb::DownloadInfo &lhs,
     const SyncJournalDb::DownloadInfo &rhs);
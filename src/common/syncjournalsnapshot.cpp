@@ -0,0 +1,249 @@
+/*
+ * SPDX-FileCopyrightText: 2026 Nextcloud GmbH and Nextcloud contributors
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "syncjournalsnapshot.h"
+#include "syncjournaldb.h"
+
+#include <QElapsedTimer>
+#include <QLoggingCategory>
+
+#include <limits>
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcJournalSnapshot, "nextcloud.sync.database.snapshot", QtInfoMsg)
+
+namespace {
+
+bool hasDefaultLockState(const SyncJournalFileLockInfo &lockstate)
+{
+    return !lockstate._locked
+        && lockstate._lockOwnerDisplayName.isEmpty()
+        && lockstate._lockOwnerId.isEmpty()
+        && lockstate._lockOwnerType == 0
+        && lockstate._lockEditorApp.isEmpty()
+        && lockstate._lockTime == 0
+        && lockstate._lockTimeout == 0
+        && lockstate._lockToken.isEmpty();
+}
+
+}
+
+bool SyncJournalSnapshot::load(SyncJournalDb &journal)
+{
+    clear();
+
+    QElapsedTimer timer;
+    timer.start();
+
+    const auto expectedRecords = journal.getFileRecordCount();
+    if (expectedRecords > 0) {
+        _records.reserve(expectedRecords);
+    }
+
+    // Records arrive sorted by path, so most of them have the same parent as the one before
+    QByteArray lastParentPath;
+    auto lastParent = directoryIndex({});
+    auto tooLarge = false;
+
+    const auto ok = journal.getFilesBelowPath({}, [&](const SyncJournalFileRecord &rec) {
+        if (tooLarge) {
+            return;
+        }
+        const auto stringsSize = rec._path.size() + rec._etag.size() + rec._fileId.size() + rec._checksumHeader.size() + rec._e2eMangledName.size();
+        if (_strings.size() + stringsSize > std::numeric_limits<quint32>::max()) {
+            tooLarge = true;
+            return;
+        }
+
+        const auto slash = rec._path.lastIndexOf('/');
+        const auto parentPath = slash < 0 ? QByteArrayView() : QByteArrayView(rec._path).first(slash);
+        if (parentPath != QByteArrayView(lastParentPath)) {
+            lastParentPath = parentPath.toByteArray();
+            lastParent = directoryIndex(parentPath);
+        }
+
+        Record record;
+        record.directory = lastParent;
+        record.name = append(rec._path.mid(slash + 1));
+        record.etag = append(rec._etag);
+        record.fileId = append(rec._fileId);
+        record.checksumHeader = append(rec._checksumHeader);
+        record.e2eMangledName = append(rec._e2eMangledName);
+        record.inode = rec._inode;
+        record.modtime = rec._modtime;
+        record.fileSize = rec._fileSize;
+        record.lastShareStateFetchedTimestamp = rec._lastShareStateFetchedTimestamp;
+        record.folderQuota = rec._folderQuota;
+        record.remotePerm = rec._remotePerm;
+        record.type = rec._type;
+        record.e2eEncryptionStatus = rec._e2eEncryptionStatus;
+        record.flags = (rec._serverHasIgnoredFiles ? ServerHasIgnoredFiles : 0)
+            | (rec._isShared ? IsShared : 0)
+            | (rec._sharedByMe ? SharedByMe : 0)
+            | (rec._isLivePhoto ? IsLivePhoto : 0);
+        if (!hasDefaultLockState(rec._lockstate) || !rec._livePhotoFile.isEmpty()) {
+            record.extra = static_cast<quint32>(_extras.size());
+            _extras.push_back({rec._lockstate, rec._livePhotoFile});
+        }
+        _records.push_back(record);
+        ++_directories[lastParent].count;
+    });
+
+    if (!ok || tooLarge) {
+        qCWarning(lcJournalSnapshot) << "Could not load the journal" << (tooLarge ? "(too large)" : "");
+        clear();
+        return false;
+    }
+
+    // Make the children of each directory adjacent; within a directory the
+    // records keep the path order of the query
+    quint32 first = 0;
+    for (auto &directory : _directories) {
+        directory.first = first;
+        first += directory.count;
+    }
+    {
+        std::vector<quint32> next;
+        next.reserve(_directories.size());
+        for (const auto &directory : _directories) {
+            next.push_back(directory.first);
+        }
+        std::vector<Record> sorted(_records.size());
+        for (auto &record : _records) {
+            sorted[next[record.directory]++] = record;
+        }
+        _records.swap(sorted);
+    }
+    _strings.squeeze();
+    _loaded = true;
+
+    qCInfo(lcJournalSnapshot) << "Loaded" << _records.size() << "records in" << _directories.size() << "directories,"
+                              << memoryUsage() << "bytes, in" << timer.elapsed() << "ms";
+    return true;
+}
+
+void SyncJournalSnapshot::clear()
+{
+    _strings = QByteArray();
+    std::vector<Record>().swap(_records);
+    std::vector<Extra>().swap(_extras);
+    std::vector<Directory>().swap(_directories);
+    _directoryByPath.clear();
+    _loaded = false;
+}
+
+qint64 SyncJournalSnapshot::memoryUsage() const
+{
+    qint64 usage = _strings.capacity()
+        + static_cast<qint64>(_records.capacity() * sizeof(Record))
+        + static_cast<qint64>(_extras.capacity() * sizeof(Extra))
+        + static_cast<qint64>(_directories.capacity() * sizeof(Directory));
+    for (auto it = _directoryByPath.cbegin(); it != _directoryByPath.cend(); ++it) {
+        usage += it.key().capacity() + static_cast<qint64>(sizeof(QByteArray) + sizeof(quint32));
+    }
+    return usage;
+}
+
+void SyncJournalSnapshot::listFilesInPath(const QByteArray &path, const std::function<void(const SyncJournalFileRecord &)> &rowCallback) const
+{
+    const auto it = _directoryByPath.constFind(path);
+    if (it == _directoryByPath.cend()) {
+        return;
+    }
+
+    const auto &directory = _directories[*it];
+    SyncJournalFileRecord rec;
+    for (auto i = directory.first; i < directory.first + directory.count; ++i) {
+        const auto &record = _records[i];
+        if (record.flags & Removed) {
+            continue;
+        }
+        fillRecord(path, record, rec);
+        rowCallback(rec);
+    }
+}
+
+void SyncJournalSnapshot::removeRecursively(const QByteArray &path)
+{
+    const auto slash = path.lastIndexOf('/');
+    const auto parentPath = slash < 0 ? QByteArray() : path.left(slash);
+    const auto name = QByteArrayView(path).sliced(slash + 1);
+    if (const auto it = _directoryByPath.constFind(parentPath); it != _directoryByPath.cend()) {
+        const auto &directory = _directories[*it];
+        for (auto i = directory.first; i < directory.first + directory.count; ++i) {
+            if (view(_records[i].name) == name) {
+                _records[i].flags |= Removed;
+            }
+        }
+    }
+
+    // The directories below path are adjacent in the sorted map
+    _directoryByPath.remove(path);
+    const QByteArray pathPrefix = path + '/';
+    auto it = _directoryByPath.lowerBound(pathPrefix);
+    while (it != _directoryByPath.end() && it.key().startsWith(pathPrefix)) {
+        it = _directoryByPath.erase(it);
+    }
+}
+
+quint32 SyncJournalSnapshot::directoryIndex(QByteArrayView path)
+{
+    const auto key = path.toByteArray();
+    if (const auto it = _directoryByPath.constFind(key); it != _directoryByPath.cend()) {
+        return *it;
+    }
+    const auto index = static_cast<quint32>(_directories.size());
+    _directories.emplace_back();
+    _directoryByPath.insert(key, index);
+    return index;
+}
+
+SyncJournalSnapshot::Slice SyncJournalSnapshot::append(const QByteArray &value)
+{
+    if (value.isEmpty()) {
+        return {};
+    }
+    const Slice slice{static_cast<quint32>(_strings.size()), static_cast<quint32>(value.size())};
+    _strings.append(value);
+    return slice;
+}
+
+void SyncJournalSnapshot::fillRecord(const QByteArray &directoryPath, const Record &record, SyncJournalFileRecord &rec) const
+{
+    const auto name = view(record.name);
+    rec._path.clear();
+    if (!directoryPath.isEmpty()) {
+        rec._path.reserve(directoryPath.size() + 1 + name.size());
+        rec._path.append(directoryPath).append('/');
+    }
+    rec._path.append(name);
+    rec._etag = view(record.etag).toByteArray();
+    rec._fileId = view(record.fileId).toByteArray();
+    rec._checksumHeader = view(record.checksumHeader).toByteArray();
+    rec._e2eMangledName = view(record.e2eMangledName).toByteArray();
+    rec._inode = record.inode;
+    rec._modtime = record.modtime;
+    rec._fileSize = record.fileSize;
+    rec._lastShareStateFetchedTimestamp = record.lastShareStateFetchedTimestamp;
+    rec._folderQuota = record.folderQuota;
+    rec._remotePerm = record.remotePerm;
+    rec._type = record.type;
+    rec._e2eEncryptionStatus = record.e2eEncryptionStatus;
+    rec._serverHasIgnoredFiles = record.flags & ServerHasIgnoredFiles;
+    rec._isShared = record.flags & IsShared;
+    rec._sharedByMe = record.flags & SharedByMe;
+    rec._isLivePhoto = record.flags & IsLivePhoto;
+    if (record.extra != noExtra) {
+        const auto &extra = _extras[record.extra];
+        rec._lockstate = extra.lockstate;
+        rec._livePhotoFile = extra.livePhotoFile;
+    } else {
+        rec._lockstate = {};
+        rec._livePhotoFile.clear();
+    }
+}
+
+}
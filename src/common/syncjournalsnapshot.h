@@ -0,0 +1,122 @@
+/*
+ * SPDX-FileCopyrightText: 2026 Nextcloud GmbH and Nextcloud contributors
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#pragma once
+
+#include "common/syncjournalfilerecord.h"
+#include "ocsynclib.h"
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QMap>
+
+#include <functional>
+#include <vector>
+
+namespace OCC {
+
+class SyncJournalDb;
+
+/**
+ * @brief Read-only copy of the file records of a journal
+ *
+ * Loaded with a single pass over the metadata table, sorted by path. Records
+ * only keep their file name, the path of their parent directory is stored
+ * once and shared by all its children. The records of one directory are
+ * adjacent in a single array and all their strings live in one buffer, so a
+ * snapshot needs a handful of allocations in total instead of several per
+ * record.
+ *
+ * Discovery uses it instead of one SyncJournalDb::listFilesInPath() query
+ * per directory. It is not updated by writes to the journal, except through
+ * removeRecursively().
+ *
+ * @ingroup libsync
+ */
+class OCSYNC_EXPORT SyncJournalSnapshot
+{
+public:
+    /// Reads all file records of the journal, returns false on database errors
+    [[nodiscard]] bool load(SyncJournalDb &journal);
+    void clear();
+
+    [[nodiscard]] bool isLoaded() const { return _loaded; }
+    [[nodiscard]] qint64 recordCount() const { return static_cast<qint64>(_records.size()); }
+
+    /// Approximate number of bytes held by the snapshot
+    [[nodiscard]] qint64 memoryUsage() const;
+
+    /// Calls rowCallback for every direct child of path, like SyncJournalDb::listFilesInPath()
+    void listFilesInPath(const QByteArray &path, const std::function<void(const SyncJournalFileRecord &)> &rowCallback) const;
+
+    /// Forgets path and everything below it, to follow SyncJournalDb::deleteFileRecord(path, true)
+    void removeRecursively(const QByteArray &path);
+
+private:
+    struct Slice
+    {
+        quint32 offset = 0;
+        quint32 length = 0;
+    };
+
+    enum Flag : quint8 {
+        ServerHasIgnoredFiles = 0x1,
+        IsShared = 0x2,
+        SharedByMe = 0x4,
+        IsLivePhoto = 0x8,
+        Removed = 0x10,
+    };
+
+    static constexpr quint32 noExtra = 0xffffffff;
+
+    struct Record
+    {
+        quint32 directory = 0; // index in _directories of the parent directory
+        quint32 extra = noExtra; // index in _extras
+        Slice name;
+        Slice etag;
+        Slice fileId;
+        Slice checksumHeader;
+        Slice e2eMangledName;
+        quint64 inode = 0;
+        qint64 modtime = 0;
+        qint64 fileSize = 0;
+        qint64 lastShareStateFetchedTimestamp = 0;
+        SyncJournalFileRecord::FolderQuota folderQuota;
+        RemotePermissions remotePerm;
+        ItemType type = ItemTypeSkip;
+        SyncJournalFileRecord::EncryptionStatus e2eEncryptionStatus = SyncJournalFileRecord::EncryptionStatus::NotEncrypted;
+        quint8 flags = 0;
+    };
+
+    // The fields hardly any record uses
+    struct Extra
+    {
+        SyncJournalFileLockInfo lockstate;
+        QString livePhotoFile;
+    };
+
+    // The children of a directory: _records[first] to _records[first + count - 1]
+    struct Directory
+    {
+        quint32 first = 0;
+        quint32 count = 0;
+    };
+
+    [[nodiscard]] quint32 directoryIndex(QByteArrayView path);
+    [[nodiscard]] Slice append(const QByteArray &value);
+    [[nodiscard]] QByteArrayView view(Slice slice) const { return QByteArrayView(_strings).sliced(slice.offset, slice.length); }
+    void fillRecord(const QByteArray &directoryPath, const Record &record, SyncJournalFileRecord &rec) const;
+
+    QByteArray _strings;
+    std::vector<Record> _records;
+    std::vector<Extra> _extras;
+    std::vector<Directory> _directories;
+    // Sorted, so that removeRecursively() finds a subtree with a single lookup
+    QMap<QByteArray, quint32> _directoryByPath;
+    bool _loaded = false;
+};
+
+}
@@ -28,6 +28,8 @@
 #include <QDir>
 #include <QVariant>
 
+#include <algorithm>
+
 /** Expands C-like escape sequences (in place)
  */
 OCSYNC_EXPORT void csync_exclude_expand_escapes(QByteArray &input)
@@ -315,8 +317,8 @@ bool ExcludedFiles::reloadExcludeFiles()
 {
     _allExcludes.clear();
     // clear all regex
-    _bnameTraversalRegexFile.clear();
-    _bnameTraversalRegexDir.clear();
+    _bnameTraversalFile.clear();
+    _bnameTraversalDir.clear();
     _fullTraversalRegexFile.clear();
     _fullTraversalRegexDir.clear();
     _fullRegexFile.clear();
@@ -453,43 +455,35 @@ CSYNC_EXCLUDE_TYPE ExcludedFiles::traversalPatternMatch(const QString &path, Ite
         bnameStr = bnameStr.mid(lastSlash + 1);
     }
 
+    if (filetype != ItemTypeDirectory && filetype != ItemTypeFile)
+        return CSYNC_NOT_EXCLUDED;
+    const auto &bnameTraversal = filetype == ItemTypeDirectory ? _bnameTraversalDir : _bnameTraversalFile;
+
     QString basePath(_localPath + path);
     while (basePath.size() > _localPath.size()) {
         basePath = leftIncludeLast(basePath, QLatin1Char('/'));
-        QRegularExpressionMatch m;
-        if (filetype == ItemTypeDirectory
-            && _bnameTraversalRegexDir.contains(basePath)) {
-            m = _bnameTraversalRegexDir[basePath].matchView(bnameStr);
-        } else if (filetype == ItemTypeFile
-            && _bnameTraversalRegexFile.contains(basePath)) {
-            m = _bnameTraversalRegexFile[basePath].matchView(bnameStr);
-        } else {
+        const auto it = bnameTraversal.constFind(basePath);
+        if (it == bnameTraversal.cend())
             continue;
-        }
 
-        if (!m.hasMatch())
-            return CSYNC_NOT_EXCLUDED;
-        if (m.capturedStart(QStringLiteral("exclude")) != -1) {
+        if (it->exclude.matches(bnameStr))
             return CSYNC_FILE_EXCLUDE_LIST;
-        } else if (m.capturedStart(QStringLiteral("excluderemove")) != -1) {
+        if (it->excludeRemove.matches(bnameStr))
             return CSYNC_FILE_EXCLUDE_AND_REMOVE;
-        }
+        if (!it->trigger.matches(bnameStr))
+            return CSYNC_NOT_EXCLUDED;
     }
 
     // third capture: full path matching is triggered
     basePath = _localPath + path;
     while (basePath.size() > _localPath.size()) {
         basePath = leftIncludeLast(basePath, QLatin1Char('/'));
-        QRegularExpressionMatch m;
-        if (filetype == ItemTypeDirectory
-            && _fullTraversalRegexDir.contains(basePath)) {
-            m = _fullTraversalRegexDir[basePath].match(path);
-        } else if (filetype == ItemTypeFile
-            && _fullTraversalRegexFile.contains(basePath)) {
-            m = _fullTraversalRegexFile[basePath].match(path);
-        } else {
+        const auto &fullTraversalRegex = filetype == ItemTypeDirectory ? _fullTraversalRegexDir : _fullTraversalRegexFile;
+        const auto it = fullTraversalRegex.constFind(basePath);
+        if (it == fullTraversalRegex.cend())
             continue;
-        }
+
+        const auto m = it->match(path);
 
         if (m.hasMatch()) {
             if (m.capturedStart(QStringLiteral("exclude")) != -1) {
@@ -673,11 +667,79 @@ QString ExcludedFiles::extractBnameTrigger(const QString &exclude, bool wildcard
     return pattern;
 }
 
+void ExcludedFiles::BnameMatcher::addPattern(const QString &pattern)
+{
+    _patterns.append(pattern);
+}
+
+void ExcludedFiles::BnameMatcher::prepare(Qt::CaseSensitivity caseSensitivity)
+{
+    _caseSensitivity = caseSensitivity;
+    _names.clear();
+    _affixes.clear();
+
+    const auto isSpecial = [](QChar c) {
+        return c == QLatin1Char('?') || c == QLatin1Char('[') || c == QLatin1Char('\\');
+    };
+
+    QString regexPattern;
+    for (const auto &pattern : std::as_const(_patterns)) {
+        const auto wildcards = pattern.count(QLatin1Char('*'));
+        if (wildcards <= 1 && std::none_of(pattern.cbegin(), pattern.cend(), isSpecial)) {
+            if (wildcards == 0) {
+                _names.append(pattern);
+            } else {
+                const auto star = pattern.indexOf(QLatin1Char('*'));
+                _affixes.append({pattern.left(star), pattern.mid(star + 1)});
+            }
+            continue;
+        }
+
+        // A bname never contains a slash, so whether wildcards match one does not matter
+        if (!regexPattern.isEmpty())
+            regexPattern.append(QLatin1Char('|'));
+        regexPattern.append(convertToRegexpSyntax(pattern, true));
+    }
+
+    const auto lessThan = [caseSensitivity](const QString &a, const QString &b) {
+        return a.compare(b, caseSensitivity) < 0;
+    };
+    std::sort(_names.begin(), _names.end(), lessThan);
+
+    _hasRegex = !regexPattern.isEmpty();
+    _regex = QRegularExpression();
+    if (_hasRegex) {
+        _regex.setPattern(QStringLiteral("^(?:%1)$").arg(regexPattern));
+        if (caseSensitivity == Qt::CaseInsensitive)
+            _regex.setPatternOptions(QRegularExpression::CaseInsensitiveOption);
+        _regex.optimize();
+    }
+}
+
+bool ExcludedFiles::BnameMatcher::matches(QStringView bname) const
+{
+    const auto name = std::lower_bound(_names.cbegin(), _names.cend(), bname, [this](const QString &a, QStringView b) {
+        return QStringView(a).compare(b, _caseSensitivity) < 0;
+    });
+    if (name != _names.cend() && bname.compare(*name, _caseSensitivity) == 0)
+        return true;
+
+    for (const auto &affix : _affixes) {
+        if (bname.size() >= affix.prefix.size() + affix.suffix.size()
+            && bname.startsWith(affix.prefix, _caseSensitivity)
+            && bname.endsWith(affix.suffix, _caseSensitivity)) {
+            return true;
+        }
+    }
+
+    return _hasRegex && _regex.matchView(bname).hasMatch();
+}
+
 void ExcludedFiles::prepare()
 {
     // clear all regex
-    _bnameTraversalRegexFile.clear();
-    _bnameTraversalRegexDir.clear();
+    _bnameTraversalFile.clear();
+    _bnameTraversalDir.clear();
     _fullTraversalRegexFile.clear();
     _fullTraversalRegexDir.clear();
     _fullRegexFile.clear();
@@ -694,8 +756,8 @@ void ExcludedFiles::prepare(const BasePathString & basePath)
 
     // Build regular expressions for the different cases.
     //
-    // To compose the _bnameTraversalRegex, _fullTraversalRegex and _fullRegex
-    // patterns we collect several subgroups of patterns here.
+    // To compose the _bnameTraversalFile/Dir matchers and the _fullTraversalRegex
+    // and _fullRegex patterns we collect several subgroups of patterns here.
     //
     // * The "full" group will contain all patterns that contain a non-trailing
     //   slash. They only make sense in the fullRegex and fullTraversalRegex.
@@ -703,7 +765,7 @@ void ExcludedFiles::prepare(const BasePathString & basePath)
     //   These need separate handling in the _fullRegex (slash-containing
     //   patterns must be anchored to the front, these don't need it)
     // * The "bnameTrigger" group contains the bname part of all patterns in the
-    //   "full" group. These and the "bname" group become _bnameTraversalRegex.
+    //   "full" group. These and the "bname" group go into _bnameTraversalFile/Dir.
     //
     // To complicate matters, the exclude patterns have two binary attributes
     // meaning we'll end up with 4 variants:
@@ -723,8 +785,8 @@ void ExcludedFiles::prepare(const BasePathString & basePath)
     QString bnameDirKeep;
     QString bnameDirRemove;
 
-    QString bnameTriggerFileDir;
-    QString bnameTriggerDir;
+    BnameTraversalMatcher bnameTraversalFile;
+    BnameTraversalMatcher bnameTraversalDir;
 
     auto regexAppend = [](QString &fileDirPattern, QString &dirPattern, const QString &appendMe, bool dirOnly) {
         QString &pattern = dirOnly ? dirPattern : fileDirPattern;
@@ -768,13 +830,18 @@ void ExcludedFiles::prepare(const BasePathString & basePath)
         auto regexExclude = convertToRegexpSyntax(exclude, _wildcardsMatchSlash);
         if (!fullPath) {
             regexAppend(bnameFileDir, bnameDir, regexExclude, matchDirOnly);
+
+            (removeExcluded ? bnameTraversalDir.excludeRemove : bnameTraversalDir.exclude).addPattern(exclude);
+            if (!matchDirOnly)
+                (removeExcluded ? bnameTraversalFile.excludeRemove : bnameTraversalFile.exclude).addPattern(exclude);
         } else {
             regexAppend(fullFileDir, fullDir, regexExclude, matchDirOnly);
 
             // For activation, trigger on the 'bname' part of the full pattern.
             QString bnameExclude = extractBnameTrigger(exclude, _wildcardsMatchSlash);
-            auto regexBname = convertToRegexpSyntax(bnameExclude, true);
-            regexAppend(bnameTriggerFileDir, bnameTriggerDir, regexBname, matchDirOnly);
+            bnameTraversalDir.trigger.addPattern(bnameExclude);
+            if (!matchDirOnly)
+                bnameTraversalFile.trigger.addPattern(bnameExclude);
         }
     }
 
@@ -793,25 +860,6 @@ void ExcludedFiles::prepare(const BasePathString & basePath)
     emptyMatchNothing(bnameDirKeep);
     emptyMatchNothing(bnameDirRemove);
 
-    emptyMatchNothing(bnameTriggerFileDir);
-    emptyMatchNothing(bnameTriggerDir);
-
-    // The bname regex is applied to the bname only, so it must be
-    // anchored in the beginning and in the end. It has the structure:
-    // (exclude)|(excluderemove)|(bname triggers).
-    // If the third group matches, the fullActivatedRegex needs to be applied
-    // to the full path.
-    _bnameTraversalRegexFile[basePath].setPattern(
-        QStringLiteral("^(?P<exclude>%1)$|"
-                       "^(?P<excluderemove>%2)$|"
-                       "^(?P<trigger>%3)$")
-            .arg(bnameFileDirKeep, bnameFileDirRemove, bnameTriggerFileDir));
-    _bnameTraversalRegexDir[basePath].setPattern(
-        QStringLiteral("^(?P<exclude>%1|%2)$|"
-                       "^(?P<excluderemove>%3|%4)$|"
-                       "^(?P<trigger>%5|%6)$")
-            .arg(bnameFileDirKeep, bnameDirKeep, bnameFileDirRemove, bnameDirRemove, bnameTriggerFileDir, bnameTriggerDir));
-
     // The full traveral regex is applied to the full path if the trigger capture of
     // the bname regex matches. Its basic form is (exclude)|(excluderemove)".
     // This pattern can be much simpler than fullRegex since we can assume a traversal
@@ -858,10 +906,6 @@ void ExcludedFiles::prepare(const BasePathString & basePath)
     QRegularExpression::PatternOptions patternOptions = QRegularExpression::NoPatternOption;
     if (OCC::Utility::fsCasePreserving())
         patternOptions |= QRegularExpression::CaseInsensitiveOption;
-    _bnameTraversalRegexFile[basePath].setPatternOptions(patternOptions);
-    _bnameTraversalRegexFile[basePath].optimize();
-    _bnameTraversalRegexDir[basePath].setPatternOptions(patternOptions);
-    _bnameTraversalRegexDir[basePath].optimize();
     _fullTraversalRegexFile[basePath].setPatternOptions(patternOptions);
     _fullTraversalRegexFile[basePath].optimize();
     _fullTraversalRegexDir[basePath].setPatternOptions(patternOptions);
@@ -870,6 +914,19 @@ void ExcludedFiles::prepare(const BasePathString & basePath)
     _fullRegexFile[basePath].optimize();
     _fullRegexDir[basePath].setPatternOptions(patternOptions);
     _fullRegexDir[basePath].optimize();
+
+    // The bname matchers are applied to the bname only. For each base path
+    // the exclude patterns win over the excluderemove patterns, and if only
+    // a trigger matches the _fullTraversalRegex needs to be applied to the
+    // full path.
+    const auto caseSensitivity = OCC::Utility::fsCasePreserving() ? Qt::CaseInsensitive : Qt::CaseSensitive;
+    for (auto *matcher : {&bnameTraversalFile, &bnameTraversalDir}) {
+        matcher->exclude.prepare(caseSensitivity);
+        matcher->excludeRemove.prepare(caseSensitivity);
+        matcher->trigger.prepare(caseSensitivity);
+    }
+    _bnameTraversalFile[basePath] = std::move(bnameTraversalFile);
+    _bnameTraversalDir[basePath] = std::move(bnameTraversalDir);
 }
 
 QStringList ExcludedFiles::activeExcludePatterns() const
@@ -192,6 +192,46 @@ private:
         }
     };
 
+    /**
+     * Matches a file name against a set of exclude patterns.
+     *
+     * Most patterns are plain names like ".DS_Store" or have a single
+     * wildcard like "*.part" and "~$*". Those are compared directly,
+     * only the remaining ones are combined into one regular expression.
+     */
+    class BnameMatcher
+    {
+    public:
+        /// Adds a pattern in exclude file syntax that contains no slash
+        void addPattern(const QString &pattern);
+        void prepare(Qt::CaseSensitivity caseSensitivity);
+
+        [[nodiscard]] bool matches(QStringView bname) const;
+        [[nodiscard]] const QStringList &patterns() const { return _patterns; }
+
+    private:
+        struct Affix
+        {
+            QString prefix;
+            QString suffix;
+        };
+
+        QStringList _patterns;
+        QStringList _names; // sorted for binary search
+        QVector<Affix> _affixes;
+        QRegularExpression _regex;
+        bool _hasRegex = false;
+        Qt::CaseSensitivity _caseSensitivity = Qt::CaseSensitive;
+    };
+
+    /// The bname patterns of one base path, checked in this order by traversalPatternMatch()
+    struct BnameTraversalMatcher
+    {
+        BnameMatcher exclude;
+        BnameMatcher excludeRemove;
+        BnameMatcher trigger;
+    };
+
     /**
      * Generate optimized regular expressions for the exclude patterns anchored to basePath.
      *
@@ -213,7 +253,7 @@ private:
      *   full("a/b/c/d") == traversal("a") || traversal("a/b") || traversal("a/b/c")
      *
      * The traversal matcher can be extremely fast because it has a fast early-out
-     * case: It checks the bname part of the path against _bnameTraversalRegex
+     * case: It checks the bname part of the path against _bnameTraversalFile/Dir
      * and only runs a simplified _fullTraversalRegex on the whole path if bname
      * activation for it was triggered.
      *
@@ -240,8 +280,8 @@ private:
     QMap<BasePathString, QStringList> _allExcludes;
 
     /// see prepare()
-    QMap<BasePathString, QRegularExpression> _bnameTraversalRegexFile;
-    QMap<BasePathString, QRegularExpression> _bnameTraversalRegexDir;
+    QMap<BasePathString, BnameTraversalMatcher> _bnameTraversalFile;
+    QMap<BasePathString, BnameTraversalMatcher> _bnameTraversalDir;
     QMap<BasePathString, QRegularExpression> _fullTraversalRegexFile;
     QMap<BasePathString, QRegularExpression> _fullTraversalRegexDir;
     QMap<BasePathString, QRegularExpression> _fullRegexFile;
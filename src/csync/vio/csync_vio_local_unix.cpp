@@ -38,6 +38,7 @@ struct csync_vio_handle_t {
 };
 
 static int _csync_vio_local_stat_mb(const mbchar_t *wuri, csync_file_stat_t *buf);
+static void _csync_vio_local_fill_stat(const csync_stat_t &sb, csync_file_stat_t *buf);
 
 csync_vio_handle_t *csync_vio_local_opendir(const QString &name) {
     auto handle = std::make_unique<csync_vio_handle_t>();
@@ -71,10 +72,15 @@ std::unique_ptr<csync_file_stat_t> csync_vio_local_readdir(csync_vio_handle_t *h
   } while (qstrcmp(dirent->d_name, ".") == 0 || qstrcmp(dirent->d_name, "..") == 0);
 
   file_stat = std::make_unique<csync_file_stat_t>();
-  file_stat->path = QFile::decodeName(dirent->d_name).toUtf8();
-  QByteArray fullPath = handle->path % '/' % QByteArray() % const_cast<const char *>(dirent->d_name);
+  const auto name = QByteArrayView(dirent->d_name);
+  if (name.isValidUtf8()) {
+      // File names are decoded as UTF-8, no need to convert back and forth
+      file_stat->path = name.toByteArray();
+  } else {
+      file_stat->path = QFile::decodeName(dirent->d_name).toUtf8();
+  }
   if (file_stat->path.isNull()) {
-      file_stat->original_path = fullPath;
+      file_stat->original_path = handle->path % '/' % QByteArray() % const_cast<const char *>(dirent->d_name);
       qCWarning(lcCSyncVIOLocal) << "Invalid characters in file/directory name, please rename:" << dirent->d_name << handle->path;
   }
 
@@ -82,10 +88,11 @@ std::unique_ptr<csync_file_stat_t> csync_vio_local_readdir(csync_vio_handle_t *h
 #if defined(_DIRENT_HAVE_D_TYPE) || defined(__APPLE__)
   switch (dirent->d_type) {
     case DT_FIFO:
-    case DT_SOCK:
     case DT_CHR:
     case DT_BLK:
-      break;
+      // Never synced, no need to stat them
+      file_stat->type = ItemTypeSkip;
+      return file_stat;
     case DT_DIR:
     case DT_REG:
       if (dirent->d_type == DT_DIR) {
@@ -102,7 +109,18 @@ std::unique_ptr<csync_file_stat_t> csync_vio_local_readdir(csync_vio_handle_t *h
   if (file_stat->path.isNull())
       return file_stat;
 
-  if (_csync_vio_local_stat_mb(fullPath.constData(), file_stat.get()) < 0) {
+#ifdef Q_OS_LINUX
+  // Relative to the open directory: no full path to build and to resolve for every entry
+  csync_stat_t sb;
+  const auto statResult = fstatat(dirfd(handle->dh), dirent->d_name, &sb, AT_SYMLINK_NOFOLLOW);
+  if (statResult == 0) {
+      _csync_vio_local_fill_stat(sb, file_stat.get());
+  }
+#else
+  const QByteArray fullPath = handle->path % '/' % QByteArray() % const_cast<const char *>(dirent->d_name);
+  const auto statResult = _csync_vio_local_stat_mb(fullPath.constData(), file_stat.get());
+#endif
+  if (statResult < 0) {
       // Will get excluded by _csync_detect_update.
       file_stat->type = ItemTypeSkip;
   }
@@ -132,6 +150,12 @@ static int _csync_vio_local_stat_mb(const mbchar_t *wuri, csync_file_stat_t *buf
         return -1;
     }
 
+    _csync_vio_local_fill_stat(sb, buf);
+    return 0;
+}
+
+static void _csync_vio_local_fill_stat(const csync_stat_t &sb, csync_file_stat_t *buf)
+{
     switch (sb.st_mode & S_IFMT) {
     case S_IFDIR:
       buf->type = ItemTypeDirectory;
@@ -158,6 +182,4 @@ static int _csync_vio_local_stat_mb(const mbchar_t *wuri, csync_file_stat_t *buf
   buf->modtime = sb.st_mtime;
   buf->size = sb.st_size;
   buf->isPermissionsInvalid = (sb.st_mode & S_IWOTH) == S_IWOTH;
-
-  return 0;
 }
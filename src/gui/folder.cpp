@@ -64,6 +64,7 @@ Folder::Folder(const FolderDefinition &definition,
 {
     _timeSinceLastSyncStart.start();
     _timeSinceLastSyncDone.start();
+    _journal.setReadConnectionsEnabled(ConfigFile().journalReadConnections());
 
     SyncResult::Status status = SyncResult::NotYetStarted;
     if (definition.paused) {
@@ -1145,6 +1146,7 @@ void Folder::startSync(const QStringList &pathList)
         _engine->setLocalDiscoveryOptions(LocalDiscoveryStyle::DatabaseAndFilesystem, {singleItemDiscoveryOptions.discoveryPath});
         _localDiscoveryTracker->startSyncPartialDiscovery();
     } else if (_folderWatcher && _folderWatcher->isReliable()
+        && _folderWatcher->isReady()
         && hasDoneFullLocalDiscovery
         && !periodicFullLocalDiscoveryNow) {
         qCInfo(lcFolder) << "Allowing local discovery to read from the database";
@@ -1191,6 +1193,9 @@ SyncOptions Folder::initializeSyncOptions() const
     opt._newBigFolderSizeLimit = newFolderLimit.first ? newFolderLimit.second * 1000LL * 1000LL : -1; // convert from MB to B
     opt._confirmExternalStorage = cfgFile.confirmExternalStorage();
     opt._moveFilesToTrash = cfgFile.moveToTrash();
+    opt._bulkRemoteDiscovery = cfgFile.bulkRemoteDiscovery();
+    opt._journalSnapshotDiscovery = cfgFile.journalSnapshotDiscovery();
+    opt._streamingPropagation = cfgFile.streamingPropagation();
     opt._vfs = _vfs;
 
     const auto capsMaxConcurrentChunkUploads = account->capabilities().maxConcurrentChunkUploads();
@@ -1600,6 +1605,17 @@ void Folder::slotWatcherUnreliable(const QString &message)
     Logger::instance()->postGuiLog(Theme::instance()->appNameGUI(), fullMessage);
 }
 
+void Folder::slotWatcherRegistrationProgress(int watchedFolders, bool done)
+{
+    if (!done) {
+        return;
+    }
+    // The syncs until now did a full local discovery, but whatever changed in a
+    // directory after it was listed and before it was watched went unnoticed
+    qCInfo(lcFolder) << "Folder watcher for" << path() << "watches" << watchedFolders << "folders";
+    slotNextSyncFullLocalDiscovery();
+}
+
 void Folder::slotHydrationStarts()
 {
     // // Abort any running full sync run and reschedule
@@ -1689,6 +1705,8 @@ void Folder::registerFolderWatcher()
         this, &Folder::slotNextSyncFullLocalDiscovery);
     connect(_folderWatcher.data(), &FolderWatcher::becameUnreliable,
         this, &Folder::slotWatcherUnreliable);
+    connect(_folderWatcher.data(), &FolderWatcher::registrationProgress,
+        this, &Folder::slotWatcherRegistrationProgress);
     if (_accountState->account()->capabilities().filesLockAvailable()) {
         connect(_folderWatcher.data(), &FolderWatcher::filesLockReleased, this, &Folder::slotFilesLockReleased);
         connect(_folderWatcher.data(), &FolderWatcher::lockedFilesFound, this, &Folder::slotLockedFilesFound);
@@ -1707,6 +1725,7 @@ void Folder::disconnectFolderWatcher()
     disconnect(_folderWatcher.data(), &FolderWatcher::pathChanged, nullptr, nullptr);
     disconnect(_folderWatcher.data(), &FolderWatcher::lostChanges, this, &Folder::slotNextSyncFullLocalDiscovery);
     disconnect(_folderWatcher.data(), &FolderWatcher::becameUnreliable, this, &Folder::slotWatcherUnreliable);
+    disconnect(_folderWatcher.data(), &FolderWatcher::registrationProgress, this, &Folder::slotWatcherRegistrationProgress);
     if (_accountState->account()->capabilities().filesLockAvailable()) {
         disconnect(_folderWatcher.data(), &FolderWatcher::filesLockReleased, this, &Folder::slotFilesLockReleased);
         disconnect(_folderWatcher.data(), &FolderWatcher::lockedFilesFound, this, &Folder::slotLockedFilesFound);
@@ -1752,6 +1771,8 @@ void Folder::removeLocalE2eFiles()
 {
     qCDebug(lcFolder) << "Removing local E2EE files";
 
+    _journal.clearE2EeFolderMetadataCache();
+
     const QDir folderRootDir(path());
     QStringList e2eFoldersToBlacklist;
     const auto couldGetFiles = _journal.getFilesBelowPath("", [this, &e2eFoldersToBlacklist, &folderRootDir](const SyncJournalFileRecord &rec) {
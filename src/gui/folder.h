@@ -454,6 +454,9 @@ private slots:
     /** Warn users about an unreliable folder watcher */
     void slotWatcherUnreliable(const QString &message);
 
+    /** Until the folder watcher watches every directory, changes can be missed */
+    void slotWatcherRegistrationProgress(int watchedFolders, bool done);
+
     /** Aborts any running sync and blocks it until hydration is finished.
      *
      * Hydration circumvents the regular SyncEngine and both mustn't be running
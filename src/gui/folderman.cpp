@@ -31,6 +31,8 @@
 #include <QSet>
 #include <QNetworkProxy>
 
+#include <limits>
+
 namespace {
 constexpr auto settingsAccountsC = "Accounts";
 constexpr auto settingsFoldersC = "Folders";
@@ -70,6 +72,10 @@ FolderMan::FolderMan(QObject *parent)
     QObject::connect(&_etagPollTimer, &QTimer::timeout, this, &FolderMan::slotEtagPollTimerTimeout);
     _etagPollTimer.start();
 
+    SyncEngine::setMaxConcurrentSyncs(cfg.maxConcurrentSyncs());
+    SyncEngine::setGlobalNetworkJobBudget(cfg.concurrentSyncsNetworkJobBudget());
+    qCInfo(lcFolderMan) << "allowing" << SyncEngine::maxConcurrentSyncs() << "folders to sync at the same time";
+
     _startScheduledSyncTimer.setSingleShot(true);
     connect(&_startScheduledSyncTimer, &QTimer::timeout,
         this, &FolderMan::slotStartScheduledFolderSync);
@@ -148,7 +154,7 @@ int FolderMan::unloadAndDeleteAllFolders()
     ASSERT(_folderMap.isEmpty());
 
     _lastSyncFolder = nullptr;
-    _currentSyncFolder = nullptr;
+    _currentSyncFolders.clear();
     _scheduledFolders.clear();
     emit folderListChanged(_folderMap);
     emit scheduleQueueChanged();
@@ -915,7 +921,7 @@ void FolderMan::startScheduledSyncSoon()
     if (_scheduledFolders.empty()) {
         return;
     }
-    if (isAnySyncRunning()) {
+    if (!hasFreeSyncSlot()) {
         return;
     }
 
@@ -959,7 +965,7 @@ void FolderMan::startScheduledSyncSoon()
   */
 void FolderMan::slotStartScheduledFolderSync()
 {
-    if (isAnySyncRunning()) {
+    if (!hasFreeSyncSlot()) {
         for (auto f : std::as_const(_folderMap)) {
             if (f->isSyncRunning())
                 qCInfo(lcFolderMan) << "Currently folder " << f->remoteUrl().toString() << " is running, wait for finish!";
@@ -977,15 +983,7 @@ void FolderMan::slotStartScheduledFolderSync()
         return;
     }
 
-    // Find the first folder in the queue that can be synced.
-    Folder *folder = nullptr;
-    while (!_scheduledFolders.isEmpty()) {
-        Folder *g = _scheduledFolders.dequeue();
-        if (g->canSync()) {
-            folder = g;
-            break;
-        }
-    }
+    const auto folder = dequeueNextSchedulableFolder();
 
     emit scheduleQueueChanged();
 
@@ -996,11 +994,70 @@ void FolderMan::slotStartScheduledFolderSync()
         folder->registerFolderWatcher();
         registerFolderWithSocketApi(folder);
 
-        _currentSyncFolder = folder;
+        _currentSyncFolders.append(folder);
         folder->startSync(QStringList());
+
+        // Fill the remaining slots when running syncs concurrently
+        if (hasFreeSyncSlot()) {
+            startScheduledSyncSoon();
+        }
     }
 }
 
+bool FolderMan::hasFreeSyncSlot() const
+{
+    const auto maxConcurrentSyncs = SyncEngine::maxConcurrentSyncs();
+    if (maxConcurrentSyncs <= 1) {
+        return !isAnySyncRunning();
+    }
+
+    // Externally managed syncs like placeholder hydrations occupy a slot as well
+    auto runningSyncs = _currentSyncFolders.size();
+    for (const auto f : std::as_const(_folderMap)) {
+        if (f->isSyncRunning() && !_currentSyncFolders.contains(f)) {
+            ++runningSyncs;
+        }
+    }
+    return runningSyncs < maxConcurrentSyncs;
+}
+
+Folder *FolderMan::dequeueNextSchedulableFolder()
+{
+    // Folders of accounts with fewer running syncs go first, so that a long
+    // sync of one account can't starve the folders of the other accounts.
+    // With a single sync slot nothing is running and this is plain FIFO.
+    QHash<const AccountState *, int> runningSyncsPerAccount;
+    for (const auto f : std::as_const(_currentSyncFolders)) {
+        ++runningSyncsPerAccount[f->accountState()];
+    }
+
+    auto bestIndex = -1;
+    auto bestRunningSyncs = std::numeric_limits<int>::max();
+    auto index = 0;
+    while (index < _scheduledFolders.size()) {
+        const auto candidate = _scheduledFolders.at(index);
+        if (!candidate->canSync()) {
+            // Folders that can't sync are dropped, they get rescheduled once they can sync again
+            _scheduledFolders.removeAt(index);
+            continue;
+        }
+        const auto runningSyncs = runningSyncsPerAccount.value(candidate->accountState(), 0);
+        if (!candidate->isSyncRunning() && runningSyncs < bestRunningSyncs) {
+            bestIndex = index;
+            bestRunningSyncs = runningSyncs;
+            if (runningSyncs == 0) {
+                break;
+            }
+        }
+        ++index;
+    }
+
+    if (bestIndex < 0) {
+        return nullptr;
+    }
+    return _scheduledFolders.takeAt(bestIndex);
+}
+
 bool FolderMan::pushNotificationsFilesReady(const AccountPtr &account)
 {
     const auto pushNotifications = account->pushNotifications();
@@ -1195,7 +1252,7 @@ void FolderMan::slotScheduleFolderByTime()
 
 bool FolderMan::isAnySyncRunning() const
 {
-    if (_currentSyncFolder)
+    if (!_currentSyncFolders.isEmpty())
         return true;
 
     for (auto f : _folderMap) {
@@ -1236,11 +1293,10 @@ void FolderMan::slotFolderSyncFinished(const SyncResult &)
         qPrintable(f->accountState()->account()->displayName()),
         qPrintable(f->remoteUrl().toString()));
 
-    if (f == _currentSyncFolder) {
-        _lastSyncFolder = _currentSyncFolder;
-        _currentSyncFolder = nullptr;
+    if (_currentSyncFolders.removeAll(f) > 0) {
+        _lastSyncFolder = f;
     }
-    if (!isAnySyncRunning())
+    if (hasFreeSyncSlot())
         startScheduledSyncSoon();
 }
 
@@ -1539,10 +1595,10 @@ void FolderMan::slotWipeFolderForAccount(AccountState *accountState)
 
         qCInfo(lcFolderMan) << "Removing " << f->alias();
 
-        const bool currentlyRunning = (_currentSyncFolder == f);
+        const bool currentlyRunning = _currentSyncFolders.contains(f);
         if (currentlyRunning) {
             // abort the sync now
-            _currentSyncFolder->slotTerminateSync();
+            f->slotTerminateSync();
         }
 
         if (_scheduledFolders.removeAll(f) > 0) {
@@ -2051,7 +2107,7 @@ QQueue<Folder *> FolderMan::scheduleQueue() const
 
 Folder *FolderMan::currentSyncFolder() const
 {
-    return _currentSyncFolder;
+    return _currentSyncFolders.isEmpty() ? nullptr : _currentSyncFolders.first();
 }
 
 void FolderMan::restartApplication()
@@ -2097,6 +2153,34 @@ void FolderMan::slotProcessFilesPushNotification(Account *account)
     }
 }
 
+void FolderMan::slotProcessFileIdsPushNotification(Account *account, const QList<qint64> &fileIds)
+{
+    qCInfo(lcFolderMan) << "Got files push notification for" << fileIds.size() << "file ids for account" << account;
+
+    // Only the folders knowing the files are synced, and their discovery
+    // lists the folders containing them even if the etags look unchanged.
+    QVector<Folder *> foldersToSync;
+    for (auto folder : std::as_const(_folderMap)) {
+        if (folder->accountState()->account() != account) {
+            continue;
+        }
+        if (folder->journalDb()->scheduleFileIdsForRemoteDiscovery(fileIds) > 0) {
+            foldersToSync.append(folder);
+        }
+    }
+
+    // New files aren't known to any folder yet
+    if (foldersToSync.isEmpty()) {
+        slotProcessFilesPushNotification(account);
+        return;
+    }
+
+    for (const auto folder : std::as_const(foldersToSync)) {
+        qCInfo(lcFolderMan) << "Schedule folder" << folder << "for sync of the changed files";
+        scheduleFolder(folder);
+    }
+}
+
 void FolderMan::slotConnectToPushNotifications(const AccountPtr &account)
 {
     const auto pushNotifications = account->pushNotifications();
@@ -2104,6 +2188,7 @@ void FolderMan::slotConnectToPushNotifications(const AccountPtr &account)
     if (pushNotificationsFilesReady(account)) {
         qCInfo(lcFolderMan) << "Push notifications ready";
         connect(pushNotifications, &PushNotifications::filesChanged, this, &FolderMan::slotProcessFilesPushNotification, Qt::UniqueConnection);
+        connect(pushNotifications, &PushNotifications::fileIdsChanged, this, &FolderMan::slotProcessFileIdsPushNotification, Qt::UniqueConnection);
     }
 }
 
@@ -329,6 +329,7 @@ private slots:
 
     void slotSetupPushNotifications(const OCC::Folder::Map &);
     void slotProcessFilesPushNotification(OCC::Account *account);
+    void slotProcessFileIdsPushNotification(OCC::Account *account, const QList<qint64> &fileIds);
     void slotConnectToPushNotifications(const OCC::AccountPtr &account);
 
     void slotLeaveShare(const QString &localFile, const QByteArray &folderToken = {});
@@ -346,6 +347,12 @@ private:
     /** Will start a sync after a bit of delay. */
     void startScheduledSyncSoon();
 
+    /** Whether another scheduled sync may start now, see SyncEngine::maxConcurrentSyncs() */
+    [[nodiscard]] bool hasFreeSyncSlot() const;
+
+    /** Takes the next folder to sync from the queue, respecting per-account fairness */
+    Folder *dequeueNextSchedulableFolder();
+
     // finds all folder configuration files
     // and create the folders
     [[nodiscard]] QString getBackupName(QString fullPathName) const;
@@ -370,7 +377,7 @@ private:
     QSet<Folder *> _disabledFolders;
     Folder::Map _folderMap;
     QString _folderConfigPath;
-    Folder *_currentSyncFolder = nullptr;
+    QList<Folder *> _currentSyncFolders;
     QPointer<Folder> _lastSyncFolder;
     bool _syncEnabled = true;
 
@@ -21,6 +21,9 @@
 
 #include "folder.h"
 #include "filesystem.h"
+#include "configfile.h"
+#include "csync/csync_exclude.h"
+#include "common/utility.h"
 
 #include <QFileInfo>
 #include <QFlags>
@@ -30,6 +33,7 @@
 
 #include <array>
 #include <cstdint>
+#include <memory>
 
 namespace
 {
@@ -65,11 +69,31 @@ bool FolderWatcher::pathIsIgnored(const QString &path) const
     return path.isEmpty();
 }
 
+std::function<bool(const QString &)> FolderWatcher::ignoredPathMatcher() const
+{
+    if (!_folder) {
+        return [](const QString &path) { return path.isEmpty(); };
+    }
+
+    // The engine's exclude list is reloaded on the GUI thread, don't share it
+    auto excludes = std::make_shared<ExcludedFiles>(_folder->path());
+    ConfigFile::setupDefaultExcludeFilePaths(*excludes);
+    excludes->reloadExcludeFiles();
+    return [excludes, basePath = _folder->path(), ignoreHidden = _folder->ignoreHiddenFiles()](const QString &path) {
+        return path.isEmpty() || (excludes->isExcluded(path, basePath, ignoreHidden) && !Utility::isConflictFile(path));
+    };
+}
+
 bool FolderWatcher::isReliable() const
 {
     return _isReliable;
 }
 
+bool FolderWatcher::isReady() const
+{
+    return _d && _d->_ready;
+}
+
 void FolderWatcher::appendSubPaths(QDir dir, QStringList& subPaths) {
     QStringList newSubPaths = dir.entryList(QDir::NoDotAndDotDot | QDir::Dirs | QDir::Files);
     for (int i = 0; i < newSubPaths.size(); i++) {
@@ -150,6 +174,15 @@ int FolderWatcher::testLinuxWatchCount() const
 #endif
 }
 
+bool FolderWatcher::testLinuxUsesFanotify() const
+{
+#ifdef Q_OS_LINUX
+    return _d->testUsesFanotify();
+#else
+    return false;
+#endif
+}
+
 void FolderWatcher::slotLockFileDetectedExternally(const QString &lockFile)
 {
     qCInfo(lcFolderWatcher) << "Lock file detected externally, probably a newly-uploaded office file: " << lockFile;
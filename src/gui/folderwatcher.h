@@ -21,6 +21,8 @@
 #include <QDir>
 #include <QTimer>
 
+#include <functional>
+
 namespace OCC {
 
 Q_DECLARE_LOGGING_CATEGORY(lcFolderWatcher)
@@ -61,6 +63,11 @@ public:
      */
     [[nodiscard]] bool isReliable() const;
 
+    /**
+     * Returns true once the directories present at init() are watched.
+     */
+    [[nodiscard]] bool isReady() const;
+
     /**
      * Triggers a change in the path and verifies a notification arrives.
      *
@@ -71,6 +78,8 @@ public:
 
     /// For testing linux behavior only
     [[nodiscard]] int testLinuxWatchCount() const;
+    /// For testing linux behavior only
+    [[nodiscard]] bool testLinuxUsesFanotify() const;
 
     void slotLockFileDetectedExternally(const QString &lockFile);
 
@@ -110,6 +119,18 @@ signals:
      */
     void becameUnreliable(const QString &message);
 
+    /**
+     * Emitted while the directories present at init() are registered in
+     * the background, currently on linux only.
+     *
+     * @param watchedFolders the number of directories watched so far
+     * @param done true once all of them are, see isReady()
+     *
+     * Changes below directories that aren't watched yet are missed, so a
+     * full local discovery is needed until and once after done.
+     */
+    void registrationProgress(int watchedFolders, bool done);
+
 protected slots:
     // called from the implementations to indicate a change in path
     void changeDetected(const QString &path);
@@ -137,6 +158,11 @@ private:
     /* Check if the path should be ignored by the FolderWatcher. */
     [[nodiscard]] bool pathIsIgnored(const QString &path) const;
 
+    /* Like pathIsIgnored(), and also true for paths the folder excludes.
+     * Works on its own copy of the exclude list, so it can be called from any thread.
+     */
+    [[nodiscard]] std::function<bool(const QString &)> ignoredPathMatcher() const;
+
     /** Path of the expected test notification */
     QString _testNotificationPath;
 
@@ -6,23 +6,193 @@
 
 #include "config.h"
 
+#include <sys/fanotify.h>
 #include <sys/inotify.h>
 
 #include "folder.h"
 #include "folderwatcher_linux.h"
 
 #include <cerrno>
+#include <climits>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <QStringList>
 #include <QObject>
 #include <QVarLengthArray>
+#include <QtConcurrentRun>
+
+namespace {
+
+constexpr uint32_t watchMask = IN_CLOSE_WRITE | IN_ATTRIB | IN_MOVE | IN_CREATE | IN_DELETE | IN_DELETE_SELF | IN_MOVE_SELF | IN_UNMOUNT | IN_ONLYDIR;
+
+// The watches registered in the background are handed over in batches of this size
+constexpr int watchBatchSize = 2000;
+
+#ifdef FAN_REPORT_DFID_NAME
+constexpr uint64_t fanotifyMask = FAN_CLOSE_WRITE | FAN_ATTRIB | FAN_MOVED_FROM | FAN_MOVED_TO | FAN_CREATE | FAN_DELETE | FAN_ONDIR;
+#endif
+
+// Bounds the memory of the resolved directories, as the whole file system reports
+constexpr int maxFanotifyDirectories = 10000;
+
+bool isJournalFile(const QByteArray &fileName)
+{
+    // Filter out journal changes - redundant with filtering in
+    // FolderWatcher::pathIsIgnored.
+    return fileName.startsWith("._sync_")
+        || fileName.startsWith(".csync_journal.db")
+        || fileName.startsWith(".sync_");
+}
+
+}
 
 namespace OCC {
 
+InotifyWatchTree::InotifyWatchTree(const QString &root)
+    : _root(root)
+{
+    _nodes.push_back(Node{root});
+}
+
+int InotifyWatchTree::find(const QString &path) const
+{
+    if (path == _root) {
+        return 0;
+    }
+    if (!path.startsWith(_root) || path.size() <= _root.size() || path.at(_root.size()) != QLatin1Char('/')) {
+        return -1;
+    }
+    int index = 0;
+    for (const auto name : QStringView(path).sliced(_root.size() + 1).tokenize(QLatin1Char('/'), Qt::SkipEmptyParts)) {
+        index = _children.value({index, name.toString()}, -1);
+        if (index < 0) {
+            return -1;
+        }
+    }
+    return index;
+}
+
+int InotifyWatchTree::findOrCreate(const QString &path)
+{
+    if (path == _root) {
+        return 0;
+    }
+    if (!path.startsWith(_root) || path.size() <= _root.size() || path.at(_root.size()) != QLatin1Char('/')) {
+        return -1;
+    }
+    int index = 0;
+    for (const auto name : QStringView(path).sliced(_root.size() + 1).tokenize(QLatin1Char('/'), Qt::SkipEmptyParts)) {
+        const auto key = std::make_pair(index, name.toString());
+        auto child = _children.value(key, -1);
+        if (child < 0) {
+            if (_freeNodes.isEmpty()) {
+                child = static_cast<int>(_nodes.size());
+                _nodes.push_back(Node{key.second, index});
+            } else {
+                child = _freeNodes.takeLast();
+                _nodes[child] = Node{key.second, index};
+            }
+            _nodes[index].children.append(child);
+            _children.insert(key, child);
+        }
+        index = child;
+    }
+    return index;
+}
+
+void InotifyWatchTree::insert(const QString &path, int wd)
+{
+    const auto index = findOrCreate(path);
+    if (index < 0) {
+        return;
+    }
+    // A descriptor is reused for the same directory under a new path
+    if (const auto previous = _byWatch.value(wd, -1); previous >= 0 && previous != index) {
+        _nodes[previous].wd = -1;
+    }
+    if (_nodes[index].wd >= 0 && _nodes[index].wd != wd) {
+        _byWatch.remove(_nodes[index].wd);
+    }
+    _nodes[index].wd = wd;
+    _byWatch.insert(wd, index);
+}
+
+bool InotifyWatchTree::contains(const QString &path) const
+{
+    const auto index = find(path);
+    return index >= 0 && _nodes[index].wd >= 0;
+}
+
+QString InotifyWatchTree::path(int wd) const
+{
+    auto index = _byWatch.value(wd, -1);
+    if (index < 0) {
+        return {};
+    }
+    QStringList names;
+    while (index > 0) {
+        names.prepend(_nodes[index].name);
+        index = _nodes[index].parent;
+    }
+    names.prepend(_root);
+    return names.join(QLatin1Char('/'));
+}
+
+QVector<int> InotifyWatchTree::removeBelow(const QString &path)
+{
+    QVector<int> watches;
+    const auto index = find(path);
+    if (index < 0) {
+        return watches;
+    }
+
+    QVector<int> pending = {index};
+    while (!pending.isEmpty()) {
+        const auto current = pending.takeLast();
+        auto &node = _nodes[current];
+        pending.append(node.children);
+        if (node.wd >= 0) {
+            watches.append(node.wd);
+            _byWatch.remove(node.wd);
+        }
+        if (current != index) {
+            removeNode(current);
+        }
+    }
+
+    if (index == 0) {
+        _nodes[0].wd = -1;
+        _nodes[0].children.clear();
+    } else {
+        _nodes[_nodes[index].parent].children.removeOne(index);
+        removeNode(index);
+    }
+    return watches;
+}
+
+void InotifyWatchTree::removeNode(int index)
+{
+    auto &node = _nodes[index];
+    _children.remove({node.parent, node.name});
+    node = Node{};
+    _freeNodes.append(index);
+}
+
 FolderWatcherPrivate::FolderWatcherPrivate(FolderWatcher *p, const QString &path)
     : QObject()
     , _parent(p)
-    , _folder(path)
+    , _folder(QDir(path).absolutePath())
+    , _watches(_folder)
 {
+    if (initFanotify()) {
+        qCInfo(lcFolderWatcher) << "Watching the file system of" << _folder << "with fanotify";
+        _ready = true;
+        return;
+    }
+
     _fd = inotify_init();
     if (_fd != -1) {
         _socket.reset(new QSocketNotifier(_fd, QSocketNotifier::Read));
@@ -31,34 +201,276 @@ FolderWatcherPrivate::FolderWatcherPrivate(FolderWatcher *p, const QString &path
         qCWarning(lcFolderWatcher) << "notify_init() failed: " << strerror(errno);
     }
 
-    QMetaObject::invokeMethod(this, "slotAddFolderRecursive", Q_ARG(QString, path));
+    startRegistration(_folder);
+}
+
+FolderWatcherPrivate::~FolderWatcherPrivate()
+{
+    _registrationCancelled = true;
+    _registration.waitForFinished();
+
+    _socket.reset();
+    if (_fd != -1) {
+        close(_fd);
+    }
+    closeFanotify();
+}
+
+bool FolderWatcherPrivate::initFanotify()
+{
+#ifdef FAN_REPORT_DFID_NAME
+    // Every change on the whole file system is reported to us, only do that when asked to
+    if (!qEnvironmentVariableIsSet("OWNCLOUD_ENABLE_FANOTIFY")) {
+        return false;
+    }
+
+    // Fails with EPERM without CAP_SYS_ADMIN, which is the common case
+    _fanotifyFd = fanotify_init(FAN_CLASS_NOTIF | FAN_REPORT_DFID_NAME | FAN_NONBLOCK | FAN_CLOEXEC, O_RDONLY | O_CLOEXEC);
+    if (_fanotifyFd == -1) {
+        qCDebug(lcFolderWatcher) << "fanotify is not available, using inotify:" << strerror(errno);
+        return false;
+    }
+
+    // Not every file system can report file handles
+    const auto encodedFolder = QFile::encodeName(_folder);
+    if (fanotify_mark(_fanotifyFd, FAN_MARK_ADD | FAN_MARK_FILESYSTEM, fanotifyMask, AT_FDCWD, encodedFolder.constData()) == -1) {
+        qCDebug(lcFolderWatcher) << "Could not mark the file system of" << _folder << "with fanotify, using inotify:" << strerror(errno);
+        closeFanotify();
+        return false;
+    }
+
+    _mountFd = open(encodedFolder.constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    _canonicalFolder = QFileInfo(_folder).canonicalFilePath();
+
+    // Opening the reported handles needs CAP_DAC_READ_SEARCH as well, try it on the folder
+    alignas(file_handle) char handleBuffer[sizeof(file_handle) + MAX_HANDLE_SZ];
+    auto handle = reinterpret_cast<file_handle *>(handleBuffer);
+    handle->handle_bytes = MAX_HANDLE_SZ;
+    int mountId = 0;
+    if (_mountFd == -1 || _canonicalFolder.isEmpty()
+        || name_to_handle_at(AT_FDCWD, encodedFolder.constData(), handle, &mountId, 0) == -1
+        || fanotifyDirectoryPath(QByteArray(handleBuffer, sizeof(file_handle) + handle->handle_bytes)) != _folder) {
+        qCDebug(lcFolderWatcher) << "Could not resolve file handles below" << _folder << ", using inotify";
+        closeFanotify();
+        return false;
+    }
+
+    _socket.reset(new QSocketNotifier(_fanotifyFd, QSocketNotifier::Read));
+    connect(_socket.data(), &QSocketNotifier::activated, this, &FolderWatcherPrivate::slotReceivedFanotifyNotification);
+    return true;
+#else
+    return false;
+#endif
 }
 
-FolderWatcherPrivate::~FolderWatcherPrivate() = default;
+void FolderWatcherPrivate::closeFanotify()
+{
+    if (_fanotifyFd != -1) {
+        _socket.reset();
+        close(_fanotifyFd);
+        _fanotifyFd = -1;
+    }
+    if (_mountFd != -1) {
+        close(_mountFd);
+        _mountFd = -1;
+    }
+    _fanotifyDirectories.clear();
+    _fanotifyDirectoryHandles.clear();
+    _fanotifyOutsideDirectories.clear();
+}
+
+QString FolderWatcherPrivate::fanotifyDirectoryPath(const QByteArray &handle)
+{
+    if (const auto it = _fanotifyDirectories.constFind(handle); it != _fanotifyDirectories.constEnd()) {
+        return *it;
+    }
+    // Most events come from outside the folder, they are dropped without resolving them again
+    if (_fanotifyOutsideDirectories.contains(handle)) {
+        return {};
+    }
+
+    QString path;
+    auto handleCopy = handle;
+    const auto dirFd = open_by_handle_at(_mountFd, reinterpret_cast<file_handle *>(handleCopy.data()), O_PATH | O_CLOEXEC);
+    if (dirFd == -1) {
+        // Removed meanwhile, or on another file system
+        return path;
+    }
+    char target[PATH_MAX];
+    const QByteArray procPath = QByteArray("/proc/self/fd/") + QByteArray::number(dirFd);
+    const auto len = readlink(procPath.constData(), target, sizeof(target));
+    close(dirFd);
+    if (len <= 0) {
+        return path;
+    }
+
+    const auto dirPath = QFile::decodeName(QByteArray(target, len));
+    if (dirPath == _canonicalFolder) {
+        path = _folder;
+    } else if (dirPath.startsWith(_canonicalFolder) && dirPath.at(_canonicalFolder.size()) == QLatin1Char('/')) {
+        path = _folder + dirPath.mid(_canonicalFolder.size());
+    }
+
+    if (path.isEmpty()) {
+        if (_fanotifyOutsideDirectories.size() >= maxFanotifyDirectories) {
+            _fanotifyOutsideDirectories.clear();
+        }
+        _fanotifyOutsideDirectories.insert(handle);
+        return path;
+    }
+    if (_fanotifyDirectories.size() >= maxFanotifyDirectories) {
+        _fanotifyDirectories.clear();
+        _fanotifyDirectoryHandles.clear();
+    }
+    _fanotifyDirectories.insert(handle, path);
+    _fanotifyDirectoryHandles.insert(path, handle);
+    return path;
+}
+
+void FolderWatcherPrivate::forgetFanotifyDirectoriesBelow(const QString &path)
+{
+    auto forget = [this](QMap<QString, QByteArray>::iterator it) {
+        _fanotifyDirectories.remove(*it);
+        return _fanotifyDirectoryHandles.erase(it);
+    };
+    if (const auto it = _fanotifyDirectoryHandles.find(path); it != _fanotifyDirectoryHandles.end()) {
+        forget(it);
+    }
+    const auto prefix = path + QLatin1Char('/');
+    for (auto it = _fanotifyDirectoryHandles.lowerBound(prefix); it != _fanotifyDirectoryHandles.end() && it.key().startsWith(prefix);) {
+        it = forget(it);
+    }
+}
+
+bool FolderWatcherPrivate::forEachFolderBelow(const QString &path, const std::function<bool(const QString &)> &callback,
+    const std::function<bool(const QString &)> &isIgnored)
+{
+    auto ok = true;
+    QStringList pending = {path};
+    while (!pending.isEmpty()) {
+        const auto dirPath = pending.takeLast();
+        const auto encodedDirPath = QFile::encodeName(dirPath);
+        const auto dir = opendir(encodedDirPath.constData());
+        if (!dir) {
+            qCDebug(lcFolderWatcher) << "Non existing path coming in: " << dirPath;
+            ok = false;
+            continue;
+        }
+
+        QStringList subdirs;
+        while (const auto entry = readdir(dir)) {
+            if (qstrcmp(entry->d_name, ".") == 0 || qstrcmp(entry->d_name, "..") == 0) {
+                continue;
+            }
+            auto isDir = entry->d_type == DT_DIR;
+            if (entry->d_type == DT_UNKNOWN) {
+                struct stat sb;
+                isDir = fstatat(dirfd(dir), entry->d_name, &sb, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(sb.st_mode);
+            }
+            if (!isDir) {
+                continue;
+            }
+            const auto subdir = dirPath + QLatin1Char('/') + QFile::decodeName(entry->d_name);
+            if (isIgnored && isIgnored(subdir)) {
+                qCDebug(lcFolderWatcher) << "* Not adding" << subdir;
+                continue;
+            }
+            subdirs.append(subdir);
+        }
+        closedir(dir);
+
+        for (const auto &subdir : std::as_const(subdirs)) {
+            if (!callback(subdir)) {
+                return ok;
+            }
+        }
+        pending.append(subdirs);
+    }
+    return ok;
+}
 
 // attention: result list passed by reference!
 bool FolderWatcherPrivate::findFoldersBelow(const QDir &dir, QStringList &fullList)
 {
-    bool ok = true;
-    if (!(dir.exists() && dir.isReadable())) {
-        qCDebug(lcFolderWatcher) << "Non existing path coming in: " << dir.absolutePath();
-        ok = false;
-    } else {
-        QStringList nameFilter;
-        nameFilter << QLatin1String("*");
-        QDir::Filters filter = QDir::Dirs | QDir::NoDotAndDotDot | QDir::NoSymLinks | QDir::Hidden;
-        const QStringList paths = dir.entryList(nameFilter, filter);
+    return forEachFolderBelow(dir.path(), [&fullList](const QString &path) {
+        fullList.append(path);
+        return true;
+    });
+}
 
-        QStringList::const_iterator constIterator;
-        for (constIterator = paths.constBegin(); constIterator != paths.constEnd();
-             ++constIterator) {
-            const QString fullPath(dir.path() + QLatin1String("/") + (*constIterator));
-            fullList.append(fullPath);
-            ok = findFoldersBelow(QDir(fullPath), fullList);
+void FolderWatcherPrivate::startRegistration(const QString &path)
+{
+    if (_fd == -1) {
+        _ready = true;
+        return;
+    }
+
+    // Listing and watching a large tree takes long, keep it off the GUI thread.
+    // Adding a watch for a watched directory only returns its descriptor again,
+    // so directories the notifications added meanwhile don't matter.
+    // Excluded trees are pruned right away, they would only use up watches.
+    _pathIsIgnored = _parent->ignoredPathMatcher();
+    _registration = QtConcurrent::run([this, path, fd = _fd, isIgnored = _pathIsIgnored] {
+        QVector<std::pair<int, QString>> batch;
+        auto exhausted = false;
+        auto handOver = [this, &batch] {
+            QMetaObject::invokeMethod(this, [this, watches = std::move(batch)] { addWatches(watches); }, Qt::QueuedConnection);
+            batch = {};
+        };
+        auto registerPath = [&](const QString &dirPath) {
+            const auto wd = inotify_add_watch(fd, QFile::encodeName(dirPath).constData(), watchMask);
+            if (wd > -1) {
+                batch.append({wd, dirPath});
+            } else if (errno == ENOMEM || errno == ENOSPC) {
+                exhausted = true;
+            }
+            if (batch.size() >= watchBatchSize) {
+                handOver();
+            }
+            return !exhausted && !_registrationCancelled;
+        };
+
+        if (registerPath(path) && !forEachFolderBelow(path, registerPath, isIgnored)) {
+            qCWarning(lcFolderWatcher) << "Could not traverse all sub folders";
+        }
+        handOver();
+
+        QMetaObject::invokeMethod(this, [this, exhausted] {
+            if (exhausted) {
+                watchesExhausted();
+            }
+            _ready = true;
+            qCInfo(lcFolderWatcher) << "Watching" << _watches.size() << "folders in" << _folder;
+            emit _parent->registrationProgress(_watches.size(), true);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void FolderWatcherPrivate::addWatches(const QVector<std::pair<int, QString>> &watches)
+{
+    for (const auto &[wd, path] : watches) {
+        if (_parent->pathIsIgnored(path)) {
+            qCDebug(lcFolderWatcher) << "* Not adding" << path;
+            inotify_rm_watch(_fd, wd);
+            continue;
         }
+        _watches.insert(path, wd);
     }
+    if (!_ready) {
+        emit _parent->registrationProgress(_watches.size(), false);
+    }
+}
 
-    return ok;
+void FolderWatcherPrivate::watchesExhausted()
+{
+    // If we're running out of memory or inotify watches, become
+    // unreliable.
+    if (_parent->_isReliable) {
+        _parent->_isReliable = false;
+        emit _parent->becameUnreliable(
+            tr("This problem usually happens when the inotify watches are exhausted. "
+               "Check the FAQ for details."));
+    }
 }
 
 void FolderWatcherPrivate::inotifyRegisterPath(const QString &path)
@@ -66,52 +478,36 @@ void FolderWatcherPrivate::inotifyRegisterPath(const QString &path)
     if (path.isEmpty())
         return;
 
-    int wd = inotify_add_watch(_fd, path.toUtf8().constData(),
-        IN_CLOSE_WRITE | IN_ATTRIB | IN_MOVE | IN_CREATE | IN_DELETE | IN_DELETE_SELF | IN_MOVE_SELF | IN_UNMOUNT | IN_ONLYDIR);
+    int wd = inotify_add_watch(_fd, QFile::encodeName(path).constData(), watchMask);
     if (wd > -1) {
-        _watchToPath.insert(wd, path);
-        _pathToWatch.insert(path, wd);
-    } else {
-        // If we're running out of memory or inotify watches, become
-        // unreliable.
-        if (_parent->_isReliable && (errno == ENOMEM || errno == ENOSPC)) {
-            _parent->_isReliable = false;
-            emit _parent->becameUnreliable(
-                tr("This problem usually happens when the inotify watches are exhausted. "
-                   "Check the FAQ for details."));
-        }
+        _watches.insert(path, wd);
+    } else if (errno == ENOMEM || errno == ENOSPC) {
+        watchesExhausted();
     }
 }
 
 void FolderWatcherPrivate::slotAddFolderRecursive(const QString &path)
 {
-    if (_pathToWatch.contains(path))
+    if (_watches.contains(path))
         return;
 
     int subdirs = 0;
     qCDebug(lcFolderWatcher) << "(+) Watcher:" << path;
 
-    QDir inPath(path);
-    inotifyRegisterPath(inPath.absolutePath());
+    inotifyRegisterPath(path);
 
-    QStringList allSubfolders;
-    if (!findFoldersBelow(QDir(path), allSubfolders)) {
-        qCWarning(lcFolderWatcher) << "Could not traverse all sub folders";
-    }
-    QStringListIterator subfoldersIt(allSubfolders);
-    while (subfoldersIt.hasNext()) {
-        QString subfolder = subfoldersIt.next();
-        QDir folder(subfolder);
-        if (folder.exists() && !_pathToWatch.contains(folder.absolutePath())) {
-            subdirs++;
-            if (_parent->pathIsIgnored(subfolder)) {
-                qCDebug(lcFolderWatcher) << "* Not adding" << folder.path();
-                continue;
-            }
-            inotifyRegisterPath(folder.absolutePath());
-        } else {
-            qCDebug(lcFolderWatcher) << "    `-> discarded:" << folder.path();
+    // New folders are usually small, they are registered right away so
+    // that the notifications from inside them aren't missed
+    const auto ok = forEachFolderBelow(path, [this, &subdirs](const QString &subfolder) {
+        if (_watches.contains(subfolder)) {
+            return true;
         }
+        subdirs++;
+        inotifyRegisterPath(subfolder);
+        return true;
+    }, _pathIsIgnored);
+    if (!ok) {
+        qCWarning(lcFolderWatcher) << "Could not traverse all sub folders";
     }
 
     if (subdirs > 0) {
@@ -161,19 +557,24 @@ void FolderWatcherPrivate::slotReceivedNotification(int fd)
         if (event->len == 0 || event->wd <= -1)
             continue;
         QByteArray fileName(event->name);
-        // Filter out journal changes - redundant with filtering in
-        // FolderWatcher::pathIsIgnored.
-        if (fileName.startsWith("._sync_")
-            || fileName.startsWith(".csync_journal.db")
-            || fileName.startsWith(".sync_")) {
+        if (isJournalFile(fileName)) {
+            continue;
+        }
+        const auto dirPath = _watches.path(event->wd);
+        if (dirPath.isEmpty()) {
+            // Watched by the registration worker, but not handed over yet
+            if (!_ready) {
+                emit _parent->lostChanges();
+            }
             continue;
         }
-        const QString p = _watchToPath[event->wd] + '/' + fileName;
+        const QString p = dirPath + '/' + fileName;
         _parent->changeDetected(p);
 
         if ((event->mask & (IN_MOVED_TO | IN_CREATE))
             && QFileInfo(p).isDir()
-            && !_parent->pathIsIgnored(p)) {
+            && !_parent->pathIsIgnored(p)
+            && !(_pathIsIgnored && _pathIsIgnored(p))) {
             slotAddFolderRecursive(p);
         }
         if (event->mask & (IN_MOVED_FROM | IN_DELETE)) {
@@ -182,30 +583,74 @@ void FolderWatcherPrivate::slotReceivedNotification(int fd)
     }
 }
 
-void FolderWatcherPrivate::removeFoldersBelow(const QString &path)
+void FolderWatcherPrivate::slotReceivedFanotifyNotification(int fd)
 {
-    auto it = _pathToWatch.find(path);
-    if (it == _pathToWatch.end())
-        return;
+#ifdef FAN_REPORT_DFID_NAME
+    alignas(fanotify_event_metadata) char buffer[8192];
+    ssize_t len = 0;
+    while ((len = read(fd, buffer, sizeof(buffer))) > 0) {
+        for (auto metadata = reinterpret_cast<fanotify_event_metadata *>(buffer); FAN_EVENT_OK(metadata, len); metadata = FAN_EVENT_NEXT(metadata, len)) {
+            if (metadata->vers != FANOTIFY_METADATA_VERSION) {
+                qCWarning(lcFolderWatcher) << "Unexpected fanotify event version" << metadata->vers;
+                return;
+            }
+            if (metadata->mask & FAN_Q_OVERFLOW) {
+                qCWarning(lcFolderWatcher) << "fanotify queue overflow, changes were lost";
+                emit _parent->lostChanges();
+                continue;
+            }
 
-    QString pathSlash = path + '/';
+            const auto eventEnd = reinterpret_cast<const char *>(metadata) + metadata->event_len;
+            auto info = reinterpret_cast<const char *>(metadata) + metadata->metadata_len;
+            while (info + sizeof(fanotify_event_info_header) <= eventEnd) {
+                const auto header = reinterpret_cast<const fanotify_event_info_header *>(info);
+                if (header->len == 0) {
+                    break;
+                }
+                info += header->len;
+                if (header->info_type != FAN_EVENT_INFO_TYPE_DFID_NAME) {
+                    continue;
+                }
 
-    // Remove the entry and all subentries
-    while (it != _pathToWatch.end()) {
-        auto itPath = it.key();
-        if (!itPath.startsWith(path))
-            break;
-        if (itPath != path && !itPath.startsWith(pathSlash)) {
-            // order is 'foo', 'foo bar', 'foo/bar'
-            ++it;
-            continue;
+                const auto fid = reinterpret_cast<const fanotify_event_info_fid *>(header);
+                const auto handle = reinterpret_cast<const file_handle *>(fid->handle);
+                const QByteArray fileName(reinterpret_cast<const char *>(handle->f_handle + handle->handle_bytes));
+                // "." is an event on the directory itself
+                if (fileName == "." || isJournalFile(fileName)) {
+                    continue;
+                }
+
+                const auto dirPath = fanotifyDirectoryPath(QByteArray(reinterpret_cast<const char *>(handle), sizeof(file_handle) + handle->handle_bytes));
+                if (dirPath.isEmpty()) {
+                    continue;
+                }
+                const auto path = dirPath + '/' + QFile::decodeName(fileName);
+                if ((metadata->mask & FAN_ONDIR) && (metadata->mask & (FAN_MOVED_FROM | FAN_MOVED_TO | FAN_DELETE))) {
+                    // The paths of the directories below it changed
+                    forgetFanotifyDirectoriesBelow(path);
+                    if (metadata->mask & FAN_MOVED_TO) {
+                        // It may come from outside the folder
+                        _fanotifyOutsideDirectories.clear();
+                    }
+                }
+                _parent->changeDetected(path);
+            }
         }
+    }
+#else
+    Q_UNUSED(fd)
+#endif
+}
 
-        auto wid = it.value();
-        inotify_rm_watch(_fd, wid);
-        _watchToPath.remove(wid);
-        it = _pathToWatch.erase(it);
-        qCDebug(lcFolderWatcher) << "Removed watch for" << itPath;
+void FolderWatcherPrivate::removeFoldersBelow(const QString &path)
+{
+    // Remove the entry and all subentries
+    const auto watches = _watches.removeBelow(path);
+    for (const auto wd : watches) {
+        inotify_rm_watch(_fd, wd);
+    }
+    if (!watches.isEmpty()) {
+        qCDebug(lcFolderWatcher) << "Removed" << watches.size() << "watches for" << path;
     }
 }
 
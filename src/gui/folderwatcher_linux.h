@@ -11,7 +11,16 @@
 #include <QString>
 #include <QSocketNotifier>
 #include <QHash>
+#include <QMap>
+#include <QSet>
 #include <QDir>
+#include <QFuture>
+#include <QVector>
+
+#include <atomic>
+#include <functional>
+#include <utility>
+#include <vector>
 
 #include "folderwatcher.h"
 
@@ -20,7 +29,62 @@ class QTimer;
 namespace OCC {
 
 /**
- * @brief Linux (inotify) API implementation of FolderWatcher
+ * @brief The directories watched with inotify, by path and by watch descriptor
+ *
+ * Every directory is stored once, as its name and the index of its parent,
+ * instead of as a full path per lookup direction. Full paths are rebuilt
+ * when a notification arrives.
+ *
+ * @ingroup gui
+ */
+class InotifyWatchTree
+{
+public:
+    explicit InotifyWatchTree(const QString &root = {});
+
+    /// Path must be the root or below it
+    void insert(const QString &path, int wd);
+    [[nodiscard]] bool contains(const QString &path) const;
+    /// The path watched with wd, empty if unknown
+    [[nodiscard]] QString path(int wd) const;
+    /// Removes path and everything below it, returns their watch descriptors
+    QVector<int> removeBelow(const QString &path);
+    [[nodiscard]] int size() const { return _byWatch.size(); }
+
+private:
+    struct Node
+    {
+        QString name;
+        int parent = -1;
+        int wd = -1;
+        QVector<int> children;
+    };
+
+    [[nodiscard]] int find(const QString &path) const;
+    int findOrCreate(const QString &path);
+    void removeNode(int index);
+
+    QString _root;
+    /// Index 0 is the root, removed nodes are reused
+    std::vector<Node> _nodes;
+    QVector<int> _freeNodes;
+    QHash<std::pair<int, QString>, int> _children;
+    QHash<int, int> _byWatch;
+};
+
+/**
+ * @brief Linux (fanotify or inotify) API implementation of FolderWatcher
+ *
+ * With OWNCLOUD_ENABLE_FANOTIFY set, and when the process may mark whole
+ * file systems (CAP_SYS_ADMIN and CAP_DAC_READ_SEARCH), one fanotify mark
+ * on the file system of the folder replaces the per directory watches,
+ * and events outside the folder are dropped. It is opt-in because every
+ * change on that file system then reaches the GUI thread.
+ *
+ * With inotify, the directories present when the watcher is created are
+ * registered by a background worker, which hands over the new watches in
+ * batches. The watcher is ready once all of them are registered.
+ *
  * @ingroup gui
  */
 class FolderWatcherPrivate : public QObject
@@ -31,28 +95,61 @@ public:
     FolderWatcherPrivate(FolderWatcher *p, const QString &path);
     ~FolderWatcherPrivate() override;
 
-    [[nodiscard]] int testWatchCount() const { return _pathToWatch.size(); }
+    [[nodiscard]] int testWatchCount() const { return _watches.size(); }
+    [[nodiscard]] bool testUsesFanotify() const { return _fanotifyFd != -1; }
 
-    /// On linux the watcher is ready when the ctor finished.
-    bool _ready = true;
+    /// On linux the watcher is ready when the initial registration finished.
+    bool _ready = false;
 
 protected slots:
     void slotReceivedNotification(int fd);
     void slotAddFolderRecursive(const QString &path);
+    void slotReceivedFanotifyNotification(int fd);
 
 protected:
+    /// Calls callback for every directory below path until it returns false, without following symlinks.
+    /// Directories for which isIgnored returns true are skipped along with everything below them.
+    static bool forEachFolderBelow(const QString &path, const std::function<bool(const QString &)> &callback,
+        const std::function<bool(const QString &)> &isIgnored = {});
     bool findFoldersBelow(const QDir &dir, QStringList &fullList);
     void inotifyRegisterPath(const QString &path);
     void removeFoldersBelow(const QString &path);
 
 private:
+    void startRegistration(const QString &path);
+    void addWatches(const QVector<std::pair<int, QString>> &watches);
+    void watchesExhausted();
+
+    bool initFanotify();
+    void closeFanotify();
+    /// The path of the directory with the given file handle, empty if it is outside the folder
+    QString fanotifyDirectoryPath(const QByteArray &handle);
+    /// Drops the resolved paths of path and the directories below it
+    void forgetFanotifyDirectoriesBelow(const QString &path);
+
     FolderWatcher *_parent = nullptr;
 
     QString _folder;
-    QHash<int, QString> _watchToPath;
-    QMap<QString, int> _pathToWatch;
+    InotifyWatchTree _watches;
     QScopedPointer<QSocketNotifier> _socket;
-    int _fd = 0;
+    int _fd = -1;
+
+    QFuture<void> _registration;
+    std::atomic_bool _registrationCancelled = false;
+    /// FolderWatcher::ignoredPathMatcher() as of the start of the registration
+    std::function<bool(const QString &)> _pathIsIgnored;
+
+    int _fanotifyFd = -1;
+    /// Any descriptor on the marked file system, needed to open the reported handles
+    int _mountFd = -1;
+    /// The folder with symlinks resolved, as the kernel reports it
+    QString _canonicalFolder;
+    /// Resolved directory handles, forgotten when they or a parent move or disappear
+    QHash<QByteArray, QString> _fanotifyDirectories;
+    /// The same by path, to find the directories below a path
+    QMap<QString, QByteArray> _fanotifyDirectoryHandles;
+    /// Handles of directories outside the folder
+    QSet<QByteArray> _fanotifyOutsideDirectories;
 };
 }
 
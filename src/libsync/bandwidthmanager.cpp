@@ -15,10 +15,13 @@
 #include <winbase.h>
 #endif
 
+#include <QElapsedTimer>
 #include <QLoggingCategory>
 #include <QTimer>
 #include <QObject>
 
+#include <vector>
+
 namespace OCC {
 
 Q_LOGGING_CATEGORY(lcBandwidthManager, "nextcloud.sync.bandwidthmanager", QtInfoMsg)
@@ -29,6 +32,9 @@ Q_LOGGING_CATEGORY(lcBandwidthManager, "nextcloud.sync.bandwidthmanager", QtInfo
 static qint64 relativeLimitMeasuringTimerIntervalMsec = 1000 * 2;
 // See also WritingState in http://code.woboq.org/qt5/qtbase/src/network/access/qhttpprotocolhandler.cpp.html#_ZN20QHttpProtocolHandler11sendRequestEv
 
+// Absolute limits hand out quota this often, short enough for transfers to look smooth
+static constexpr int absoluteLimitTimerIntervalMsec = 100;
+
 // FIXME At some point:
 //  * Register device only after the QNR received its metaDataChanged() signal
 //  * Incorporate Qt buffer fill state (it's a negative absolute delta).
@@ -36,12 +42,84 @@ static qint64 relativeLimitMeasuringTimerIntervalMsec = 1000 * 2;
 //  * For relative limiting, do less measuring and more delaying+giving quota
 //  * For relative limiting, smoothen measurements
 
-BandwidthManager::BandwidthManager(OwncloudPropagator *p)
+BandwidthBucket::BandwidthBucket(Clock clock)
+    : _clock(std::move(clock))
+{
+    if (!_clock) {
+        QElapsedTimer timer;
+        timer.start();
+        _clock = [timer] { return timer.elapsed(); };
+    }
+    _lastRefill = _clock();
+}
+
+void BandwidthBucket::setRate(qint64 bytesPerSecond)
+{
+    if (bytesPerSecond == _rate) {
+        return;
+    }
+    _rate = qMax(0LL, bytesPerSecond);
+    _tokens = burst();
+    _remainder = 0;
+    _lastRefill = _clock();
+}
+
+QVector<qint64> BandwidthBucket::takeShares(qint64 waitingTransfers)
+{
+    refill();
+    if (waitingTransfers <= 0) {
+        return {};
+    }
+    QVector<qint64> shares(waitingTransfers, _tokens / waitingTransfers);
+    const auto extra = _tokens % waitingTransfers;
+    const auto first = _nextExtra % waitingTransfers;
+    for (qint64 i = 0; i < extra; ++i) {
+        ++shares[(first + i) % waitingTransfers];
+    }
+    _nextExtra = (first + extra) % waitingTransfers;
+    _tokens = 0;
+    return shares;
+}
+
+qint64 BandwidthBucket::available()
+{
+    refill();
+    return _tokens;
+}
+
+void BandwidthBucket::refill()
+{
+    const auto now = _clock();
+    const auto elapsedMsec = now - _lastRefill;
+    _lastRefill = now;
+    if (_rate <= 0 || elapsedMsec <= 0) {
+        return;
+    }
+
+    _remainder += _rate * elapsedMsec;
+    _tokens += _remainder / 1000;
+    _remainder %= 1000;
+    if (_tokens >= burst()) {
+        _tokens = burst();
+        _remainder = 0;
+    }
+}
+
+qint64 BandwidthBucket::burst() const
+{
+    return _rate > 0 ? qMax(1LL, _rate * burstMsec / 1000) : 0;
+}
+
+BandwidthManager::BandwidthManager(OwncloudPropagator *p, const BandwidthBucket::Clock &clock)
     : QObject()
     , _propagator(p)
+    , _uploadBucket(clock)
+    , _downloadBucket(clock)
 {
     _currentUploadLimit = _propagator->_uploadLimit;
     _currentDownloadLimit = _propagator->_downloadLimit;
+    _uploadBucket.setRate(usingAbsoluteUploadLimit() ? _currentUploadLimit : 0);
+    _downloadBucket.setRate(usingAbsoluteDownloadLimit() ? _currentDownloadLimit : 0);
 
     QObject::connect(&_switchingTimer, &QTimer::timeout, this, &BandwidthManager::switchingTimerExpired);
     _switchingTimer.setInterval(10 * 1000);
@@ -50,8 +128,8 @@ BandwidthManager::BandwidthManager(OwncloudPropagator *p)
 
     // absolute uploads/downloads
     QObject::connect(&_absoluteLimitTimer, &QTimer::timeout, this, &BandwidthManager::absoluteLimitTimerExpired);
-    _absoluteLimitTimer.setInterval(1000);
-    _absoluteLimitTimer.start();
+    _absoluteLimitTimer.setInterval(absoluteLimitTimerIntervalMsec);
+    updateAbsoluteLimitTimer();
 
     // Relative uploads
     QObject::connect(&_relativeUploadMeasuringTimer, &QTimer::timeout,
@@ -76,6 +154,14 @@ BandwidthManager::BandwidthManager(OwncloudPropagator *p)
 
 BandwidthManager::~BandwidthManager() = default;
 
+void BandwidthManager::setClock(const BandwidthBucket::Clock &clock)
+{
+    _uploadBucket = BandwidthBucket(clock);
+    _downloadBucket = BandwidthBucket(clock);
+    _uploadBucket.setRate(usingAbsoluteUploadLimit() ? _currentUploadLimit : 0);
+    _downloadBucket.setRate(usingAbsoluteDownloadLimit() ? _currentDownloadLimit : 0);
+}
+
 void BandwidthManager::registerUploadDevice(UploadDevice *p)
 {
     _absoluteUploadDeviceList.push_back(p);
@@ -85,6 +171,8 @@ void BandwidthManager::registerUploadDevice(UploadDevice *p)
     if (usingAbsoluteUploadLimit()) {
         p->setBandwidthLimited(true);
         p->setChoked(false);
+        // Don't make a new transfer wait for the next tick, small files would crawl
+        absoluteLimitTimerExpired();
     } else if (usingRelativeUploadLimit()) {
         p->setBandwidthLimited(true);
         p->setChoked(true);
@@ -113,6 +201,7 @@ void BandwidthManager::registerDownloadJob(GETFileJob *j)
     if (usingAbsoluteDownloadLimit()) {
         j->setBandwidthLimited(true);
         j->setChoked(false);
+        absoluteLimitTimerExpired();
     } else if (usingRelativeDownloadLimit()) {
         j->setBandwidthLimited(true);
         j->setChoked(true);
@@ -333,12 +422,25 @@ void BandwidthManager::relativeDownloadDelayTimerExpired()
 
 // end downloads
 
+void BandwidthManager::updateAbsoluteLimitTimer()
+{
+    // Without an absolute limit there is nothing to hand out
+    if (usingAbsoluteUploadLimit() || usingAbsoluteDownloadLimit()) {
+        if (!_absoluteLimitTimer.isActive()) {
+            _absoluteLimitTimer.start();
+        }
+    } else {
+        _absoluteLimitTimer.stop();
+    }
+}
+
 void BandwidthManager::switchingTimerExpired()
 {
     const auto newUploadLimit = _propagator->_uploadLimit;
     if (newUploadLimit != _currentUploadLimit) {
         qCInfo(lcBandwidthManager) << "Upload Bandwidth limit changed" << _currentUploadLimit << newUploadLimit;
         _currentUploadLimit = newUploadLimit;
+        _uploadBucket.setRate(usingAbsoluteUploadLimit() ? _currentUploadLimit : 0);
 
         for (const auto uploadDevice : _relativeUploadDeviceList) {
             Q_ASSERT(uploadDevice);
@@ -360,6 +462,7 @@ void BandwidthManager::switchingTimerExpired()
     if (newDownloadLimit != _currentDownloadLimit) {
         qCInfo(lcBandwidthManager) << "Download Bandwidth limit changed" << _currentDownloadLimit << newDownloadLimit;
         _currentDownloadLimit = newDownloadLimit;
+        _downloadBucket.setRate(usingAbsoluteDownloadLimit() ? _currentDownloadLimit : 0);
 
         for (const auto getJob : _downloadJobList) {
             Q_ASSERT(getJob);
@@ -376,29 +479,49 @@ void BandwidthManager::switchingTimerExpired()
             }
         }
     }
+
+    updateAbsoluteLimitTimer();
 }
 
 void BandwidthManager::absoluteLimitTimerExpired()
 {
-    if (usingAbsoluteUploadLimit() && !_absoluteUploadDeviceList.empty()) {
-        const auto quotaPerDevice = _currentUploadLimit / qMax((std::list<UploadDevice *>::size_type)1, _absoluteUploadDeviceList.size());
-
-        qCDebug(lcBandwidthManager) << quotaPerDevice << _absoluteUploadDeviceList.size() << _currentUploadLimit;
-
+    // Only the transfers that used up their quota get more, in equal shares. The
+    // others are waiting for the network or the server and keep what they have.
+    if (usingAbsoluteUploadLimit()) {
+        std::vector<UploadDevice *> waitingDevices;
         for (const auto device : _absoluteUploadDeviceList) {
-            device->giveBandwidthQuota(quotaPerDevice);
-            qCDebug(lcBandwidthManager) << "Gave " << quotaPerDevice / 1024.0 << " kB to" << device;
+            if (device->_bandwidthQuota <= 0 && !device->atEnd()) {
+                waitingDevices.push_back(device);
+            }
         }
-    }
 
-    if (usingAbsoluteDownloadLimit() && !_downloadJobList.empty()) {
-        const auto quotaPerJob = _currentDownloadLimit / qMax((std::list<GETFileJob *>::size_type)1, _downloadJobList.size());
-
-        qCDebug(lcBandwidthManager) << quotaPerJob << _downloadJobList.size() << _currentDownloadLimit;
+        const auto shares = _uploadBucket.takeShares(static_cast<qint64>(waitingDevices.size()));
+        for (size_t i = 0; i < waitingDevices.size(); ++i) {
+            if (shares.at(i) > 0) {
+                waitingDevices.at(i)->giveBandwidthQuota(shares.at(i));
+            }
+        }
+        if (!shares.isEmpty()) {
+            qCDebug(lcBandwidthManager) << shares.first() << waitingDevices.size() << _absoluteUploadDeviceList.size() << _currentUploadLimit;
+        }
+    }
 
+    if (usingAbsoluteDownloadLimit()) {
+        std::vector<GETFileJob *> waitingJobs;
         for (const auto job : _downloadJobList) {
-            job->giveBandwidthQuota(quotaPerJob);
-            qCDebug(lcBandwidthManager) << "Gave " << quotaPerJob / 1024.0 << " kB to" << job;
+            if (job->bandwidthQuota() <= 0) {
+                waitingJobs.push_back(job);
+            }
+        }
+
+        const auto shares = _downloadBucket.takeShares(static_cast<qint64>(waitingJobs.size()));
+        for (size_t i = 0; i < waitingJobs.size(); ++i) {
+            if (shares.at(i) > 0) {
+                waitingJobs.at(i)->giveBandwidthQuota(shares.at(i));
+            }
+        }
+        if (!shares.isEmpty()) {
+            qCDebug(lcBandwidthManager) << shares.first() << waitingJobs.size() << _downloadJobList.size() << _currentDownloadLimit;
         }
     }
 }
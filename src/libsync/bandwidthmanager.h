@@ -7,9 +7,13 @@
 #ifndef BANDWIDTHMANAGER_H
 #define BANDWIDTHMANAGER_H
 
+#include "owncloudlib.h"
+
 #include <QObject>
 #include <QTimer>
 #include <QIODevice>
+#include <QVector>
+#include <functional>
 #include <list>
 
 namespace OCC {
@@ -18,17 +22,70 @@ class UploadDevice;
 class GETFileJob;
 class OwncloudPropagator;
 
+/**
+ * @brief Token bucket that shares a byte rate among parallel transfers
+ *
+ * The bucket fills at the rate, up to burstMsec worth of bytes. Every
+ * takeShares() hands what was gathered out in equal parts to the transfers
+ * that are waiting for more, so that together they stay within the rate
+ * however many of them run in parallel.
+ *
+ * @ingroup libsync
+ */
+class OWNCLOUDSYNC_EXPORT BandwidthBucket
+{
+public:
+    /// Milliseconds of a monotonic clock, tests pass a simulated one
+    using Clock = std::function<qint64()>;
+
+    static constexpr qint64 burstMsec = 200;
+
+    explicit BandwidthBucket(Clock clock = {});
+
+    /// A new rate starts with a full burst, so that transfers start right away. 0 means no limit.
+    void setRate(qint64 bytesPerSecond);
+    [[nodiscard]] qint64 rate() const { return _rate; }
+
+    /** The bytes each of the waiting transfers may send, in their order.
+     *
+     * Bytes that don't divide evenly go one each to the transfers from a
+     * position that moves on with every call, so that with fewer tokens than
+     * transfers every one of them still gets its turn. With no waiting
+     * transfer the tokens stay in the bucket, up to the burst.
+     */
+    QVector<qint64> takeShares(qint64 waitingTransfers);
+
+    [[nodiscard]] qint64 available();
+
+private:
+    void refill();
+    [[nodiscard]] qint64 burst() const;
+
+    Clock _clock;
+    qint64 _rate = 0;
+    qint64 _tokens = 0;
+    // Rate times milliseconds not converted to tokens yet, for rates below 1000 bytes per second
+    qint64 _remainder = 0;
+    qint64 _lastRefill = 0;
+    // Where the next bytes that don't divide evenly go
+    qint64 _nextExtra = 0;
+};
+
 /**
  * @brief The BandwidthManager class
  * @ingroup libsync
  */
-class BandwidthManager : public QObject
+class OWNCLOUDSYNC_EXPORT BandwidthManager : public QObject
 {
     Q_OBJECT
 public:
-    BandwidthManager(OwncloudPropagator *p);
+    /// clock is for the absolute limits, tests pass a simulated one
+    BandwidthManager(OwncloudPropagator *p, const BandwidthBucket::Clock &clock = {});
     ~BandwidthManager() override;
 
+    /// for the test, restarts the absolute limits on the given clock
+    void setClock(const BandwidthBucket::Clock &clock);
+
     bool usingAbsoluteUploadLimit() { return _currentUploadLimit > 0; }
     bool usingRelativeUploadLimit() { return _currentUploadLimit < 0; }
     bool usingAbsoluteDownloadLimit() { return _currentDownloadLimit > 0; }
@@ -52,6 +109,9 @@ public slots:
     void relativeDownloadDelayTimerExpired();
 
 private:
+    // runs the absolute limit timer only while one of the limits is absolute
+    void updateAbsoluteLimitTimer();
+
     // for switching between absolute and relative bw limiting
     QTimer _switchingTimer;
 
@@ -61,6 +121,8 @@ private:
 
     // for absolute up/down bw limiting
     QTimer _absoluteLimitTimer;
+    BandwidthBucket _uploadBucket;
+    BandwidthBucket _downloadBucket;
 
     // FIXME merge these two lists
     std::list<UploadDevice *> _absoluteUploadDeviceList;
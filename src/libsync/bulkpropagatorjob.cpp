@@ -300,34 +300,18 @@ void BulkPropagatorJob::slotComputeTransmissionChecksum(SyncFileItemPtr item,
     // Compute the transmission checksum.
     const auto computeChecksum = new ComputeChecksum(this);
     const auto checksumType = uploadChecksumEnabled() ? propagator()->account()->capabilities().preferredUploadChecksumType() : QByteArray{""};
-    computeChecksum->setChecksumType(checksumType);
-
-    connect(computeChecksum, &ComputeChecksum::done, this, [this, item, fileToUpload] (const QByteArray &contentChecksumType, const QByteArray &contentChecksum) {
-        if (propagator()->account()->bulkUploadNeedsLegacyChecksumHeader()) {
-            slotComputeMd5Checksum(item, fileToUpload, contentChecksumType, contentChecksum);
-        } else {
-            slotStartUpload(item, fileToUpload, contentChecksumType, contentChecksum, {});
-        }
-    });
-    connect(computeChecksum, &ComputeChecksum::done, computeChecksum, &QObject::deleteLater);
-
-    computeChecksum->start(fileToUpload._path);
-}
-
-void BulkPropagatorJob::slotComputeMd5Checksum(SyncFileItemPtr item,
-                                               UploadFileInfo fileToUpload,
-                                               const QByteArray &transmissionChecksumType,
-                                               const QByteArray &transmissionChecksum)
-{
-    // Compute the transmission checksum.
-    const auto computeChecksum = new ComputeChecksum(this);
-    const auto checksumType = QByteArray{"MD5"};
-    computeChecksum->setChecksumType(checksumType);
-
-    connect(computeChecksum, &ComputeChecksum::done, this, [this, item, fileToUpload, transmissionChecksumType, transmissionChecksum] (const QByteArray &contentChecksumType, const QByteArray &contentChecksum) {
-        Q_UNUSED(contentChecksumType)
+    const auto md5ChecksumType = QByteArray{"MD5"};
+    const auto needsMd5Checksum = propagator()->account()->bulkUploadNeedsLegacyChecksumHeader();
+    if (needsMd5Checksum) {
+        // Computed in the same pass over the file
+        computeChecksum->setChecksumTypes({checksumType, md5ChecksumType});
+    } else {
+        computeChecksum->setChecksumType(checksumType);
+    }
 
-        slotStartUpload(item, fileToUpload, transmissionChecksumType, transmissionChecksum, contentChecksum);
+    connect(computeChecksum, &ComputeChecksum::done, this, [this, item, fileToUpload, computeChecksum, needsMd5Checksum, md5ChecksumType] (const QByteArray &contentChecksumType, const QByteArray &contentChecksum) {
+        const auto md5Checksum = needsMd5Checksum ? computeChecksum->checksum(md5ChecksumType) : QByteArray{};
+        slotStartUpload(item, fileToUpload, contentChecksumType, contentChecksum, md5Checksum);
     });
     connect(computeChecksum, &ComputeChecksum::done, computeChecksum, &QObject::deleteLater);
 
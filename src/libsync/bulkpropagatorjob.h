@@ -64,11 +64,6 @@ private slots:
     void slotComputeTransmissionChecksum(OCC::SyncFileItemPtr item,
                                          OCC::BulkPropagatorJob::UploadFileInfo fileToUpload);
 
-    void slotComputeMd5Checksum(SyncFileItemPtr item,
-                                UploadFileInfo fileToUpload,
-                                const QByteArray &transmissionChecksumType,
-                                const QByteArray &transmissionChecksum);
-
     // transmission checksum computed, prepare the upload
     void slotStartUpload(OCC::SyncFileItemPtr item,
                          OCC::BulkPropagatorJob::UploadFileInfo fileToUpload,
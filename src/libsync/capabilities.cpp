@@ -253,6 +253,11 @@ bool Capabilities::bulkUpload() const
     return _capabilities["dav"].toMap()["bulkupload"].toByteArray() >= "1.0";
 }
 
+bool Capabilities::deltaSync() const
+{
+    return _capabilities["dav"].toMap()["deltaSync"].toByteArray() >= "1.0";
+}
+
 bool Capabilities::filesLockAvailable() const
 {
     return _capabilities["files"].toMap()["locking"].toByteArray() >= "1.0";
@@ -58,6 +58,8 @@ public:
     [[nodiscard]] qint64 maxChunkSize() const;
     [[nodiscard]] int maxConcurrentChunkUploads() const;
     [[nodiscard]] bool bulkUpload() const;
+    /// Whether chunks of an upload may refer to a range of the version on the server
+    [[nodiscard]] bool deltaSync() const;
     [[nodiscard]] bool filesLockAvailable() const;
     [[nodiscard]] bool filesLockTypeAvailable() const;
     [[nodiscard]] bool userStatus() const;
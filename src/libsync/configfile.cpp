@@ -59,6 +59,12 @@ static constexpr char chunkSizeC[] = "chunkSize";
 static constexpr char minChunkSizeC[] = "minChunkSize";
 static constexpr char maxChunkSizeC[] = "maxChunkSize";
 static constexpr char targetChunkUploadDurationC[] = "targetChunkUploadDuration";
+static constexpr char maxConcurrentSyncsC[] = "maxConcurrentSyncs";
+static constexpr char concurrentSyncsNetworkJobBudgetC[] = "concurrentSyncsNetworkJobBudget";
+static constexpr char journalReadConnectionsC[] = "journalReadConnections";
+static constexpr char bulkRemoteDiscoveryC[] = "bulkRemoteDiscovery";
+static constexpr char journalSnapshotDiscoveryC[] = "journalSnapshotDiscovery";
+static constexpr char streamingPropagationC[] = "streamingPropagation";
 static constexpr char automaticLogDirC[] = "logToTemporaryLogDir";
 static constexpr char logDirC[] = "logDir";
 static constexpr char logDebugC[] = "logDebug";
@@ -279,6 +285,42 @@ chrono::milliseconds ConfigFile::targetChunkUploadDuration() const
     return millisecondsValue(settings, targetChunkUploadDurationC, chrono::minutes(1));
 }
 
+int ConfigFile::maxConcurrentSyncs() const
+{
+    QSettings settings(configFile(), QSettings::IniFormat);
+    return qMax(1, settings.value(QLatin1String(maxConcurrentSyncsC), 1).toInt()); // default to one sync at a time
+}
+
+int ConfigFile::concurrentSyncsNetworkJobBudget() const
+{
+    QSettings settings(configFile(), QSettings::IniFormat);
+    return qMax(0, settings.value(QLatin1String(concurrentSyncsNetworkJobBudgetC), 12).toInt());
+}
+
+bool ConfigFile::journalReadConnections() const
+{
+    QSettings settings(configFile(), QSettings::IniFormat);
+    return settings.value(QLatin1String(journalReadConnectionsC), false).toBool();
+}
+
+bool ConfigFile::bulkRemoteDiscovery() const
+{
+    QSettings settings(configFile(), QSettings::IniFormat);
+    return settings.value(QLatin1String(bulkRemoteDiscoveryC), false).toBool();
+}
+
+bool ConfigFile::journalSnapshotDiscovery() const
+{
+    QSettings settings(configFile(), QSettings::IniFormat);
+    return settings.value(QLatin1String(journalSnapshotDiscoveryC), false).toBool();
+}
+
+bool ConfigFile::streamingPropagation() const
+{
+    QSettings settings(configFile(), QSettings::IniFormat);
+    return settings.value(QLatin1String(streamingPropagationC), false).toBool();
+}
+
 void ConfigFile::setOptionalServerNotifications(bool show)
 {
     QSettings settings(configFile(), QSettings::IniFormat);
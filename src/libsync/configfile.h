@@ -177,6 +177,19 @@ public:
     [[nodiscard]] qint64 minChunkSize() const;
     [[nodiscard]] std::chrono::milliseconds targetChunkUploadDuration() const;
 
+    /** How many folders may sync at the same time, 1 means one folder at a time */
+    [[nodiscard]] int maxConcurrentSyncs() const;
+    /** Number of parallel network jobs shared by all concurrently syncing folders, 0 for no limit */
+    [[nodiscard]] int concurrentSyncsNetworkJobBudget() const;
+    /** Whether other threads read the sync journal through connections of their own, see SyncJournalDb::setReadConnectionsEnabled() */
+    [[nodiscard]] bool journalReadConnections() const;
+    /** Whether the initial sync of a folder lists the whole remote tree with one Depth: infinity PROPFIND */
+    [[nodiscard]] bool bulkRemoteDiscovery() const;
+    /** Whether discovery reads the whole journal into memory once instead of querying it per directory */
+    [[nodiscard]] bool journalSnapshotDiscovery() const;
+    /** Whether downloads of completely discovered subtrees start before the whole discovery finished */
+    [[nodiscard]] bool streamingPropagation() const;
+
     void saveGeometry(QWidget *w);
     void restoreGeometry(QWidget *w);
 
@@ -0,0 +1,180 @@
+/*
+ * SPDX-FileCopyrightText: 2026 Nextcloud GmbH and Nextcloud contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "davproperties.h"
+
+#include <algorithm>
+
+using namespace Qt::StringLiterals;
+
+namespace OCC {
+
+namespace {
+
+// In the order of DavProperties::Key
+constexpr std::array<QLatin1String, DavProperties::KeyCount> keyNames = {
+    "resourcetype"_L1,
+    "getlastmodified"_L1,
+    "getcontentlength"_L1,
+    "getetag"_L1,
+    "quota-available-bytes"_L1,
+    "quota-used-bytes"_L1,
+    "size"_L1,
+    "id"_L1,
+    "fileid"_L1,
+    "downloadURL"_L1,
+    "dDC"_L1,
+    "permissions"_L1,
+    "checksums"_L1,
+    "is-encrypted"_L1,
+    "metadata-files-live-photo"_L1,
+    "share-attributes"_L1,
+    "share-types"_L1,
+    "data-fingerprint"_L1,
+    "lock"_L1,
+    "lock-owner"_L1,
+    "lock-owner-displayname"_L1,
+    "lock-owner-type"_L1,
+    "lock-owner-editor"_L1,
+    "lock-time"_L1,
+    "lock-timeout"_L1,
+    "lock-token"_L1,
+    "is-mount-root"_L1,
+};
+
+// The keys sorted by name, for a binary search in keyForName()
+const std::array<DavProperties::Key, DavProperties::KeyCount> &keysByName()
+{
+    static const auto keys = [] {
+        std::array<DavProperties::Key, DavProperties::KeyCount> result{};
+        for (int i = 0; i < DavProperties::KeyCount; ++i) {
+            result[i] = static_cast<DavProperties::Key>(i);
+        }
+        std::sort(result.begin(), result.end(), [](DavProperties::Key a, DavProperties::Key b) {
+            return keyNames[a] < keyNames[b];
+        });
+        return result;
+    }();
+    return keys;
+}
+
+}
+
+DavProperties::Key DavProperties::keyForName(QStringView name)
+{
+    const auto &keys = keysByName();
+    const auto it = std::lower_bound(keys.cbegin(), keys.cend(), name, [](Key key, QStringView name) {
+        return name.compare(keyNames[key]) > 0;
+    });
+    if (it != keys.cend() && name == keyNames[*it]) {
+        return *it;
+    }
+    return KeyCount;
+}
+
+QLatin1String DavProperties::nameForKey(Key key)
+{
+    Q_ASSERT(key < KeyCount);
+    return keyNames[key];
+}
+
+bool DavProperties::contains(QStringView name) const
+{
+    if (const auto key = keyForName(name); key != KeyCount) {
+        return contains(key);
+    }
+    return std::any_of(_other.cbegin(), _other.cend(), [name](const auto &property) {
+        return property.first == name;
+    });
+}
+
+QStringView DavProperties::value(Key key) const
+{
+    return contains(key) ? view(_slots[key]) : QStringView{};
+}
+
+QStringView DavProperties::value(QStringView name) const
+{
+    if (const auto key = keyForName(name); key != KeyCount) {
+        return value(key);
+    }
+    for (const auto &property : _other) {
+        if (property.first == name) {
+            return view(property.second);
+        }
+    }
+    return {};
+}
+
+void DavProperties::insert(Key key, QStringView value)
+{
+    Q_ASSERT(key < KeyCount);
+    _slots[key] = append(value);
+    _present |= 1u << key;
+}
+
+void DavProperties::insert(QStringView name, QStringView value)
+{
+    if (const auto key = keyForName(name); key != KeyCount) {
+        insert(key, value);
+        return;
+    }
+    const auto slice = append(value);
+    for (auto &property : _other) {
+        if (property.first == name) {
+            property.second = slice;
+            return;
+        }
+    }
+    _other.append({name.toString(), slice});
+}
+
+void DavProperties::clear()
+{
+    if (_values.isDetached()) {
+        // Keep the capacity, the next entry will need about as much
+        _values.truncate(0);
+    } else {
+        // Someone kept a copy of these values, don't touch their buffer
+        const auto capacity = _values.capacity();
+        _values = QString();
+        _values.reserve(capacity);
+    }
+    _present = 0;
+    _other.clear();
+}
+
+DavProperties::Slice DavProperties::append(QStringView value)
+{
+    const auto offset = _values.size();
+    _values.append(value);
+    return {offset, value.size()};
+}
+
+QMap<QString, QString> DavProperties::toMap() const
+{
+    QMap<QString, QString> map;
+    for (int i = 0; i < KeyCount; ++i) {
+        const auto key = static_cast<Key>(i);
+        if (contains(key)) {
+            map.insert(keyNames[key], view(_slots[key]).toString());
+        }
+    }
+    for (const auto &property : _other) {
+        map.insert(property.first, view(property.second).toString());
+    }
+    return map;
+}
+
+DavProperties DavProperties::fromMap(const QMap<QString, QString> &map)
+{
+    DavProperties properties;
+    for (auto it = map.cbegin(); it != map.cend(); ++it) {
+        properties.insert(it.key(), it.value());
+    }
+    return properties;
+}
+
+}
@@ -0,0 +1,107 @@
+/*
+ * SPDX-FileCopyrightText: 2026 Nextcloud GmbH and Nextcloud contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include "owncloudlib.h"
+
+#include <QMap>
+#include <QMetaType>
+#include <QString>
+#include <QStringView>
+#include <QVector>
+
+#include <array>
+
+namespace OCC {
+
+/**
+ * @brief The WebDAV properties of one entry of a PROPFIND reply
+ *
+ * Property names are the element names without namespace. The properties the
+ * sync engine asks for have a fixed slot indexed by Key, anything else is kept
+ * in a small list. All values are stored back to back in a single string, so
+ * an entry costs one allocation instead of a map node and two strings per
+ * property, and clear() keeps that buffer for the next entry.
+ *
+ * @ingroup libsync
+ */
+class OWNCLOUDSYNC_EXPORT DavProperties
+{
+public:
+    enum Key : quint8 {
+        ResourceType,
+        GetLastModified,
+        GetContentLength,
+        GetEtag,
+        QuotaAvailableBytes,
+        QuotaUsedBytes,
+        Size,
+        Id,
+        FileId,
+        DownloadUrl,
+        DirectDownloadCookies,
+        Permissions,
+        Checksums,
+        IsEncrypted,
+        MetadataFilesLivePhoto,
+        ShareAttributes,
+        ShareTypes,
+        DataFingerprint,
+        Lock,
+        LockOwner,
+        LockOwnerDisplayName,
+        LockOwnerType,
+        LockOwnerEditor,
+        LockTime,
+        LockTimeout,
+        LockToken,
+        IsMountRoot,
+
+        KeyCount
+    };
+
+    /// The key of a property name, KeyCount if the property has no slot
+    [[nodiscard]] static Key keyForName(QStringView name);
+    [[nodiscard]] static QLatin1String nameForKey(Key key);
+
+    [[nodiscard]] bool contains(Key key) const { return _present & (1u << key); }
+    [[nodiscard]] bool contains(QStringView name) const;
+
+    /// The value of the property, an empty view if it is missing
+    [[nodiscard]] QStringView value(Key key) const;
+    [[nodiscard]] QStringView value(QStringView name) const;
+
+    /// Sets a property, replacing any previous value
+    void insert(Key key, QStringView value);
+    void insert(QStringView name, QStringView value);
+
+    [[nodiscard]] bool isEmpty() const { return _present == 0 && _other.isEmpty(); }
+    void clear();
+
+    [[nodiscard]] QMap<QString, QString> toMap() const;
+    [[nodiscard]] static DavProperties fromMap(const QMap<QString, QString> &map);
+
+private:
+    struct Slice
+    {
+        qsizetype offset = 0;
+        qsizetype length = 0;
+    };
+
+    [[nodiscard]] Slice append(QStringView value);
+    [[nodiscard]] QStringView view(Slice slice) const { return QStringView{_values}.mid(slice.offset, slice.length); }
+
+    QString _values;
+    std::array<Slice, KeyCount> _slots{};
+    quint32 _present = 0;
+    QVector<QPair<QString, Slice>> _other;
+
+    static_assert(KeyCount <= 32, "_present has one bit per key");
+};
+
+}
+
+Q_DECLARE_METATYPE(OCC::DavProperties)
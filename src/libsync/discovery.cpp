@@ -20,7 +20,6 @@
 #include "vio/csync_vio_local.h"
 #include <QFileInfo>
 #include <QFile>
-#include <QThreadPool>
 #include <common/checksums.h>
 #include <common/constants.h>
 #include "csync_exclude.h"
@@ -99,6 +98,7 @@ void ProcessDirectoryJob::start()
     if (_queryLocal == NormalQuery) {
         startAsyncLocalQuery();
     } else {
+        _discoveryData->releaseLocalListing(_discoveryData->_localDir + _currentFolder._local);
         _localQueryDone = true;
     }
 
@@ -125,7 +125,7 @@ void ProcessDirectoryJob::process()
 
     // fetch all the name from the DB
     auto pathU8 = _currentFolder._original.toUtf8();
-    if (!_discoveryData->_statedb->listFilesInPath(pathU8, [&](const SyncJournalFileRecord &rec) {
+    if (!_discoveryData->listDbFilesInPath(pathU8, [&](const SyncJournalFileRecord &rec) {
             auto name = pathU8.isEmpty() ? rec._path : QString::fromUtf8(rec._path.constData() + (pathU8.size() + 1));
             if (rec.isVirtualFile() && isVfsWithSuffix())
                 chopVirtualFileSuffix(name);
@@ -887,7 +887,7 @@ void ProcessDirectoryJob::processFileAnalyzeRemoteInfo(const SyncFileItemPtr &it
                         }
                     };
 
-                    const auto listFilesSucceeded = _discoveryData->_statedb->listFilesInPath(dbEntry.path().toUtf8(), listFilesCallback);
+                    const auto listFilesSucceeded = _discoveryData->listDbFilesInPath(dbEntry.path().toUtf8(), listFilesCallback);
 
                     if (listFilesSucceeded && localFolderSize != 0 && localFolderSize == serverEntry.sizeOfFolder) {
                         qCInfo(lcDisco) << "Migration of E2EE folder " << dbEntry.path() << " from older version to the one, supporting the implicit VFS hydration.";
@@ -1280,7 +1280,7 @@ void ProcessDirectoryJob::processFileAnalyzeLocalInfo(
         } else if (noServerEntry) {
             // Not locally, not on the server. The entry is stale!
             qCInfo(lcDisco) << "Stale DB entry";
-            if (!_discoveryData->_statedb->deleteFileRecord(path._original, true)) {
+            if (!_discoveryData->deleteDbRecordRecursively(path._original)) {
                 emit _discoveryData->fatalError(tr("Error while deleting file record %1 from the database").arg(path._original), ErrorCategory::GenericError);
                 qCWarning(lcDisco) << "Failed to delete a file record from the local DB" << path._original;
             }
@@ -1616,7 +1616,7 @@ void ProcessDirectoryJob::processFileAnalyzeLocalInfo(
         if (wasDeletedOnClient.first) {
             // More complicated. The REMOVE is canceled. Restore will happen next sync.
             qCInfo(lcDisco) << "Undid remove instruction on source" << originalPath;
-            if (!_discoveryData->_statedb->deleteFileRecord(originalPath, true)) {
+            if (!_discoveryData->deleteDbRecordRecursively(originalPath)) {
                 qCWarning(lcDisco) << "Failed to delete a file record from the local DB" << originalPath;
             }
             _discoveryData->_statedb->schedulePathForRemoteDiscovery(originalPath);
@@ -2166,8 +2166,12 @@ void ProcessDirectoryJob::subJobFinished()
     _childIgnored |= job->_childIgnored;
     _childModified |= job->_childModified;
 
-    if (job->_dirItem)
+    if (job->_dirItem) {
         emit _discoveryData->itemDiscovered(job->_dirItem);
+        if (_discoveryData->_syncOptions._streamingPropagation && job->canPropagateSubtreeEarly()) {
+            emit _discoveryData->subtreeDiscovered(job->_dirItem);
+        }
+    }
 
     int count = _runningJobs.removeAll(job);
     ASSERT(count == 1);
@@ -2175,8 +2179,29 @@ void ProcessDirectoryJob::subJobFinished()
     QTimer::singleShot(0, _discoveryData, &DiscoveryPhase::scheduleMoreJobs);
 }
 
+bool ProcessDirectoryJob::canPropagateSubtreeEarly() const
+{
+    if (isInsideEncryptedTree()) {
+        return false;
+    }
+    for (auto job = this; job && job->_dirItem; job = qobject_cast<const ProcessDirectoryJob *>(job->parent())) {
+        const auto &item = *job->_dirItem;
+        const auto staysInPlace = item._instruction == CSYNC_INSTRUCTION_NONE
+            || item._instruction == CSYNC_INSTRUCTION_UPDATE_METADATA
+            || (item._instruction == CSYNC_INSTRUCTION_NEW && item._direction == SyncFileItem::Down);
+        if (!staysInPlace || !item.isDirectory() || item._isSelectiveSync || item._isRestoration) {
+            return false;
+        }
+    }
+    return !_discoveryData->hasPendingRenameOrDeletion(_dirItem->_file);
+}
+
 int ProcessDirectoryJob::processSubJobs(int nbJobs)
 {
+    if (_pendingAsyncJobs == 0 && !_prefetchedLocalPaths.isEmpty()) {
+        releaseUnusedLocalListings();
+    }
+
     if (_queuedJobs.empty() && _runningJobs.empty() && _pendingAsyncJobs == 0) {
         _pendingAsyncJobs = -1; // We're finished, we don't want to emit finished again
         if (_dirItem) {
@@ -2262,6 +2287,10 @@ DiscoverySingleDirectoryJob *ProcessDirectoryJob::startAsyncServerQuery()
     if (!_dirItem) {
         serverJob->setIsRootPath(); // query the fingerprint on the root
     }
+    if (_discoveryData->_bulkRemoteListing) {
+        serverJob->setBulkRemoteListing(_discoveryData->_bulkRemoteListing);
+    }
+    serverJob->setJournal(_discoveryData->_statedb);
 
     connect(serverJob, &DiscoverySingleDirectoryJob::etag, this, &ProcessDirectoryJob::etag);
     connect(serverJob, &DiscoverySingleDirectoryJob::setfolderQuota, this, &ProcessDirectoryJob::setFolderQuota);
@@ -2342,53 +2371,85 @@ void ProcessDirectoryJob::setFolderQuota(const FolderQuota &folderQuota)
 void ProcessDirectoryJob::startAsyncLocalQuery()
 {
     QString localPath = _discoveryData->_localDir + _currentFolder._local;
-    auto localJob = new DiscoverySingleLocalDirectoryJob(_discoveryData->_account, localPath, _discoveryData->_syncOptions._vfs.data());
 
     _discoveryData->_currentlyActiveJobs++;
     _pendingAsyncJobs++;
 
-    connect(localJob, &DiscoverySingleLocalDirectoryJob::itemDiscovered, _discoveryData, &DiscoveryPhase::itemDiscovered);
-
-    connect(localJob, &DiscoverySingleLocalDirectoryJob::childIgnored, this, [this](bool b) {
-        _childIgnored = b;
-    });
-
-    connect(localJob, &DiscoverySingleLocalDirectoryJob::finishedFatalError, this, [this](const QString &msg) {
+    _discoveryData->listLocalDirectory(localPath, this, [this](const LocalDirectoryListing &listing) {
         _discoveryData->_currentlyActiveJobs--;
         _pendingAsyncJobs--;
-        if (_serverJob)
-            _serverJob->abort();
 
-        emit _discoveryData->fatalError(msg, ErrorCategory::NetworkError);
-    });
+        for (const auto &item : listing.discoveredItems) {
+            emit _discoveryData->itemDiscovered(item);
+        }
+        if (listing.childIgnored) {
+            _childIgnored = true;
+        }
 
-    connect(localJob, &DiscoverySingleLocalDirectoryJob::finishedNonFatalError, this, [this](const QString &msg) {
-        _discoveryData->_currentlyActiveJobs--;
-        _pendingAsyncJobs--;
+        switch (listing.status) {
+        case LocalDirectoryListing::Status::FatalError:
+            if (_serverJob)
+                _serverJob->abort();
 
-        if (_dirItem) {
-            _dirItem->_instruction = CSYNC_INSTRUCTION_IGNORE;
-            _dirItem->_errorString = msg;
-            emit this->finished();
-        } else {
-            // Fatal for the root job since it has no SyncFileItem
-            emit _discoveryData->fatalError(msg, ErrorCategory::GenericError);
+            emit _discoveryData->fatalError(listing.errorString, ErrorCategory::NetworkError);
+            return;
+        case LocalDirectoryListing::Status::NonFatalError:
+            if (_dirItem) {
+                _dirItem->_instruction = CSYNC_INSTRUCTION_IGNORE;
+                _dirItem->_errorString = listing.errorString;
+                emit this->finished();
+            } else {
+                // Fatal for the root job since it has no SyncFileItem
+                emit _discoveryData->fatalError(listing.errorString, ErrorCategory::GenericError);
+            }
+            return;
+        case LocalDirectoryListing::Status::Pending:
+        case LocalDirectoryListing::Status::Success:
+            break;
         }
-    });
 
-    connect(localJob, &DiscoverySingleLocalDirectoryJob::finished, this, [this](const auto &results) {
-        _discoveryData->_currentlyActiveJobs--;
-        _pendingAsyncJobs--;
-
-        _localNormalQueryEntries = results;
+        _localNormalQueryEntries = listing.entries;
         _localQueryDone = true;
 
+        prefetchLocalSubdirectories();
+
         if (_serverQueryDone)
             this->process();
     });
+}
 
-    QThreadPool *pool = QThreadPool::globalInstance();
-    pool->start(localJob); // QThreadPool takes ownership
+void ProcessDirectoryJob::prefetchLocalSubdirectories()
+{
+    QStringList localPaths;
+    for (const auto &entry : std::as_const(_localNormalQueryEntries)) {
+        if (!entry.isDirectory || entry.isSymLink || entry.isVirtualFile) {
+            continue;
+        }
+        const auto path = PathTuple::pathAppend(_currentFolder._local, entry.name);
+        // Same policy as in start(), the subdirectories that won't be listed aren't worth prefetching
+        if (!_discoveryData->_shouldDiscoverLocaly(path) && !_discoveryData->isInSelectiveSyncBlackList(path)) {
+            continue;
+        }
+        localPaths.append(_discoveryData->_localDir + path);
+    }
+    _discoveryData->prefetchLocalDirectories(localPaths);
+    _prefetchedLocalPaths = localPaths;
+}
+
+void ProcessDirectoryJob::releaseUnusedLocalListings()
+{
+    QSet<QString> listedPaths;
+    for (const auto job : std::as_const(_queuedJobs)) {
+        if (job->_queryLocal == NormalQuery) {
+            listedPaths.insert(_discoveryData->_localDir + job->_currentFolder._local);
+        }
+    }
+    for (const auto &localPath : std::as_const(_prefetchedLocalPaths)) {
+        if (!listedPaths.contains(localPath)) {
+            _discoveryData->releaseLocalListing(localPath);
+        }
+    }
+    _prefetchedLocalPaths.clear();
 }
 
 
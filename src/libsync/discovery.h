@@ -207,6 +207,14 @@ private:
     void processBlacklisted(const PathTuple &, const LocalInfo &, const SyncJournalFileRecord &dbEntry);
     void subJobFinished();
 
+    /** Whether the finished subtree of this job can be propagated before the
+     * whole discovery is done, see SyncOptions::_streamingPropagation.
+     *
+     * This directory and all the ones above it must stay where they are, and
+     * no pending rename or deletion detection may involve the subtree.
+     */
+    [[nodiscard]] bool canPropagateSubtreeEarly() const;
+
     /** An DB operation failed */
     void dbError();
 
@@ -229,6 +237,16 @@ private:
       */
     void startAsyncLocalQuery();
 
+    /// Lets the local scan pool list the subdirectories in _localNormalQueryEntries ahead of time
+    void prefetchLocalSubdirectories();
+
+    /** Drops the prefetched listings of subdirectories that won't be listed
+     *
+     * Called once all entries are processed: subdirectories that were excluded,
+     * ignored, blacklisted or renamed away have no queued job to claim them.
+     */
+    void releaseUnusedLocalListings();
+
 
     /** Sets _pinState, the directory's pin state
      *
@@ -263,6 +281,9 @@ private:
     QVector<RemoteInfo> _serverNormalQueryEntries;
     QVector<LocalInfo> _localNormalQueryEntries;
 
+    // Absolute paths of the subdirectories prefetched by prefetchLocalSubdirectories()
+    QStringList _prefetchedLocalPaths;
+
     // Whether the local/remote directory item queries are done. Will be set
     // even even for do-nothing (!= NormalQuery) queries.
     bool _serverQueryDone = false;
@@ -12,21 +12,26 @@
 #include "helpers.h"
 #include "progressdispatcher.h"
 #include "account.h"
+#include "clientsideencryption.h"
 #include "clientsideencryptionjobs.h"
 #include "foldermetadata.h"
 
 #include "common/asserts.h"
 #include "common/checksums.h"
+#include "common/syncjournaldb.h"
 
 #include <csync_exclude.h>
 #include "vio/csync_vio_local.h"
 
+#include <QCryptographicHash>
+#include <QJsonObject>
 #include <QLoggingCategory>
 #include <QUrl>
 #include <QFile>
 #include <QDir>
 #include <QFileInfo>
 #include <QTextCodec>
+#include <QThread>
 #include <cstring>
 #include <QDateTime>
 
@@ -293,9 +298,171 @@ void DiscoveryPhase::startJob(ProcessDirectoryJob *job)
         }
     });
     _currentRootJob = job;
+    const auto localScanJobs = _syncOptions._parallelLocalScanJobs > 0 ? _syncOptions._parallelLocalScanJobs : QThread::idealThreadCount();
+    _localScanPool->setMaxThreadCount(qMax(1, localScanJobs));
+    if (_bulkRemoteDiscovery && !job->_dirItem) {
+        startBulkRemoteListing(job);
+        return;
+    }
     job->start();
 }
 
+bool DiscoveryPhase::listDbFilesInPath(const QByteArray &path, const std::function<void(const SyncJournalFileRecord &)> &rowCallback)
+{
+    if (_journalSnapshot.isLoaded()) {
+        _journalSnapshot.listFilesInPath(path, rowCallback);
+        return true;
+    }
+    return _statedb->listFilesInPath(path, rowCallback);
+}
+
+bool DiscoveryPhase::deleteDbRecordRecursively(const QString &path)
+{
+    if (_journalSnapshot.isLoaded()) {
+        _journalSnapshot.removeRecursively(path.toUtf8());
+    }
+    return _statedb->deleteFileRecord(path, true);
+}
+
+void DiscoveryPhase::listLocalDirectory(const QString &localPath, QObject *context, const std::function<void(const LocalDirectoryListing &)> &callback)
+{
+    auto request = _localListings.value(localPath);
+    if (request && !request->callback) {
+        --_prefetchedLocalListings;
+    } else {
+        // Nothing prefetched, or someone else is already waiting for that listing
+        request = std::make_shared<LocalListingRequest>();
+        if (!_localListings.contains(localPath)) {
+            _localListings.insert(localPath, request);
+        }
+        startLocalListing(localPath, request);
+    }
+    request->context = context;
+    request->callback = callback;
+    if (request->listing.status != LocalDirectoryListing::Status::Pending) {
+        QMetaObject::invokeMethod(this, [this, localPath, request] { deliverLocalListing(localPath, request); }, Qt::QueuedConnection);
+    }
+}
+
+void DiscoveryPhase::prefetchLocalDirectories(const QStringList &localPaths)
+{
+    for (const auto &localPath : localPaths) {
+        if (_prefetchedLocalListings >= maxPrefetchedLocalDirectories) {
+            return;
+        }
+        if (!_localListings.contains(localPath)) {
+            const auto request = std::make_shared<LocalListingRequest>();
+            _localListings.insert(localPath, request);
+            ++_prefetchedLocalListings;
+            startLocalListing(localPath, request);
+        }
+    }
+}
+
+void DiscoveryPhase::releaseLocalListing(const QString &localPath)
+{
+    const auto it = _localListings.constFind(localPath);
+    if (it == _localListings.constEnd() || (*it)->callback) {
+        return;
+    }
+    // A listing still running finishes on its own, its result is dropped
+    _localListings.erase(it);
+    --_prefetchedLocalListings;
+}
+
+void DiscoveryPhase::startLocalListing(const QString &localPath, const std::shared_ptr<LocalListingRequest> &request)
+{
+    auto localJob = new DiscoverySingleLocalDirectoryJob(_account, localPath, _syncOptions._vfs.data());
+
+    connect(localJob, &DiscoverySingleLocalDirectoryJob::itemDiscovered, this, [request](const SyncFileItemPtr &item) {
+        request->listing.discoveredItems.append(item);
+    });
+    connect(localJob, &DiscoverySingleLocalDirectoryJob::childIgnored, this, [request](bool b) {
+        request->listing.childIgnored = b;
+    });
+    connect(localJob, &DiscoverySingleLocalDirectoryJob::finished, this, [this, localPath, request](const QVector<LocalInfo> &entries) {
+        request->listing.entries = entries;
+        request->listing.status = LocalDirectoryListing::Status::Success;
+        deliverLocalListing(localPath, request);
+    });
+    connect(localJob, &DiscoverySingleLocalDirectoryJob::finishedFatalError, this, [this, localPath, request](const QString &errorString) {
+        request->listing.errorString = errorString;
+        request->listing.status = LocalDirectoryListing::Status::FatalError;
+        deliverLocalListing(localPath, request);
+    });
+    connect(localJob, &DiscoverySingleLocalDirectoryJob::finishedNonFatalError, this, [this, localPath, request](const QString &errorString) {
+        request->listing.errorString = errorString;
+        request->listing.status = LocalDirectoryListing::Status::NonFatalError;
+        deliverLocalListing(localPath, request);
+    });
+
+    _localScanPool->start(localJob); // QThreadPool takes ownership
+}
+
+void DiscoveryPhase::deliverLocalListing(const QString &localPath, const std::shared_ptr<LocalListingRequest> &request)
+{
+    if (!request->callback) {
+        // Prefetched, kept until a ProcessDirectoryJob asks for it
+        return;
+    }
+    if (_localListings.value(localPath) == request) {
+        _localListings.remove(localPath);
+    }
+    const auto callback = std::move(request->callback);
+    request->callback = nullptr;
+    if (request->context) {
+        callback(request->listing);
+    }
+}
+
+DiscoveryPhase::~DiscoveryPhase()
+{
+    // Don't start listings nobody is going to look at, and don't block on the
+    // running ones: the pool is deleted once they are done.
+    _localScanPool->clear();
+    QThreadPool::globalInstance()->start([pool = _localScanPool.release()] {
+        pool->waitForDone();
+        pool->deleteLater();
+    });
+    if (_bulkRemoteListingJob && _bulkRemoteListingJob->reply()) {
+        _bulkRemoteListingJob->reply()->abort();
+    }
+}
+
+void DiscoveryPhase::startBulkRemoteListing(ProcessDirectoryJob *job)
+{
+    auto listing = QSharedPointer<BulkRemoteListing>::create();
+    auto lsColJob = new LsColJob(_account, _remoteFolder);
+    lsColJob->setProperties(LsColJob::defaultProperties(LsColJob::FolderType::RootFolder, _account));
+    lsColJob->setDepth(QByteArrayLiteral("infinity"));
+
+    // The first entry is the sync root itself, everything else is grouped under its parent
+    connect(lsColJob, &LsColJob::directoryListingEntry, this, [listing, isRoot = true](const QString &href, const DavProperties &properties) mutable {
+        if (isRoot) {
+            isRoot = false;
+        } else {
+            const auto parentHref = href.left(href.lastIndexOf(QLatin1Char('/')));
+            listing->directories[parentHref].append({href, properties});
+        }
+        if (properties.value(DavProperties::ResourceType).contains("collection"_L1)) {
+            listing->directories[href].prepend({href, properties});
+        }
+    });
+    connect(lsColJob, &LsColJob::finishedWithoutError, this, [this, job, listing, lsColJob] {
+        listing->responseTimestamp = lsColJob->responseTimestamp();
+        qCInfo(lcDiscovery) << "Bulk remote listing of" << _remoteFolder << "returned" << listing->directories.size() << "directories";
+        _bulkRemoteListing = listing;
+        job->start();
+    });
+    connect(lsColJob, &LsColJob::finishedWithError, this, [this, job](QNetworkReply *reply) {
+        qCInfo(lcDiscovery) << "Bulk remote listing of" << _remoteFolder << "failed, falling back to listing each directory:"
+                            << reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() << reply->errorString();
+        job->start();
+    });
+    _bulkRemoteListingJob = lsColJob;
+    lsColJob->start();
+}
+
 void DiscoveryPhase::setSelectiveSyncBlackList(const QStringList &list)
 {
     _selectiveSyncBlackList = list;
@@ -313,6 +480,30 @@ bool DiscoveryPhase::isRenamed(const QString &p) const
     return _renamedItemsLocal.contains(p) || _renamedItemsRemote.contains(p);
 }
 
+bool DiscoveryPhase::hasPendingRenameOrDeletion(const QString &path) const
+{
+    const auto containsPathOrBelow = [&path](const auto &map) {
+        if (map.contains(path)) {
+            return true;
+        }
+        const QString prefix = path + QLatin1Char('/');
+        const auto it = map.lowerBound(prefix);
+        return it != map.cend() && it.key().startsWith(prefix);
+    };
+    if (containsPathOrBelow(_deletedItem) || containsPathOrBelow(_queuedDeletedDirectories)
+        || containsPathOrBelow(_renamedItemsRemote) || containsPathOrBelow(_renamedItemsLocal)) {
+        return true;
+    }
+
+    for (auto slashPos = path.lastIndexOf(QLatin1Char('/')); slashPos > 0; slashPos = path.lastIndexOf(QLatin1Char('/'), slashPos - 1)) {
+        const auto parentPath = path.left(slashPos);
+        if (_deletedItem.contains(parentPath) || _queuedDeletedDirectories.contains(parentPath) || isRenamed(parentPath)) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void DiscoveryPhase::scheduleMoreJobs()
 {
     auto limit = qMax(1, _syncOptions._parallelNetworkJobs);
@@ -356,6 +547,7 @@ void DiscoverySingleLocalDirectoryJob::run() {
         } else if (errno == ENOTDIR) {
             // Not a directory..
             // Just consider it is empty
+            emit finished({});
             return;
         }
         emit finishedFatalError(errorString);
@@ -417,6 +609,84 @@ void DiscoverySingleLocalDirectoryJob::run() {
     emit finished(results);
 }
 
+namespace {
+
+constexpr auto e2eFolderDiscoveryInfoIvSize = 16;
+
+// The journal lives in the sync folder, so the cache is encrypted with a key derived from the account's private key
+QByteArray e2eFolderDiscoveryInfoKey(const AccountPtr &account)
+{
+    const auto &privateKey = account->e2e()->getPrivateKey();
+    if (privateKey.isEmpty()) {
+        return {};
+    }
+    return QCryptographicHash::hash(privateKey + QByteArrayLiteral("e2ee-folder-discovery-info"), QCryptographicHash::Sha256).left(16);
+}
+
+}
+
+Optional<E2eFolderDiscoveryInfo> E2eFolderDiscoveryInfo::loadFromJournal(const AccountPtr &account, SyncJournalDb *journal, const QByteArray &folderId, const QByteArray &etag)
+{
+    if (!journal || folderId.isEmpty() || etag.isEmpty()) {
+        return {};
+    }
+    const auto key = e2eFolderDiscoveryInfoKey(account);
+    if (key.isEmpty()) {
+        return {};
+    }
+    const auto cached = journal->e2EeFolderMetadataCache(folderId, etag);
+    if (cached.size() <= e2eFolderDiscoveryInfoIvSize) {
+        return {};
+    }
+
+    const auto json = QJsonDocument::fromJson(EncryptionHelper::decryptThenUnGzipData(key, cached.mid(e2eFolderDiscoveryInfoIvSize), cached.left(e2eFolderDiscoveryInfoIvSize))).object();
+    // What the discovery derives from the metadata depends on the server's encryption version
+    if (json.isEmpty() || json.value("capability"_L1).toDouble() != account->capabilities().clientSideEncryptionVersion()) {
+        return {};
+    }
+
+    E2eFolderDiscoveryInfo info;
+    info.encryptionStatus = static_cast<SyncFileItem::EncryptionStatus>(json.value("encryptionStatus"_L1).toInt());
+    if (info.encryptionStatus == SyncFileItem::EncryptionStatus::NotEncrypted || info.encryptionStatus == SyncFileItem::EncryptionStatus::Encrypted) {
+        return {};
+    }
+    const auto files = json.value("files"_L1).toObject();
+    for (auto it = files.constBegin(); it != files.constEnd(); ++it) {
+        info.originalFilenames.insert(it.key(), it.value().toString());
+    }
+    return info;
+}
+
+void E2eFolderDiscoveryInfo::saveToJournal(const AccountPtr &account, SyncJournalDb *journal, const QByteArray &folderId, const QByteArray &etag) const
+{
+    if (!journal || folderId.isEmpty() || etag.isEmpty()) {
+        return;
+    }
+    const auto key = e2eFolderDiscoveryInfoKey(account);
+    if (key.isEmpty()) {
+        return;
+    }
+
+    QJsonObject files;
+    for (auto it = originalFilenames.constBegin(); it != originalFilenames.constEnd(); ++it) {
+        files.insert(it.key(), it.value());
+    }
+    const QJsonObject json{
+        {"capability"_L1, account->capabilities().clientSideEncryptionVersion()},
+        {"encryptionStatus"_L1, static_cast<int>(encryptionStatus)},
+        {"files"_L1, files},
+    };
+
+    const auto iv = EncryptionHelper::generateRandom(e2eFolderDiscoveryInfoIvSize);
+    QByteArray tag;
+    const auto encrypted = EncryptionHelper::gzipThenEncryptData(key, QJsonDocument(json).toJson(QJsonDocument::Compact), iv, tag);
+    if (encrypted.isEmpty()) {
+        journal->deleteE2EeFolderMetadataCache(folderId);
+        return;
+    }
+    journal->setE2EeFolderMetadataCache(folderId, etag, iv + encrypted);
+}
+
 DiscoverySingleDirectoryJob::DiscoverySingleDirectoryJob(const AccountPtr &account,
                                                          const QString &path,
                                                          const QString &remoteRootFolderPath,
@@ -435,6 +705,10 @@ DiscoverySingleDirectoryJob::DiscoverySingleDirectoryJob(const AccountPtr &accou
 
 void DiscoverySingleDirectoryJob::start()
 {
+    if (_bulkRemoteListing && startFromBulkRemoteListing()) {
+        return;
+    }
+
     // Start the actual HTTP job
     auto *lsColJob = new LsColJob(_account, _subPath);
 
@@ -442,7 +716,7 @@ void DiscoverySingleDirectoryJob::start()
                                                    _account);
     lsColJob->setProperties(props);
 
-    QObject::connect(lsColJob, &LsColJob::directoryListingIterated,
+    QObject::connect(lsColJob, &LsColJob::directoryListingEntry,
         this, &DiscoverySingleDirectoryJob::directoryListingIteratedSlot);
     QObject::connect(lsColJob, &LsColJob::finishedWithError, this, &DiscoverySingleDirectoryJob::lsJobFinishedWithErrorSlot);
     QObject::connect(lsColJob, &LsColJob::finishedWithoutError, this, &DiscoverySingleDirectoryJob::lsJobFinishedWithoutErrorSlot);
@@ -451,6 +725,30 @@ void DiscoverySingleDirectoryJob::start()
     _lsColJob = lsColJob;
 }
 
+bool DiscoverySingleDirectoryJob::startFromBulkRemoteListing()
+{
+    auto listingPath = Utility::concatUrlPath(_account->davUrl(), _subPath).path();
+    if (listingPath.endsWith(QLatin1Char('/'))) {
+        listingPath.chop(1);
+    }
+
+    // Every directory is listed exactly once per sync, so the entries can be handed over
+    const auto entries = _bulkRemoteListing->directories.take(listingPath);
+    if (entries.isEmpty() || entries.first().href != listingPath) {
+        return false;
+    }
+
+    _responseTimestamp = _bulkRemoteListing->responseTimestamp;
+    // Deliver the results asynchronously, just like a PROPFIND would
+    QMetaObject::invokeMethod(this, [this, entries] {
+        for (const auto &entry : entries) {
+            directoryListingIteratedSlot(entry.href, entry.properties);
+        }
+        lsJobFinishedWithoutErrorSlot();
+    }, Qt::QueuedConnection);
+    return true;
+}
+
 void DiscoverySingleDirectoryJob::abort()
 {
     if (_lsColJob && _lsColJob->reply()) {
@@ -478,47 +776,52 @@ SyncFileItem::EncryptionStatus DiscoverySingleDirectoryJob::requiredEncryptionSt
     return _encryptionStatusRequired;
 }
 
-void DiscoverySingleDirectoryJob::directoryListingIteratedSlot(const QString &file, const QMap<QString, QString> &map)
+void DiscoverySingleDirectoryJob::directoryListingIteratedSlot(const QString &file, const DavProperties &properties)
 {
+    const auto mountedPermissionAlgorithm = _account->serverHasMountRootProperty() ? RemotePermissions::MountedPermissionAlgorithm::UseMountRootProperty
+                                                                                   : RemotePermissions::MountedPermissionAlgorithm::WildGuessMountedSubProperty;
+
     if (!_ignoredFirst) {
         // The first entry is for the folder itself, we should process it differently.
         _ignoredFirst = true;
-        if (map.contains("permissions")) {
-            const auto perm = RemotePermissions::fromServerString(map.value("permissions"),
-                                                            _account->serverHasMountRootProperty() ? RemotePermissions::MountedPermissionAlgorithm::UseMountRootProperty : RemotePermissions::MountedPermissionAlgorithm::WildGuessMountedSubProperty,
-                                                            map);
+        if (properties.contains(DavProperties::Permissions)) {
+            const auto isMountRoot = properties.contains(DavProperties::IsMountRoot) && properties.value(DavProperties::IsMountRoot) != "false"_L1;
+            const auto perm = RemotePermissions::fromServerString(properties.value(DavProperties::Permissions),
+                                                                  mountedPermissionAlgorithm,
+                                                                  properties.value(DavProperties::ShareAttributes),
+                                                                  isMountRoot);
             emit firstDirectoryPermissions(perm);
             _isExternalStorage = perm.hasPermission(RemotePermissions::IsMounted);
         }
-        if (map.contains("data-fingerprint"_L1)) {
-            _dataFingerprint = map.value("data-fingerprint"_L1).toUtf8();
+        if (properties.contains(DavProperties::DataFingerprint)) {
+            _dataFingerprint = properties.value(DavProperties::DataFingerprint).toUtf8();
             if (_dataFingerprint.isEmpty()) {
                 // Placeholder that means that the server supports the feature even if it did not set one.
                 _dataFingerprint = "[empty]";
             }
         }
-        if (map.contains("fileid"_L1)) {
-            _localFileId = map.value("fileid"_L1).toUtf8();
+        if (properties.contains(DavProperties::FileId)) {
+            _localFileId = properties.value(DavProperties::FileId).toUtf8();
         }
-        if (map.contains("id"_L1)) {
-            _fileId = map.value("id"_L1).toUtf8();
+        if (properties.contains(DavProperties::Id)) {
+            _fileId = properties.value(DavProperties::Id).toUtf8();
         }
-        if (map.contains("is-encrypted"_L1) && map.value("is-encrypted"_L1) == "1"_L1) {
+        if (properties.value(DavProperties::IsEncrypted) == "1"_L1) {
             _encryptionStatusCurrent = SyncFileItem::EncryptionStatus::EncryptedMigratedV2_0;
             Q_ASSERT(!_fileId.isEmpty());
         }
-        if (map.contains("size"_L1)) {
-            _size = map.value("size"_L1).toInt();
+        if (properties.contains(DavProperties::Size)) {
+            _size = properties.value(DavProperties::Size).toInt();
         }
 
         // all folders will contain both
-        if (map.contains(FolderQuota::usedBytesC) && map.contains(FolderQuota::availableBytesC)) {          
+        if (properties.contains(DavProperties::QuotaUsedBytes) && properties.contains(DavProperties::QuotaAvailableBytes)) {
             // The server can respond with e.g. "2.58440798353E+12" for the quota
             // therefore: parse the string as a double and cast it to i64
             auto ok = false;
-            auto quotaValue = static_cast<int64_t>(map.value(FolderQuota::usedBytesC).toDouble(&ok));
+            auto quotaValue = static_cast<int64_t>(properties.value(DavProperties::QuotaUsedBytes).toDouble(&ok));
             _folderQuota.bytesUsed = ok ? quotaValue : -1;
-            quotaValue = static_cast<int64_t>(map.value(FolderQuota::availableBytesC).toDouble(&ok));
+            quotaValue = static_cast<int64_t>(properties.value(DavProperties::QuotaAvailableBytes).toDouble(&ok));
             _folderQuota.bytesAvailable = ok ? quotaValue : -1;
 
             qCDebug(lcDiscovery) << "Setting quota for" << file
@@ -532,9 +835,7 @@ void DiscoverySingleDirectoryJob::directoryListingIteratedSlot(const QString &fi
         int slash = file.lastIndexOf(u'/');
         result.name = file.mid(slash + 1);
         result.size = -1;
-        LsColJob::propertyMapToRemoteInfo(map,
-                                          _account->serverHasMountRootProperty() ? RemotePermissions::MountedPermissionAlgorithm::UseMountRootProperty : RemotePermissions::MountedPermissionAlgorithm::WildGuessMountedSubProperty,
-                                          result);
+        LsColJob::propertiesToRemoteInfo(properties, mountedPermissionAlgorithm, result);
         if (result.isDirectory)
             result.size = 0;
 
@@ -542,15 +843,19 @@ void DiscoverySingleDirectoryJob::directoryListingIteratedSlot(const QString &fi
     }
 
     //This works in concerto with the RequestEtagJob and the Folder object to check if the remote folder changed.
-    if (map.contains("getetag"_L1)) {
+    if (properties.contains(DavProperties::GetEtag)) {
         if (_firstEtag.isEmpty()) {
-            _firstEtag = parseEtag(map.value("getetag"_L1).toUtf8()); // for directory itself
+            _firstEtag = parseEtag(properties.value(DavProperties::GetEtag).toUtf8()); // for directory itself
         }
     }
 }
 
 void DiscoverySingleDirectoryJob::lsJobFinishedWithoutErrorSlot()
 {
+    if (_lsColJob) {
+        _responseTimestamp = _lsColJob->responseTimestamp();
+    }
+
     if (!_ignoredFirst) {
         // This is a sanity check, if we haven't _ignoredFirst then it means we never received any directoryListingIteratedSlot
         // which means somehow the server XML was bogus
@@ -562,11 +867,11 @@ void DiscoverySingleDirectoryJob::lsJobFinishedWithoutErrorSlot()
         deleteLater();
         return;
     } else if (isE2eEncrypted() && _account->capabilities().clientSideEncryptionAvailable()) {
-        emit etag(_firstEtag, QDateTime::fromString(QString::fromUtf8(_lsColJob->responseTimestamp()), Qt::RFC2822Date));
+        emit etag(_firstEtag, QDateTime::fromString(QString::fromUtf8(_responseTimestamp), Qt::RFC2822Date));
         fetchE2eMetadata();
         return;
     }
-    emit etag(_firstEtag, QDateTime::fromString(QString::fromUtf8(_lsColJob->responseTimestamp()), Qt::RFC2822Date));
+    emit etag(_firstEtag, QDateTime::fromString(QString::fromUtf8(_responseTimestamp), Qt::RFC2822Date));
     emit finished(_results);
     deleteLater();
 }
@@ -598,6 +903,12 @@ void DiscoverySingleDirectoryJob::lsJobFinishedWithErrorSlot(QNetworkReply *repl
 
 void DiscoverySingleDirectoryJob::fetchE2eMetadata()
 {
+    if (const auto cachedInfo = E2eFolderDiscoveryInfo::loadFromJournal(_account, _journal, _fileId, _firstEtag)) {
+        qCDebug(lcDiscovery) << "Using the cached metadata of" << _subPath << "for etag" << _firstEtag;
+        applyE2eFolderDiscoveryInfo(*cachedInfo);
+        return;
+    }
+
     const auto job = new GetMetadataApiJob(_account, _localFileId);
     connect(job, &GetMetadataApiJob::jsonReceived,
             this, &DiscoverySingleDirectoryJob::metadataReceived);
@@ -658,41 +969,54 @@ void DiscoverySingleDirectoryJob::metadataReceived(const QJsonDocument &json, in
         }
         _isFileDropDetected = e2EeFolderMetadata->isFileDropPresent();
         _encryptedMetadataNeedUpdate = e2EeFolderMetadata->encryptedMetadataNeedUpdate();
-        _encryptionStatusRequired = EncryptionStatusEnums::fromEndToEndEncryptionApiVersion(_account->capabilities().clientSideEncryptionVersion());
-        _encryptionStatusCurrent = e2EeFolderMetadata->existingMetadataEncryptionStatus();
-
-        Q_ASSERT(_encryptionStatusCurrent != SyncFileItem::EncryptionStatus::Encrypted);
-        Q_ASSERT(_encryptionStatusCurrent != SyncFileItem::EncryptionStatus::NotEncrypted);
 
+        E2eFolderDiscoveryInfo info;
+        info.encryptionStatus = e2EeFolderMetadata->existingMetadataEncryptionStatus();
         const auto encryptedFiles = e2EeFolderMetadata->files();
-
-        const auto findEncryptedFile = [=](const QString &name) {
-            const auto it = std::find_if(std::cbegin(encryptedFiles), std::cend(encryptedFiles), [=](const FolderMetadata::EncryptedFile &file) {
-                return file.encryptedFilename == name;
-            });
-            if (it == std::cend(encryptedFiles)) {
-                return Optional<FolderMetadata::EncryptedFile>();
-            } else {
-                return Optional<FolderMetadata::EncryptedFile>(*it);
+        for (const auto &file : encryptedFiles) {
+            // keep the first entry if a name is listed more than once
+            if (!info.originalFilenames.contains(file.encryptedFilename)) {
+                info.originalFilenames.insert(file.encryptedFilename, file.originalFilename);
             }
-        };
-
-        std::transform(std::cbegin(_results), std::cend(_results), std::begin(_results), [=, this](const RemoteInfo &info) {
-            auto result = info;
-            const auto encryptedFileInfo = findEncryptedFile(result.name);
-            if (encryptedFileInfo) {
-                result._isE2eEncrypted = true;
-                result.e2eMangledName = _subPath.mid(1) + u'/' + result.name;
-                result.name = encryptedFileInfo->originalFilename;
+        }
+
+        // Dropped files and outdated metadata make the propagation rewrite the metadata,
+        // so their folders must always be seen as the server has them
+        if (_isFileDropDetected || _encryptedMetadataNeedUpdate) {
+            if (_journal) {
+                _journal->deleteE2EeFolderMetadataCache(_fileId);
             }
-            return result;
-        });
+        } else {
+            info.saveToJournal(_account, _journal, _fileId, _firstEtag);
+        }
 
-        emit finished(_results);
-        deleteLater();
+        applyE2eFolderDiscoveryInfo(info);
     });
 }
 
+void DiscoverySingleDirectoryJob::applyE2eFolderDiscoveryInfo(const E2eFolderDiscoveryInfo &info)
+{
+    _encryptionStatusRequired = EncryptionStatusEnums::fromEndToEndEncryptionApiVersion(_account->capabilities().clientSideEncryptionVersion());
+    _encryptionStatusCurrent = info.encryptionStatus;
+
+    Q_ASSERT(_encryptionStatusCurrent != SyncFileItem::EncryptionStatus::Encrypted);
+    Q_ASSERT(_encryptionStatusCurrent != SyncFileItem::EncryptionStatus::NotEncrypted);
+
+    std::transform(std::cbegin(_results), std::cend(_results), std::begin(_results), [&info, this](const RemoteInfo &remoteInfo) {
+        auto result = remoteInfo;
+        const auto originalFilename = info.originalFilenames.constFind(result.name);
+        if (originalFilename != info.originalFilenames.cend()) {
+            result._isE2eEncrypted = true;
+            result.e2eMangledName = _subPath.mid(1) + u'/' + result.name;
+            result.name = *originalFilename;
+        }
+        return result;
+    });
+
+    emit finished(_results);
+    deleteLater();
+}
+
 void DiscoverySingleDirectoryJob::metadataError(const QByteArray &fileId, int httpReturnCode)
 {
     qCWarning(lcDiscovery) << "E2EE Metadata job error. Trying to proceed without it." << fileId << httpReturnCode;
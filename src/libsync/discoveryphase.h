@@ -12,6 +12,7 @@
 
 #include "common/folderquota.h"
 #include "common/remoteinfo.h"
+#include "common/syncjournalsnapshot.h"
 
 #include <QObject>
 #include <QElapsedTimer>
@@ -22,7 +23,10 @@
 #include <QMutex>
 #include <QWaitCondition>
 #include <QRunnable>
+#include <QThreadPool>
 #include <deque>
+#include <functional>
+#include <memory>
 
 class ExcludedFiles;
 
@@ -94,14 +98,80 @@ private:
 public:
 };
 
+/**
+ * @brief The outcome of a DiscoverySingleLocalDirectoryJob
+ *
+ * Everything the job reported, so a listing made ahead of time can be handed
+ * to the ProcessDirectoryJob that asks for it later.
+ *
+ * @ingroup libsync
+ */
+struct LocalDirectoryListing
+{
+    enum class Status {
+        Pending,
+        Success,
+        FatalError,
+        NonFatalError,
+    };
+
+    Status status = Status::Pending;
+    QVector<LocalInfo> entries;
+    QString errorString;
+    bool childIgnored = false;
+    // Items for entries that can't be synced, e.g. with an invalid file name encoding
+    QVector<SyncFileItemPtr> discoveredItems;
+};
+
 class FolderMetadata;
 
+/**
+ * @brief Remote directory listings obtained from a single Depth: infinity PROPFIND
+ *
+ * Directories are keyed by their dav path without trailing slash. Every listing
+ * starts with the entry for the directory itself followed by its direct children,
+ * the same order a Depth: 1 PROPFIND would deliver them in.
+ *
+ * @ingroup libsync
+ */
+struct BulkRemoteListing
+{
+    struct Entry
+    {
+        QString href;
+        DavProperties properties;
+    };
+
+    QHash<QString, QVector<Entry>> directories;
+    QByteArray responseTimestamp;
+};
+
+/**
+ * @brief What the discovery needs from the decrypted metadata of an end-to-end encrypted folder
+ *
+ * It is kept encrypted in the journal, keyed by the folder's file id and etag, so that
+ * listing an unchanged encrypted folder again does not need to fetch and decrypt its
+ * metadata. It never contains keys or the users the folder is shared with.
+ *
+ * @ingroup libsync
+ */
+struct OWNCLOUDSYNC_EXPORT E2eFolderDiscoveryInfo
+{
+    SyncFileItem::EncryptionStatus encryptionStatus = SyncFileItem::EncryptionStatus::NotEncrypted;
+    // encrypted file name -> original file name
+    QHash<QString, QString> originalFilenames;
+
+    /// The info cached for this etag of the folder, none if it changed or the account can't decrypt it
+    [[nodiscard]] static Optional<E2eFolderDiscoveryInfo> loadFromJournal(const AccountPtr &account, SyncJournalDb *journal, const QByteArray &folderId, const QByteArray &etag);
+    void saveToJournal(const AccountPtr &account, SyncJournalDb *journal, const QByteArray &folderId, const QByteArray &etag) const;
+};
+
 /**
  * @brief Run a PROPFIND on a directory and process the results for Discovery
  *
  * @ingroup libsync
  */
-class DiscoverySingleDirectoryJob : public QObject
+class OWNCLOUDSYNC_EXPORT DiscoverySingleDirectoryJob : public QObject
 {
     Q_OBJECT
 public:
@@ -116,6 +186,10 @@ public:
                                          QObject *parent = nullptr);
     // Specify that this is the root and we need to check the data-fingerprint
     void setIsRootPath() { _isRootPath = true; }
+    // Use the prefetched listing for this directory instead of a PROPFIND, if it has one
+    void setBulkRemoteListing(const QSharedPointer<BulkRemoteListing> &listing) { _bulkRemoteListing = listing; }
+    // Cache the decrypted metadata of encrypted folders in this journal, see E2eFolderDiscoveryInfo
+    void setJournal(SyncJournalDb *journal) { _journal = journal; }
     void start();
     void abort();
     [[nodiscard]] bool isFileDropDetected() const;
@@ -131,7 +205,7 @@ signals:
     void setfolderQuota(const FolderQuota &folderQuota);
 
 private slots:
-    void directoryListingIteratedSlot(const QString &, const QMap<QString, QString> &);
+    void directoryListingIteratedSlot(const QString &, const OCC::DavProperties &);
     void lsJobFinishedWithoutErrorSlot();
     void lsJobFinishedWithErrorSlot(QNetworkReply *reply);
     void fetchE2eMetadata();
@@ -139,6 +213,8 @@ private slots:
     void metadataError(const QByteArray& fileId, int httpReturnCode);
 
 private:
+    [[nodiscard]] bool startFromBulkRemoteListing();
+    void applyE2eFolderDiscoveryInfo(const E2eFolderDiscoveryInfo &info);
 
     [[nodiscard]] bool isE2eEncrypted() const { return _encryptionStatusCurrent != SyncFileItem::EncryptionStatus::NotEncrypted; }
 
@@ -166,6 +242,9 @@ private:
     int64_t _size = 0;
     QString _error;
     QPointer<LsColJob> _lsColJob;
+    QByteArray _responseTimestamp;
+    QSharedPointer<BulkRemoteListing> _bulkRemoteListing;
+    SyncJournalDb *_journal = nullptr;
 
     // store top level E2EE folder paths as they are used later when discovering nested folders
     QSet<QString> _topLevelE2eeFolderPaths;
@@ -226,8 +305,54 @@ class DiscoveryPhase : public QObject
      */
     [[nodiscard]] bool isRenamed(const QString &p) const;
 
+    /** Returns whether a rename or deletion was found at, above or below the db-path.
+     *
+     * The items of such a subtree may still change with findAndCancelDeletedJob()
+     * or be moved by a rename, so they must not be propagated before the
+     * discovery has finished.
+     */
+    [[nodiscard]] bool hasPendingRenameOrDeletion(const QString &path) const;
+
     int _currentlyActiveJobs = 0;
 
+    struct LocalListingRequest
+    {
+        LocalDirectoryListing listing;
+        QPointer<QObject> context;
+        std::function<void(const LocalDirectoryListing &)> callback;
+    };
+
+    // Listings of local directories that are running or done, keyed by absolute path
+    QHash<QString, std::shared_ptr<LocalListingRequest>> _localListings;
+    // How many of _localListings were prefetched and not asked for yet
+    int _prefetchedLocalListings = 0;
+    std::unique_ptr<QThreadPool> _localScanPool = std::make_unique<QThreadPool>();
+
+    /** Lists a local directory on _localScanPool.
+     *
+     * A listing started by prefetchLocalDirectories() is reused. The callback
+     * is always invoked from the event loop, unless context was destroyed.
+     */
+    void listLocalDirectory(const QString &localPath, QObject *context, const std::function<void(const LocalDirectoryListing &)> &callback);
+
+    /** Starts listing local directories before their ProcessDirectoryJob runs.
+     *
+     * Called with the subdirectories of every listed directory, so the local
+     * scan stays one level ahead of the merge with remote and db entries.
+     * Limited to maxPrefetchedLocalDirectories listings not yet asked for.
+     */
+    void prefetchLocalDirectories(const QStringList &localPaths);
+
+    /** Drops a prefetched listing that no ProcessDirectoryJob is going to ask for.
+     *
+     * Does nothing if the listing was already asked for.
+     */
+    void releaseLocalListing(const QString &localPath);
+    void startLocalListing(const QString &localPath, const std::shared_ptr<LocalListingRequest> &request);
+    void deliverLocalListing(const QString &localPath, const std::shared_ptr<LocalListingRequest> &request);
+
+    static constexpr auto maxPrefetchedLocalDirectories = 1024;
+
     // both must contain a sorted list
     QStringList _selectiveSyncBlackList;
     QStringList _selectiveSyncWhiteList;
@@ -279,7 +404,19 @@ class DiscoveryPhase : public QObject
 
     void markPermanentDeletionRequests();
 
+    /** Fetches the whole remote tree with one Depth: infinity PROPFIND, then starts the job.
+     *
+     * The job is started in any case; if the server refuses the request or the
+     * reply can't be used, discovery falls back to one PROPFIND per directory.
+     */
+    void startBulkRemoteListing(ProcessDirectoryJob *job);
+
+    QSharedPointer<BulkRemoteListing> _bulkRemoteListing;
+    QPointer<LsColJob> _bulkRemoteListingJob;
+
 public:
+    ~DiscoveryPhase() override;
+
     // input
     QString _localDir; // absolute path to the local directory. ends with '/'
     QString _remoteFolder; // remote folder, ends with '/'
@@ -293,9 +430,18 @@ public:
     bool _shouldEnforceWindowsFileNameCompatibility = false;
     bool _ignoreHiddenFiles = false;
     std::function<bool(const QString &)> _shouldDiscoverLocaly;
+    // Discover the remote tree with a single Depth: infinity PROPFIND (initial syncs only)
+    bool _bulkRemoteDiscovery = false;
+    // Used instead of querying _statedb per directory when loaded
+    SyncJournalSnapshot _journalSnapshot;
 
     void startJob(ProcessDirectoryJob *);
 
+    /// Lists the db records in path, from _journalSnapshot if it is loaded
+    [[nodiscard]] bool listDbFilesInPath(const QByteArray &path, const std::function<void(const SyncJournalFileRecord &)> &rowCallback);
+    /// Deletes the db records of path and everything below it
+    [[nodiscard]] bool deleteDbRecordRecursively(const QString &path);
+
     void setSelectiveSyncBlackList(const QStringList &list);
     void setSelectiveSyncWhiteList(const QStringList &list);
 
@@ -322,6 +468,13 @@ public:
 signals:
     void fatalError(const QString &errorString, const OCC::ErrorCategory errorCategory);
     void itemDiscovered(const OCC::SyncFileItemPtr &item);
+
+    /** The directory and everything below it was discovered and can be
+     * propagated right away, see SyncOptions::_streamingPropagation.
+     *
+     * Emitted right after itemDiscovered() for the directory item.
+     */
+    void subtreeDiscovered(const OCC::SyncFileItemPtr &dirItem);
     void finished();
 
     // A new folder was discovered and was not synced because of the confirmation feature
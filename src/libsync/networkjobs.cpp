@@ -16,6 +16,7 @@
 #include "configfile.h"
 
 #include <QJsonDocument>
+#include <QMetaMethod>
 #include <QLoggingCategory>
 #include <QNetworkRequest>
 #include <QNetworkAccessManager>
@@ -177,136 +178,233 @@ bool MkColJob::finished()
 }
 
 /*********************************************************************************************/
-// supposed to read <D:collection> when pointing to <D:resourcetype><D:collection></D:resourcetype>..
-static QString readContentsAsString(QXmlStreamReader &reader)
+
+LsColXMLParser::LsColXMLParser() = default;
+
+bool LsColXMLParser::parse(const QByteArray &xml, QHash<QString, ExtraFolderInfo> *fileInfo, const QString &expectedPath)
+{
+    beginParse(expectedPath, fileInfo);
+    if (!addData(xml)) {
+        return false;
+    }
+    return endParse();
+}
+
+void LsColXMLParser::beginParse(const QString &expectedPath, QHash<QString, ExtraFolderInfo> *sizes)
+{
+    _reader.clear();
+    _reader.addExtraNamespaceDeclaration(QXmlStreamNamespaceDeclaration("d", "DAV:"));
+    _expectedPath = expectedPath;
+    _folderInfos = sizes;
+
+    _folders.clear();
+    _currentHref.clear();
+    _currentTmpProperties.clear();
+    _currentHttp200Properties.clear();
+    _currentPropsHaveHttp200 = false;
+    _insidePropstat = false;
+    _insideProp = false;
+    _insideMultiStatus = false;
+    _failed = false;
+    _capture = TextCapture::None;
+    _captureText.clear();
+    _propertyName.clear();
+    _propertyKey = DavProperties::KeyCount;
+    _propertyLevel = 0;
+}
+
+bool LsColXMLParser::addData(const QByteArray &data)
+{
+    if (_failed) {
+        return false;
+    }
+    _reader.addData(data);
+    return parseAvailableTokens();
+}
+
+bool LsColXMLParser::endParse()
 {
-    QString result;
-    int level = 0;
-    do {
-        QXmlStreamReader::TokenType type = reader.readNext();
+    if (_failed) {
+        return false;
+    }
+
+    if (_reader.hasError()) {
+        // XML Parser error? Whatever had been emitted before will come as directoryListingIterated
+        qCWarning(lcLsColJob) << "ERROR" << _reader.errorString() << "at line" << _reader.lineNumber() << "column" << _reader.columnNumber();
+        return false;
+    } else if (!_insideMultiStatus) {
+        qCWarning(lcLsColJob) << "ERROR no WebDAV response?";
+        return false;
+    }
+
+    emit directoryListingSubfolders(_folders);
+    emit finishedWithoutError();
+    return true;
+}
+
+bool LsColXMLParser::parseAvailableTokens()
+{
+    while (!_reader.atEnd()) {
+        const auto type = _reader.readNext();
         if (type == QXmlStreamReader::StartElement) {
-            level++;
-            result += "<" + reader.name().toString() + ">";
+            if (!handleStartElement()) {
+                _failed = true;
+                return false;
+            }
         } else if (type == QXmlStreamReader::Characters) {
-            result += reader.text();
+            if (_capture != TextCapture::None) {
+                _captureText += _reader.text();
+            }
         } else if (type == QXmlStreamReader::EndElement) {
-            level--;
-            if (level < 0) {
-                break;
+            if (!handleEndElement()) {
+                _failed = true;
+                return false;
             }
-            result += "</" + reader.name().toString() + ">";
         }
+    }
 
-    } while (!reader.atEnd());
-    return result;
+    if (_reader.hasError() && _reader.error() != QXmlStreamReader::PrematureEndOfDocumentError) {
+        // More data can't fix this one
+        qCWarning(lcLsColJob) << "ERROR" << _reader.errorString() << "at line" << _reader.lineNumber() << "column" << _reader.columnNumber();
+        _failed = true;
+        return false;
+    }
+    return true;
 }
 
+bool LsColXMLParser::handleStartElement()
+{
+    const auto name = _reader.name();
 
-LsColXMLParser::LsColXMLParser() = default;
+    // Nested elements of a property are kept as text, e.g. <d:collection> in <d:resourcetype>
+    if (_capture == TextCapture::Property) {
+        ++_propertyLevel;
+        _captureText += u'<';
+        _captureText += name;
+        _captureText += u'>';
+        return true;
+    }
+    if (_capture != TextCapture::None) {
+        return true;
+    }
 
-bool LsColXMLParser::parse(const QByteArray &xml, QHash<QString, ExtraFolderInfo> *fileInfo, const QString &expectedPath)
+    if (_insidePropstat && _insideProp) {
+        // All those elements are properties
+        _capture = TextCapture::Property;
+        // Known properties are only looked up, others need their name kept
+        _propertyKey = DavProperties::keyForName(name);
+        if (_propertyKey == DavProperties::KeyCount) {
+            _propertyName = name.toString();
+        }
+        _propertyLevel = 0;
+        _captureText.clear();
+        return true;
+    }
+
+    // Start elements with DAV:
+    if (_reader.namespaceUri() == "DAV:"_L1) {
+        if (name == "href"_L1) {
+            _capture = TextCapture::Href;
+            _captureText.clear();
+        } else if (name == "propstat"_L1) {
+            _insidePropstat = true;
+        } else if (name == "status"_L1 && _insidePropstat) {
+            _capture = TextCapture::Status;
+            _captureText.clear();
+        } else if (name == "prop"_L1) {
+            _insideProp = true;
+        } else if (name == "multistatus"_L1) {
+            _insideMultiStatus = true;
+        }
+    }
+    return true;
+}
+
+bool LsColXMLParser::handleEndElement()
 {
-    // Parse DAV response
-    QXmlStreamReader reader(xml);
-    reader.addExtraNamespaceDeclaration(QXmlStreamNamespaceDeclaration("d", "DAV:"));
-
-    QStringList folders;
-    QString currentHref;
-    QMap<QString, QString> currentTmpProperties;
-    QMap<QString, QString> currentHttp200Properties;
-    bool currentPropsHaveHttp200 = false;
-    bool insidePropstat = false;
-    bool insideProp = false;
-    bool insideMultiStatus = false;
-
-    while (!reader.atEnd()) {
-        QXmlStreamReader::TokenType type = reader.readNext();
-        QString name = reader.name().toString();
-        // Start elements with DAV:
-        if (type == QXmlStreamReader::StartElement && reader.namespaceUri() == QLatin1String("DAV:")) {
-            if (name == QLatin1String("href")) {
-                // We don't use URL encoding in our request URL (which is the expected path) (QNAM will do it for us)
-                // but the result will have URL encoding..
-                QString hrefString = QUrl::fromLocalFile(QUrl::fromPercentEncoding(reader.readElementText().toUtf8()))
-                        .adjusted(QUrl::NormalizePathSegments)
-                        .path();
-                if (!hrefString.startsWith(expectedPath)) {
-                    qCWarning(lcLsColJob) << "Invalid href" << hrefString << "expected starting with" << expectedPath;
-                    return false;
-                }
-                currentHref = hrefString;
-            } else if (name == QLatin1String("response")) {
-            } else if (name == QLatin1String("propstat")) {
-                insidePropstat = true;
-            } else if (name == QLatin1String("status") && insidePropstat) {
-                QString httpStatus = reader.readElementText();
-                if (httpStatus.startsWith("HTTP/1.1 200")) {
-                    currentPropsHaveHttp200 = true;
-                } else {
-                    currentPropsHaveHttp200 = false;
-                }
-            } else if (name == QLatin1String("prop")) {
-                insideProp = true;
-                continue;
-            } else if (name == QLatin1String("multistatus")) {
-                insideMultiStatus = true;
-                continue;
-            }
+    switch (_capture) {
+    case TextCapture::Property:
+        if (_propertyLevel > 0) {
+            --_propertyLevel;
+            _captureText += "</"_L1;
+            _captureText += _reader.name();
+            _captureText += u'>';
+        } else {
+            finishProperty();
+        }
+        return true;
+    case TextCapture::Href: {
+        _capture = TextCapture::None;
+        // We don't use URL encoding in our request URL (which is the expected path) (QNAM will do it for us)
+        // but the result will have URL encoding..
+        const auto hrefString = QUrl::fromLocalFile(QUrl::fromPercentEncoding(_captureText.toUtf8()))
+                                    .adjusted(QUrl::NormalizePathSegments)
+                                    .path();
+        if (!hrefString.startsWith(_expectedPath)) {
+            qCWarning(lcLsColJob) << "Invalid href" << hrefString << "expected starting with" << _expectedPath;
+            return false;
         }
+        _currentHref = hrefString;
+        return true;
+    }
+    case TextCapture::Status:
+        _capture = TextCapture::None;
+        _currentPropsHaveHttp200 = _captureText.startsWith("HTTP/1.1 200"_L1);
+        return true;
+    case TextCapture::None:
+        break;
+    }
 
-        if (type == QXmlStreamReader::StartElement && insidePropstat && insideProp) {
-            // All those elements are properties
-            QString propertyContent = readContentsAsString(reader);
-            if (name == QLatin1String("resourcetype") && propertyContent.contains("collection")) {
-                folders.append(currentHref);
-            } else if (name == QLatin1String("size")) {
-                bool ok = false;
-                auto s = propertyContent.toLongLong(&ok);
-                if (ok && fileInfo) {
-                    (*fileInfo)[currentHref].size = s;
-                }
-            } else if (name == QLatin1String("fileid")) {
-                (*fileInfo)[currentHref].fileId = propertyContent.toUtf8();
+    // End elements with DAV:
+    if (_reader.namespaceUri() == "DAV:"_L1) {
+        const auto name = _reader.name();
+        if (name == "response"_L1) {
+            if (_currentHref.endsWith('/')) {
+                _currentHref.chop(1);
+            }
+            emit directoryListingEntry(_currentHref, _currentHttp200Properties);
+            if (isSignalConnected(QMetaMethod::fromSignal(&LsColXMLParser::directoryListingIterated))) {
+                emit directoryListingIterated(_currentHref, _currentHttp200Properties.toMap());
+            }
+            _currentHref.clear();
+            _currentHttp200Properties.clear();
+        } else if (name == "propstat"_L1) {
+            _insidePropstat = false;
+            if (_currentPropsHaveHttp200) {
+                // Swap instead of copying so both buffers get reused for the next entries
+                std::swap(_currentHttp200Properties, _currentTmpProperties);
             }
-            currentTmpProperties.insert(reader.name().toString(), propertyContent);
+            _currentTmpProperties.clear();
+            _currentPropsHaveHttp200 = false;
+        } else if (name == "prop"_L1) {
+            _insideProp = false;
         }
+    }
+    return true;
+}
 
-        // End elements with DAV:
-        if (type == QXmlStreamReader::EndElement) {
-            if (reader.namespaceUri() == QLatin1String("DAV:")) {
-                if (reader.name() == QStringLiteral("response")) {
-                    if (currentHref.endsWith('/')) {
-                        currentHref.chop(1);
-                    }
-                    emit directoryListingIterated(currentHref, currentHttp200Properties);
-                    currentHref.clear();
-                    currentHttp200Properties.clear();
-                } else if (reader.name() == QStringLiteral("propstat")) {
-                    insidePropstat = false;
-                    if (currentPropsHaveHttp200) {
-                        currentHttp200Properties = QMap<QString, QString>(currentTmpProperties);
-                    }
-                    currentTmpProperties.clear();
-                    currentPropsHaveHttp200 = false;
-                } else if (reader.name() == QStringLiteral("prop")) {
-                    insideProp = false;
-                }
-            }
+void LsColXMLParser::finishProperty()
+{
+    _capture = TextCapture::None;
+    const auto &propertyContent = _captureText;
+
+    if (_propertyKey == DavProperties::ResourceType && propertyContent.contains("collection"_L1)) {
+        _folders.append(_currentHref);
+    } else if (_propertyKey == DavProperties::Size) {
+        bool ok = false;
+        auto s = propertyContent.toLongLong(&ok);
+        if (ok && _folderInfos) {
+            (*_folderInfos)[_currentHref].size = s;
         }
+    } else if (_propertyKey == DavProperties::FileId && _folderInfos) {
+        (*_folderInfos)[_currentHref].fileId = propertyContent.toUtf8();
     }
 
-    if (reader.hasError()) {
-        // XML Parser error? Whatever had been emitted before will come as directoryListingIterated
-        qCWarning(lcLsColJob) << "ERROR" << reader.errorString() << xml;
-        return false;
-    } else if (!insideMultiStatus) {
-        qCWarning(lcLsColJob) << "ERROR no WebDAV response?" << xml;
-        return false;
+    if (_propertyKey != DavProperties::KeyCount) {
+        _currentTmpProperties.insert(_propertyKey, propertyContent);
     } else {
-        emit directoryListingSubfolders(folders);
-        emit finishedWithoutError();
+        _currentTmpProperties.insert(_propertyName, propertyContent);
     }
-    return true;
 }
 
 /*********************************************************************************************/
@@ -378,117 +476,133 @@ QList<QByteArray> LsColJob::defaultProperties(FolderType isRootPath, AccountPtr
 
 void LsColJob::propertyMapToRemoteInfo(const QMap<QString, QString> &map, RemotePermissions::MountedPermissionAlgorithm algorithm, RemoteInfo &result)
 {
-    for (auto it = map.constBegin(); it != map.constEnd(); ++it) {
-        QString property = it.key();
-        QString value = it.value();
-        if (property == "resourcetype"_L1) {
-            result.isDirectory = value.contains("collection"_L1);
-        } else if (property == "getlastmodified"_L1) {
-            value.replace("GMT", "+0000");
-            const auto date = QDateTime::fromString(value, Qt::RFC2822Date);
-            Q_ASSERT(date.isValid());
-            result.modtime = 0;
-            if (date.toSecsSinceEpoch() > 0) {
-                result.modtime = date.toSecsSinceEpoch();
-            }
-        } else if (property == "getcontentlength"_L1) {
-            // See #4573, sometimes negative size values are returned
-            bool ok = false;
-            qlonglong ll = value.toLongLong(&ok);
-            if (ok && ll >= 0) {
-                result.size = ll;
-            } else {
-                result.size = 0;
-            }
-        } else if (property == "getetag"_L1) {
-            result.etag = Utility::normalizeEtag(value.toUtf8());
-        } else if (property == "id"_L1) {
-            result.fileId = value.toUtf8();
-        } else if (property == "downloadURL"_L1) {
-            result.directDownloadUrl = value;
-        } else if (property == "dDC"_L1) {
-            result.directDownloadCookies = value;
-        } else if (property == "permissions"_L1) {
-            result.remotePerm = RemotePermissions::fromServerString(value, algorithm, map);
-        } else if (property == "checksums"_L1) {
-            result.checksumHeader = findBestChecksum(value.toUtf8());
-        } else if (property == "share-types"_L1 && !value.isEmpty()) {
-            // Since QMap is sorted, "share-types" is always after "permissions".
-            if (result.remotePerm.isNull()) {
-                qWarning() << "Server returned a share type, but no permissions?";
-            } else {
-                // S means shared with me.
-                // But for our purpose, we want to know if the file is shared. It does not matter
-                // if we are the owner or not.
-                // Piggy back on the permission field
-                result.remotePerm.setPermission(RemotePermissions::IsShared);
-                result.sharedByMe = true;
-            }
-        } else if (property == "is-encrypted"_L1 && value == "1"_L1) {
-            result._isE2eEncrypted = true;
-        } else if (property == "lock"_L1) {
-            result.locked = (value == "1"_L1 ? SyncFileItem::LockStatus::LockedItem : SyncFileItem::LockStatus::UnlockedItem);
-        }
-        if (property == "lock-owner-displayname"_L1) {
-            result.lockOwnerDisplayName = value;
-        }
-        if (property == "lock-owner"_L1) {
-            result.lockOwnerId = value;
-        }
-        if (property == "lock-owner-type"_L1) {
-            auto ok = false;
-            const auto intConvertedValue = value.toULongLong(&ok);
-            if (ok) {
-                result.lockOwnerType = static_cast<SyncFileItem::LockOwnerType>(intConvertedValue);
-            } else {
-                result.lockOwnerType = SyncFileItem::LockOwnerType::UserLock;
-            }
-        }
-        if (property == "lock-owner-editor"_L1) {
-            result.lockEditorApp = value;
-        }
-        if (property == "lock-time"_L1) {
-            auto ok = false;
-            const auto intConvertedValue = value.toULongLong(&ok);
-            if (ok) {
-                result.lockTime = intConvertedValue;
-            } else {
-                result.lockTime = 0;
-            }
-        }
-        if (property == "lock-timeout"_L1) {
-            auto ok = false;
-            const auto intConvertedValue = value.toULongLong(&ok);
-            if (ok) {
-                result.lockTimeout = intConvertedValue;
-            } else {
-                result.lockTimeout = 0;
-            }
+    propertiesToRemoteInfo(DavProperties::fromMap(map), algorithm, result);
+}
+
+void LsColJob::propertiesToRemoteInfo(const DavProperties &properties, RemotePermissions::MountedPermissionAlgorithm algorithm, RemoteInfo &result)
+{
+    const auto toULongLong = [&properties](DavProperties::Key key, qulonglong fallback) {
+        auto ok = false;
+        const auto value = properties.value(key).toULongLong(&ok);
+        return ok ? value : fallback;
+    };
+
+    if (properties.contains(DavProperties::ResourceType)) {
+        result.isDirectory = properties.value(DavProperties::ResourceType).contains("collection"_L1);
+    }
+    if (properties.contains(DavProperties::GetLastModified)) {
+        auto value = properties.value(DavProperties::GetLastModified).toString();
+        value.replace("GMT", "+0000");
+        const auto date = QDateTime::fromString(value, Qt::RFC2822Date);
+        Q_ASSERT(date.isValid());
+        result.modtime = 0;
+        if (date.toSecsSinceEpoch() > 0) {
+            result.modtime = date.toSecsSinceEpoch();
         }
-        if (property == "lock-token"_L1) {
-            result.lockToken = value;
+    }
+    if (properties.contains(DavProperties::GetContentLength)) {
+        // See #4573, sometimes negative size values are returned
+        bool ok = false;
+        qlonglong ll = properties.value(DavProperties::GetContentLength).toLongLong(&ok);
+        if (ok && ll >= 0) {
+            result.size = ll;
+        } else {
+            result.size = 0;
         }
-        if (property == "metadata-files-live-photo"_L1) {
-            result.livePhotoFile = value;
-            result.isLivePhoto = true;
+    }
+    if (properties.contains(DavProperties::GetEtag)) {
+        result.etag = Utility::normalizeEtag(properties.value(DavProperties::GetEtag).toUtf8());
+    }
+    if (properties.contains(DavProperties::Id)) {
+        result.fileId = properties.value(DavProperties::Id).toUtf8();
+    }
+    if (properties.contains(DavProperties::DownloadUrl)) {
+        result.directDownloadUrl = properties.value(DavProperties::DownloadUrl).toString();
+    }
+    if (properties.contains(DavProperties::DirectDownloadCookies)) {
+        result.directDownloadCookies = properties.value(DavProperties::DirectDownloadCookies).toString();
+    }
+    if (properties.contains(DavProperties::Permissions)) {
+        const auto isMountRoot = properties.contains(DavProperties::IsMountRoot) && properties.value(DavProperties::IsMountRoot) != "false"_L1;
+        result.remotePerm = RemotePermissions::fromServerString(properties.value(DavProperties::Permissions),
+                                                                algorithm,
+                                                                properties.value(DavProperties::ShareAttributes),
+                                                                isMountRoot);
+    }
+    if (properties.contains(DavProperties::Checksums)) {
+        result.checksumHeader = findBestChecksum(properties.value(DavProperties::Checksums).toUtf8());
+    }
+    if (!properties.value(DavProperties::ShareTypes).isEmpty()) {
+        // The permissions have been handled above, the share type piggy backs on them
+        if (result.remotePerm.isNull()) {
+            qWarning() << "Server returned a share type, but no permissions?";
+        } else {
+            // S means shared with me.
+            // But for our purpose, we want to know if the file is shared. It does not matter
+            // if we are the owner or not.
+            // Piggy back on the permission field
+            result.remotePerm.setPermission(RemotePermissions::IsShared);
+            result.sharedByMe = true;
         }
     }
+    if (properties.value(DavProperties::IsEncrypted) == "1"_L1) {
+        result._isE2eEncrypted = true;
+    }
+    if (properties.contains(DavProperties::Lock)) {
+        result.locked = (properties.value(DavProperties::Lock) == "1"_L1 ? SyncFileItem::LockStatus::LockedItem : SyncFileItem::LockStatus::UnlockedItem);
+    }
+    if (properties.contains(DavProperties::LockOwnerDisplayName)) {
+        result.lockOwnerDisplayName = properties.value(DavProperties::LockOwnerDisplayName).toString();
+    }
+    if (properties.contains(DavProperties::LockOwner)) {
+        result.lockOwnerId = properties.value(DavProperties::LockOwner).toString();
+    }
+    if (properties.contains(DavProperties::LockOwnerType)) {
+        const auto userLock = static_cast<qulonglong>(SyncFileItem::LockOwnerType::UserLock);
+        result.lockOwnerType = static_cast<SyncFileItem::LockOwnerType>(toULongLong(DavProperties::LockOwnerType, userLock));
+    }
+    if (properties.contains(DavProperties::LockOwnerEditor)) {
+        result.lockEditorApp = properties.value(DavProperties::LockOwnerEditor).toString();
+    }
+    if (properties.contains(DavProperties::LockTime)) {
+        result.lockTime = toULongLong(DavProperties::LockTime, 0);
+    }
+    if (properties.contains(DavProperties::LockTimeout)) {
+        result.lockTimeout = toULongLong(DavProperties::LockTimeout, 0);
+    }
+    if (properties.contains(DavProperties::LockToken)) {
+        result.lockToken = properties.value(DavProperties::LockToken).toString();
+    }
+    if (properties.contains(DavProperties::MetadataFilesLivePhoto)) {
+        result.livePhotoFile = properties.value(DavProperties::MetadataFilesLivePhoto).toString();
+        result.isLivePhoto = true;
+    }
 
-    if (result.isDirectory && map.contains("size"_L1)) {
-        result.sizeOfFolder = map.value("size"_L1).toInt();
+    if (result.isDirectory && properties.contains(DavProperties::Size)) {
+        result.sizeOfFolder = properties.value(DavProperties::Size).toInt();
     }
 
-    if (result.isDirectory && map.contains(FolderQuota::usedBytesC) && map.contains(FolderQuota::availableBytesC)) {
+    if (result.isDirectory && properties.contains(DavProperties::QuotaUsedBytes) && properties.contains(DavProperties::QuotaAvailableBytes)) {
         // The server can respond with e.g. "2.58440798353E+12" for the quota
         // therefore: parse the string as a double and cast it to i64
         auto ok = false;
-        auto quotaValue = static_cast<int64_t>(map.value(FolderQuota::usedBytesC).toDouble(&ok));
+        auto quotaValue = static_cast<int64_t>(properties.value(DavProperties::QuotaUsedBytes).toDouble(&ok));
         result.folderQuota.bytesUsed = ok ? quotaValue : -1;
-        quotaValue = static_cast<int64_t>(map.value(FolderQuota::availableBytesC).toDouble(&ok));
+        quotaValue = static_cast<int64_t>(properties.value(DavProperties::QuotaAvailableBytes).toDouble(&ok));
         result.folderQuota.bytesAvailable = ok ? quotaValue : -1;
     }
 }
 
+void LsColJob::setDepth(const QByteArray &depth)
+{
+    _depth = depth;
+}
+
+QByteArray LsColJob::depth() const
+{
+    return _depth;
+}
+
 void LsColJob::start()
 {
     QList<QByteArray> properties = _properties;
@@ -512,7 +626,7 @@ void LsColJob::start()
     }
 
     QNetworkRequest req;
-    req.setRawHeader("Depth", "1");
+    req.setRawHeader("Depth", _depth);
     QByteArray xml("<?xml version=\"1.0\" ?>\n"
                    "<d:propfind xmlns:d=\"DAV:\" xmlns:oc=\"http://owncloud.org/ns\">\n"
                    "  <d:prop>\n"
@@ -529,31 +643,73 @@ void LsColJob::start()
     AbstractNetworkJob::start();
 }
 
-// TODO: Instead of doing all in this slot, we should iteratively parse in readyRead(). This
-// would allow us to be more asynchronous in processing while data is coming from the network,
-// not all in one big blob at the end.
-bool LsColJob::finished()
+void LsColJob::newReplyHook(QNetworkReply *reply)
 {
-    qCInfo(lcLsColJob) << "LSCOL of" << reply()->request().url() << "FINISHED WITH STATUS"
-                       << replyStatusString();
+    // A redirected or retried request starts over with a fresh parser
+    _parser.reset();
+    _parseError = false;
+    connect(reply, &QIODevice::readyRead, this, &LsColJob::slotReadyRead);
+}
 
+bool LsColJob::isMultiStatusReply() const
+{
     const auto contentType = reply()->header(QNetworkRequest::ContentTypeHeader).toString();
     const auto httpCode = reply()->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
     const auto validContentType = contentType.contains("application/xml; charset=utf-8") ||
                                   contentType.contains("application/xml; charset=\"utf-8\"") ||
                                   contentType.contains("text/xml; charset=utf-8") ||
                                   contentType.contains("text/xml; charset=\"utf-8\"");
+    return httpCode == 207 && validContentType;
+}
 
-    if (httpCode == 207 && validContentType) {
-        LsColXMLParser parser;
-        connect(&parser, &LsColXMLParser::directoryListingSubfolders,
-            this, &LsColJob::directoryListingSubfolders);
-        connect(&parser, &LsColXMLParser::directoryListingIterated,
+void LsColJob::setupParser()
+{
+    _parser = std::make_unique<LsColXMLParser>();
+    connect(_parser.get(), &LsColXMLParser::directoryListingSubfolders,
+        this, &LsColJob::directoryListingSubfolders);
+    connect(_parser.get(), &LsColXMLParser::directoryListingEntry,
+        this, &LsColJob::directoryListingEntry);
+    // Only have the parser build property maps if anybody still wants them
+    if (isSignalConnected(QMetaMethod::fromSignal(&LsColJob::directoryListingIterated))) {
+        connect(_parser.get(), &LsColXMLParser::directoryListingIterated,
             this, &LsColJob::directoryListingIterated);
-        connect(&parser, &LsColXMLParser::finishedWithError,
-            this, &LsColJob::finishedWithError);
-        connect(&parser, &LsColXMLParser::finishedWithoutError,
-            this, &LsColJob::finishedWithoutError);
+    }
+    connect(_parser.get(), &LsColXMLParser::finishedWithError,
+        this, &LsColJob::finishedWithError);
+    connect(_parser.get(), &LsColXMLParser::finishedWithoutError,
+        this, &LsColJob::finishedWithoutError);
+
+    const auto expectedPath = reply()->request().url().path(); // something like "/owncloud/remote.php/dav/folder"
+    _parser->beginParse(expectedPath, &_folderInfos);
+}
+
+void LsColJob::slotReadyRead()
+{
+    // Parse the listing while it is being received instead of buffering the whole
+    // body, entries are handed out as soon as they are complete.
+    // Error replies are left untouched for finished().
+    if (!_parser) {
+        if (!isMultiStatusReply()) {
+            return;
+        }
+        setupParser();
+    }
+
+    const auto data = reply()->readAll();
+    if (!_parseError && !_parser->addData(data)) {
+        _parseError = true;
+    }
+}
+
+bool LsColJob::finished()
+{
+    qCInfo(lcLsColJob) << "LSCOL of" << reply()->request().url() << "FINISHED WITH STATUS"
+                       << replyStatusString();
+
+    if (isMultiStatusReply()) {
+        if (!_parser) {
+            setupParser();
+        }
 
         // bool LsColXMLParser::parse takes a while, let's process some events in attempt to make UI more responsive
         // from https://doc.qt.io/qt-5/qcoreapplication.html#processEvents-1 
@@ -562,8 +718,11 @@ bool LsColJob::finished()
         // one reason I had to remove ability for LsColJob to have parent, which, otherwise, leads to a crash later
         QCoreApplication::processEvents(QEventLoop::AllEvents, 100);
 
-        QString expectedPath = reply()->request().url().path(); // something like "/owncloud/remote.php/dav/folder"
-        if (!parser.parse(reply()->readAll(), &_folderInfos, expectedPath)) {
+        // Whatever is still buffered wasn't announced through readyRead yet
+        if (!_parseError && !_parser->addData(reply()->readAll())) {
+            _parseError = true;
+        }
+        if (_parseError || !_parser->endParse()) {
             // XML parse error
             emit finishedWithError(reply());
         }
@@ -10,6 +10,7 @@
 #include "config.h"
 
 #include "abstractnetworkjob.h"
+#include "davproperties.h"
 
 #include "common/remoteinfo.h"
 #include "common/remotepermissions.h"
@@ -17,6 +18,9 @@
 
 #include <QBuffer>
 #include <QUrlQuery>
+#include <QXmlStreamReader>
+
+#include <memory>
 
 class QUrl;
 class QJsonObject;
@@ -113,6 +117,11 @@ struct ExtraFolderInfo {
 /**
  * @brief The LsColJob class
  * @ingroup libsync
+ *
+ * The parser can either consume a complete reply with parse() or be fed
+ * incrementally with beginParse(), addData() and endParse() while the
+ * reply is still being received. directoryListingEntry is emitted as
+ * soon as an entry is complete.
  */
 class OWNCLOUDSYNC_EXPORT LsColXMLParser : public QObject
 {
@@ -124,11 +133,53 @@ public:
                QHash<QString, ExtraFolderInfo> *sizes,
                const QString &expectedPath);
 
+    void beginParse(const QString &expectedPath, QHash<QString, ExtraFolderInfo> *sizes);
+    /** Parses as much of the data as possible, returns false on a parse error */
+    bool addData(const QByteArray &data);
+    /** Called once all data was added, emits the final signals on success */
+    bool endParse();
+
 signals:
     void directoryListingSubfolders(const QStringList &items);
+    void directoryListingEntry(const QString &name, const OCC::DavProperties &properties);
+    /** Same as directoryListingEntry, only emitted when connected since building the map is costly */
     void directoryListingIterated(const QString &name, const QMap<QString, QString> &properties);
     void finishedWithError(QNetworkReply *reply);
     void finishedWithoutError();
+
+private:
+    enum class TextCapture {
+        None,
+        Href,
+        Status,
+        Property,
+    };
+
+    bool parseAvailableTokens();
+    bool handleStartElement();
+    bool handleEndElement();
+    void finishProperty();
+
+    QXmlStreamReader _reader;
+    QString _expectedPath;
+    QHash<QString, ExtraFolderInfo> *_folderInfos = nullptr;
+
+    QStringList _folders;
+    QString _currentHref;
+    DavProperties _currentTmpProperties;
+    DavProperties _currentHttp200Properties;
+    bool _currentPropsHaveHttp200 = false;
+    bool _insidePropstat = false;
+    bool _insideProp = false;
+    bool _insideMultiStatus = false;
+    bool _failed = false;
+
+    // Text of the element currently being read, elements may span several addData() calls
+    TextCapture _capture = TextCapture::None;
+    QString _captureText;
+    QString _propertyName;
+    DavProperties::Key _propertyKey = DavProperties::KeyCount;
+    int _propertyLevel = 0;
 };
 
 class OWNCLOUDSYNC_EXPORT LsColJob : public AbstractNetworkJob
@@ -157,21 +208,43 @@ public:
     void setProperties(QList<QByteArray> properties);
     [[nodiscard]] QList<QByteArray> properties() const;
 
+    /**
+     * The value of the Depth header, "1" by default.
+     *
+     * "infinity" lists the whole subtree in a single reply; servers are
+     * free to refuse that with 403 Forbidden.
+     */
+    void setDepth(const QByteArray &depth);
+    [[nodiscard]] QByteArray depth() const;
+
     static QList<QByteArray> defaultProperties(FolderType isRootPath, AccountPtr account);
     static void propertyMapToRemoteInfo(const QMap<QString, QString> &map, RemotePermissions::MountedPermissionAlgorithm algorithm, RemoteInfo &result);
+    static void propertiesToRemoteInfo(const DavProperties &properties, RemotePermissions::MountedPermissionAlgorithm algorithm, RemoteInfo &result);
 
 signals:
     void directoryListingSubfolders(const QStringList &items);
+    void directoryListingEntry(const QString &name, const OCC::DavProperties &properties);
+    /** Same as directoryListingEntry, prefer that one for large listings */
     void directoryListingIterated(const QString &name, const QMap<QString, QString> &properties);
     void finishedWithError(QNetworkReply *reply);
     void finishedWithoutError();
 
+protected:
+    void newReplyHook(QNetworkReply *reply) override;
+
 private slots:
     bool finished() override;
+    void slotReadyRead();
 
 private:
+    [[nodiscard]] bool isMultiStatusReply() const;
+    void setupParser();
+
     QList<QByteArray> _properties;
     QUrl _url; // Used instead of path() if the url is specified in the constructor
+    QByteArray _depth = QByteArrayLiteral("1");
+    std::unique_ptr<LsColXMLParser> _parser;
+    bool _parseError = false;
 };
 
 /**
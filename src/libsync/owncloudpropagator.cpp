@@ -78,10 +78,11 @@ OwncloudPropagator::~OwncloudPropagator() = default;
 
 int OwncloudPropagator::maximumActiveTransferJob()
 {
-    if (_downloadLimit != 0
-        || _uploadLimit != 0
+    if (_downloadLimit < 0
+        || _uploadLimit < 0
         || !_syncOptions._parallelNetworkJobs) {
-        // disable parallelism when there is a network limit.
+        // disable parallelism when there is a relative network limit, it is
+        // measured on one transfer at a time. Absolute limits are shared fairly.
         return 1;
     }
     return qMin(3, qCeil(_syncOptions._parallelNetworkJobs / 2.));
@@ -105,6 +106,19 @@ PropagateItemJob::~PropagateItemJob()
     }
 }
 
+bool PropagateItemJob::scheduleSelfOrChild()
+{
+    if (_state != NotYetStarted) {
+        return false;
+    }
+    qCInfo(lcPropagator) << "Starting" << _item->_instruction << "propagation of" << _item->destination() << "by" << this;
+
+    _state = Running;
+    propagator()->_lastStartedItemJob = this;
+    QMetaObject::invokeMethod(this, "start"); // We could be in a different thread (neon jobs)
+    return true;
+}
+
 static qint64 getMinBlacklistTime()
 {
     return qMax(qEnvironmentVariableIntValue("OWNCLOUD_BLACKLIST_TIME_MIN"),
@@ -504,6 +518,8 @@ void OwncloudPropagator::start(SyncFileItemVector &&items)
     Q_ASSERT(std::is_sorted(items.begin(), items.end()));
 
     _abortRequested = false;
+    // With streaming propagation the same propagator runs several batches
+    _finishedEmited = false;
 
     /* This builds all the jobs needed for the propagation.
      * Each directory is a PropagateDirectory job, which contains the files in it.
@@ -798,6 +814,15 @@ void OwncloudPropagator::setSyncOptions(const SyncOptions &syncOptions)
     _chunkSize = syncOptions._initialChunkSize;
 }
 
+void OwncloudPropagator::setParallelNetworkJobs(int jobs)
+{
+    _syncOptions._parallelNetworkJobs = jobs;
+    // Use the slots that became free right away
+    if (_rootJob) {
+        scheduleNextJob();
+    }
+}
+
 bool OwncloudPropagator::localFileNameClash(const QString &relFile)
 {
     const QString file(_localDir + relFile);
@@ -891,38 +916,68 @@ void OwncloudPropagator::scheduleNextJob()
 {
     if (_jobScheduled) return; // don't schedule more than 1
     _jobScheduled = true;
-    QTimer::singleShot(3, this, &OwncloudPropagator::scheduleNextJobImpl);
+    QMetaObject::invokeMethod(this, &OwncloudPropagator::scheduleNextJobImpl, Qt::QueuedConnection);
 }
 
-void OwncloudPropagator::scheduleNextJobImpl()
+bool OwncloudPropagator::canStartAnotherJob()
 {
     // TODO: If we see that the automatic up-scaling has a bad impact we
     // need to check how to avoid this.
     // Down-scaling on slow networks? https://github.com/owncloud/client/issues/3382
     // Making sure we do up/down at same time? https://github.com/owncloud/client/issues/1633
 
+    if (_activeJobList.count() < maximumActiveTransferJob()) {
+        return true;
+    }
+    if (_activeJobList.count() >= hardMaximumActiveJob()) {
+        return false;
+    }
+
+    int likelyFinishedQuicklyCount = 0;
+    // NOTE: Only counts the first 3 jobs! Then for each
+    // one that is likely finished quickly, we can launch another one.
+    // When a job finishes another one will "move up" to be one of the first 3 and then
+    // be counted too.
+    for (int i = 0; i < maximumActiveTransferJob() && i < _activeJobList.count(); i++) {
+        if (_activeJobList.at(i)->isLikelyFinishedQuickly()) {
+            likelyFinishedQuicklyCount++;
+        }
+    }
+    if (_activeJobList.count() < maximumActiveTransferJob() + likelyFinishedQuicklyCount) {
+        qCDebug(lcPropagator) << "Can pump in another request! activeJobs =" << _activeJobList.count();
+        return true;
+    }
+    return false;
+}
+
+void OwncloudPropagator::scheduleNextJobImpl()
+{
+    // Jobs that finish synchronously (local operations, ignored items) don't
+    // go through the event loop, don't let a large tree of them block it.
+    static constexpr int maximumJobsStartedPerPass = 100;
+
     _jobScheduled = false;
 
-    if (_activeJobList.count() < maximumActiveTransferJob()) {
-        if (_rootJob->scheduleSelfOrChild()) {
+    // Fill every free slot in one pass rather than starting one job per pass.
+    for (int started = 0; canStartAnotherJob(); ++started) {
+        if (started == maximumJobsStartedPerPass) {
             scheduleNextJob();
+            return;
         }
-    } else if (_activeJobList.count() < hardMaximumActiveJob()) {
-        int likelyFinishedQuicklyCount = 0;
-        // NOTE: Only counts the first 3 jobs! Then for each
-        // one that is likely finished quickly, we can launch another one.
-        // When a job finishes another one will "move up" to be one of the first 3 and then
-        // be counted too.
-        for (int i = 0; i < maximumActiveTransferJob() && i < _activeJobList.count(); i++) {
-            if (_activeJobList.at(i)->isLikelyFinishedQuickly()) {
-                likelyFinishedQuicklyCount++;
-            }
+
+        _lastStartedItemJob.clear();
+        if (!_rootJob->scheduleSelfOrChild()) {
+            return;
         }
-        if (_activeJobList.count() < maximumActiveTransferJob() + likelyFinishedQuicklyCount) {
-            qCDebug(lcPropagator) << "Can pump in another request! activeJobs =" << _activeJobList.count();
-            if (_rootJob->scheduleSelfOrChild()) {
-                scheduleNextJob();
-            }
+
+        // A job that is still preparing (for example computing checksums) is
+        // not in _activeJobList yet, so the free slots can't be trusted until
+        // it is. Check again a bit later instead of starting more in a burst.
+        if (_lastStartedItemJob && _lastStartedItemJob->_state == PropagatorJob::Running
+            && !_activeJobList.contains(_lastStartedItemJob.data())) {
+            _jobScheduled = true;
+            QTimer::singleShot(3, this, &OwncloudPropagator::scheduleNextJobImpl);
+            return;
         }
     }
 }
@@ -205,17 +205,7 @@ public:
     }
     ~PropagateItemJob() override;
 
-    bool scheduleSelfOrChild() override
-    {
-        if (_state != NotYetStarted) {
-            return false;
-        }
-        qCInfo(lcPropagator) << "Starting" << _item->_instruction << "propagation of" << _item->destination() << "by" << this;
-
-        _state = Running;
-        QMetaObject::invokeMethod(this, "start"); // We could be in a different thread (neon jobs)
-        return true;
-    }
+    bool scheduleSelfOrChild() override;
 
     [[nodiscard]] JobParallelism parallelism() const override { return _parallelism; }
 
@@ -462,6 +452,8 @@ public:
 
     [[nodiscard]] const SyncOptions &syncOptions() const;
     void setSyncOptions(const SyncOptions &syncOptions);
+    /// Changes how many network jobs may run in parallel, also while propagating
+    void setParallelNetworkJobs(int jobs);
 
     int _downloadLimit = 0;
     int _uploadLimit = 0;
@@ -477,6 +469,14 @@ public:
      */
     QList<PropagateItemJob *> _activeJobList;
 
+    /** The item job that was started last by scheduleSelfOrChild().
+     *
+     * Lets scheduleNextJobImpl() see whether the job it just started is
+     * still preparing (for example computing checksums) before it uses
+     * the network and shows up in _activeJobList.
+     */
+    QPointer<PropagateItemJob> _lastStartedItemJob;
+
     /** We detected that another sync is required after this one */
     bool _anotherSyncNeeded = false;
 
@@ -682,6 +682,9 @@ signals:
     void insufficientRemoteStorage();
 
 private:
+    /** Whether the active jobs leave room to start one more */
+    [[nodiscard]] bool canStartAnotherJob();
+
     std::unique_ptr<PropagateUploadFileCommon> createUploadJob(SyncFileItemPtr item,
                                                                bool deleteExisting);
 
@@ -24,13 +24,31 @@
 #include <QNetworkAccessManager>
 #include <QFileInfo>
 #include <QDir>
+#include <QSet>
 
+#include <algorithm>
 #include <cmath>
 
 namespace OCC {
 
 static constexpr auto CustomDecompressedSafetyCheckThreshold = 20 * 1024 * 1024;
 
+// The read buffer of a GET reply while the bandwidth manager limits downloads:
+// kept low so that the limit can be enforced on what the job reads.
+static constexpr qint64 LimitedReadBufferSize = 16 * 1024;
+// Without a limit, the network thread of the QNAM may receive this much ahead
+// of the job, so that a busy main thread doesn't stall the download.
+static constexpr qint64 ReadAheadBufferSize = 4 * 1024 * 1024;
+// What all replies together may receive ahead, parallel and segmented downloads share it
+static constexpr qint64 TotalReadAheadBufferSize = 16 * 1024 * 1024;
+
+// The jobs with a reply that reads ahead, all of them live on the propagator's thread
+static QSet<GETFileJob *> &readingAheadJobs()
+{
+    static QSet<GETFileJob *> jobs;
+    return jobs;
+}
+
 Q_LOGGING_CATEGORY(lcGetJob, "nextcloud.sync.networkjob.get", QtInfoMsg)
 Q_LOGGING_CATEGORY(lcPropagateDownload, "nextcloud.sync.propagator.download", QtInfoMsg)
 
@@ -104,8 +122,8 @@ GETFileJob::GETFileJob(AccountPtr account, const QUrl &url, QIODevice *device,
 
 void GETFileJob::start()
 {
-    if (_resumeStart > 0) {
-        _headers["Range"] = "bytes=" + QByteArray::number(_resumeStart) + '-';
+    if (_resumeStart > 0 || _rangeEnd >= 0) {
+        _headers["Range"] = "bytes=" + QByteArray::number(_resumeStart) + '-' + (_rangeEnd >= 0 ? QByteArray::number(_rangeEnd - 1) : QByteArray());
         _headers["Accept-Ranges"] = "bytes";
         qCDebug(lcGetJob) << "Retry with range " << _headers["Range"];
     }
@@ -137,7 +155,11 @@ void GETFileJob::start()
 
 void GETFileJob::newReplyHook(QNetworkReply *reply)
 {
-    reply->setReadBufferSize(16 * 1024); // keep low so we can easier limit the bandwidth
+    if (!readingAheadJobs().contains(this)) {
+        readingAheadJobs().insert(this);
+        updateReadBufferSizes();
+    }
+    reply->setReadBufferSize(replyReadBufferSize());
 
     connect(reply, &QNetworkReply::metaDataChanged, this, &GETFileJob::slotMetaDataChanged);
     connect(reply, &QIODevice::readyRead, this, &GETFileJob::slotReadyRead);
@@ -149,7 +171,7 @@ void GETFileJob::slotMetaDataChanged()
 {
     // For some reason setting the read buffer in GETFileJob::start doesn't seem to go
     // through the HTTP layer thread(?)
-    reply()->setReadBufferSize(16 * 1024);
+    reply()->setReadBufferSize(replyReadBufferSize());
 
     int httpStatus = reply()->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
 
@@ -197,6 +219,16 @@ void GETFileJob::slotMetaDataChanged()
         return;
     }
 
+    if (_rangeEnd >= 0 && httpStatus != 206) {
+        // The body is the whole file, which must not be written at the offset of the range
+        qCWarning(lcGetJob) << "Server ignored the range request" << _headers["Range"];
+        _errorString = tr("The server does not support downloading parts of a file");
+        _errorStatus = SyncFileItem::SoftError;
+        _rangeIgnored = true;
+        reply()->abort();
+        return;
+    }
+
     bool ok = false;
     _contentLength = reply()->header(QNetworkRequest::ContentLengthHeader).toLongLong(&ok);
     if (ok && _expectedContentLength != -1 && _contentLength != _expectedContentLength) {
@@ -259,6 +291,10 @@ void GETFileJob::setChoked(bool c)
 void GETFileJob::setBandwidthLimited(bool b)
 {
     _bandwidthLimited = b;
+    // An unlimited read buffer is kept for error bodies, see slotMetaDataChanged()
+    if (reply() && reply()->readBufferSize() > 0) {
+        reply()->setReadBufferSize(replyReadBufferSize());
+    }
     QMetaObject::invokeMethod(this, "slotReadyRead", Qt::QueuedConnection);
 }
 
@@ -269,6 +305,32 @@ void GETFileJob::giveBandwidthQuota(qint64 q)
     QMetaObject::invokeMethod(this, "slotReadyRead", Qt::QueuedConnection);
 }
 
+qint64 GETFileJob::replyReadBufferSize() const
+{
+    if (_bandwidthLimited) {
+        return LimitedReadBufferSize;
+    }
+    const auto jobs = qMax(qsizetype(1), readingAheadJobs().size());
+    return qBound(LimitedReadBufferSize, TotalReadAheadBufferSize / jobs, ReadAheadBufferSize);
+}
+
+void GETFileJob::updateReadBufferSizes()
+{
+    for (const auto job : std::as_const(readingAheadJobs())) {
+        // An unlimited read buffer is kept for error bodies, see slotMetaDataChanged()
+        if (job->reply() && job->reply()->readBufferSize() > 0) {
+            job->reply()->setReadBufferSize(job->replyReadBufferSize());
+        }
+    }
+}
+
+void GETFileJob::stopReadingAhead()
+{
+    if (readingAheadJobs().remove(this)) {
+        updateReadBufferSizes();
+    }
+}
+
 qint64 GETFileJob::currentDownloadPosition()
 {
     if (_device && _device->pos() > 0 && _device->pos() > qint64(_resumeStart)) {
@@ -286,7 +348,8 @@ void GETFileJob::slotReadyRead()
 {
     if (!reply())
         return;
-    int bufferSize = qMin(1024 * 8ll, reply()->bytesAvailable());
+    // Small reads keep the bandwidth quota accurate, otherwise drain what was read ahead in larger pieces
+    int bufferSize = qMin(_bandwidthLimited ? 8 * 1024ll : 64 * 1024ll, reply()->bytesAvailable());
     QByteArray buffer(bufferSize, Qt::Uninitialized);
 
     while (reply()->bytesAvailable() > 0 && _saveBodyToFile) {
@@ -646,6 +709,7 @@ void PropagateDownloadFile::startDownload()
 
     QString tmpFileName;
     QByteArray expectedEtagForResume;
+    QVector<SyncJournalDb::DownloadSegment> segments;
     const SyncJournalDb::DownloadInfo progressInfo = propagator()->_journal->getDownloadInfo(_item->_file);
     if (progressInfo._valid) {
         // if the etag has changed meanwhile, remove the already downloaded part.
@@ -655,15 +719,24 @@ void PropagateDownloadFile::startDownload()
         } else {
             tmpFileName = progressInfo._tmpfile;
             expectedEtagForResume = progressInfo._etag;
+            segments = progressInfo._segments;
         }
     }
 
     if (tmpFileName.isEmpty()) {
         tmpFileName = createDownloadTmpFileName(_item->_file);
+        segments = downloadSegments();
     }
     _tmpFile.setFileName(propagator()->fullLocalPath(tmpFileName));
     makeParentFolderModifiable(_tmpFile.fileName());
 
+    if (!segments.isEmpty()) {
+        // A segmented temporary file has its full size from the start, it
+        // must not be resumed as if it was downloaded in one piece.
+        startSegmentedDownload(tmpFileName, segments);
+        return;
+    }
+
     _resumeStart = _tmpFile.size();
     if (_resumeStart > 0 && _resumeStart == _item->_size) {
         qCInfo(lcPropagateDownload) << "File is already complete, no need to download";
@@ -686,20 +759,7 @@ void PropagateDownloadFile::startDownload()
     FileSystem::setFileHidden(_tmpFile.fileName(), true);
 
     // If there's not enough space to fully download this file, stop.
-    const auto diskSpaceResult = propagator()->diskSpaceCheck();
-    if (diskSpaceResult != OwncloudPropagator::DiskSpaceOk) {
-        if (diskSpaceResult == OwncloudPropagator::DiskSpaceFailure) {
-            // Using DetailError here will make the error not pop up in the account
-            // tab: instead we'll generate a general "disk space low" message and show
-            // these detail errors only in the error view.
-            done(SyncFileItem::DetailError,
-                tr("The download would reduce free local disk space below the limit"), ErrorCategory::GenericError);
-            emit propagator()->insufficientLocalStorage();
-        } else if (diskSpaceResult == OwncloudPropagator::DiskSpaceCritical) {
-            done(SyncFileItem::FatalError,
-                tr("Free space on disk is less than %1").arg(Utility::octetsToString(criticalFreeSpaceLimit())), ErrorCategory::GenericError);
-        }
-
+    if (!checkDiskSpace()) {
         // Remove the temporary, if empty.
         if (_resumeStart == 0) {
             _tmpFile.remove();
@@ -744,6 +804,166 @@ void PropagateDownloadFile::startDownload()
     _job->start();
 }
 
+bool PropagateDownloadFile::checkDiskSpace()
+{
+    const auto diskSpaceResult = propagator()->diskSpaceCheck();
+    if (diskSpaceResult == OwncloudPropagator::DiskSpaceFailure) {
+        // Using DetailError here will make the error not pop up in the account
+        // tab: instead we'll generate a general "disk space low" message and show
+        // these detail errors only in the error view.
+        done(SyncFileItem::DetailError,
+            tr("The download would reduce free local disk space below the limit"), ErrorCategory::GenericError);
+        emit propagator()->insufficientLocalStorage();
+        return false;
+    } else if (diskSpaceResult == OwncloudPropagator::DiskSpaceCritical) {
+        done(SyncFileItem::FatalError,
+            tr("Free space on disk is less than %1").arg(Utility::octetsToString(criticalFreeSpaceLimit())), ErrorCategory::GenericError);
+        return false;
+    }
+    return true;
+}
+
+QVector<SyncJournalDb::DownloadSegment> PropagateDownloadFile::downloadSegments() const
+{
+    const auto &options = propagator()->syncOptions();
+    // Encrypted files are decrypted after the download and direct download
+    // URLs may not support ranges, keep them in one piece.
+    if (_rangeRequestsIgnored || options._downloadSegments <= 1 || _item->_size < options._minSegmentedDownloadSize
+        || isEncrypted() || !_item->_directDownloadUrl.isEmpty() || propagator()->_downloadLimit < 0) {
+        return {};
+    }
+
+    const auto count = qMin(qint64(options._downloadSegments), _item->_size);
+    const auto segmentSize = (_item->_size + count - 1) / count;
+    QVector<SyncJournalDb::DownloadSegment> segments;
+    for (qint64 start = 0; start < _item->_size; start += segmentSize) {
+        SyncJournalDb::DownloadSegment segment;
+        segment._start = start;
+        segment._end = qMin(start + segmentSize, _item->_size);
+        segments.append(segment);
+    }
+    return segments;
+}
+
+void PropagateDownloadFile::startSegmentedDownload(const QString &tmpFileName, QVector<SyncJournalDb::DownloadSegment> segments)
+{
+    // Only resume what matches the file on the server
+    if (segments.last()._end != _item->_size || _tmpFile.size() != _item->_size) {
+        if (_tmpFile.exists()) {
+            qCInfo(lcPropagateDownload) << "Not resuming the segments of" << _item->_file << "with a temporary file of" << _tmpFile.size() << "bytes";
+        }
+        segments = downloadSegments();
+        if (segments.isEmpty()) {
+            FileSystem::remove(_tmpFile.fileName());
+            propagator()->_journal->setDownloadInfo(_item->_file, SyncJournalDb::DownloadInfo());
+            startDownload();
+            return;
+        }
+    }
+
+    const auto resumed = _tmpFile.exists();
+    if (!checkDiskSpace()) {
+        return;
+    }
+
+    // Can't open read-only files for writing
+    if (resumed) {
+        FileSystem::setFileReadOnly(_tmpFile.fileName(), false);
+    }
+    if (!_tmpFile.open(QIODevice::ReadWrite) || !_tmpFile.resize(_item->_size)) {
+        qCWarning(lcPropagateDownload) << "could not create temporary file" << _tmpFile.fileName() << _tmpFile.errorString();
+        done(SyncFileItem::NormalError, _tmpFile.errorString(), ErrorCategory::GenericError);
+        return;
+    }
+    _tmpFile.close();
+    // Hide temporary after creation
+    FileSystem::setFileHidden(_tmpFile.fileName(), true);
+
+    _segmentedDownloadInfo = SyncJournalDb::DownloadInfo();
+    _segmentedDownloadInfo._etag = _item->_etag;
+    _segmentedDownloadInfo._tmpfile = tmpFileName;
+    _segmentedDownloadInfo._valid = true;
+    _segmentedDownloadInfo._segments = segments;
+    propagator()->_journal->setDownloadInfo(_item->_file, _segmentedDownloadInfo);
+    propagator()->_journal->commit("download file start");
+
+    _resumeStart = 0;
+    _segmentJobs = QVector<QPointer<GETFileJob>>(segments.size());
+    for (int i = 0; i < segments.size(); ++i) {
+        if (!segments.at(i).isComplete() && !startSegment(i)) {
+            return;
+        }
+    }
+    _downloadProgress = segmentedDownloadProgress();
+
+    if (_downloadProgress == _item->_size) {
+        qCInfo(lcPropagateDownload) << "File is already complete, no need to download";
+        downloadFinished();
+        return;
+    }
+    qCInfo(lcPropagateDownload) << "Downloading" << _item->_file << "in" << segments.size() << "segments," << _downloadProgress << "bytes already received";
+}
+
+bool PropagateDownloadFile::startSegment(int index)
+{
+    const auto &segment = _segmentedDownloadInfo._segments.at(index);
+    const auto start = segment._start + segment._received;
+
+    // Every segment writes through its own handle at its own offset
+    auto device = new QFile(_tmpFile.fileName());
+    if (!device->open(QIODevice::ReadWrite | QIODevice::Unbuffered) || !device->seek(start)) {
+        qCWarning(lcPropagateDownload) << "could not open temporary file" << device->fileName() << device->errorString();
+        cancelSegments();
+        done(SyncFileItem::NormalError, device->errorString(), ErrorCategory::GenericError);
+        delete device;
+        return false;
+    }
+
+    const auto job = new GETFileJob(propagator()->account(),
+        propagator()->fullRemotePath(_item->_file),
+        device, {}, _item->_etag, start, this);
+    device->setParent(job);
+    job->setRangeEnd(segment._end);
+    job->setExpectedContentLength(segment._end - start);
+    job->setBandwidthManager(&propagator()->_bandwidthManager);
+    connect(job, &GETFileJob::finishedSignal, this, &PropagateDownloadFile::slotSegmentFinished);
+    connect(job, &GETFileJob::downloadProgress, this, &PropagateDownloadFile::slotSegmentProgress);
+    _segmentJobs[index] = job;
+    propagator()->_activeJobList.append(this);
+    job->start();
+    return true;
+}
+
+void PropagateDownloadFile::cancelSegments()
+{
+    for (int i = 0; i < _segmentJobs.size(); ++i) {
+        auto &job = _segmentJobs[i];
+        if (job) {
+            // What was written so far is kept for resuming
+            auto &segment = _segmentedDownloadInfo._segments[i];
+            segment._received = qBound(segment._received, job->currentDownloadPosition() - segment._start, segment._end - segment._start);
+            disconnect(job, nullptr, this, nullptr);
+            job->cancel();
+            propagator()->_activeJobList.removeOne(this);
+        }
+        job = nullptr;
+    }
+    if (_segmentedDownloadInfo._valid) {
+        propagator()->_journal->setDownloadInfo(_item->_file, _segmentedDownloadInfo);
+    }
+}
+
+qint64 PropagateDownloadFile::segmentedDownloadProgress()
+{
+    qint64 received = 0;
+    for (int i = 0; i < _segmentJobs.size(); ++i) {
+        const auto &segment = _segmentedDownloadInfo._segments.at(i);
+        const auto &job = _segmentJobs.at(i);
+        received += job ? job->currentDownloadPosition() - segment._start : segment._received;
+    }
+    return received;
+}
+
 qint64 PropagateDownloadFile::committedDiskSpace() const
 {
     if (_state == Running) {
@@ -805,94 +1025,12 @@ void PropagateDownloadFile::slotGetFinished()
     _item->_httpErrorCode = job->reply()->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
     _item->_requestId = job->requestId();
 
-    QNetworkReply::NetworkError err = job->reply()->error();
-    if (err != QNetworkReply::NoError) {
-        // If we sent a 'Range' header and get 416 back, we want to retry
-        // without the header.
-        const bool badRangeHeader = job->resumeStart() > 0 && _item->_httpErrorCode == 416;
-        if (badRangeHeader) {
-            qCWarning(lcPropagateDownload) << "server replied 416 to our range request, trying again without";
-            propagator()->_anotherSyncNeeded = true;
-        }
-
-        // Getting a 404 probably means that the file was deleted on the server.
-        const bool fileNotFound = _item->_httpErrorCode == 404;
-        if (fileNotFound) {
-            qCWarning(lcPropagateDownload) << "server replied 404, assuming file was deleted";
-        }
-
-        // Getting a 423 means that the file is locked
-        const bool fileLocked = _item->_httpErrorCode == 423;
-        if (fileLocked) {
-            qCWarning(lcPropagateDownload) << "server replied 423, file is Locked";
-        }
-
-        // Don't keep the temporary file if it is empty or we
-        // used a bad range header or the file's not on the server anymore.
-        if (_tmpFile.exists() && (_tmpFile.size() == 0 || badRangeHeader || fileNotFound)) {
-            _tmpFile.close();
-            FileSystem::remove(_tmpFile.fileName());
-            propagator()->_journal->setDownloadInfo(_item->_file, SyncJournalDb::DownloadInfo());
-        }
-
-        if (!_item->_directDownloadUrl.isEmpty() && err != QNetworkReply::OperationCanceledError) {
-            // If this was with a direct download, retry without direct download
-            qCWarning(lcPropagateDownload) << "Direct download of" << _item->_directDownloadUrl << "failed. Retrying through owncloud.";
-            _item->_directDownloadUrl.clear();
-            start();
-            return;
-        }
-
-        // This gives a custom QNAM (by the user of libowncloudsync) to abort() a QNetworkReply in its metaDataChanged() slot and
-        // set a custom error string to make this a soft error. In contrast to the default hard error this won't bring down
-        // the whole sync and allows for a custom error message.
-        QNetworkReply *reply = job->reply();
-        if (err == QNetworkReply::OperationCanceledError && reply->property(owncloudCustomSoftErrorStringC).isValid()) {
-            job->setErrorString(reply->property(owncloudCustomSoftErrorStringC).toString());
-            job->setErrorStatus(SyncFileItem::SoftError);
-        } else if (badRangeHeader) {
-            // Can't do this in classifyError() because 416 without a
-            // Range header should result in NormalError.
-            job->setErrorStatus(SyncFileItem::SoftError);
-        } else if (fileNotFound) {
-            job->setErrorString(tr("File was deleted from server"));
-            job->setErrorStatus(SyncFileItem::SoftError);
-
-            // As a precaution against bugs that cause our database and the
-            // reality on the server to diverge, rediscover this folder on the
-            // next sync run.
-            propagator()->_journal->schedulePathForRemoteDiscovery(_item->_file);
-        }
-
-        QByteArray errorBody;
-        QString errorString = _item->_httpErrorCode >= 400 ? job->errorStringParsingBody(&errorBody)
-                                                           : job->errorString();
-        SyncFileItem::Status status = job->errorStatus();
-        if (status == SyncFileItem::NoStatus) {
-            status = classifyError(err, _item->_httpErrorCode,
-                &propagator()->_anotherSyncNeeded, errorBody);
-        }
-
-        done(status, errorString, errorCategoryFromNetworkError(err));
+    if (job->reply()->error() != QNetworkReply::NoError) {
+        handleGetError(job);
         return;
     }
 
-    _item->_responseTimeStamp = job->responseTimestamp();
-
-    if (!job->etag().isEmpty()) {
-        // The etag will be empty if we used a direct download URL.
-        // (If it was really empty by the server, the GETFileJob will have errored
-        _item->_etag = parseEtag(job->etag());
-    }
-    if (job->lastModified()) {
-        // It is possible that the file was modified on the server since we did the discovery phase
-        // so make sure we have the up-to-date time
-        _item->_modtime = job->lastModified();
-        Q_ASSERT(_item->_modtime > 0);
-        if (_item->_modtime <= 0) {
-            qCWarning(lcPropagateDownload()) << "invalid modified time" << _item->_file << _item->_modtime;
-        }
-    }
+    readReplyMetadata(job);
 
     _tmpFile.close();
     _tmpFile.flush();
@@ -939,19 +1077,94 @@ void PropagateDownloadFile::slotGetFinished()
         return;
     }
 
+    validateDownload(job->reply());
+}
+
+void PropagateDownloadFile::slotSegmentFinished()
+{
+    propagator()->_activeJobList.removeOne(this);
+
+    auto job = qobject_cast<GETFileJob *>(sender());
+    ASSERT(job);
+    const auto index = _segmentJobs.indexOf(job);
+    ASSERT(index >= 0);
+    _segmentJobs[index] = nullptr;
+
+    _item->_httpErrorCode = job->reply()->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    _item->_requestId = job->requestId();
+
+    // Whatever arrived was written, keep it for resuming
+    auto &segment = _segmentedDownloadInfo._segments[index];
+    segment._received = qBound(segment._received, job->currentDownloadPosition() - segment._start, segment._end - segment._start);
+    propagator()->_journal->setDownloadInfo(_item->_file, _segmentedDownloadInfo);
+
+    if (job->reply()->error() != QNetworkReply::NoError) {
+        cancelSegments();
+        if (job->rangeIgnored()) {
+            qCWarning(lcPropagateDownload) << "Server ignored a range request, downloading" << _item->_file << "with a single request";
+            FileSystem::remove(_tmpFile.fileName());
+            propagator()->_journal->setDownloadInfo(_item->_file, SyncJournalDb::DownloadInfo());
+            _rangeRequestsIgnored = true;
+            startDownload();
+            return;
+        }
+        handleGetError(job);
+        return;
+    }
+
+    if (!segment.isComplete()) {
+        qCWarning(lcPropagateDownload) << "Segment" << segment._start << segment._end << "of" << _item->_file << "ended after" << segment._received << "bytes";
+        cancelSegments();
+        propagator()->_anotherSyncNeeded = true;
+        done(SyncFileItem::SoftError, tr("The file could not be downloaded completely."), ErrorCategory::GenericError);
+        return;
+    }
+
+    if (std::any_of(_segmentJobs.cbegin(), _segmentJobs.cend(), [](const QPointer<GETFileJob> &segmentJob) { return !segmentJob.isNull(); })) {
+        return;
+    }
+
+    // All segments are there, the checksum is validated on the assembled file
+    _segmentJobs.clear();
+    readReplyMetadata(job);
+    validateDownload(job->reply());
+}
+
+void PropagateDownloadFile::readReplyMetadata(GETFileJob *job)
+{
+    _item->_responseTimeStamp = job->responseTimestamp();
+
+    if (!job->etag().isEmpty()) {
+        // The etag will be empty if we used a direct download URL.
+        // (If it was really empty by the server, the GETFileJob will have errored
+        _item->_etag = parseEtag(job->etag());
+    }
+    if (job->lastModified()) {
+        // It is possible that the file was modified on the server since we did the discovery phase
+        // so make sure we have the up-to-date time
+        _item->_modtime = job->lastModified();
+        Q_ASSERT(_item->_modtime > 0);
+        if (_item->_modtime <= 0) {
+            qCWarning(lcPropagateDownload()) << "invalid modified time" << _item->_file << _item->_modtime;
+        }
+    }
+}
+
+void PropagateDownloadFile::validateDownload(QNetworkReply *reply)
+{
     // Did the file come with conflict headers? If so, store them now!
     // If we download conflict files but the server doesn't send conflict
     // headers, the record will be established by SyncEngine::conflictRecordMaintenance.
     // (we can't reliably determine the file id of the base file here,
     // it might still be downloaded in a parallel job and not exist in
     // the database yet!)
-    if (job->reply()->rawHeader("OC-Conflict") == "1") {
+    if (reply->rawHeader("OC-Conflict") == "1") {
         _conflictRecord.path = _item->_file.toUtf8();
-        _conflictRecord.initialBasePath = job->reply()->rawHeader("OC-ConflictInitialBasePath");
-        _conflictRecord.baseFileId = job->reply()->rawHeader("OC-ConflictBaseFileId");
-        _conflictRecord.baseEtag = job->reply()->rawHeader("OC-ConflictBaseEtag");
+        _conflictRecord.initialBasePath = reply->rawHeader("OC-ConflictInitialBasePath");
+        _conflictRecord.baseFileId = reply->rawHeader("OC-ConflictBaseFileId");
+        _conflictRecord.baseEtag = reply->rawHeader("OC-ConflictBaseEtag");
 
-        auto mtimeHeader = job->reply()->rawHeader("OC-ConflictBaseMtime");
+        auto mtimeHeader = reply->rawHeader("OC-ConflictBaseMtime");
         if (!mtimeHeader.isEmpty())
             _conflictRecord.baseModtime = mtimeHeader.toLongLong();
 
@@ -968,13 +1181,85 @@ void PropagateDownloadFile::slotGetFinished()
         this, &PropagateDownloadFile::transmissionChecksumValidated);
     connect(validator, &ValidateChecksumHeader::validationFailed,
         this, &PropagateDownloadFile::slotChecksumFail);
-    auto checksumHeader = findBestChecksum(job->reply()->rawHeader(checkSumHeaderC));
-    auto contentMd5Header = job->reply()->rawHeader(contentMd5HeaderC);
+    auto checksumHeader = findBestChecksum(reply->rawHeader(checkSumHeaderC));
+    auto contentMd5Header = reply->rawHeader(contentMd5HeaderC);
     if (checksumHeader.isEmpty() && !contentMd5Header.isEmpty())
         checksumHeader = "MD5:" + contentMd5Header;
     validator->start(_tmpFile.fileName(), checksumHeader);
 }
 
+void PropagateDownloadFile::handleGetError(GETFileJob *job)
+{
+    QNetworkReply::NetworkError err = job->reply()->error();
+    // If we sent a 'Range' header and get 416 back, we want to retry
+    // without the header.
+    const bool badRangeHeader = job->resumeStart() > 0 && _item->_httpErrorCode == 416;
+    if (badRangeHeader) {
+        qCWarning(lcPropagateDownload) << "server replied 416 to our range request, trying again without";
+        propagator()->_anotherSyncNeeded = true;
+    }
+
+    // Getting a 404 probably means that the file was deleted on the server.
+    const bool fileNotFound = _item->_httpErrorCode == 404;
+    if (fileNotFound) {
+        qCWarning(lcPropagateDownload) << "server replied 404, assuming file was deleted";
+    }
+
+    // Getting a 423 means that the file is locked
+    const bool fileLocked = _item->_httpErrorCode == 423;
+    if (fileLocked) {
+        qCWarning(lcPropagateDownload) << "server replied 423, file is Locked";
+    }
+
+    // Don't keep the temporary file if it is empty or we
+    // used a bad range header or the file's not on the server anymore.
+    if (_tmpFile.exists() && (_tmpFile.size() == 0 || badRangeHeader || fileNotFound)) {
+        _tmpFile.close();
+        FileSystem::remove(_tmpFile.fileName());
+        propagator()->_journal->setDownloadInfo(_item->_file, SyncJournalDb::DownloadInfo());
+    }
+
+    if (!_item->_directDownloadUrl.isEmpty() && err != QNetworkReply::OperationCanceledError) {
+        // If this was with a direct download, retry without direct download
+        qCWarning(lcPropagateDownload) << "Direct download of" << _item->_directDownloadUrl << "failed. Retrying through owncloud.";
+        _item->_directDownloadUrl.clear();
+        start();
+        return;
+    }
+
+    // This gives a custom QNAM (by the user of libowncloudsync) to abort() a QNetworkReply in its metaDataChanged() slot and
+    // set a custom error string to make this a soft error. In contrast to the default hard error this won't bring down
+    // the whole sync and allows for a custom error message.
+    QNetworkReply *reply = job->reply();
+    if (err == QNetworkReply::OperationCanceledError && reply->property(owncloudCustomSoftErrorStringC).isValid()) {
+        job->setErrorString(reply->property(owncloudCustomSoftErrorStringC).toString());
+        job->setErrorStatus(SyncFileItem::SoftError);
+    } else if (badRangeHeader) {
+        // Can't do this in classifyError() because 416 without a
+        // Range header should result in NormalError.
+        job->setErrorStatus(SyncFileItem::SoftError);
+    } else if (fileNotFound) {
+        job->setErrorString(tr("File was deleted from server"));
+        job->setErrorStatus(SyncFileItem::SoftError);
+
+        // As a precaution against bugs that cause our database and the
+        // reality on the server to diverge, rediscover this folder on the
+        // next sync run.
+        propagator()->_journal->schedulePathForRemoteDiscovery(_item->_file);
+    }
+
+    QByteArray errorBody;
+    QString errorString = _item->_httpErrorCode >= 400 ? job->errorStringParsingBody(&errorBody)
+                                                       : job->errorString();
+    SyncFileItem::Status status = job->errorStatus();
+    if (status == SyncFileItem::NoStatus) {
+        status = classifyError(err, _item->_httpErrorCode,
+            &propagator()->_anotherSyncNeeded, errorBody);
+    }
+
+    done(status, errorString, errorCategoryFromNetworkError(err));
+}
+
 void PropagateDownloadFile::slotChecksumFail(const QString &errMsg,
     const QByteArray &calculatedChecksumType, const QByteArray &calculatedChecksum, const ValidateChecksumHeader::FailureReason reason)
 {
@@ -1445,12 +1730,26 @@ void PropagateDownloadFile::slotDownloadProgress(qint64 received, qint64)
     propagator()->reportProgress(*_item, _resumeStart + received);
 }
 
+void PropagateDownloadFile::slotSegmentProgress()
+{
+    _downloadProgress = segmentedDownloadProgress();
+    propagator()->reportProgress(*_item, _downloadProgress);
+}
+
 
 void PropagateDownloadFile::abort(PropagatorJob::AbortType abortType)
 {
     if (_job && _job->reply())
         _job->reply()->abort();
 
+    // The first segment to finish cancels the others
+    for (const auto &job : std::as_const(_segmentJobs)) {
+        if (job && job->reply()) {
+            job->reply()->abort();
+            break;
+        }
+    }
+
     if (abortType == AbortType::Asynchronous) {
         emit abortFinished();
     }
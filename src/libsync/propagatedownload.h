@@ -33,6 +33,8 @@ class OWNCLOUDSYNC_EXPORT GETFileJob : public AbstractNetworkJob
     QByteArray _expectedEtagForResume;
     qint64 _expectedContentLength;
     qint64 _resumeStart;
+    qint64 _rangeEnd = -1;
+    bool _rangeIgnored = false;
     SyncFileItem::Status _errorStatus;
     QUrl _directDownloadUrl;
     QByteArray _etag;
@@ -63,6 +65,7 @@ public:
         if (_bandwidthManager) {
             _bandwidthManager->unregisterDownloadJob(this);
         }
+        stopReadingAhead();
     }
 
     void start() override;
@@ -74,6 +77,7 @@ public:
             if (_bandwidthManager) {
                 _bandwidthManager->unregisterDownloadJob(this);
             }
+            stopReadingAhead();
             if (!_hasEmittedFinishedSignal) {
                 emit finishedSignal();
             }
@@ -90,6 +94,7 @@ public:
     void setChoked(bool c);
     void setBandwidthLimited(bool b);
     void giveBandwidthQuota(qint64 q);
+    [[nodiscard]] qint64 bandwidthQuota() const { return _bandwidthQuota; }
     qint64 currentDownloadPosition();
 
     [[nodiscard]] QString errorString() const override;
@@ -102,6 +107,14 @@ public:
 
     QByteArray &etag() { return _etag; }
     qint64 resumeStart() { return _resumeStart; }
+
+    /** Only download up to end (exclusive) instead of to the end of the file.
+     *
+     * Unlike resuming, this relies on the server to honor the range: the job
+     * fails and rangeIgnored() returns true if it doesn't.
+     */
+    void setRangeEnd(qint64 end) { _rangeEnd = end; }
+    [[nodiscard]] bool rangeIgnored() const { return _rangeIgnored; }
     time_t lastModified() { return _lastModified; }
 
     [[nodiscard]] qint64 contentLength() const { return _contentLength; }
@@ -111,6 +124,15 @@ public:
 protected:
     virtual qint64 writeToDevice(const QByteArray &data);
 
+private:
+    /// The read buffer size of the reply, depends on whether the bandwidth is limited
+    /// and on how many replies share the read-ahead
+    [[nodiscard]] qint64 replyReadBufferSize() const;
+    /// Applies replyReadBufferSize() to the replies of all jobs reading ahead
+    static void updateReadBufferSizes();
+    /// Gives the share of the read-ahead of this job back to the others
+    void stopReadingAhead();
+
 signals:
     void finishedSignal();
     void downloadProgress(qint64, qint64);
@@ -166,8 +188,10 @@ private:
     +-> startDownload() <--------------------------+
           |                                        |
           +-> run a GETFileJob                     | checksum identical?
+          |   or one per segment of a large file   |
                                                    |
       done?-> slotGetFinished()                    |
+          or slotSegmentFinished() for the last    |
                 |                                  |
                 +-> validate checksum header       |
                                                    |
@@ -223,6 +247,8 @@ private slots:
     void startDownload();
     /// Called when the GETFileJob finishes
     void slotGetFinished();
+    /// Called when the GETFileJob of a segment finishes
+    void slotSegmentFinished();
     /// Called when the download's checksum header was validated
     void transmissionChecksumValidated(const QByteArray &checksumType, const QByteArray &checksum);
     /// Called when the download's checksum computation is done
@@ -237,6 +263,7 @@ private slots:
 
     void abort(PropagatorJob::AbortType abortType) override;
     void slotDownloadProgress(qint64, qint64);
+    void slotSegmentProgress();
     void slotChecksumFail(const QString &errMsg, const QByteArray &calculatedChecksumType,
         const QByteArray &calculatedChecksum, const ValidateChecksumHeader::FailureReason reason);
     void processChecksumRecalculate(const QNetworkReply *reply, const QByteArray &originalChecksumHeader, const QString &errorMessage);
@@ -245,12 +272,31 @@ private slots:
 private:
     void startAfterIsEncryptedIsChecked();
     void deleteExistingFolder();
+    [[nodiscard]] bool checkDiskSpace();
+
+    /// The segments to split a new download into, none to use a single request
+    [[nodiscard]] QVector<SyncJournalDb::DownloadSegment> downloadSegments() const;
+    void startSegmentedDownload(const QString &tmpFileName, QVector<SyncJournalDb::DownloadSegment> segments);
+    [[nodiscard]] bool startSegment(int index);
+    void cancelSegments();
+    [[nodiscard]] qint64 segmentedDownloadProgress();
+
+    void handleGetError(GETFileJob *job);
+    void readReplyMetadata(GETFileJob *job);
+    void validateDownload(QNetworkReply *reply);
     [[nodiscard]] bool isEncrypted() const { return _isEncrypted; }
 
     qint64 _resumeStart = 0;
     qint64 _downloadProgress = 0;
     QPointer<GETFileJob> _job;
     QFile _tmpFile;
+
+    /// Progress of a download split into segments, see startSegmentedDownload()
+    SyncJournalDb::DownloadInfo _segmentedDownloadInfo;
+    /// The running job of each segment
+    QVector<QPointer<GETFileJob>> _segmentJobs;
+    /// Set once the server ignored a range request, to fall back to a single request
+    bool _rangeRequestsIgnored = false;
     bool _deleteExisting = false;
     bool _isEncrypted = false;
     FolderMetadata::EncryptedFile _encryptedInfo;
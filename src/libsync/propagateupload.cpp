@@ -255,6 +255,7 @@ void PropagateUploadFileCommon::setupEncryptedFile(const QString& path, const QS
     _fileToUpload._path = path;
     _fileToUpload._file = filename;
     _fileToUpload._size = size;
+    _fileToUpload._streamingEncryption = _uploadEncryptedHelper->streamingEncryption();
     startUploadFile();
 }
 
@@ -264,6 +265,7 @@ void PropagateUploadFileCommon::setupUnencryptedFile()
     _fileToUpload._file = _item->_file;
     _fileToUpload._size = _item->_size;
     _fileToUpload._path = propagator()->fullLocalPath(_fileToUpload._file);
+    _fileToUpload._streamingEncryption.reset();
     startUploadFile();
 }
 
@@ -351,13 +353,35 @@ void PropagateUploadFileCommon::slotComputeContentChecksum()
 
     // Compute the content checksum.
     auto computeChecksum = new ComputeChecksum(this);
-    computeChecksum->setChecksumType(checksumType);
-
-    connect(computeChecksum, &ComputeChecksum::done,
-        this, &PropagateUploadFileCommon::slotComputeTransmissionChecksum);
+    const auto transmissionChecksumType = separateTransmissionChecksumType(checksumType);
+    if (transmissionChecksumType.isEmpty()) {
+        computeChecksum->setChecksumType(checksumType);
+        connect(computeChecksum, &ComputeChecksum::done,
+            this, &PropagateUploadFileCommon::slotComputeTransmissionChecksum);
+    } else {
+        // Both checksums are needed, compute them while reading the file once
+        computeChecksum->setChecksumTypes({checksumType, transmissionChecksumType});
+        connect(computeChecksum, &ComputeChecksum::done,
+            this, [this, computeChecksum, transmissionChecksumType](const QByteArray &contentChecksumType, const QByteArray &contentChecksum) {
+                _item->_checksumHeader = makeChecksumHeader(contentChecksumType, contentChecksum);
+                slotStartUpload(transmissionChecksumType, computeChecksum->checksum(transmissionChecksumType));
+            });
+    }
     connect(computeChecksum, &ComputeChecksum::done,
         computeChecksum, &QObject::deleteLater);
-    computeChecksum->start(_fileToUpload._path);
+    startChecksumComputation(computeChecksum);
+}
+
+QByteArray PropagateUploadFileCommon::separateTransmissionChecksumType(const QByteArray &contentChecksumType) const
+{
+    if (!uploadChecksumEnabled()) {
+        return {};
+    }
+    const auto &capabilities = propagator()->account()->capabilities();
+    if (capabilities.supportedChecksumTypes().contains(contentChecksumType)) {
+        return {};
+    }
+    return capabilities.uploadChecksumType();
 }
 
 void PropagateUploadFileCommon::slotComputeTransmissionChecksum(const QByteArray &contentChecksumType, const QByteArray &contentChecksum)
@@ -384,7 +408,25 @@ void PropagateUploadFileCommon::slotComputeTransmissionChecksum(const QByteArray
         this, &PropagateUploadFileCommon::slotStartUpload);
     connect(computeChecksum, &ComputeChecksum::done,
         computeChecksum, &QObject::deleteLater);
-    computeChecksum->start(_fileToUpload._path);
+    startChecksumComputation(computeChecksum);
+}
+
+void PropagateUploadFileCommon::startChecksumComputation(ComputeChecksum *computeChecksum)
+{
+    // Encrypted files are checksummed in the form they are uploaded in
+    if (_fileToUpload._streamingEncryption) {
+        computeChecksum->start(std::make_unique<StreamingEncryptor>(*_fileToUpload._streamingEncryption));
+    } else {
+        computeChecksum->start(_fileToUpload._path);
+    }
+}
+
+std::unique_ptr<UploadDevice> PropagateUploadFileCommon::createUploadDevice(qint64 start, qint64 size)
+{
+    if (_fileToUpload._streamingEncryption) {
+        return std::make_unique<UploadDevice>(*_fileToUpload._streamingEncryption, start, size, &propagator()->_bandwidthManager);
+    }
+    return std::make_unique<UploadDevice>(_fileToUpload._path, start, size, &propagator()->_bandwidthManager);
 }
 
 void PropagateUploadFileCommon::slotStartUpload(const QByteArray &transmissionChecksumType, const QByteArray &transmissionChecksum)
@@ -433,7 +475,7 @@ void PropagateUploadFileCommon::slotStartUpload(const QByteArray &transmissionCh
         return slotOnErrorStartFolderUnlock(SyncFileItem::SoftError, tr("Local file changed during syncing. It will be resumed."));
     }
 
-    _fileToUpload._size = FileSystem::getSize(fullFilePath);
+    _fileToUpload._size = _fileToUpload._streamingEncryption ? _fileToUpload._streamingEncryption->encryptedSize() : FileSystem::getSize(fullFilePath);
     _item->_size = FileSystem::getSize(originalFilePath);
 
     // But skip the file if the mtime is too close to 'now'!
@@ -476,10 +518,24 @@ UploadDevice::UploadDevice(const QString &fileName, qint64 start, qint64 size, B
     , _size(size)
     , _bandwidthManager(bwm)
 {
-    _bandwidthManager->registerUploadDevice(this);
+    if (_bandwidthManager) {
+        _bandwidthManager->registerUploadDevice(this);
+    }
 }
 
 
+UploadDevice::UploadDevice(const StreamingEncryptor::Parameters &encryption, qint64 start, qint64 size, BandwidthManager *bwm)
+    : _file(encryption.localPath)
+    , _encryptor(std::make_unique<StreamingEncryptor>(encryption, start, size))
+    , _start(start)
+    , _size(size)
+    , _bandwidthManager(bwm)
+{
+    if (_bandwidthManager) {
+        _bandwidthManager->registerUploadDevice(this);
+    }
+}
+
 UploadDevice::~UploadDevice()
 {
     if (_bandwidthManager) {
@@ -492,6 +548,16 @@ bool UploadDevice::open(QIODevice::OpenMode mode)
     if (mode & QIODevice::WriteOnly)
         return false;
 
+    if (_encryptor) {
+        if (!_encryptor->open(QIODevice::ReadOnly)) {
+            setErrorString(_encryptor->errorString());
+            return false;
+        }
+        _size = _encryptor->size();
+        _read = 0;
+        return QIODevice::open(mode);
+    }
+
     // Get the file size now: _file.fileName() is no longer reliable
     // on all platforms after openAndSeekFileSharedRead().
     auto fileDiskSize = FileSystem::getSize(_file.fileName());
@@ -510,6 +576,9 @@ bool UploadDevice::open(QIODevice::OpenMode mode)
 
 void UploadDevice::close()
 {
+    if (_encryptor) {
+        _encryptor->close();
+    }
     _file.close();
     QIODevice::close();
 }
@@ -544,12 +613,13 @@ qint64 UploadDevice::readData(char *data, qint64 maxlen)
         _bandwidthQuota -= maxlen;
     }
 
-    auto c = _file.read(data, maxlen);
+    auto &source = _encryptor ? static_cast<QIODevice &>(*_encryptor) : static_cast<QIODevice &>(_file);
+    auto c = source.read(data, maxlen);
     if (c == 0) {
         setErrorString({});
         return c;
     } else if (c < 0) {
-        setErrorString(_file.errorString());
+        setErrorString(source.errorString());
         return -1;
     }
     _read += c;
@@ -594,6 +664,9 @@ bool UploadDevice::seek(qint64 pos)
         return false;
     }
     _read = pos;
+    if (_encryptor) {
+        return _encryptor->seek(pos);
+    }
     _file.seek(_start + pos);
     return true;
 }
@@ -7,10 +7,16 @@
 
 #include "owncloudpropagator.h"
 #include "networkjobs.h"
+#include "streamingencryptor.h"
+#include "common/contentdefinedchunker.h"
 
 #include <QBuffer>
 #include <QFile>
 #include <QElapsedTimer>
+#include <QFutureWatcher>
+
+#include <memory>
+#include <optional>
 
 
 namespace OCC {
@@ -21,16 +27,20 @@ Q_DECLARE_LOGGING_CATEGORY(lcPropagateUploadV1)
 Q_DECLARE_LOGGING_CATEGORY(lcPropagateUploadNG)
 
 class BandwidthManager;
+class ComputeChecksum;
 
 /**
  * @brief The UploadDevice class
  * @ingroup libsync
  */
-class UploadDevice : public QIODevice
+class OWNCLOUDSYNC_EXPORT UploadDevice : public QIODevice
 {
     Q_OBJECT
 public:
+    /// bwm may be null to upload without bandwidth accounting
     UploadDevice(const QString &fileName, qint64 start, qint64 size, BandwidthManager *bwm);
+    /// Uploads the encrypted form of a file, encrypting it while reading
+    UploadDevice(const StreamingEncryptor::Parameters &encryption, qint64 start, qint64 size, BandwidthManager *bwm);
     ~UploadDevice() override;
 
     bool open(QIODevice::OpenMode mode) override;
@@ -50,11 +60,15 @@ public:
     bool isChoked() { return _choked; }
     void giveBandwidthQuota(qint64 bwq);
 
+    [[nodiscard]] qint64 bandwidthQuota() const { return _bandwidthQuota; }
+
 signals:
 
 private:
     /// The local file to read data from
     QFile _file;
+    /// Reads the data instead of _file for encrypted uploads
+    std::unique_ptr<StreamingEncryptor> _encryptor;
 
     /// Start of the file data to use
     qint64 _start = 0;
@@ -184,7 +198,7 @@ class PropagateUploadEncrypted;
  *   +--> slotComputeContentChecksum()  <---+
  *                   |
  *                   v
- *    slotComputeTransmissionChecksum()
+ *    slotComputeTransmissionChecksum()  (skipped when both are computed in one pass)
  *         |
  *         v
  *    slotStartUpload()  -> doStartUpload()
@@ -225,6 +239,8 @@ protected:
       QString _file; /// I'm still unsure if I should use a SyncFilePtr here.
       QString _path; /// the full path on disk.
       qint64 _size = 0LL;
+      /// Set if the file at _path is encrypted while it is uploaded
+      std::optional<StreamingEncryptor::Parameters> _streamingEncryption;
     };
     UploadFileInfo _fileToUpload;
     QByteArray _transmissionChecksumHeader;
@@ -308,7 +324,15 @@ protected:
 
     /** Bases headers that need to be sent on the PUT, or in the MOVE for chunking-ng */
     QMap<QByteArray, QByteArray> headers();
+
+    /** A device for the bytes [start, start + size) of _fileToUpload */
+    [[nodiscard]] std::unique_ptr<UploadDevice> createUploadDevice(qint64 start, qint64 size);
+
 private:
+    void startChecksumComputation(ComputeChecksum *computeChecksum);
+    /// The transmission checksum type if it differs from and cannot reuse the content checksum, empty otherwise
+    [[nodiscard]] QByteArray separateTransmissionChecksumType(const QByteArray &contentChecksumType) const;
+
   PropagateUploadEncrypted *_uploadEncryptedHelper = nullptr;
   bool _uploadingEncrypted = false;
   UploadStatus _uploadStatus;
@@ -391,6 +415,7 @@ private slots:
     void slotPutFinished();
     void slotMoveJobFinished();
     void slotUploadProgress(qint64, qint64);
+    void slotContentChunksComputed();
 
 private:
     // Map chunk number with its size  from the PROPFIND on resume.
@@ -400,20 +425,52 @@ private:
         QString originalName;
     };
 
+    // A chunk that is being uploaded
+    struct ChunkInFlight {
+        qint64 size = 0LL;
+        qint64 uploaded = 0LL; /// amount of data (bytes) of the chunk that was already sent
+        bool reference = false; /// the server copies the chunk from the version it has
+    };
+
+    // A range of the file that is either uploaded or copied by the server from
+    // the version it has, at baseOffset
+    struct DeltaSegment {
+        qint64 offset = 0LL;
+        qint64 size = 0LL;
+        qint64 baseOffset = -1LL; /// -1 if the data has to be uploaded
+    };
+
     [[nodiscard]] QUrl chunkUploadFolderUrl() const;
     [[nodiscard]] QUrl chunkUrl(const int chunk) const;
     [[nodiscard]] QByteArray destinationHeader() const;
 
+    [[nodiscard]] int maxParallelChunks() const;
+
+    /// Whether content defined chunks are computed to upload only changes now or next time
+    [[nodiscard]] bool deltaUploadEnabled() const;
+    void computeContentChunks();
+    /// Compares the content chunks with the stored ones of the version on the server
+    void planDeltaUpload();
+    [[nodiscard]] const DeltaSegment *deltaSegmentAt(qint64 offset) const;
+
+    void startOrResumeUpload();
     void startNewUpload();
     void startNextChunk();
+    [[nodiscard]] bool startChunk();
     void finishUpload();
 
     QMap<qint64, ServerChunkInfo> _serverChunks;
 
-    qint64 _sent = 0; /// amount of data (bytes) that was already sent
+    QMap<int, ChunkInFlight> _chunksInFlight; /// chunks being uploaded, by chunk number
+
+    qint64 _sent = 0; /// amount of data (bytes) that was already sent or is being sent
+    qint64 _confirmed = 0; /// amount of data (bytes) of the chunks the server received
     uint _transferId = 0; /// transfer id (part of the url)
     int _currentChunk = 1; /// Id of the next chunk that will be sent
-    qint64 _currentChunkSize = 0; /// current chunk size
     bool _removeJobError = false; /// If not null, there was an error removing the job
+
+    QFutureWatcher<std::optional<QVector<ContentDefinedChunker::Chunk>>> _contentChunksWatcher;
+    QVector<ContentDefinedChunker::Chunk> _contentChunks; /// stored after the upload for the next one
+    QVector<DeltaSegment> _deltaSegments; /// sorted by offset, empty to upload everything
 };
 }
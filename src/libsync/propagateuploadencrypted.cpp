@@ -144,6 +144,17 @@ void PropagateUploadEncrypted::slotFetchMetadataJobFinished(int statusCode, cons
 
     if (info.isDir()) {
         _completeFileName = encryptedFile.encryptedFilename;
+    } else if (_propagator->syncOptions()._streamingEncryptedUploads) {
+        // Only the tag is needed for the metadata, the file is encrypted again while it is uploaded
+        _streamingEncryption = StreamingEncryptor::prepare(info.absoluteFilePath(), encryptedFile.encryptionKey, encryptedFile.initializationVector);
+        if (!_streamingEncryption) {
+            qCWarning(lcPropagateUploadEncrypted()) << "There was an error encrypting the file, aborting upload.";
+            emit error();
+            return;
+        }
+
+        encryptedFile.authenticationTag = _streamingEncryption->tag;
+        _completeFileName = encryptedFile.encryptedFilename;
     } else {
         QFile input(info.absoluteFilePath());
         QFile output(QDir::tempPath() + QDir::separator() + encryptedFile.encryptedFilename);
@@ -181,6 +192,14 @@ void PropagateUploadEncrypted::slotUploadMetadataFinished(int statusCode, const
     }
 
     qCDebug(lcPropagateUploadEncrypted) << "Uploading of the metadata success, Encrypting the file";
+    if (_streamingEncryption) {
+        qCDebug(lcPropagateUploadEncrypted) << "Finalizing the upload part, the file is encrypted while it is uploaded";
+        emit finalized(_streamingEncryption->localPath,
+                       Utility::trailingSlashPath(_remoteParentPath) + _completeFileName,
+                       _streamingEncryption->encryptedSize());
+        return;
+    }
+
     QFileInfo outputInfo(_completeFileName);
 
     qCDebug(lcPropagateUploadEncrypted) << "Encrypted Info:" << outputInfo.path() << outputInfo.fileName() << outputInfo.size();
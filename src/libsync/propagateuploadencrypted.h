@@ -17,6 +17,9 @@
 
 #include "owncloudpropagator.h"
 #include "clientsideencryption.h"
+#include "streamingencryptor.h"
+
+#include <optional>
 
 namespace OCC {
 
@@ -49,6 +52,9 @@ public:
     [[nodiscard]] bool isFolderLocked() const;
     [[nodiscard]] const QByteArray folderToken() const;
 
+    /// Set once finalized() was emitted for a file that is to be encrypted while uploading
+    [[nodiscard]] const std::optional<StreamingEncryptor::Parameters> &streamingEncryption() const { return _streamingEncryption; }
+
 private slots:
     void slotFetchMetadataJobFinished(int statusCode, const QString &message);
     void slotUploadMetadataFinished(int statusCode, const QString &message);
@@ -74,6 +80,7 @@ private:
   QByteArray _generatedIv;
   QString _completeFileName;
   QString _remoteParentAbsolutePath;
+  std::optional<StreamingEncryptor::Parameters> _streamingEncryption;
 
   QScopedPointer<EncryptedFolderMetadataHandler> _encryptedFolderMetadataHandler;
 };
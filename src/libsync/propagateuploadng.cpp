@@ -22,6 +22,8 @@
 #include <QNetworkAccessManager>
 #include <QFileInfo>
 #include <QDir>
+#include <QtConcurrentRun>
+#include <algorithm>
 #include <cmath>
 #include <cstring>
 
@@ -74,6 +76,14 @@ QUrl PropagateUploadFileNG::chunkUrl(const int chunk) const
     |
     +-> MOVE ------> moveJobFinished() ---> finalize()
 
+  startNextChunk() keeps up to maxParallelChunks() PUTs in flight and every
+  finished one schedules the next, the MOVE waits for all of them.
+
+  Delta uploads: if the server supports it, doStartUpload() first splits the
+  file into content defined chunks in a thread. The ranges whose chunks the
+  version on the server also has are sent as empty PUTs that tell the server
+  where to copy them from, only the other ranges are uploaded. The chunks are
+  stored in the journal after the MOVE for the next upload of the file.
 
  */
 
@@ -89,6 +99,122 @@ void PropagateUploadFileNG::doStartUpload()
 {
     propagator()->_activeJobList.append(this);
 
+    if (deltaUploadEnabled()) {
+        computeContentChunks();
+        return;
+    }
+    startOrResumeUpload();
+}
+
+bool PropagateUploadFileNG::deltaUploadEnabled() const
+{
+    return propagator()->account()->capabilities().deltaSync()
+        && _fileToUpload._size >= propagator()->syncOptions()._minDeltaUploadSize
+        && !_item->isEncrypted()
+        && !_fileToUpload._streamingEncryption;
+}
+
+void PropagateUploadFileNG::computeContentChunks()
+{
+    const auto averageSize = propagator()->syncOptions()._deltaChunkSize;
+    connect(&_contentChunksWatcher, &QFutureWatcherBase::finished,
+        this, &PropagateUploadFileNG::slotContentChunksComputed, Qt::UniqueConnection);
+    _contentChunksWatcher.setFuture(QtConcurrent::run([path = _fileToUpload._path, averageSize]() -> std::optional<QVector<ContentDefinedChunker::Chunk>> {
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) {
+            return {};
+        }
+        ContentDefinedChunker chunker(averageSize / 4, averageSize, averageSize * 4);
+        return chunker.chunkDevice(&file);
+    }));
+}
+
+void PropagateUploadFileNG::slotContentChunksComputed()
+{
+    if (propagator()->_abortRequested) {
+        return;
+    }
+
+    if (const auto chunks = _contentChunksWatcher.result()) {
+        _contentChunks = *chunks;
+        planDeltaUpload();
+    } else {
+        // The upload reports the error if the file stays unreadable
+        qCWarning(lcPropagateUploadNG) << "Could not chunk" << _fileToUpload._path << ", uploading all of it";
+    }
+    startOrResumeUpload();
+}
+
+void PropagateUploadFileNG::planDeltaUpload()
+{
+    _deltaSegments.clear();
+
+    // Only the version the upload is conditioned on with If-Match can be referenced
+    if (_item->_instruction != CSYNC_INSTRUCTION_SYNC || _deleteExisting) {
+        return;
+    }
+    const auto base = propagator()->_journal->getDeltaChunks(_item->_file);
+    if (!base.isValid() || base._etag != _item->_etag) {
+        return;
+    }
+
+    QHash<QByteArray, qint64> baseOffsets;
+    qint64 baseOffset = 0;
+    for (const auto &chunk : base._chunks) {
+        if (!baseOffsets.contains(chunk.hash)) {
+            baseOffsets.insert(chunk.hash, baseOffset);
+        }
+        baseOffset += chunk.size;
+    }
+    if (baseOffset != base._size) {
+        qCWarning(lcPropagateUploadNG) << "Ignoring the stored chunks of" << _item->_file << ", they don't add up to its size";
+        return;
+    }
+
+    // Neighbouring chunks to upload are merged, as are ones the server copies from one range
+    qint64 offset = 0;
+    qint64 reused = 0;
+    for (const auto &chunk : std::as_const(_contentChunks)) {
+        const auto chunkBaseOffset = baseOffsets.value(chunk.hash, -1);
+        if (chunkBaseOffset >= 0) {
+            reused += chunk.size;
+        }
+        if (!_deltaSegments.isEmpty()) {
+            auto &last = _deltaSegments.last();
+            const auto bothUploaded = last.baseOffset < 0 && chunkBaseOffset < 0;
+            const auto bothCopied = last.baseOffset >= 0 && chunkBaseOffset == last.baseOffset + last.size;
+            if (bothUploaded || bothCopied) {
+                last.size += chunk.size;
+                offset += chunk.size;
+                continue;
+            }
+        }
+        _deltaSegments.append({offset, chunk.size, chunkBaseOffset});
+        offset += chunk.size;
+    }
+
+    if (reused == 0) {
+        _deltaSegments.clear();
+        return;
+    }
+    qCInfo(lcPropagateUploadNG) << "Delta upload of" << _item->_file << ":" << reused << "of" << offset << "bytes are copied from the server in"
+                                << _deltaSegments.size() << "ranges";
+}
+
+const PropagateUploadFileNG::DeltaSegment *PropagateUploadFileNG::deltaSegmentAt(qint64 offset) const
+{
+    const auto it = std::upper_bound(_deltaSegments.cbegin(), _deltaSegments.cend(), offset, [](qint64 value, const DeltaSegment &segment) {
+        return value < segment.offset;
+    });
+    if (it == _deltaSegments.cbegin()) {
+        return nullptr;
+    }
+    const auto &segment = *(it - 1);
+    return offset < segment.offset + segment.size ? &segment : nullptr;
+}
+
+void PropagateUploadFileNG::startOrResumeUpload()
+{
     const SyncJournalDb::UploadInfo progressInfo = propagator()->_journal->getUploadInfo(_item->_file);
     Q_ASSERT(_item->_modtime > 0);
     if (_item->_modtime <= 0) {
@@ -145,11 +271,13 @@ void PropagateUploadFileNG::slotPropfindFinished()
     // Chunked upload v2: numbers range from 1 to 10000
     _currentChunk = 1;
     _sent = 0;
+    _chunksInFlight.clear();
     while (_serverChunks.contains(_currentChunk)) {
         _sent += _serverChunks[_currentChunk].size;
         _serverChunks.remove(_currentChunk);
         ++_currentChunk;
     }
+    _confirmed = _sent;
 
     if (_sent > _fileToUpload._size) {
         // Normally this can't happen because the size is xor'ed with the transfer id, and it is
@@ -248,6 +376,8 @@ void PropagateUploadFileNG::startNewUpload()
     }
     _transferId = uint(Utility::rand() ^ uint(_item->_modtime) ^ (uint(_fileToUpload._size) << 16) ^ qHash(_fileToUpload._file));
     _sent = 0;
+    _confirmed = 0;
+    _chunksInFlight.clear();
     _currentChunk = 1; // Chunked upload v2: numbers range from 1 to 10000
 
     propagator()->reportProgress(*_item, 0);
@@ -335,6 +465,21 @@ void PropagateUploadFileNG::finishUpload()
     return;
 }
 
+int PropagateUploadFileNG::maxParallelChunks() const
+{
+    if (propagator()->_uploadLimit < 0) {
+        // disable parallelism when there is a relative network limit.
+        return 1;
+    }
+
+    const auto serverLimit = propagator()->account()->capabilities().maxConcurrentChunkUploads();
+    auto limit = propagator()->syncOptions()._maxParallelChunkUploads;
+    if (limit <= 0 || (serverLimit > 0 && serverLimit < limit)) {
+        limit = serverLimit;
+    }
+    return qBound(1, limit, propagator()->hardMaximumActiveJob());
+}
+
 void PropagateUploadFileNG::startNextChunk()
 {
     if (propagator()->_abortRequested)
@@ -342,16 +487,46 @@ void PropagateUploadFileNG::startNextChunk()
 
     const auto fileSize = _fileToUpload._size;
     ENFORCE(fileSize >= _sent, "Sent data exceeds file size")
-    // prevent situation that chunk size is bigger then required one to send
-    _currentChunkSize = qMin(propagator()->_chunkSize, fileSize - _sent);
 
-    if (_currentChunkSize == 0) {
-        finishUpload();
+    if (_sent == fileSize) {
+        // The MOVE has to wait for the chunks still being uploaded
+        if (_chunksInFlight.isEmpty()) {
+            finishUpload();
+        }
         return;
     }
 
+    // Chunks may finish out of order. Resuming is still correct as it only
+    // keeps the chunks before the first missing one, see slotPropfindFinished().
+    const auto maxInFlight = maxParallelChunks();
+    while (_sent < fileSize && _chunksInFlight.size() < maxInFlight) {
+        if (!startChunk()) {
+            return;
+        }
+    }
+}
+
+bool PropagateUploadFileNG::startChunk()
+{
+    const auto fileSize = _fileToUpload._size;
+    // prevent situation that chunk size is bigger then required one to send
+    auto chunkSize = qMin(propagator()->_chunkSize, fileSize - _sent);
+
+    // A resumed upload may continue in the middle of a segment
+    qint64 baseOffset = -1;
+    if (const auto segment = deltaSegmentAt(_sent)) {
+        const auto segmentEnd = segment->offset + segment->size;
+        if (segment->baseOffset >= 0) {
+            baseOffset = segment->baseOffset + (_sent - segment->offset);
+            chunkSize = segmentEnd - _sent;
+        } else {
+            chunkSize = qMin(chunkSize, segmentEnd - _sent);
+        }
+    }
+    const auto reference = baseOffset >= 0;
+
     const auto fileName = _fileToUpload._path;
-    auto device = std::make_unique<UploadDevice>(fileName, _sent, _currentChunkSize, &propagator()->_bandwidthManager);
+    auto device = createUploadDevice(_sent, reference ? 0 : chunkSize);
     if (!device->open(QIODevice::ReadOnly)) {
         qCWarning(lcPropagateUploadNG) << "Could not prepare upload device: " << device->errorString();
 
@@ -362,15 +537,20 @@ void PropagateUploadFileNG::startNextChunk()
         }
         // Soft error because this is likely caused by the user modifying his files while syncing
         abortWithError(SyncFileItem::SoftError, device->errorString());
-        return;
+        return false;
     }
 
     QMap<QByteArray, QByteArray> headers;
     headers["OC-Chunk-Offset"] = QByteArray::number(_sent);
     headers["Destination"] = destinationHeader();
     headers[QByteArrayLiteral("OC-Total-Length")] = QByteArray::number(fileSize);
+    if (reference) {
+        headers[QByteArrayLiteral("OC-Delta-Base-Offset")] = QByteArray::number(baseOffset);
+        headers[QByteArrayLiteral("OC-Delta-Base-Length")] = QByteArray::number(chunkSize);
+    }
 
-    _sent += _currentChunkSize;
+    _sent += chunkSize;
+    _chunksInFlight.insert(_currentChunk, {chunkSize, 0, reference});
     const auto url = chunkUrl(_currentChunk);
 
     // job takes ownership of device via a QScopedPointer. Job deletes itself when finishing
@@ -386,6 +566,7 @@ void PropagateUploadFileNG::startNextChunk()
     job->start();
     propagator()->_activeJobList.append(this);
     _currentChunk++;
+    return true;
 }
 
 void PropagateUploadFileNG::slotPutFinished()
@@ -396,6 +577,7 @@ void PropagateUploadFileNG::slotPutFinished()
     slotJobDestroyed(job); // remove it from the _jobs list
 
     propagator()->_activeJobList.removeOne(this);
+    const auto chunk = _chunksInFlight.take(job->_chunk);
 
     if (_finished) {
         // We have sent the finished signal already. We don't need to handle any remaining jobs
@@ -407,6 +589,12 @@ void PropagateUploadFileNG::slotPutFinished()
     if (err != QNetworkReply::NoError) {
         _item->_httpErrorCode = job->reply()->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
         _item->_requestId = job->requestId();
+        const auto refused = (_item->_httpErrorCode >= 400 && _item->_httpErrorCode < 500) || _item->_httpErrorCode == 501;
+        if (chunk.reference && refused) {
+            // The version on the server may not be the one the chunks describe, the next attempt uploads everything
+            qCWarning(lcPropagateUploadNG) << "Server refused to copy a range of" << _item->_file << ", dropping its stored chunks";
+            propagator()->_journal->setDeltaChunks(_item->_file, {});
+        }
         commonErrorHandling(job);
         const auto exceptionParsed = getExceptionFromReply(job->reply());
         _item->_errorExceptionName = exceptionParsed.first;
@@ -415,15 +603,16 @@ void PropagateUploadFileNG::slotPutFinished()
     }
 
     ENFORCE(_sent <= _fileToUpload._size, "can't send more than size");
+    _confirmed += chunk.size;
 
     // Adjust the chunk size for the time taken.
     //
     // Dynamic chunk sizing is enabled if the server configured a
     // target duration for each chunk upload.
     auto targetDuration = propagator()->syncOptions()._targetChunkUploadDuration;
-    if (targetDuration.count() > 0) {
+    if (targetDuration.count() > 0 && !chunk.reference) {
         auto uploadTime = ++job->msSinceStart(); // add one to avoid div-by-zero
-        qint64 predictedGoodSize = (_currentChunkSize * targetDuration) / uploadTime;
+        qint64 predictedGoodSize = (chunk.size * targetDuration) / uploadTime;
 
         // The whole targeting is heuristic. The predictedGoodSize will fluctuate
         // quite a bit because of external factors (like available bandwidth)
@@ -436,13 +625,13 @@ void PropagateUploadFileNG::slotPutFinished()
         // Adjust the dynamic chunk size _chunkSize used for sizing of the item's chunks to be send
         propagator()->_chunkSize = ::qBound(propagator()->syncOptions().minChunkSize(), targetSize, propagator()->syncOptions().maxChunkSize());
 
-        qCInfo(lcPropagateUploadNG) << "Chunked upload of" << _currentChunkSize << "bytes took" << uploadTime.count()
+        qCInfo(lcPropagateUploadNG) << "Chunked upload of" << chunk.size << "bytes took" << uploadTime.count()
                                   << "ms, desired is" << targetDuration.count() << "ms, expected good chunk size is"
                                   << predictedGoodSize << "bytes and nudged next chunk size to "
                                   << propagator()->_chunkSize << "bytes";
     }
 
-    _finished = _sent == _item->_size;
+    _finished = _sent == _item->_size && _chunksInFlight.isEmpty();
 
     // Check if the file still exists
     const QString fullFilePath(propagator()->fullLocalPath(_item->_file));
@@ -544,6 +733,10 @@ void PropagateUploadFileNG::slotMoveJobFinished()
         abortWithError(SyncFileItem::NormalError, tr("Missing ETag from server"));
         return;
     }
+
+    if (!_contentChunks.isEmpty()) {
+        propagator()->_journal->setDeltaChunks(_item->_file, {_item->_etag, _fileToUpload._size, _contentChunks});
+    }
     finalize();
 }
 
@@ -556,7 +749,19 @@ void PropagateUploadFileNG::slotUploadProgress(qint64 sent, qint64 total)
     if (sent == 0 && total == 0) {
         return;
     }
-    propagator()->reportProgress(*_item, _sent + sent - total);
+    const auto job = qobject_cast<PUTFileJob *>(sender());
+    ASSERT(job);
+    const auto chunk = _chunksInFlight.find(job->_chunk);
+    if (chunk == _chunksInFlight.end()) {
+        return;
+    }
+    chunk->uploaded = sent;
+
+    auto uploaded = _confirmed;
+    for (const auto &chunkInFlight : std::as_const(_chunksInFlight)) {
+        uploaded += chunkInFlight.uploaded;
+    }
+    propagator()->reportProgress(*_item, uploaded);
 }
 
 void PropagateUploadFileNG::abort(PropagatorJob::AbortType abortType)
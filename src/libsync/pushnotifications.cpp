@@ -7,6 +7,9 @@
 #include "creds/abstractcredentials.h"
 #include "account.h"
 
+#include <QJsonArray>
+#include <QJsonDocument>
+
 namespace {
 static constexpr int MAX_ALLOWED_FAILED_AUTHENTICATION_ATTEMPTS = 3;
 static constexpr int PING_INTERVAL = 30 * 1000;
@@ -104,6 +107,8 @@ void PushNotifications::onWebSocketTextMessageReceived(const QString &message)
 
     if (message == "notify_file") {
         handleNotifyFile();
+    } else if (message.startsWith(QStringLiteral("notify_file_id "))) {
+        handleNotifyFileId(message.mid(QStringLiteral("notify_file_id ").size()));
     } else if (message == "notify_activity") {
         handleNotifyActivity();
     } else if (message == "notify_notification") {
@@ -186,6 +191,10 @@ void PushNotifications::handleAuthenticated()
     _failedAuthenticationAttemptsCount = 0;
     _isReady = true;
     startPingTimer();
+
+    // Ask for the ids of the changed files, servers that can't tell them keep sending notify_file
+    _webSocket->sendTextMessage(QStringLiteral("listen notify_file_id"));
+
     emit ready();
 
     // We maybe reconnected to websocket while being offline for a
@@ -202,6 +211,30 @@ void PushNotifications::handleNotifyFile()
     emitFilesChanged();
 }
 
+void PushNotifications::handleNotifyFileId(const QString &fileIds)
+{
+    qCInfo(lcPushNotifications) << "Files push notification with file ids arrived";
+
+    const auto json = QJsonDocument::fromJson(fileIds.toUtf8());
+    QList<qint64> ids;
+    const auto array = json.array();
+    for (const auto &value : array) {
+        const auto id = value.toInteger(-1);
+        if (id < 0) {
+            ids.clear();
+            break;
+        }
+        ids.append(id);
+    }
+
+    if (ids.isEmpty()) {
+        qCWarning(lcPushNotifications) << "Could not read the file ids" << fileIds;
+        emitFilesChanged();
+        return;
+    }
+    emit fileIdsChanged(_account, ids);
+}
+
 void PushNotifications::handleInvalidCredentials()
 {
     qCInfo(lcPushNotifications) << "Invalid credentials submitted to websocket";
@@ -65,6 +65,13 @@ signals:
      */
     void filesChanged(OCC::Account *account);
 
+    /**
+     * Will be emitted instead of filesChanged() if the server told which files changed
+     *
+     * @param fileIds The numeric ids of the changed files
+     */
+    void fileIdsChanged(OCC::Account *account, const QList<qint64> &fileIds);
+
     /**
      * Will be emitted if activities have been changed on the server
      */
@@ -111,6 +118,7 @@ private:
 
     void handleAuthenticated();
     void handleNotifyFile();
+    void handleNotifyFileId(const QString &fileIds);
     void handleInvalidCredentials();
     void handleNotifyNotification();
     void handleNotifyActivity();
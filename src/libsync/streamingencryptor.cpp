@@ -0,0 +1,308 @@
+/*
+ * SPDX-FileCopyrightText: 2026 Nextcloud GmbH and Nextcloud contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "streamingencryptor.h"
+#include "common/constants.h"
+#include "common/filesystembase.h"
+#include "filesystem.h"
+
+#include <QLoggingCategory>
+#include <QtEndian>
+
+#include <openssl/evp.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcStreamingEncryptor, "nextcloud.sync.clientsideencryption.streaming", QtInfoMsg)
+
+namespace {
+
+constexpr qint64 cipherBlockSize = 16;
+constexpr qint64 readBufferSize = 1024 * 1024;
+
+unsigned char *unsignedData(char *data)
+{
+    return reinterpret_cast<unsigned char *>(data);
+}
+
+const unsigned char *unsignedData(const QByteArray &data)
+{
+    return reinterpret_cast<const unsigned char *>(data.constData());
+}
+
+bool initGcm(EncryptionHelper::CipherCtx &ctx, const QByteArray &key, const QByteArray &iv)
+{
+    return ctx
+        && EVP_EncryptInit_ex(ctx, EVP_aes_128_gcm(), nullptr, nullptr, nullptr)
+        && EVP_CIPHER_CTX_set_padding(ctx, 0)
+        && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, iv.size(), nullptr)
+        && EVP_EncryptInit_ex(ctx, nullptr, nullptr, unsignedData(key), unsignedData(iv));
+}
+
+}
+
+qint64 StreamingEncryptor::Parameters::encryptedSize() const
+{
+    return plainSize + Constants::e2EeTagSize;
+}
+
+std::optional<StreamingEncryptor::Parameters> StreamingEncryptor::prepare(const QString &localPath, const QByteArray &key, const QByteArray &iv)
+{
+    Parameters parameters;
+    parameters.localPath = localPath;
+    parameters.key = key;
+    parameters.iv = iv;
+    parameters.plainSize = FileSystem::getSize(localPath);
+    parameters.modtime = FileSystem::getModTime(localPath);
+
+    QFile file(localPath);
+    QString openError;
+    if (!FileSystem::openAndSeekFileSharedRead(&file, &openError, 0)) {
+        qCWarning(lcStreamingEncryptor) << "Could not open" << localPath << openError;
+        return {};
+    }
+
+    EncryptionHelper::CipherCtx ctx;
+    if (!initGcm(ctx, key, iv)) {
+        qCWarning(lcStreamingEncryptor) << "Could not initialize the cipher";
+        return {};
+    }
+
+    // Only the tag is kept, the ciphertext is encrypted in place and dropped
+    QByteArray buffer(readBufferSize, Qt::Uninitialized);
+    qint64 total = 0;
+    forever {
+        const auto read = file.read(buffer.data(), buffer.size());
+        if (read < 0) {
+            qCWarning(lcStreamingEncryptor) << "Could not read" << localPath << file.errorString();
+            return {};
+        }
+        if (read == 0) {
+            break;
+        }
+        int len = 0;
+        if (!EVP_EncryptUpdate(ctx, unsignedData(buffer.data()), &len, unsignedData(buffer), static_cast<int>(read))) {
+            qCWarning(lcStreamingEncryptor) << "Could not encrypt";
+            return {};
+        }
+        total += read;
+    }
+
+    int len = 0;
+    parameters.tag = QByteArray(Constants::e2EeTagSize, '\0');
+    if (!EVP_EncryptFinal_ex(ctx, unsignedData(buffer.data()), &len)
+        || !EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, Constants::e2EeTagSize, unsignedData(parameters.tag.data()))) {
+        qCWarning(lcStreamingEncryptor) << "Could not finalize the encryption";
+        return {};
+    }
+
+    if (total != parameters.plainSize || !FileSystem::verifyFileUnchanged(localPath, parameters.plainSize, parameters.modtime)) {
+        qCInfo(lcStreamingEncryptor) << localPath << "changed while computing the tag";
+        return {};
+    }
+    return parameters;
+}
+
+StreamingEncryptor::StreamingEncryptor(const Parameters &parameters, qint64 start, qint64 size, QObject *parent)
+    : QIODevice(parent)
+    , _parameters(parameters)
+    , _file(parameters.localPath)
+    , _start(start)
+    , _size(size)
+{
+}
+
+StreamingEncryptor::~StreamingEncryptor() = default;
+
+bool StreamingEncryptor::open(OpenMode mode)
+{
+    if (mode & QIODevice::WriteOnly) {
+        return false;
+    }
+
+    QString openError;
+    if (!FileSystem::openAndSeekFileSharedRead(&_file, &openError, 0)) {
+        setErrorString(openError);
+        return false;
+    }
+    if (!initFirstCounter()) {
+        _file.close();
+        setErrorString(tr("Could not initialize the encryption"));
+        return false;
+    }
+
+    const auto available = qMax(0ll, _parameters.encryptedSize() - _start);
+    _size = _size < 0 ? available : qMin(_size, available);
+    _read = 0;
+    _cipherPos = -1;
+    _unchangedVerified = false;
+
+    return QIODevice::open(mode);
+}
+
+void StreamingEncryptor::close()
+{
+    _file.close();
+    QIODevice::close();
+}
+
+bool StreamingEncryptor::isSequential() const
+{
+    return false;
+}
+
+qint64 StreamingEncryptor::size() const
+{
+    return qMax(0ll, _size);
+}
+
+bool StreamingEncryptor::seek(qint64 pos)
+{
+    if (pos < 0 || pos > size() || !QIODevice::seek(pos)) {
+        return false;
+    }
+    _read = pos;
+    return true;
+}
+
+qint64 StreamingEncryptor::readData(char *data, qint64 maxlen)
+{
+    maxlen = qMin(maxlen, size() - _read);
+    if (maxlen <= 0) {
+        return 0;
+    }
+
+    const auto pos = _start + _read;
+    qint64 done = 0;
+
+    if (pos < _parameters.plainSize) {
+        const auto toRead = qMin(maxlen, _parameters.plainSize - pos);
+        if (_file.pos() != pos && !_file.seek(pos)) {
+            setErrorString(_file.errorString());
+            return -1;
+        }
+        const auto read = _file.read(data, toRead);
+        if (read <= 0) {
+            setErrorString(read < 0 ? _file.errorString() : tr("The file is shorter than expected"));
+            return -1;
+        }
+        if (!encrypt(data, pos, read)) {
+            setErrorString(tr("Could not encrypt the file"));
+            return -1;
+        }
+        done = read;
+    }
+
+    if (done < maxlen && pos + done >= _parameters.plainSize) {
+        // Only hand out the tag if it matches the data that was read
+        if (!_unchangedVerified) {
+            if (!FileSystem::verifyFileUnchanged(_parameters.localPath, _parameters.plainSize, _parameters.modtime)) {
+                if (done > 0) {
+                    // fail on the next read
+                    _read += done;
+                    return done;
+                }
+                setErrorString(tr("The file changed while it was being uploaded"));
+                return -1;
+            }
+            _unchangedVerified = true;
+        }
+        const auto tagOffset = pos + done - _parameters.plainSize;
+        const auto tagBytes = qMin(maxlen - done, qint64(_parameters.tag.size()) - tagOffset);
+        memcpy(data + done, _parameters.tag.constData() + tagOffset, tagBytes);
+        done += tagBytes;
+    }
+
+    _read += done;
+    return done;
+}
+
+qint64 StreamingEncryptor::writeData(const char *, qint64)
+{
+    return -1;
+}
+
+bool StreamingEncryptor::initFirstCounter()
+{
+    // GCM encrypts the first block with the counter block inc32(J0), see
+    // NIST SP 800-38D. Encrypting zeros gives E(K, inc32(J0)), and decrypting
+    // that with the plain block cipher gives the counter block back, without
+    // computing J0 from the 16 byte IV by hand.
+    EncryptionHelper::CipherCtx gcm;
+    if (!initGcm(gcm, _parameters.key, _parameters.iv)) {
+        return false;
+    }
+    const QByteArray zeros(cipherBlockSize, '\0');
+    QByteArray keystream(cipherBlockSize, '\0');
+    int len = 0;
+    if (!EVP_EncryptUpdate(gcm, unsignedData(keystream.data()), &len, unsignedData(zeros), zeros.size()) || len != cipherBlockSize) {
+        return false;
+    }
+
+    EncryptionHelper::CipherCtx ecb;
+    _firstCounter = QByteArray(cipherBlockSize, '\0');
+    return ecb
+        && EVP_DecryptInit_ex(ecb, EVP_aes_128_ecb(), nullptr, unsignedData(_parameters.key), nullptr)
+        && EVP_CIPHER_CTX_set_padding(ecb, 0)
+        && EVP_DecryptUpdate(ecb, unsignedData(_firstCounter.data()), &len, unsignedData(keystream), keystream.size())
+        && len == cipherBlockSize;
+}
+
+bool StreamingEncryptor::startCipherAt(qint64 pos)
+{
+    const auto block = pos / cipherBlockSize;
+
+    // GCM increments only the last 32 bits of the counter block and lets
+    // them wrap around, the CTR mode of OpenSSL carries into the other bits.
+    // Restart the cipher at the wrap around so both agree.
+    const auto firstCounterLow = qFromBigEndian<quint32>(_firstCounter.constData() + 12);
+    const auto counterLow = static_cast<quint32>(firstCounterLow + static_cast<quint64>(block));
+    auto counter = _firstCounter;
+    qToBigEndian(counterLow, counter.data() + 12);
+
+    if (!EVP_EncryptInit_ex(_ctx, EVP_aes_128_ctr(), nullptr, unsignedData(_parameters.key), unsignedData(counter))) {
+        return false;
+    }
+    _cipherPos = block * cipherBlockSize;
+    _cipherEnd = (block + (Q_INT64_C(0x100000000) - counterLow)) * cipherBlockSize;
+
+    // Skip the keystream up to pos
+    if (const auto skip = pos - _cipherPos; skip > 0) {
+        QByteArray scratch(skip, '\0');
+        int len = 0;
+        if (!EVP_EncryptUpdate(_ctx, unsignedData(scratch.data()), &len, unsignedData(scratch), scratch.size())) {
+            return false;
+        }
+        _cipherPos += len;
+    }
+    return _cipherPos == pos;
+}
+
+bool StreamingEncryptor::encrypt(char *data, qint64 pos, qint64 len)
+{
+    qint64 offset = 0;
+    while (offset < len) {
+        if (_cipherPos != pos + offset || _cipherPos >= _cipherEnd) {
+            if (!startCipherAt(pos + offset)) {
+                _cipherPos = -1;
+                return false;
+            }
+        }
+        const auto count = std::min({len - offset, _cipherEnd - _cipherPos, qint64(std::numeric_limits<int>::max())});
+        int outLen = 0;
+        if (!EVP_EncryptUpdate(_ctx, unsignedData(data + offset), &outLen, unsignedData(data + offset), static_cast<int>(count))) {
+            _cipherPos = -1;
+            return false;
+        }
+        offset += outLen;
+        _cipherPos += outLen;
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,99 @@
+/*
+ * SPDX-FileCopyrightText: 2026 Nextcloud GmbH and Nextcloud contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include "owncloudlib.h"
+#include "clientsideencryption.h"
+
+#include <QByteArray>
+#include <QFile>
+#include <QIODevice>
+#include <QString>
+
+#include <optional>
+
+namespace OCC {
+
+/**
+ * @brief Reads a local file in its end-to-end encrypted form
+ *
+ * Produces the bytes EncryptionHelper::fileEncryption() would write, the
+ * AES-GCM ciphertext followed by the tag, without an encrypted copy on disk.
+ * GCM encrypts in counter mode, so any range of the ciphertext can be
+ * computed from the same range of the file: the device is seekable and can
+ * serve a single chunk of a chunked upload.
+ *
+ * The tag covers the whole file and is computed up front by prepare().
+ * Reading the tag fails if the file changed since then, so an upload can't
+ * end with a tag that doesn't match the data that was sent.
+ *
+ * @ingroup libsync
+ */
+class OWNCLOUDSYNC_EXPORT StreamingEncryptor : public QIODevice
+{
+    Q_OBJECT
+public:
+    /// Everything needed to read a file in its encrypted form, see prepare()
+    struct Parameters
+    {
+        QString localPath;
+        QByteArray key;
+        QByteArray iv;
+        QByteArray tag;
+        qint64 plainSize = 0;
+        time_t modtime = 0;
+
+        [[nodiscard]] qint64 encryptedSize() const;
+    };
+
+    /**
+     * Encrypts the file once without writing the result, to get the tag.
+     *
+     * Returns nothing if the file could not be read or changed meanwhile.
+     */
+    [[nodiscard]] static std::optional<Parameters> prepare(const QString &localPath, const QByteArray &key, const QByteArray &iv);
+
+    /// The encrypted bytes [start, start + size), a negative size for all of them
+    explicit StreamingEncryptor(const Parameters &parameters, qint64 start = 0, qint64 size = -1, QObject *parent = nullptr);
+    ~StreamingEncryptor() override;
+
+    bool open(OpenMode mode) override;
+    void close() override;
+
+    [[nodiscard]] bool isSequential() const override;
+    [[nodiscard]] qint64 size() const override;
+    bool seek(qint64 pos) override;
+
+protected:
+    qint64 readData(char *data, qint64 maxlen) override;
+    qint64 writeData(const char *data, qint64 len) override;
+
+private:
+    [[nodiscard]] bool initFirstCounter();
+    [[nodiscard]] bool startCipherAt(qint64 pos);
+    [[nodiscard]] bool encrypt(char *data, qint64 pos, qint64 len);
+
+    Parameters _parameters;
+    QFile _file;
+
+    /// Start of the encrypted data to use
+    qint64 _start = 0;
+    /// Amount of encrypted data after _start to use, negative until opened for all of it
+    qint64 _size = -1;
+    /// Position between _start and _start+_size
+    qint64 _read = 0;
+
+    /// The GCM counter block of the first ciphertext block
+    QByteArray _firstCounter;
+    EncryptionHelper::CipherCtx _ctx;
+    /// Position in the file the counter mode cipher continues at, -1 if not started
+    qint64 _cipherPos = -1;
+    /// Position the cipher has to be restarted at, see startCipherAt()
+    qint64 _cipherEnd = -1;
+    bool _unchangedVerified = false;
+};
+
+}
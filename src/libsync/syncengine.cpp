@@ -33,6 +33,7 @@
 #include <climits>
 #include <cassert>
 #include <chrono>
+#include <iterator>
 
 #include <QCoreApplication>
 #include <QSslSocket>
@@ -54,7 +55,9 @@ namespace OCC {
 
 Q_LOGGING_CATEGORY(lcEngine, "nextcloud.sync.engine", QtInfoMsg)
 
-bool SyncEngine::s_anySyncRunning = false;
+QVector<SyncEngine *> SyncEngine::s_runningSyncs;
+int SyncEngine::s_maxConcurrentSyncs = 1;
+int SyncEngine::s_globalNetworkJobBudget = 0;
 
 /** When the client touches a file, block change notifications for this duration (ms)
  *
@@ -112,6 +115,9 @@ SyncEngine::~SyncEngine()
 {
     abort();
     _excludedFiles.reset();
+    if (s_runningSyncs.removeOne(this)) {
+        rebalanceNetworkJobBudget();
+    }
 }
 
 bool SyncEngine::SingleItemDiscoveryOptions::isValid() const
@@ -202,6 +208,28 @@ static bool isFileTransferInstruction(SyncInstructions instruction)
         || instruction == CSYNC_INSTRUCTION_TYPE_CHANGE;
 }
 
+// Whether the item can be propagated while the rest of the tree is still discovered
+static bool canPropagateDuringDiscovery(const SyncFileItem &item)
+{
+    if (item._isSelectiveSync || item._isRestoration || item.isEncrypted()
+        || item._wantsSpecificActions != SyncFileItem::SynchronizationOptions::NormalSynchronization) {
+        return false;
+    }
+
+    switch (item._instruction) {
+    case CSYNC_INSTRUCTION_NONE:
+    case CSYNC_INSTRUCTION_UPDATE_METADATA:
+    case CSYNC_INSTRUCTION_IGNORE:
+    case CSYNC_INSTRUCTION_ERROR:
+        return true;
+    case CSYNC_INSTRUCTION_NEW:
+    case CSYNC_INSTRUCTION_SYNC:
+        return item._direction == SyncFileItem::Down;
+    default:
+        return false;
+    }
+}
+
 void SyncEngine::deleteStaleDownloadInfos(const SyncFileItemVector &syncItems)
 {
     // Find all downloadinfo paths that we want to preserve.
@@ -476,6 +504,19 @@ void OCC::SyncEngine::slotItemDiscovered(const OCC::SyncFileItemPtr &item)
     auto it = std::lower_bound( _syncItems.begin(), _syncItems.end(), item ); // the _syncItems is sorted
     _syncItems.insert( it, item );
 
+    if (_syncOptions._streamingPropagation && !canPropagateDuringDiscovery(*item)) {
+        // The directories above this item must wait for the end of the discovery
+        for (const auto &path : {item->_file, item->destination()}) {
+            for (auto slashPos = path.lastIndexOf(QLatin1Char('/')); slashPos > 0; slashPos = path.lastIndexOf(QLatin1Char('/'), slashPos - 1)) {
+                const auto parentPath = path.left(slashPos);
+                if (_earlyPropagationBlockedDirectories.contains(parentPath)) {
+                    break;
+                }
+                _earlyPropagationBlockedDirectories.insert(parentPath);
+            }
+        }
+    }
+
     slotNewItem(item);
 
     if (item->isDirectory()) {
@@ -483,6 +524,100 @@ void OCC::SyncEngine::slotItemDiscovered(const OCC::SyncFileItemPtr &item)
     }
 }
 
+void SyncEngine::slotSubtreeDiscovered(const SyncFileItemPtr &dirItem)
+{
+    if (!canPropagateDuringDiscovery(*dirItem) || _earlyPropagationBlockedDirectories.contains(dirItem->_file)) {
+        return;
+    }
+
+    const auto databaseFingerprint = _journal->dataFingerprint();
+    if (!databaseFingerprint.isEmpty() && _discoveryPhase->_dataFingerprint != databaseFingerprint) {
+        // finishSync() turns downloads into conflicts when restoring a backup
+        return;
+    }
+
+    // The directory and its contents directly follow each other in the sorted items
+    const auto path = dirItem->_file;
+    const auto isInSubtree = [&path](const SyncFileItemPtr &item) {
+        const auto destination = item->destination();
+        return destination.startsWith(path) && (destination.size() == path.size() || destination.at(path.size()) == QLatin1Char('/'));
+    };
+    const auto first = std::lower_bound(_syncItems.begin(), _syncItems.end(), dirItem);
+    const auto last = std::find_if_not(first, _syncItems.end(), isInSubtree);
+    if (first == last) {
+        return;
+    }
+
+    std::copy(first, last, std::back_inserter(_earlyPropagationQueue));
+    _syncItems.erase(first, last);
+    startEarlyPropagation();
+}
+
+void SyncEngine::startEarlyPropagation()
+{
+    if (_earlyPropagationRunning || _earlyPropagationQueue.isEmpty()) {
+        return;
+    }
+
+    std::sort(_earlyPropagationQueue.begin(), _earlyPropagationQueue.end());
+    _earlyPropagationBatch = std::exchange(_earlyPropagationQueue, {});
+
+    _journal->commit(QStringLiteral("pre early propagation"));
+
+    if (!_propagator) {
+        qCInfo(lcEngine) << "#### Early propagation start #################################################### " << _stopWatch.addLapTime(QStringLiteral("Early propagation start")) << "ms";
+        createPropagator();
+        _propagatingDuringDiscovery = true;
+        emit aboutToPropagate(_earlyPropagationBatch);
+        Q_EMIT started();
+    } else {
+        emit aboutToPropagateMore(_earlyPropagationBatch);
+    }
+
+    qCInfo(lcEngine) << "Propagating" << _earlyPropagationBatch.size() << "items while the discovery is running";
+    _earlyPropagationRunning = true;
+    auto items = _earlyPropagationBatch;
+    _propagator->start(std::move(items));
+}
+
+void SyncEngine::earlyPropagationFinished(SyncFileItem::Status status)
+{
+    _earlyPropagationRunning = false;
+
+    for (const auto &item : std::as_const(_earlyPropagationBatch)) {
+        if (item->_instruction != CSYNC_INSTRUCTION_IGNORE && item->_status != SyncFileItem::Success) {
+            // The parent directories are only propagated later, they must not
+            // store an etag that would hide this item from the next sync
+            _journal->schedulePathForRemoteDiscovery(item->_file);
+        }
+    }
+    _earlyPropagatedItems.append(_earlyPropagationBatch);
+    _earlyPropagationBatch.clear();
+
+    if (!_discoveryPhase) {
+        // Aborted while the discovery was running
+        finalize(false);
+        return;
+    }
+
+    if (status == SyncFileItem::FatalError) {
+        qCWarning(lcEngine) << "Early propagation failed, stopping the discovery";
+        disconnect(_discoveryPhase.get(), nullptr, this, nullptr);
+        _earlyPropagationQueue.clear();
+        _discoveryFinishPending = false;
+        slotPropagationFinished(status);
+        return;
+    }
+
+    if (_discoveryFinishPending) {
+        _discoveryFinishPending = false;
+        slotDiscoveryFinished();
+        return;
+    }
+
+    startEarlyPropagation();
+}
+
 void SyncEngine::startSync()
 {
     if (_journal->exists()) {
@@ -516,7 +651,11 @@ void SyncEngine::startSync()
         }
     }
 
-    if (s_anySyncRunning || _syncRunning) {
+    if (_syncRunning) {
+        return;
+    }
+    if (s_runningSyncs.size() >= s_maxConcurrentSyncs) {
+        qCInfo(lcEngine) << "Not starting sync," << s_runningSyncs.size() << "syncs are already running";
         return;
     }
     const auto currentEncryptionStatus = EncryptionStatusEnums::toDbEncryptionStatus(EncryptionStatusEnums::fromEndToEndEncryptionApiVersion(_account->capabilities().clientSideEncryptionVersion()));
@@ -524,8 +663,9 @@ void SyncEngine::startSync()
         _journal->schedulePathForRemoteDiscovery(record.path());
     });
 
-    s_anySyncRunning = true;
+    s_runningSyncs.append(this);
     _syncRunning = true;
+    rebalanceNetworkJobBudget();
     _anotherSyncNeeded = NoFollowUpSync;
     _clearTouchedFilesTimer.stop();
 
@@ -566,6 +706,9 @@ void SyncEngine::startSync()
     }
 
     _syncItems.clear();
+    _earlyPropagationBlockedDirectories.clear();
+    _earlyPropagationQueue.clear();
+    _earlyPropagatedItems.clear();
     _needsUpdate = false;
 
     if (!_journal->exists()) {
@@ -644,6 +787,17 @@ void SyncEngine::startSync()
     _discoveryPhase->_localDir = Utility::trailingSlashPath(_localPath);
     _discoveryPhase->_remoteFolder = Utility::trailingSlashPath(_remotePath);
     _discoveryPhase->_syncOptions = _syncOptions;
+    _discoveryPhase->_syncOptions._parallelNetworkJobs = parallelNetworkJobsShare();
+    const auto fileRecordCount = _journal->getFileRecordCount();
+    // Listing the whole tree at once only pays off while there is nothing in the journal to compare against
+    _discoveryPhase->_bulkRemoteDiscovery = _syncOptions._bulkRemoteDiscovery
+        && !singleItemDiscoveryOptions().isValid()
+        && fileRecordCount == 0;
+    // Same for reading the whole journal, a single item discovery only looks at a few records
+    if (_syncOptions._journalSnapshotDiscovery && !singleItemDiscoveryOptions().isValid() && fileRecordCount > 0
+        && !_discoveryPhase->_journalSnapshot.load(*_journal)) {
+        qCWarning(lcEngine) << "Could not load the journal snapshot, discovery queries the journal per directory";
+    }
     _discoveryPhase->_shouldDiscoverLocaly = [this](const QString &path) {
         const auto result = shouldDiscoverLocally(path);
         return result;
@@ -696,10 +850,18 @@ void SyncEngine::startSync()
     _discoveryPhase->_ignoreHiddenFiles = ignoreHiddenFiles();
 
     connect(_discoveryPhase.get(), &DiscoveryPhase::itemDiscovered, this, &SyncEngine::slotItemDiscovered);
+    connect(_discoveryPhase.get(), &DiscoveryPhase::subtreeDiscovered, this, &SyncEngine::slotSubtreeDiscovered);
     connect(_discoveryPhase.get(), &DiscoveryPhase::newBigFolder, this, &SyncEngine::newBigFolder);
     connect(_discoveryPhase.get(), &DiscoveryPhase::existingFolderNowBig, this, &SyncEngine::existingFolderNowBig);
     connect(_discoveryPhase.get(), &DiscoveryPhase::fatalError, this, [this](const QString &errorString, ErrorCategory errorCategory) {
         Q_EMIT syncError(errorString, errorCategory);
+        if (_earlyPropagationRunning) {
+            // Finalized once the early batch stopped
+            disconnect(_discoveryPhase.get(), nullptr, this, nullptr);
+            _discoveryPhase.release()->deleteLater();
+            _propagator->abort();
+            return;
+        }
         finalize(false);
     });
     connect(_discoveryPhase.get(), &DiscoveryPhase::finished, this, &SyncEngine::slotDiscoveryFinished);
@@ -804,8 +966,20 @@ void SyncEngine::slotDiscoveryFinished()
         return;
     }
 
+    if (_earlyPropagationRunning) {
+        // Continue once the running early batch is done
+        _discoveryFinishPending = true;
+        return;
+    }
+
     qCInfo(lcEngine) << "#### Discovery end #################################################### " << _stopWatch.addLapTime(QLatin1String("Discovery Finished")) << "ms";
 
+    if (!_earlyPropagationQueue.isEmpty()) {
+        // Subtrees that didn't get their turn are propagated with the rest
+        _syncItems.append(std::exchange(_earlyPropagationQueue, {}));
+        std::sort(_syncItems.begin(), _syncItems.end());
+    }
+
     // Sanity check
     if (!_journal->open()) {
         qCWarning(lcEngine) << "Bailing out, DB failure";
@@ -894,6 +1068,11 @@ void SyncEngine::slotItemCompleted(const SyncFileItemPtr &item, const ErrorCateg
 
 void SyncEngine::slotPropagationFinished(OCC::SyncFileItem::Status status)
 {
+    if (_earlyPropagationRunning) {
+        earlyPropagationFinished(status);
+        return;
+    }
+
     if (_propagator->_anotherSyncNeeded && _anotherSyncNeeded == NoFollowUpSync) {
         _anotherSyncNeeded = ImmediateFollowUp;
     }
@@ -906,7 +1085,12 @@ void SyncEngine::slotPropagationFinished(OCC::SyncFileItem::Status status)
     caseClashConflictRecordMaintenance();
 
     _journal->deleteStaleFlagsEntries();
-    _journal->commit("All Finished.", false);
+    _journal->deleteStaleDeltaChunks();
+    if (!_journal->commit("All Finished.", false)) {
+        // The propagated items' records are not in the database, the next sync has to find them again
+        Q_EMIT syncError(tr("Could not write the synchronization state to the local database."), ErrorCategory::GenericError);
+        status = SyncFileItem::FatalError;
+    }
 
     // Send final progress information even if no
     // files needed propagation, but clear the lastCompletedItem
@@ -928,8 +1112,12 @@ void SyncEngine::finalize(bool success)
     if (_discoveryPhase) {
         _discoveryPhase.release()->deleteLater();
     }
-    s_anySyncRunning = false;
+    const auto wasRunning = _syncRunning;
     _syncRunning = false;
+    if (wasRunning) {
+        s_runningSyncs.removeOne(this);
+        rebalanceNetworkJobBudget();
+    }
     emit finished(success);
 
     if (_account->shouldSkipE2eeMetadataChecksumValidation()) {
@@ -939,6 +1127,13 @@ void SyncEngine::finalize(bool success)
 
     // Delete the propagator only after emitting the signal.
     _propagator.clear();
+    _earlyPropagationRunning = false;
+    _propagatingDuringDiscovery = false;
+    _discoveryFinishPending = false;
+    _earlyPropagationQueue.clear();
+    _earlyPropagationBatch.clear();
+    _earlyPropagatedItems.clear();
+    _earlyPropagationBlockedDirectories.clear();
     _seenConflictFiles.clear();
     _uniqueErrors.clear();
     _localDiscoveryPaths.clear();
@@ -1053,8 +1248,15 @@ void SyncEngine::finishSync()
 
     _localDiscoveryPaths.clear();
 
+    // Streaming propagation already created the propagator and announced the sync
+    const auto propagationStartedEarly = !_propagator.isNull();
+
     // To announce the beginning of the sync
-    emit aboutToPropagate(_syncItems);
+    if (propagationStartedEarly) {
+        emit aboutToPropagateMore(_syncItems);
+    } else {
+        emit aboutToPropagate(_syncItems);
+    }
 
     qCInfo(lcEngine) << "#### Reconcile (aboutToPropagate OK) #################################################### "<< _stopWatch.addLapTime(QStringLiteral("Reconcile (aboutToPropagate OK)")) << "ms";
 
@@ -1082,9 +1284,33 @@ void SyncEngine::finishSync()
     // do a database commit
     _journal->commit(QStringLiteral("post treewalk"));
 
+    if (!propagationStartedEarly) {
+        createPropagator();
+    }
+
+    // Items propagated early may still have download or upload infos to resume
+    const auto allSyncItems = _earlyPropagatedItems + _syncItems;
+    deleteStaleDownloadInfos(allSyncItems);
+    deleteStaleUploadInfos(allSyncItems);
+    deleteStaleErrorBlacklistEntries(allSyncItems);
+    _journal->commit(QStringLiteral("post stale entry removal"));
+
+    // Emit the started signal only after the propagator has been set up.
+    if (_needsUpdate && !propagationStartedEarly)
+        Q_EMIT started();
+
+    _propagatingDuringDiscovery = false;
+    _propagator->start(std::move(_syncItems));
+
+    qCInfo(lcEngine) << "#### Post-Reconcile end #################################################### " << _stopWatch.addLapTime(QStringLiteral("Post-Reconcile Finished")) << "ms";
+}
+
+void SyncEngine::createPropagator()
+{
     _propagator = QSharedPointer<OwncloudPropagator>(
         new OwncloudPropagator(_account, _localPath, _remotePath, _journal, _bulkUploadBlackList));
     _propagator->setSyncOptions(_syncOptions);
+    _propagator->setParallelNetworkJobs(parallelNetworkJobsShare());
     connect(_propagator.data(), &OwncloudPropagator::itemCompleted,
             this, &SyncEngine::slotItemCompleted);
     connect(_propagator.data(), &OwncloudPropagator::progress,
@@ -1098,19 +1324,6 @@ void SyncEngine::finishSync()
 
     // apply the network limits to the propagator
     setNetworkLimits(_uploadLimit, _downloadLimit);
-
-    deleteStaleDownloadInfos(_syncItems);
-    deleteStaleUploadInfos(_syncItems);
-    deleteStaleErrorBlacklistEntries(_syncItems);
-    _journal->commit(QStringLiteral("post stale entry removal"));
-
-    // Emit the started signal only after the propagator has been set up.
-    if (_needsUpdate)
-        Q_EMIT started();
-
-    _propagator->start(std::move(_syncItems));
-
-    qCInfo(lcEngine) << "#### Post-Reconcile end #################################################### " << _stopWatch.addLapTime(QStringLiteral("Post-Reconcile Finished")) << "ms";
 }
 
 bool SyncEngine::handleMassDeletion()
@@ -1293,6 +1506,65 @@ const SyncEngine::SingleItemDiscoveryOptions &SyncEngine::singleItemDiscoveryOpt
     return _singleItemDiscoveryOptions;
 }
 
+int SyncEngine::maxConcurrentSyncs()
+{
+    return s_maxConcurrentSyncs;
+}
+
+void SyncEngine::setMaxConcurrentSyncs(int count)
+{
+    s_maxConcurrentSyncs = qMax(1, count);
+}
+
+int SyncEngine::runningSyncCount()
+{
+    return s_runningSyncs.size();
+}
+
+int SyncEngine::parallelNetworkJobs() const
+{
+    return _syncRunning ? parallelNetworkJobsShare() : _syncOptions._parallelNetworkJobs;
+}
+
+int SyncEngine::parallelNetworkJobsShare() const
+{
+    const auto configured = _syncOptions._parallelNetworkJobs;
+    if (s_maxConcurrentSyncs <= 1 || s_globalNetworkJobBudget <= 0) {
+        return configured;
+    }
+    // Concurrent syncs share the network budget evenly so that many running
+    // folders don't multiply the number of connections to the servers.
+    const auto share = qMax(1, s_globalNetworkJobBudget / qMax<int>(1, s_runningSyncs.size()));
+    return qMin(configured, share);
+}
+
+void SyncEngine::rebalanceNetworkJobBudget()
+{
+    for (const auto engine : std::as_const(s_runningSyncs)) {
+        const auto jobs = engine->parallelNetworkJobsShare();
+        if (jobs != engine->_syncOptions._parallelNetworkJobs) {
+            qCInfo(lcEngine) << "Limiting parallel network jobs of" << engine->_localPath << "from" << engine->_syncOptions._parallelNetworkJobs
+                             << "to" << jobs << "to share the budget with" << s_runningSyncs.size() << "running syncs";
+        }
+        if (engine->_discoveryPhase) {
+            engine->_discoveryPhase->_syncOptions._parallelNetworkJobs = jobs;
+        }
+        if (engine->_propagator) {
+            engine->_propagator->setParallelNetworkJobs(jobs);
+        }
+    }
+}
+
+int SyncEngine::globalNetworkJobBudget()
+{
+    return s_globalNetworkJobBudget;
+}
+
+void SyncEngine::setGlobalNetworkJobBudget(int budget)
+{
+    s_globalNetworkJobBudget = qMax(0, budget);
+}
+
 bool SyncEngine::shouldDiscoverLocally(const QString &path) const
 {
     auto result = false;
@@ -1405,7 +1677,7 @@ void SyncEngine::switchToVirtualFiles(const QString &localPath, SyncJournalDb &j
 
 void SyncEngine::abort()
 {
-    if (_propagator) {
+    if (_propagator && !_propagatingDuringDiscovery) {
         // If we're already in the propagation phase, aborting that is sufficient
         qCInfo(lcEngine) << "Aborting sync in propagator...";
         _propagator->abort();
@@ -1415,6 +1687,11 @@ void SyncEngine::abort()
         disconnect(_discoveryPhase.get(), nullptr, this, nullptr);
         _discoveryPhase.release()->deleteLater();
         qCInfo(lcEngine) << "Aborting sync in discovery...";
+        if (_earlyPropagationRunning) {
+            // Finalized once the early batch stopped
+            _propagator->abort();
+            return;
+        }
         finalize(false);
     }
 }
@@ -125,6 +125,29 @@ public:
     [[nodiscard]] QSharedPointer<OwncloudPropagator> getPropagator() const { return _propagator; } // for the test
     [[nodiscard]] const SyncEngine::SingleItemDiscoveryOptions &singleItemDiscoveryOptions() const;
 
+    /** Maximum number of sync runs that may be active in this process at the same time.
+     *
+     * Defaults to 1, which serializes all syncs. startSync() is a no-op while
+     * this many engines are already running.
+     */
+    [[nodiscard]] static int maxConcurrentSyncs();
+    static void setMaxConcurrentSyncs(int count);
+
+    /** Number of sync runs currently active in this process */
+    [[nodiscard]] static int runningSyncCount();
+
+    /** The parallel network jobs this engine uses, its share of the global budget while running */
+    [[nodiscard]] int parallelNetworkJobs() const;
+
+    /** Total number of parallel network jobs shared by all concurrently running syncs.
+     *
+     * When several syncs may run at once, every running engine limits its
+     * parallel network jobs to an equal share of this budget. The shares are
+     * recomputed whenever a sync starts or stops. 0 means no global limit.
+     */
+    [[nodiscard]] static int globalNetworkJobBudget();
+    static void setGlobalNetworkJobBudget(int budget);
+
 public slots:
     void setSingleItemDiscoveryOptions(const OCC::SyncEngine::SingleItemDiscoveryOptions &singleItemDiscoveryOptions);
 
@@ -159,6 +182,9 @@ signals:
     // after the above signals. with the items that actually need propagating
     void aboutToPropagate(OCC::SyncFileItemVector &);
 
+    // with streaming propagation: more items of the same sync, after aboutToPropagate
+    void aboutToPropagateMore(OCC::SyncFileItemVector &);
+
     // after each item completed by a job (successful or not)
     void itemCompleted(const OCC::SyncFileItemPtr &item, const OCC::ErrorCategory category);
 
@@ -201,6 +227,9 @@ private slots:
     /** When the discovery phase discovers an item */
     void slotItemDiscovered(const OCC::SyncFileItemPtr &item);
 
+    /** When the discovery phase finished a subtree that may be propagated early */
+    void slotSubtreeDiscovered(const OCC::SyncFileItemPtr &dirItem);
+
     /** Called when a SyncFileItem gets accepted for a sync.
      *
      * Mostly done in initial creation inside treewalkFile but
@@ -315,11 +344,33 @@ private:
     QSharedPointer<SyncEngine::ScheduledSyncTimer> nearbyScheduledSyncTimer(const qint64 scheduledSyncTimerSecs,
                                                                             const qint64 intervalSecs) const;
 
-    static bool s_anySyncRunning; //true when one sync is running somewhere (for debugging)
+    /// The parallel network jobs of the current run, capped to its share of the global budget
+    [[nodiscard]] int parallelNetworkJobsShare() const;
+    /// Gives every running sync its share of the global budget, called whenever a sync starts or stops
+    static void rebalanceNetworkJobBudget();
+
+    static QVector<SyncEngine *> s_runningSyncs; // syncs currently running in this process
+    static int s_maxConcurrentSyncs;
+    static int s_globalNetworkJobBudget;
 
     // Must only be accessed during update and reconcile
     QVector<SyncFileItemPtr> _syncItems;
 
+    // Streaming propagation, see SyncOptions::_streamingPropagation.
+    // Directories containing items that must wait for the end of the discovery
+    QSet<QString> _earlyPropagationBlockedDirectories;
+    // Discovered subtrees waiting for the running early batch to finish
+    SyncFileItemVector _earlyPropagationQueue;
+    // The items of the running early batch
+    SyncFileItemVector _earlyPropagationBatch;
+    // All items that were propagated before the discovery finished
+    SyncFileItemVector _earlyPropagatedItems;
+    bool _earlyPropagationRunning = false;
+    // The propagator was created before the discovery finished
+    bool _propagatingDuringDiscovery = false;
+    // The discovery finished while an early batch was running
+    bool _discoveryFinishPending = false;
+
     AccountPtr _account;
     bool _needsUpdate = false;
     bool _syncRunning = false;
@@ -357,6 +408,13 @@ private:
 
     void finishSync();
 
+    /** Creates _propagator and connects its signals */
+    void createPropagator();
+
+    /** Propagates the queued subtrees, unless an early batch is running already */
+    void startEarlyPropagation();
+    void earlyPropagationFinished(SyncFileItem::Status status);
+
     bool handleMassDeletion();
 
     void handleRemnantReadOnlyFolders();
@@ -106,6 +106,8 @@ SyncFileStatusTracker::SyncFileStatusTracker(SyncEngine *syncEngine)
 {
     connect(syncEngine, &SyncEngine::aboutToPropagate,
         this, &SyncFileStatusTracker::slotAboutToPropagate);
+    connect(syncEngine, &SyncEngine::aboutToPropagateMore,
+        this, &SyncFileStatusTracker::slotAboutToPropagateMore);
     connect(syncEngine, &SyncEngine::itemCompleted,
         this, &SyncFileStatusTracker::slotItemCompleted);
     connect(syncEngine, &SyncEngine::finished, this, &SyncFileStatusTracker::slotSyncFinished);
@@ -226,6 +228,37 @@ void SyncFileStatusTracker::slotAboutToPropagate(SyncFileItemVector &items)
     ProblemsMap oldProblems;
     std::swap(_syncProblems, oldProblems);
 
+    markItemsAboutToPropagate(items);
+
+    // Some metadata status won't trigger files to be synced, make sure that we
+    // push the OK status for dirty files that don't need to be propagated.
+    // Swap into a copy since fileStatus() reads _dirtyPaths to determine the status
+    QSet<QString> oldDirtyPaths;
+    std::swap(_dirtyPaths, oldDirtyPaths);
+    for (const auto &oldDirtyPath : std::as_const(oldDirtyPaths))
+        emit fileStatusChanged(getSystemDestination(oldDirtyPath), fileStatus(oldDirtyPath));
+
+    // Make sure to push any status that might have been resolved indirectly since the last sync
+    // (like an error file being deleted from disk)
+    for (const auto &syncProblem : _syncProblems)
+        oldProblems.erase(syncProblem.first);
+    for (const auto &oldProblem : oldProblems) {
+        const QString &path = oldProblem.first;
+        SyncFileStatus::SyncFileStatusTag severity = oldProblem.second;
+        if (severity == SyncFileStatus::StatusError)
+            invalidateParentPaths(path);
+        emit fileStatusChanged(getSystemDestination(path), fileStatus(path));
+    }
+}
+
+void SyncFileStatusTracker::slotAboutToPropagateMore(SyncFileItemVector &items)
+{
+    // More items of the running sync, after the ones of slotAboutToPropagate()
+    markItemsAboutToPropagate(items);
+}
+
+void SyncFileStatusTracker::markItemsAboutToPropagate(const SyncFileItemVector &items)
+{
     for (const auto &item : std::as_const(items)) {
         if (item->_instruction == CSyncEnums::CSYNC_INSTRUCTION_RENAME) {
             qCInfo(lcStatusTracker) << "Investigating" << item->destination() << item->_status << item->_instruction << item->_direction << item->_type << item->_file << item->_originalFile << item->_renameTarget;
@@ -257,26 +290,6 @@ void SyncFileStatusTracker::slotAboutToPropagate(SyncFileItemVector &items)
             emit fileStatusChanged(getSystemDestination(item->destination()), resolveSyncAndErrorStatus(item->destination(), sharedFlag));
         }
     }
-
-    // Some metadata status won't trigger files to be synced, make sure that we
-    // push the OK status for dirty files that don't need to be propagated.
-    // Swap into a copy since fileStatus() reads _dirtyPaths to determine the status
-    QSet<QString> oldDirtyPaths;
-    std::swap(_dirtyPaths, oldDirtyPaths);
-    for (const auto &oldDirtyPath : std::as_const(oldDirtyPaths))
-        emit fileStatusChanged(getSystemDestination(oldDirtyPath), fileStatus(oldDirtyPath));
-
-    // Make sure to push any status that might have been resolved indirectly since the last sync
-    // (like an error file being deleted from disk)
-    for (const auto &syncProblem : _syncProblems)
-        oldProblems.erase(syncProblem.first);
-    for (const auto &oldProblem : oldProblems) {
-        const QString &path = oldProblem.first;
-        SyncFileStatus::SyncFileStatusTag severity = oldProblem.second;
-        if (severity == SyncFileStatus::StatusError)
-            invalidateParentPaths(path);
-        emit fileStatusChanged(getSystemDestination(path), fileStatus(path));
-    }
 }
 
 void SyncFileStatusTracker::slotItemCompleted(const SyncFileItemPtr &item)
@@ -40,6 +40,7 @@ signals:
 
 private slots:
     void slotAboutToPropagate(OCC::SyncFileItemVector &items);
+    void slotAboutToPropagateMore(OCC::SyncFileItemVector &items);
     void slotItemCompleted(const OCC::SyncFileItemPtr &item);
     void slotSyncFinished();
     void slotSyncEngineRunningChanged();
@@ -62,6 +63,8 @@ private:
     QString getSystemDestination(const QString &relativePath);
     void incSyncCountAndEmitStatusChanged(const QString &relativePath, SharedFlag sharedState);
     void decSyncCountAndEmitStatusChanged(const QString &relativePath, SharedFlag sharedState);
+    /// Marks the items as syncing, or records their problems if they won't be propagated
+    void markItemsAboutToPropagate(const SyncFileItemVector &items);
 
     SyncEngine *_syncEngine;
 
@@ -60,6 +60,42 @@ void SyncOptions::fillFromEnvironmentVariables()
     int maxParallel = qgetenv("OWNCLOUD_MAX_PARALLEL").toInt();
     if (maxParallel > 0)
         _parallelNetworkJobs = maxParallel;
+
+    int maxParallelChunkUploads = qgetenv("OWNCLOUD_MAX_PARALLEL_CHUNK_UPLOADS").toInt();
+    if (maxParallelChunkUploads > 0)
+        _maxParallelChunkUploads = maxParallelChunkUploads;
+
+    int downloadSegments = qgetenv("OWNCLOUD_DOWNLOAD_SEGMENTS").toInt();
+    if (downloadSegments > 0)
+        _downloadSegments = downloadSegments;
+
+    QByteArray minSegmentedDownloadSizeEnv = qgetenv("OWNCLOUD_MIN_SEGMENTED_DOWNLOAD_SIZE");
+    if (!minSegmentedDownloadSizeEnv.isEmpty())
+        _minSegmentedDownloadSize = minSegmentedDownloadSizeEnv.toLongLong();
+
+    QByteArray minDeltaUploadSizeEnv = qgetenv("OWNCLOUD_MIN_DELTA_UPLOAD_SIZE");
+    if (!minDeltaUploadSizeEnv.isEmpty())
+        _minDeltaUploadSize = minDeltaUploadSizeEnv.toLongLong();
+
+    int maxParallelLocalScan = qgetenv("OWNCLOUD_MAX_PARALLEL_LOCAL_SCAN").toInt();
+    if (maxParallelLocalScan > 0)
+        _parallelLocalScanJobs = maxParallelLocalScan;
+
+    QByteArray bulkRemoteDiscoveryEnv = qgetenv("OWNCLOUD_BULK_REMOTE_DISCOVERY");
+    if (!bulkRemoteDiscoveryEnv.isEmpty())
+        _bulkRemoteDiscovery = bulkRemoteDiscoveryEnv != "0";
+
+    QByteArray journalSnapshotDiscoveryEnv = qgetenv("OWNCLOUD_JOURNAL_SNAPSHOT_DISCOVERY");
+    if (!journalSnapshotDiscoveryEnv.isEmpty())
+        _journalSnapshotDiscovery = journalSnapshotDiscoveryEnv != "0";
+
+    QByteArray streamingEncryptedUploadsEnv = qgetenv("OWNCLOUD_STREAMING_ENCRYPTED_UPLOADS");
+    if (!streamingEncryptedUploadsEnv.isEmpty())
+        _streamingEncryptedUploads = streamingEncryptedUploadsEnv != "0";
+
+    QByteArray streamingPropagationEnv = qgetenv("OWNCLOUD_STREAMING_PROPAGATION");
+    if (!streamingPropagationEnv.isEmpty())
+        _streamingPropagation = streamingPropagationEnv != "0";
 }
 
 void SyncOptions::verifyChunkSizes()
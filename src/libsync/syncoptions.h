@@ -58,6 +58,72 @@ public:
     /** The maximum number of active jobs in parallel  */
     int _parallelNetworkJobs = 6;
 
+    /** The maximum number of chunks of a single file uploaded in parallel
+     * with chunking v2.
+     *
+     * 0 follows the max_parallel_count capability of the server, which means
+     * one chunk after the other if the server doesn't announce a limit.
+     */
+    int _maxParallelChunkUploads = 0;
+
+    /** The number of ranged requests a large file is downloaded with in
+     * parallel. 1 downloads every file with a single request.
+     */
+    int _downloadSegments = 1;
+
+    /** Files smaller than this are always downloaded with a single request */
+    qint64 _minSegmentedDownloadSize = 64LL * 1024LL * 1024LL; // 64MiB
+
+    /** Modified files smaller than this are always uploaded in full, larger
+     * ones only upload their changed chunks if the server supports it.
+     */
+    qint64 _minDeltaUploadSize = 32LL * 1024LL * 1024LL; // 32MiB
+
+    /** The average size of the content defined chunks of delta uploads, a
+     * power of two. Chunks are between a quarter and four times as big.
+     */
+    qint64 _deltaChunkSize = 1024LL * 1024LL; // 1MiB
+
+    /** The number of threads listing local directories during discovery,
+     * 0 for one per processor core.
+     */
+    int _parallelLocalScanJobs = 0;
+
+    /** If the initial sync should fetch the whole remote tree with a single
+     * Depth: infinity PROPFIND instead of one PROPFIND per directory.
+     *
+     * Only used while the journal is still empty; servers refusing such
+     * requests transparently get the per-directory listings.
+     */
+    bool _bulkRemoteDiscovery = false;
+
+    /** If discovery should read the journal once into a SyncJournalSnapshot
+     * instead of querying it for every directory.
+     *
+     * Costs memory in proportion to the number of synced files, in exchange
+     * for much faster discovery of large folders with few changes.
+     */
+    bool _journalSnapshotDiscovery = false;
+
+    /** If files in end-to-end encrypted folders are encrypted while they are
+     * uploaded, instead of into a temporary copy before the upload starts.
+     *
+     * The file is read once for the tag and again for every checksum, chunk
+     * and retry, all under the same key and IV. A file changed in between
+     * is only noticed once parts of it were already sent, encrypted with the
+     * same keystream as before, so this stays off until it works from a snapshot.
+     */
+    bool _streamingEncryptedUploads = false;
+
+    /** If subtrees whose discovery is complete are propagated while the
+     * rest of the tree is still being discovered.
+     *
+     * Only downloads of new and changed files in directories that can't be
+     * touched by renames or deletions found later are started early, all
+     * other items wait for the end of the discovery as usual.
+     */
+    bool _streamingPropagation = false;
+
     static constexpr auto chunkV2MinChunkSize = 5LL * 1000LL * 1000LL; // 5 MB
     static constexpr auto chunkV2MaxChunkSize = 5LL * 1000LL * 1000LL * 1000LL; // 5 GB
 
@@ -72,7 +138,10 @@ public:
     /** Reads settings from env vars where available.
      *
      * Currently reads _initialChunkSize, _minChunkSize, _maxChunkSize,
-     * _targetChunkUploadDuration, _parallelNetworkJobs.
+     * _targetChunkUploadDuration, _parallelNetworkJobs, _maxParallelChunkUploads,
+     * _downloadSegments, _minSegmentedDownloadSize, _minDeltaUploadSize,
+     * _parallelLocalScanJobs, _bulkRemoteDiscovery, _journalSnapshotDiscovery, _streamingEncryptedUploads,
+     * _streamingPropagation.
      */
     void fillFromEnvironmentVariables();
 
@@ -0,0 +1,126 @@
+/*
+ * SPDX-FileCopyrightText: 2026 Nextcloud GmbH and Nextcloud contributors
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * This software is in the public domain, furnished "as is", without technical
+ * support, and with no warranty, express or implied, as to its usefulness for
+ * any purpose.
+ */
+
+#include "common/checksumcalculator.h"
+#include "common/checksumconsts.h"
+#include "common/checksums.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+#include <QThreadPool>
+
+using namespace OCC;
+
+namespace {
+
+bool writeFile(const QString &path, qint64 size)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    QByteArray block(qMin(size, qint64(4 * 1024 * 1024)), Qt::Uninitialized);
+    QRandomGenerator::global()->fillRange(reinterpret_cast<quint32 *>(block.data()), block.size() / sizeof(quint32));
+    for (qint64 written = 0; written < size;) {
+        const auto toWrite = qMin(size - written, qint64(block.size()));
+        if (file.write(block.constData(), toWrite) != toWrite) {
+            return false;
+        }
+        written += toWrite;
+    }
+    return true;
+}
+
+// Runs compute repetitions times and returns the throughput in MB/s
+template <typename Compute>
+qint64 throughput(qint64 size, int repetitions, Compute compute)
+{
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < repetitions; ++i) {
+        compute();
+    }
+    const auto elapsedNs = qMax(qint64(1), timer.nsecsElapsed());
+    return size * repetitions * 1000 / elapsedNs;
+}
+
+QString sizeName(qint64 size)
+{
+    if (size >= 1000 * 1000 * 1000) {
+        return QStringLiteral("%1 GB").arg(size / (1000 * 1000 * 1000));
+    } else if (size >= 1000 * 1000) {
+        return QStringLiteral("%1 MB").arg(size / (1000 * 1000));
+    }
+    return QStringLiteral("%1 KB").arg(size / 1000);
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    // Usage: ChecksumsBench [largest size in MB]
+    // Files grow by a factor of ten from 1 KB up to the largest size,
+    // pass 10000 to go up to 10 GB. The files were just written, so they
+    // are mostly read from the page cache and the numbers show the CPU cost.
+    const auto args = app.arguments();
+    const auto maxSize = (args.size() > 1 ? args.at(1).toLongLong() : 1000) * 1000 * 1000;
+
+    // The content checksum and the transmission checksum of an upload
+    const QList<QByteArray> types = {checkSumSHA1C, checkSumMD5C};
+
+    QTemporaryDir dir;
+    const auto path = dir.filePath(QStringLiteral("input.bin"));
+    for (qint64 size = 1000; size <= maxSize; size *= 10) {
+        if (!writeFile(path, size)) {
+            qWarning() << "Could not create" << path;
+            return -1;
+        }
+        // Enough repetitions for small files to be measurable
+        const auto repetitions = static_cast<int>(qBound(qint64(1), qint64(256 * 1000 * 1000) / size, qint64(10000)));
+
+        QByteArrayList results;
+        const auto perType = [&](const QByteArray &type) {
+            return throughput(size, repetitions, [&] {
+                ChecksumCalculator calculator(path, type);
+                results.append(calculator.calculate());
+            });
+        };
+        const auto sha1 = perType(checkSumSHA1C);
+        const auto md5 = perType(checkSumMD5C);
+        const auto sha256 = perType(checkSumSHA2C);
+        const auto adler = perType(checkSumAdlerC);
+
+        const auto separatePasses = throughput(size, repetitions, [&] {
+            for (const auto &type : types) {
+                ChecksumCalculator calculator(path, type);
+                results.append(calculator.calculate());
+            }
+        });
+        const auto singlePass = throughput(size, repetitions, [&] {
+            ChecksumCalculator calculator(std::make_unique<QFile>(path), types);
+            results.append(calculator.calculateAll());
+        });
+
+        if (results.contains(QByteArray())) {
+            qWarning() << "A checksum could not be computed";
+            return -1;
+        }
+        qDebug() << "FILE SIZE" << sizeName(size) << "REPETITIONS" << repetitions << "MB/s SHA1" << sha1 << "MD5" << md5 << "SHA256" << sha256 << "ADLER32"
+                 << adler << "SHA1+MD5 SEPARATE" << separatePasses << "SINGLE PASS" << singlePass;
+    }
+
+    qDebug() << "CHECKSUM THREADS" << checksumThreadPool()->maxThreadCount();
+    return 0;
+}
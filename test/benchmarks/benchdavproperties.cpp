@@ -0,0 +1,124 @@
+/*
+ * SPDX-FileCopyrightText: 2026 Nextcloud GmbH and Nextcloud contributors
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * This software is in the public domain, furnished "as is", without technical
+ * support, and with no warranty, express or implied, as to its usefulness for
+ * any purpose.
+ */
+
+#include "networkjobs.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+using namespace OCC;
+
+namespace {
+
+std::atomic<qint64> allocationCount{0};
+
+}
+
+// Count every heap allocation of the process, the parser runs on this thread only
+void *operator new(std::size_t size)
+{
+    ++allocationCount;
+    if (auto p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+namespace {
+
+const auto expectedPath = QStringLiteral("/remote.php/dav/files/admin/big");
+
+QByteArray listing(int entries)
+{
+    QByteArray xml = QByteArrayLiteral("<?xml version=\"1.0\"?>\n"
+                                       "<d:multistatus xmlns:d=\"DAV:\" xmlns:oc=\"http://owncloud.org/ns\" xmlns:nc=\"http://nextcloud.org/ns\">");
+    for (int i = 0; i < entries; ++i) {
+        const auto name = i == 0 ? QByteArray() : QByteArrayLiteral("file") + QByteArray::number(i) + QByteArrayLiteral(".txt");
+        xml += QByteArrayLiteral("<d:response><d:href>/remote.php/dav/files/admin/big/") + name + QByteArrayLiteral("</d:href>"
+               "<d:propstat><d:prop>"
+               "<d:getlastmodified>Fri, 06 Feb 2015 13:49:55 GMT</d:getlastmodified>"
+               "<d:getcontentlength>") + QByteArray::number(i * 13) + QByteArrayLiteral("</d:getcontentlength>"
+               "<d:resourcetype/>"
+               "<d:getetag>&quot;") + QByteArray::number(i, 16) + QByteArrayLiteral("&quot;</d:getetag>"
+               "<oc:id>") + QByteArray::number(i) + QByteArrayLiteral("ocobzus5kn6s</oc:id>"
+               "<oc:fileid>") + QByteArray::number(i) + QByteArrayLiteral("</oc:fileid>"
+               "<oc:permissions>RGDNVW</oc:permissions>"
+               "<oc:checksums><oc:checksum>SHA1:da39a3ee5e6b4b0d3255bfef95601890afd80709</oc:checksum></oc:checksums>"
+               "<oc:share-types/>"
+               "<nc:is-encrypted>0</nc:is-encrypted>"
+               "<nc:is-mount-root>false</nc:is-mount-root>"
+               "<nc:lock>0</nc:lock>"
+               "</d:prop><d:status>HTTP/1.1 200 OK</d:status></d:propstat>"
+               "<d:propstat><d:prop><oc:downloadURL/><oc:dDC/></d:prop><d:status>HTTP/1.1 404 Not Found</d:status></d:propstat>"
+               "</d:response>");
+    }
+    xml += QByteArrayLiteral("</d:multistatus>");
+    return xml;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    // Usage: DavPropertiesBench [typed|map] [entries]
+    // "map" measures the QMap<QString, QString> based path still used by the GUI.
+    const auto args = app.arguments();
+    const auto typed = args.size() < 2 || args.at(1) != QStringLiteral("map");
+    const auto entries = args.size() > 2 ? args.at(2).toInt() : 100000;
+    const auto algorithm = RemotePermissions::MountedPermissionAlgorithm::UseMountRootProperty;
+
+    const auto xml = listing(entries);
+
+    LsColXMLParser parser;
+    QHash<QString, ExtraFolderInfo> folderInfos;
+    QVector<RemoteInfo> results;
+    results.reserve(entries);
+    if (typed) {
+        QObject::connect(&parser, &LsColXMLParser::directoryListingEntry, &parser, [&](const QString &, const DavProperties &properties) {
+            RemoteInfo info;
+            LsColJob::propertiesToRemoteInfo(properties, algorithm, info);
+            results.push_back(std::move(info));
+        });
+    } else {
+        QObject::connect(&parser, &LsColXMLParser::directoryListingIterated, &parser, [&](const QString &, const QMap<QString, QString> &properties) {
+            RemoteInfo info;
+            LsColJob::propertyMapToRemoteInfo(properties, algorithm, info);
+            results.push_back(std::move(info));
+        });
+    }
+
+    const auto allocationsBefore = allocationCount.load();
+    QElapsedTimer timer;
+    timer.start();
+    const auto ok = parser.parse(xml, &folderInfos, expectedPath);
+    const auto elapsedNs = timer.nsecsElapsed();
+    const auto allocations = allocationCount.load() - allocationsBefore;
+
+    qDebug() << "MODE" << (typed ? "typed" : "map") << "ENTRIES" << results.size() << "OK" << ok;
+    qDebug() << "NS PER ENTRY" << (results.isEmpty() ? 0 : elapsedNs / results.size());
+    qDebug() << "ALLOCATIONS PER ENTRY" << (results.isEmpty() ? 0.0 : double(allocations) / results.size());
+    return ok ? 0 : -1;
+}
@@ -0,0 +1,167 @@
+/*
+ * SPDX-FileCopyrightText: 2026 Nextcloud GmbH and Nextcloud contributors
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * This software is in the public domain, furnished "as is", without technical
+ * support, and with no warranty, express or implied, as to its usefulness for
+ * any purpose.
+ */
+
+#include "clientsideencryption.h"
+#include "streamingencryptor.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTemporaryDir>
+
+#include <memory>
+
+using namespace OCC;
+
+namespace {
+
+// Accepts a single PUT, drops the body and remembers when its first byte arrived
+class MockServer : public QObject
+{
+public:
+    MockServer()
+    {
+        connect(&_server, &QTcpServer::newConnection, this, [this] {
+            auto socket = _server.nextPendingConnection();
+            connect(socket, &QTcpSocket::readyRead, this, [this, socket] { onReadyRead(socket); });
+        });
+        _server.listen(QHostAddress::LocalHost);
+    }
+
+    [[nodiscard]] QUrl url() const { return QUrl(QStringLiteral("http://127.0.0.1:%1/upload").arg(_server.serverPort())); }
+
+    void reset(QElapsedTimer *clock)
+    {
+        _clock = clock;
+        _firstByteAt = -1;
+        _received = 0;
+        _headers.clear();
+        _headersDone = false;
+    }
+
+    [[nodiscard]] qint64 firstByteAt() const { return _firstByteAt; }
+    [[nodiscard]] qint64 received() const { return _received; }
+
+private:
+    void onReadyRead(QTcpSocket *socket)
+    {
+        auto data = socket->readAll();
+        if (!_headersDone) {
+            _headers += data;
+            const auto end = _headers.indexOf("\r\n\r\n");
+            if (end < 0) {
+                return;
+            }
+            _headersDone = true;
+            const auto lengthAt = _headers.toLower().indexOf("content-length:");
+            _expected = _headers.mid(lengthAt + 15, _headers.indexOf("\r\n", lengthAt) - lengthAt - 15).trimmed().toLongLong();
+            data = _headers.mid(end + 4);
+        }
+        if (!data.isEmpty() && _firstByteAt < 0) {
+            _firstByteAt = _clock->elapsed();
+        }
+        _received += data.size();
+        if (_received >= _expected) {
+            socket->write("HTTP/1.1 201 Created\r\nContent-Length: 0\r\n\r\n");
+        }
+    }
+
+    QTcpServer _server;
+    QElapsedTimer *_clock = nullptr;
+    QByteArray _headers;
+    bool _headersDone = false;
+    qint64 _expected = 0;
+    qint64 _received = 0;
+    qint64 _firstByteAt = -1;
+};
+
+bool upload(QNetworkAccessManager &qnam, const QUrl &url, QIODevice *device)
+{
+    QNetworkRequest request(url);
+    request.setHeader(QNetworkRequest::ContentLengthHeader, device->size());
+    request.setHeader(QNetworkRequest::ContentTypeHeader, QByteArrayLiteral("application/octet-stream"));
+    auto reply = qnam.put(request, device);
+    QEventLoop loop;
+    QObject::connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
+    loop.exec();
+    const auto ok = reply->error() == QNetworkReply::NoError;
+    if (!ok) {
+        qWarning() << "Upload failed" << reply->errorString();
+    }
+    reply->deleteLater();
+    return ok;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    // Usage: EncryptedUploadBench [size in MiB]
+    const auto args = app.arguments();
+    const auto sizeMiB = args.size() > 1 ? args.at(1).toLongLong() : 4096;
+
+    QTemporaryDir dir;
+    const auto inputPath = dir.filePath(QStringLiteral("input.bin"));
+    {
+        QFile input(inputPath);
+        if (!input.open(QIODevice::WriteOnly) || !input.resize(sizeMiB * 1024 * 1024)) {
+            qWarning() << "Could not create" << inputPath;
+            return -1;
+        }
+    }
+    qDebug() << "FILE SIZE" << sizeMiB << "MiB";
+
+    const auto key = EncryptionHelper::generateRandom(16);
+    const auto iv = EncryptionHelper::generateRandom(16);
+
+    MockServer server;
+    QNetworkAccessManager qnam;
+    auto ok = true;
+
+    {
+        // What the upload of an encrypted file used to do: encrypt into a temporary copy first
+        QElapsedTimer clock;
+        clock.start();
+        server.reset(&clock);
+        QFile input(inputPath);
+        QFile encrypted(QDir::tempPath() + QStringLiteral("/") + QString::fromLatin1(EncryptionHelper::generateRandomFilename()));
+        QByteArray tag;
+        ok = EncryptionHelper::fileEncryption(key, iv, &input, &encrypted, tag) && ok;
+        input.close();
+        encrypted.close();
+        const auto peakDisk = encrypted.size();
+        ok = encrypted.open(QIODevice::ReadOnly) && upload(qnam, server.url(), &encrypted) && ok;
+        encrypted.close();
+        encrypted.remove();
+        qDebug() << "MODE temporary copy TTFB" << server.firstByteAt() << "ms TOTAL" << clock.elapsed() << "ms EXTRA DISK" << peakDisk << "bytes SENT" << server.received();
+    }
+
+    {
+        QElapsedTimer clock;
+        clock.start();
+        server.reset(&clock);
+        const auto parameters = StreamingEncryptor::prepare(inputPath, key, iv);
+        ok = parameters.has_value() && ok;
+        if (parameters) {
+            StreamingEncryptor encryptor(*parameters);
+            ok = encryptor.open(QIODevice::ReadOnly) && upload(qnam, server.url(), &encryptor) && ok;
+        }
+        qDebug() << "MODE streaming TTFB" << server.firstByteAt() << "ms TOTAL" << clock.elapsed() << "ms EXTRA DISK" << 0 << "bytes SENT" << server.received();
+    }
+
+    return ok ? 0 : -1;
+}
@@ -0,0 +1,129 @@
+/*
+ * SPDX-FileCopyrightText: 2026 Nextcloud GmbH and Nextcloud contributors
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * This software is in the public domain, furnished "as is", without technical
+ * support, and with no warranty, express or implied, as to its usefulness for
+ * any purpose.
+ */
+
+#include "config_csync.h"
+#include "csync_exclude.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QRandomGenerator>
+#include <QRegularExpression>
+
+#define EXCLUDE_LIST_FILE SOURCEDIR "/../../sync-exclude.lst"
+
+namespace {
+
+// Mostly ordinary names, with a few of the kind the shipped list excludes
+QStringList syntheticPaths(int count)
+{
+    const QStringList stems = {
+        QStringLiteral("report"), QStringLiteral("IMG_2041"), QStringLiteral("notes"), QStringLiteral("main"),
+        QStringLiteral("Budget 2026"), QStringLiteral("index"), QStringLiteral("README"), QStringLiteral("photo"),
+    };
+    const QStringList extensions = {
+        QStringLiteral(".txt"), QStringLiteral(".jpg"), QStringLiteral(".cpp"), QStringLiteral(".docx"),
+        QStringLiteral(".pdf"), QStringLiteral(".md"), QStringLiteral(""), QStringLiteral(".tar.gz"),
+    };
+    const QStringList excluded = {
+        QStringLiteral(".DS_Store"), QStringLiteral("Thumbs.db"), QStringLiteral("~$report.docx"), QStringLiteral("notes.txt~"),
+        QStringLiteral("movie.mkv.part"), QStringLiteral(".~lock.budget.ods#"), QStringLiteral(".main.cpp.swp"), QStringLiteral("._photo.jpg"),
+    };
+
+    QRandomGenerator random(42);
+    QStringList paths;
+    paths.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        QString path = QStringLiteral("dir%1/sub%2/").arg(random.bounded(10)).arg(random.bounded(10));
+        if (random.bounded(10) == 0) {
+            path += excluded.at(random.bounded(excluded.size()));
+        } else {
+            path += stems.at(random.bounded(stems.size())) + QString::number(i % 100) + extensions.at(random.bounded(extensions.size()));
+        }
+        paths.append(path);
+    }
+    return paths;
+}
+
+// Roughly what every traversal check used to do: one anchored alternation of all bname patterns
+QRegularExpression combinedRegex(const QString &excludeListFile)
+{
+    QFile file(excludeListFile);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return {};
+    }
+    QStringList alternatives;
+    while (!file.atEnd()) {
+        auto pattern = QString::fromUtf8(file.readLine()).trimmed();
+        if (pattern.isEmpty() || pattern.startsWith(QLatin1Char('#'))) {
+            continue;
+        }
+        if (pattern.startsWith(QLatin1Char(']'))) {
+            pattern.remove(0, 1);
+        }
+        if (pattern.endsWith(QLatin1Char('/'))) {
+            pattern.chop(1);
+        }
+        if (pattern.contains(QLatin1Char('/'))) {
+            continue;
+        }
+        alternatives.append(QRegularExpression::wildcardToRegularExpression(pattern, QRegularExpression::UnanchoredWildcardConversion));
+    }
+    QRegularExpression regex(QStringLiteral("^(?:%1)$").arg(alternatives.join(QLatin1Char('|'))));
+    regex.optimize();
+    return regex;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    // Usage: ExcludedFilesBench [paths] [exclude list]
+    const auto args = app.arguments();
+    const auto count = args.size() > 1 ? args.at(1).toInt() : 2000000;
+    const auto excludeListFile = args.size() > 2 ? args.at(2) : QStringLiteral(EXCLUDE_LIST_FILE);
+
+    ExcludedFiles excludedFiles;
+    excludedFiles.addExcludeFilePath(excludeListFile);
+    if (!excludedFiles.reloadExcludeFiles()) {
+        qWarning() << "Could not load" << excludeListFile;
+        return -1;
+    }
+    qDebug() << "PATTERNS" << excludedFiles.activeExcludePatterns().size();
+
+    const auto paths = syntheticPaths(count);
+    qDebug() << "PATHS" << paths.size();
+
+    QElapsedTimer timer;
+    timer.start();
+    qint64 excludedCount = 0;
+    for (const auto &path : paths) {
+        if (excludedFiles.traversalPatternMatch(path, ItemTypeFile) != CSYNC_NOT_EXCLUDED) {
+            ++excludedCount;
+        }
+    }
+    auto elapsedNs = timer.nsecsElapsed();
+    qDebug() << "MODE traversal EXCLUDED" << excludedCount << "NS PER PATH" << elapsedNs / qMax(1, count);
+
+    const auto regex = combinedRegex(excludeListFile);
+    timer.restart();
+    qint64 regexExcludedCount = 0;
+    for (const auto &path : paths) {
+        if (regex.matchView(QStringView(path).sliced(path.lastIndexOf(QLatin1Char('/')) + 1)).hasMatch()) {
+            ++regexExcludedCount;
+        }
+    }
+    elapsedNs = timer.nsecsElapsed();
+    qDebug() << "MODE single regex EXCLUDED" << regexExcludedCount << "NS PER PATH" << elapsedNs / qMax(1, count);
+
+    return excludedCount > 0 ? 0 : -1;
+}
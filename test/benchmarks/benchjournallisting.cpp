@@ -0,0 +1,146 @@
+/*
+ * SPDX-FileCopyrightText: 2026 Nextcloud GmbH and Nextcloud contributors
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * This software is in the public domain, furnished "as is", without technical
+ * support, and with no warranty, express or implied, as to its usefulness for
+ * any purpose.
+ */
+
+#include "common/ownsql.h"
+#include "common/syncjournaldb.h"
+#include "common/syncjournalfilerecord.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+
+#include <sqlite3.h>
+
+#include <algorithm>
+#include <cstring>
+
+using namespace OCC;
+
+namespace {
+
+constexpr auto filesPerFolder = 100;
+constexpr auto foldersPerTop = 100;
+
+// The expression the former metadata_parent index was built on
+void registerParentHashFunction(SqlDatabase &db)
+{
+    sqlite3_create_function(db.sqliteDb(), "parent_hash", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, nullptr,
+        [](sqlite3_context *ctx, int, sqlite3_value **argv) {
+            const auto text = reinterpret_cast<const char *>(sqlite3_value_text(argv[0]));
+            const char *end = std::strrchr(text, '/');
+            sqlite3_result_int64(ctx, SyncJournalDb::getPHash(QByteArray(text, end ? end - text : 0)));
+        },
+        nullptr, nullptr);
+}
+
+SyncJournalFileRecord makeRecord(const QByteArray &path, ItemType type)
+{
+    SyncJournalFileRecord record;
+    record._path = path;
+    record._type = type;
+    record._etag = "etag";
+    record._modtime = 1;
+    record._remotePerm = RemotePermissions::fromDbValue("RW");
+    return record;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    // Usage: JournalListingBench [files]
+    // Compares the listings with the stored parentPhash and pathSortKey columns
+    // against the former parent_hash(path) expression index and path||'/' ordering.
+    // Pass 2000000 for a large journal.
+    const auto args = app.arguments();
+    const auto rows = args.size() > 1 ? args.at(1).toInt() : 20000;
+
+    QTemporaryDir dir;
+    const auto dbPath = dir.filePath(QStringLiteral("listing.db"));
+    SyncJournalDb journal(dbPath);
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < rows; ++i) {
+        const QByteArray top = "t" + QByteArray::number(i / (filesPerFolder * foldersPerTop));
+        const QByteArray folder = top + "/s" + QByteArray::number(i / filesPerFolder % foldersPerTop);
+        auto ok = true;
+        if (i % (filesPerFolder * foldersPerTop) == 0) {
+            ok = static_cast<bool>(journal.setFileRecord(makeRecord(top, ItemTypeDirectory)));
+        }
+        if (i % filesPerFolder == 0) {
+            ok = static_cast<bool>(journal.setFileRecord(makeRecord(folder, ItemTypeDirectory))) && ok;
+        }
+        ok = static_cast<bool>(journal.setFileRecord(makeRecord(folder + "/f" + QByteArray::number(i % filesPerFolder), ItemTypeFile))) && ok;
+        if (!ok) {
+            qWarning() << "Could not write the journal";
+            return -1;
+        }
+    }
+    journal.commit(QStringLiteral("listing"));
+    qDebug() << "FILES" << rows << "INSERTED IN" << timer.elapsed() << "ms";
+
+    const auto topCount = std::max(1, rows / (filesPerFolder * foldersPerTop));
+    QByteArrayList folders;
+    for (int i = 0; i < 200; ++i) {
+        folders.append("t" + QByteArray::number(i % topCount) + "/s" + QByteArray::number(i * 37 % foldersPerTop));
+    }
+
+    qint64 listed = 0;
+    qint64 below = 0;
+    auto ok = true;
+    timer.restart();
+    for (const auto &folder : std::as_const(folders)) {
+        ok = journal.listFilesInPath(folder, [&listed](const SyncJournalFileRecord &) { ++listed; }) && ok;
+    }
+    const auto listMs = timer.restart();
+    ok = journal.getFilesBelowPath("t0", [&below](const SyncJournalFileRecord &) { ++below; }) && ok;
+    const auto belowMs = timer.elapsed();
+    journal.close();
+    qDebug() << "COLUMNS LIST" << folders.size() << "FOLDERS" << listMs << "ms SUBTREE OF t0" << belowMs << "ms";
+
+    SqlDatabase db;
+    if (!db.openOrCreateReadWrite(dbPath)) {
+        qWarning() << "Could not open" << dbPath << db.error();
+        return -1;
+    }
+    registerParentHashFunction(db);
+    SqlQuery index("CREATE INDEX metadata_parent ON metadata(parent_hash(path));", db);
+    ok = index.exec() && ok;
+
+    qint64 oldListed = 0;
+    qint64 oldBelow = 0;
+    timer.restart();
+    SqlQuery list("SELECT path FROM metadata WHERE parent_hash(path) = ?1 ORDER BY path||'/' ASC", db);
+    for (const auto &folder : std::as_const(folders)) {
+        list.reset_and_clear_bindings();
+        list.bindValue(1, SyncJournalDb::getPHash(folder));
+        ok = list.exec() && ok;
+        while (list.next().hasData) {
+            ++oldListed;
+        }
+    }
+    const auto oldListMs = timer.restart();
+    SqlQuery subtree("SELECT path FROM metadata WHERE (path > ('t0'||'/') AND path < ('t0'||'0')) ORDER BY path||'/' ASC", db);
+    ok = subtree.exec() && ok;
+    while (subtree.next().hasData) {
+        ++oldBelow;
+    }
+    const auto oldBelowMs = timer.elapsed();
+    qDebug() << "EXPRESSION INDEX LIST" << folders.size() << "FOLDERS" << oldListMs << "ms SUBTREE OF t0" << oldBelowMs << "ms";
+
+    if (!ok || listed != oldListed || below != oldBelow) {
+        qWarning() << "The listings differ:" << listed << oldListed << below << oldBelow;
+        return -1;
+    }
+    return 0;
+}
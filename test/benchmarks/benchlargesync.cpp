@@ -9,6 +9,7 @@
  */
 
 #include "syncenginetestutils.h"
+#include "common/syncjournalsnapshot.h"
 #include <syncengine.h>
 
 using namespace OCC;
@@ -16,6 +17,9 @@ using namespace OCC;
 int numDirs = 0;
 int numFiles = 0;
 
+constexpr auto concurrentFolderCount = 3;
+constexpr auto journalRecordCount = 500000;
+
 template<int filesPerDir, int dirPerDir, int maxDepth>
 void addBunchOfFiles(int depth, const QString &path, FileModifier &fi) {
     for (int fileNum = 1; fileNum <= filesPerDir; ++fileNum) {
@@ -48,5 +52,156 @@ int main(int argc, char *argv[])
     qDebug() << "FIRST SYNC: " << result1 << timer.restart();
     bool result2 = fakeFolder.syncOnce();
     qDebug() << "SECOND SYNC: " << result2 << timer.restart();
-    return (result1 && result2) ? 0 : -1;
+
+    // Nothing changed again, discovery reads the journal from a snapshot
+    auto options = fakeFolder.syncEngine().syncOptions();
+    options._journalSnapshotDiscovery = true;
+    fakeFolder.syncEngine().setSyncOptions(options);
+    bool result2Snapshot = fakeFolder.syncOnce();
+    qDebug() << "SECOND SYNC, NOTHING CHANGED, JOURNAL SNAPSHOT: " << result2Snapshot << timer.restart();
+    options._journalSnapshotDiscovery = false;
+    fakeFolder.syncEngine().setSyncOptions(options);
+
+    // The journal reads of that discovery alone: one query per directory, or one snapshot
+    {
+        auto &journal = fakeFolder.syncJournal();
+        QByteArrayList directories = {QByteArray()};
+        result2Snapshot = journal.getFilesBelowPath({}, [&](const SyncJournalFileRecord &rec) {
+            if (rec.isDirectory()) {
+                directories.append(rec._path);
+            }
+        }) && result2Snapshot;
+
+        qint64 records = 0;
+        timer.restart();
+        for (const auto &directory : std::as_const(directories)) {
+            result2Snapshot = journal.listFilesInPath(directory, [&](const SyncJournalFileRecord &) { ++records; }) && result2Snapshot;
+        }
+        qDebug() << "JOURNAL QUERY PER DIRECTORY: " << records << "records in" << timer.restart() << "ms";
+
+        SyncJournalSnapshot snapshot;
+        result2Snapshot = snapshot.load(journal) && result2Snapshot;
+        const auto loadTime = timer.restart();
+        records = 0;
+        for (const auto &directory : std::as_const(directories)) {
+            snapshot.listFilesInPath(directory, [&](const SyncJournalFileRecord &) { ++records; });
+        }
+        qDebug() << "JOURNAL SNAPSHOT: " << records << "records, loaded in" << loadTime << "ms, listed in" << timer.restart() << "ms,"
+                 << snapshot.memoryUsage() << "bytes," << (records ? snapshot.memoryUsage() / records : 0) << "bytes per record";
+    }
+
+    // Several folders with a fresh initial sync each: one after the other, then all at once
+    auto makeFolders = [] {
+        std::vector<std::unique_ptr<FakeFolder>> folders;
+        for (int i = 0; i < concurrentFolderCount; ++i) {
+            folders.push_back(std::make_unique<FakeFolder>(FileInfo{}));
+            addBunchOfFiles<10, 8, 3>(0, "", folders.back()->remoteModifier());
+        }
+        return folders;
+    };
+
+    bool result3 = true;
+    {
+        auto folders = makeFolders();
+        SyncEngine::setMaxConcurrentSyncs(1);
+        timer.restart();
+        for (const auto &folder : folders) {
+            result3 = folder->syncOnce() && result3;
+        }
+        qDebug() << "SERIAL SYNC OF" << concurrentFolderCount << "FOLDERS: " << result3 << timer.restart();
+    }
+
+    bool result4 = true;
+    {
+        auto folders = makeFolders();
+        SyncEngine::setMaxConcurrentSyncs(concurrentFolderCount);
+        std::vector<std::unique_ptr<QSignalSpy>> spies;
+        timer.restart();
+        for (const auto &folder : folders) {
+            spies.push_back(std::make_unique<QSignalSpy>(&folder->syncEngine(), &SyncEngine::finished));
+            folder->scheduleSync();
+        }
+        for (const auto &spy : spies) {
+            if (spy->isEmpty() && !spy->wait(3600000)) {
+                result4 = false;
+                continue;
+            }
+            result4 = spy->first().first().toBool() && result4;
+        }
+        qDebug() << "CONCURRENT SYNC OF" << concurrentFolderCount << "FOLDERS: " << result4 << timer.restart();
+        SyncEngine::setMaxConcurrentSyncs(1);
+    }
+
+    // The journal writes of a sync of 500k files: executed one by one, and queued
+    bool result5 = true;
+    {
+        auto writeRecords = [&](bool executeEach) {
+            QTemporaryDir dir;
+            SyncJournalDb journal(dir.path() + QStringLiteral("/journal.db"));
+            SyncJournalFileRecord record;
+            record._type = ItemTypeFile;
+            record._etag = "etag";
+            record._remotePerm = RemotePermissions::fromDbValue("RW");
+            record._checksumHeader = "SHA1:da39a3ee5e6b4b0d3255bfef95601890afd80709";
+            record._modtime = QDateTime::currentSecsSinceEpoch();
+            QElapsedTimer writeTimer;
+            writeTimer.start();
+            for (int i = 0; i < journalRecordCount; ++i) {
+                record._path = "dir" + QByteArray::number(i / 1000) + "/file" + QByteArray::number(i % 1000);
+                record._fileId = QByteArray::number(i);
+                result5 = static_cast<bool>(journal.setFileRecord(record)) && result5;
+                if (executeEach) {
+                    // Opening an open journal executes the queued writes
+                    result5 = journal.open() && result5;
+                }
+                if (i % 10000 == 0) {
+                    journal.commitIfNeededAndStartNewTransaction(QStringLiteral("benchmark"));
+                }
+            }
+            journal.commit(QStringLiteral("benchmark"));
+            result5 = journal.getFileRecordCount() == journalRecordCount && result5;
+            return writeTimer.elapsed();
+        };
+        const auto executedEach = writeRecords(true);
+        const auto queued = writeRecords(false);
+        qDebug() << "JOURNAL WRITES OF" << journalRecordCount << "FILES: " << result5 << "one by one" << executedEach << "ms, queued" << queued << "ms";
+    }
+
+    // An initial download: when the first byte arrives and when the sync is done,
+    // once after the whole discovery and once streaming discovered subtrees
+    bool result7 = true;
+    for (const auto streaming : {false, true}) {
+        FakeFolder folder{FileInfo{}};
+        addBunchOfFiles<10, 8, 3>(0, "", folder.remoteModifier());
+        auto options = folder.syncEngine().syncOptions();
+        options._streamingPropagation = streaming;
+        folder.syncEngine().setSyncOptions(options);
+
+        qint64 firstByte = -1;
+        QObject::connect(&folder.syncEngine(), &SyncEngine::transmissionProgress, [&](const ProgressInfo &progress) {
+            if (firstByte < 0 && progress.completedSize() > 0) {
+                firstByte = timer.elapsed();
+            }
+        });
+        timer.restart();
+        result7 = folder.syncOnce() && result7;
+        const auto total = timer.restart();
+        result7 = folder.currentLocalState() == folder.currentRemoteState() && result7;
+        qDebug() << (streaming ? "STREAMING" : "NON-STREAMING") << "INITIAL DOWNLOAD: " << result7 << "first byte after" << firstByte << "ms, total" << total << "ms";
+    }
+
+    // A whole initial sync of about as many files takes long, run it on request
+    bool result6 = true;
+    if (!qEnvironmentVariableIsEmpty("OWNCLOUD_BENCHMARK_HUGE_SYNC")) {
+        numFiles = 0;
+        numDirs = 0;
+        FakeFolder hugeFolder{FileInfo{}};
+        addBunchOfFiles<14, 8, 5>(0, "", hugeFolder.remoteModifier());
+        qDebug() << "HUGE NUMFILES" << numFiles << "NUMDIRS" << numDirs;
+        timer.restart();
+        result6 = hugeFolder.syncOnce();
+        qDebug() << "HUGE FIRST SYNC: " << result6 << timer.restart();
+    }
+
+    return (result1 && result2 && result2Snapshot && result3 && result4 && result5 && result6 && result7) ? 0 : -1;
 }
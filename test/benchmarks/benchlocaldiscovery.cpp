@@ -0,0 +1,83 @@
+/*
+ * SPDX-FileCopyrightText: 2026 Nextcloud GmbH and Nextcloud contributors
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * This software is in the public domain, furnished "as is", without technical
+ * support, and with no warranty, express or implied, as to its usefulness for
+ * any purpose.
+ */
+
+#include "syncenginetestutils.h"
+#include <syncengine.h>
+
+using namespace OCC;
+
+namespace {
+
+int numDirs = 0;
+int numFiles = 0;
+
+void addBunchOfFiles(int depth, int maxDepth, const QString &path, FileModifier &fi)
+{
+    constexpr auto filesPerDir = 20;
+    constexpr auto dirPerDir = 6;
+    for (int fileNum = 1; fileNum <= filesPerDir; ++fileNum) {
+        const QString name = QStringLiteral("file") + QString::number(fileNum);
+        fi.insert(path.isEmpty() ? name : path + "/" + name, 1);
+        numFiles++;
+    }
+    if (depth >= maxDepth)
+        return;
+    for (int dirNum = 1; dirNum <= dirPerDir; ++dirNum) {
+        const QString name = QStringLiteral("dir") + QString::number(dirNum);
+        const QString subPath = path.isEmpty() ? name : path + "/" + name;
+        fi.mkdir(subPath);
+        numDirs++;
+        addBunchOfFiles(depth + 1, maxDepth, subPath, fi);
+    }
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    // Usage: LocalDiscoveryBench [depth] [threads...]
+    // Syncs a tree that exists on disk and on the server without changes, so
+    // the time is spent listing local directories and merging them with the db.
+    const auto args = app.arguments();
+    const auto maxDepth = args.size() > 1 ? args.at(1).toInt() : 4;
+    QVector<int> threadCounts;
+    for (int i = 2; i < args.size(); ++i) {
+        threadCounts.append(args.at(i).toInt());
+    }
+    if (threadCounts.isEmpty()) {
+        threadCounts = {1, 2, 4, QThread::idealThreadCount()};
+    }
+
+    FileInfo tree;
+    addBunchOfFiles(0, maxDepth, QString(), tree);
+    qDebug() << "NUMFILES" << numFiles;
+    qDebug() << "NUMDIRS" << numDirs;
+
+    QElapsedTimer timer;
+    timer.start();
+    FakeFolder fakeFolder{tree};
+    qDebug() << "INITIAL SYNC: " << timer.restart();
+
+    auto result = true;
+    for (const auto threads : std::as_const(threadCounts)) {
+        auto options = fakeFolder.syncEngine().syncOptions();
+        options._parallelLocalScanJobs = threads;
+        fakeFolder.syncEngine().setSyncOptions(options);
+
+        // Once to warm up the file system caches, then measured
+        result = fakeFolder.syncOnce() && result;
+        timer.restart();
+        result = fakeFolder.syncOnce() && result;
+        qDebug() << "NOTHING CHANGED, LOCAL SCAN THREADS" << threads << ": " << timer.restart();
+    }
+
+    return result ? 0 : -1;
+}
@@ -0,0 +1,176 @@
+/*
+ * SPDX-FileCopyrightText: 2026 Nextcloud GmbH and Nextcloud contributors
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * This software is in the public domain, furnished "as is", without technical
+ * support, and with no warranty, express or implied, as to its usefulness for
+ * any purpose.
+ */
+
+#include "csync.h"
+#include "vio/csync_vio_local.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTemporaryDir>
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <functional>
+
+#ifdef Q_OS_LINUX
+#include <csignal>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+void createTree(const QString &path, int depth, int maxDepth, int &entries)
+{
+    constexpr auto filesPerDir = 50;
+    constexpr auto dirPerDir = 5;
+    for (int fileNum = 1; fileNum <= filesPerDir; ++fileNum) {
+        QFile file(path + QStringLiteral("/file") + QString::number(fileNum));
+        if (file.open(QFile::WriteOnly)) {
+            file.write("x");
+        }
+        ++entries;
+    }
+    if (depth >= maxDepth) {
+        return;
+    }
+    for (int dirNum = 1; dirNum <= dirPerDir; ++dirNum) {
+        const QString subPath = path + QStringLiteral("/dir") + QString::number(dirNum);
+        QDir().mkdir(subPath);
+        ++entries;
+        createTree(subPath, depth + 1, maxDepth, entries);
+    }
+}
+
+// The csync_vio_local_readdir() implementation
+qint64 scanReaddir(const QString &path)
+{
+    auto dh = csync_vio_local_opendir(path);
+    if (!dh) {
+        return 0;
+    }
+    qint64 entries = 0;
+    QStringList subdirs;
+    while (auto dirent = csync_vio_local_readdir(dh, nullptr)) {
+        ++entries;
+        if (dirent->type == ItemTypeDirectory) {
+            subdirs.append(path + QLatin1Char('/') + QString::fromUtf8(dirent->path));
+        }
+    }
+    csync_vio_local_closedir(dh);
+    for (const auto &subdir : std::as_const(subdirs)) {
+        entries += scanReaddir(subdir);
+    }
+    return entries;
+}
+
+// What csync_vio_local_readdir() used to do: lstat() every entry by its full path
+qint64 scanFullPathStat(const QString &path)
+{
+    const auto dirname = QFile::encodeName(path);
+    auto dh = opendir(dirname.constData());
+    if (!dh) {
+        return 0;
+    }
+    qint64 entries = 0;
+    QStringList subdirs;
+    while (auto dirent = readdir(dh)) {
+        if (qstrcmp(dirent->d_name, ".") == 0 || qstrcmp(dirent->d_name, "..") == 0) {
+            continue;
+        }
+        const auto name = QFile::decodeName(dirent->d_name).toUtf8();
+        const QByteArray fullPath = dirname % '/' % QByteArray() % const_cast<const char *>(dirent->d_name);
+        struct stat sb;
+        if (lstat(fullPath.constData(), &sb) < 0) {
+            continue;
+        }
+        ++entries;
+        if (S_ISDIR(sb.st_mode)) {
+            subdirs.append(path + QLatin1Char('/') + QString::fromUtf8(name));
+        }
+    }
+    closedir(dh);
+    for (const auto &subdir : std::as_const(subdirs)) {
+        entries += scanFullPathStat(subdir);
+    }
+    return entries;
+}
+
+#ifdef Q_OS_LINUX
+// Runs work in a child process and counts the system calls it makes
+qint64 countSyscalls(const std::function<void()> &work)
+{
+    const auto pid = fork();
+    if (pid == 0) {
+        ptrace(PTRACE_TRACEME, 0, nullptr, nullptr);
+        raise(SIGSTOP);
+        work();
+        _exit(0);
+    }
+    if (pid < 0) {
+        return -1;
+    }
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    ptrace(PTRACE_SETOPTIONS, pid, nullptr, PTRACE_O_TRACESYSGOOD | PTRACE_O_EXITKILL);
+    qint64 stops = 0;
+    forever {
+        if (ptrace(PTRACE_SYSCALL, pid, nullptr, nullptr) < 0 || waitpid(pid, &status, 0) < 0 || WIFEXITED(status) || WIFSIGNALED(status)) {
+            break;
+        }
+        if (WIFSTOPPED(status) && WSTOPSIG(status) == (SIGTRAP | 0x80)) {
+            ++stops;
+        }
+    }
+    // Every system call stops once when entering and once when leaving
+    return stops / 2;
+}
+#endif
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    // Usage: LocalReaddirBench [depth]
+    const auto args = app.arguments();
+    const auto maxDepth = args.size() > 1 ? args.at(1).toInt() : 4;
+
+    QTemporaryDir dir;
+    int created = 0;
+    createTree(dir.path(), 0, maxDepth, created);
+    qDebug() << "ENTRIES" << created;
+
+    const std::pair<const char *, std::function<qint64(const QString &)>> scanners[] = {
+        {"readdir", scanReaddir},
+        {"full path lstat", scanFullPathStat},
+    };
+    auto ok = true;
+    for (const auto &[name, scan] : scanners) {
+        // Once to warm up the file system caches, then measured
+        scan(dir.path());
+        QElapsedTimer timer;
+        timer.start();
+        const auto entries = scan(dir.path());
+        const auto elapsedNs = timer.nsecsElapsed();
+        ok = ok && entries == created;
+        qDebug() << "MODE" << name << "ENTRIES" << entries << "NS PER ENTRY" << (entries ? elapsedNs / entries : 0);
+#ifdef Q_OS_LINUX
+        const auto syscalls = countSyscalls([&scan, &dir] { scan(dir.path()); });
+        qDebug() << "MODE" << name << "SYSCALLS" << syscalls << "PER ENTRY" << (created ? double(syscalls) / created : 0.0);
+#endif
+    }
+    return ok ? 0 : -1;
+}
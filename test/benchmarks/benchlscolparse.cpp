@@ -0,0 +1,143 @@
+/*
+ * SPDX-FileCopyrightText: 2026 Nextcloud GmbH and Nextcloud contributors
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * This software is in the public domain, furnished "as is", without technical
+ * support, and with no warranty, express or implied, as to its usefulness for
+ * any purpose.
+ */
+
+#include "networkjobs.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+using namespace OCC;
+
+namespace {
+
+constexpr auto chunkSize = 16 * 1024;
+const auto expectedPath = QStringLiteral("/remote.php/dav/files/admin/big");
+
+QByteArray header()
+{
+    return QByteArrayLiteral("<?xml version=\"1.0\"?>\n"
+                             "<d:multistatus xmlns:d=\"DAV:\" xmlns:s=\"http://sabredav.org/ns\" xmlns:oc=\"http://owncloud.org/ns\" xmlns:nc=\"http://nextcloud.org/ns\">");
+}
+
+QByteArray entry(int i)
+{
+    const auto name = i == 0 ? QByteArray() : QByteArrayLiteral("file") + QByteArray::number(i) + QByteArrayLiteral(".txt");
+    return QByteArrayLiteral("<d:response><d:href>/remote.php/dav/files/admin/big/") + name + QByteArrayLiteral("</d:href>"
+           "<d:propstat><d:prop>"
+           "<d:getlastmodified>Fri, 06 Feb 2015 13:49:55 GMT</d:getlastmodified>"
+           "<d:getcontentlength>") + QByteArray::number(i * 13) + QByteArrayLiteral("</d:getcontentlength>"
+           "<d:resourcetype/>"
+           "<d:getetag>&quot;") + QByteArray::number(i, 16) + QByteArrayLiteral("&quot;</d:getetag>"
+           "<oc:id>") + QByteArray::number(i) + QByteArrayLiteral("ocobzus5kn6s</oc:id>"
+           "<oc:fileid>") + QByteArray::number(i) + QByteArrayLiteral("</oc:fileid>"
+           "<oc:permissions>RGDNVW</oc:permissions>"
+           "<oc:checksums><oc:checksum>SHA1:da39a3ee5e6b4b0d3255bfef95601890afd80709</oc:checksum></oc:checksums>"
+           "<nc:is-encrypted>0</nc:is-encrypted>"
+           "</d:prop><d:status>HTTP/1.1 200 OK</d:status></d:propstat>"
+           "<d:propstat><d:prop><oc:downloadURL/><oc:dDC/></d:prop><d:status>HTTP/1.1 404 Not Found</d:status></d:propstat>"
+           "</d:response>");
+}
+
+QByteArray footer()
+{
+    return QByteArrayLiteral("</d:multistatus>");
+}
+
+// Produces the body piecewise, like a network reply would
+class BodyGenerator
+{
+public:
+    explicit BodyGenerator(int entries)
+        : _entries(entries)
+    {
+        _pending = header();
+    }
+
+    [[nodiscard]] bool atEnd() const { return _next > _entries && _pending.isEmpty(); }
+
+    QByteArray read()
+    {
+        while (_pending.size() < chunkSize && _next <= _entries) {
+            _pending += _next < _entries ? entry(_next) : footer();
+            ++_next;
+        }
+        const auto chunk = _pending.left(chunkSize);
+        _pending.remove(0, chunk.size());
+        return chunk;
+    }
+
+private:
+    int _entries;
+    int _next = 0;
+    QByteArray _pending;
+};
+
+long peakRssKb()
+{
+#ifdef Q_OS_UNIX
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+#else
+    return -1;
+#endif
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    // Usage: LsColParseBench [streaming|buffered] [entries]
+    // Run each mode in its own process to compare the peak RSS.
+    const auto args = app.arguments();
+    const auto streaming = args.size() < 2 || args.at(1) != QStringLiteral("buffered");
+    const auto entries = args.size() > 2 ? args.at(2).toInt() : 200000;
+
+    LsColXMLParser parser;
+    QHash<QString, ExtraFolderInfo> folderInfos;
+    qint64 entryCount = 0;
+    qint64 timeToFirstEntry = -1;
+    QElapsedTimer timer;
+    QObject::connect(&parser, &LsColXMLParser::directoryListingIterated, &parser, [&](const QString &, const QMap<QString, QString> &) {
+        if (entryCount++ == 1) { // the first entry is the folder itself
+            timeToFirstEntry = timer.elapsed();
+        }
+    });
+
+    BodyGenerator body(entries);
+    auto ok = true;
+    timer.start();
+    if (streaming) {
+        parser.beginParse(expectedPath, &folderInfos);
+        while (ok && !body.atEnd()) {
+            ok = parser.addData(body.read());
+        }
+        ok = ok && parser.endParse();
+    } else {
+        QByteArray wholeReply;
+        while (!body.atEnd()) {
+            wholeReply += body.read();
+        }
+        ok = parser.parse(wholeReply, &folderInfos, expectedPath);
+    }
+    const auto totalTime = timer.elapsed();
+
+    qDebug() << "MODE" << (streaming ? "streaming" : "buffered") << "ENTRIES" << entryCount << "OK" << ok;
+    qDebug() << "TIME TO FIRST ENTRY (ms)" << timeToFirstEntry;
+    qDebug() << "TOTAL TIME (ms)" << totalTime;
+    qDebug() << "PEAK RSS (KiB)" << peakRssKb();
+    return ok ? 0 : -1;
+}
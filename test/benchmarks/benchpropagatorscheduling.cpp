@@ -0,0 +1,55 @@
+/*
+ * SPDX-FileCopyrightText: 2026 Nextcloud GmbH and Nextcloud contributors
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * This software is in the public domain, furnished "as is", without technical
+ * support, and with no warranty, express or implied, as to its usefulness for
+ * any purpose.
+ */
+
+#include "syncenginetestutils.h"
+#include <syncengine.h>
+
+using namespace OCC;
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    // Usage: PropagatorSchedulingBench [number of files] [files per directory]
+    // Empty files leave nothing but the scheduling of the propagation jobs to measure.
+    const auto args = app.arguments();
+    const auto fileCount = args.size() > 1 ? args.at(1).toInt() : 1000000;
+    const auto filesPerDir = args.size() > 2 ? qMax(1, args.at(2).toInt()) : 1000;
+    qDebug() << "NUMFILES" << fileCount << "FILES PER DIRECTORY" << filesPerDir;
+
+    FakeFolder fakeFolder{FileInfo{}};
+    for (int fileNum = 0; fileNum < fileCount; ++fileNum) {
+        const QString dir = QStringLiteral("dir") + QString::number(fileNum / filesPerDir);
+        if (fileNum % filesPerDir == 0) {
+            fakeFolder.remoteModifier().mkdir(dir);
+        }
+        fakeFolder.remoteModifier().insert(dir + QStringLiteral("/file") + QString::number(fileNum), 0);
+    }
+
+    QElapsedTimer timer;
+    qint64 discoveryMs = 0;
+    int completedFiles = 0;
+    timer.start();
+    QObject::connect(&fakeFolder.syncEngine(), &SyncEngine::aboutToPropagate, &fakeFolder.syncEngine(), [&](const SyncFileItemVector &) {
+        discoveryMs = timer.restart();
+    });
+    QObject::connect(&fakeFolder.syncEngine(), &SyncEngine::itemCompleted, &fakeFolder.syncEngine(), [&](const SyncFileItemPtr &item, ErrorCategory) {
+        if (!item->isDirectory() && item->_status == SyncFileItem::Success) {
+            ++completedFiles;
+        }
+    });
+
+    const auto result = fakeFolder.syncOnce();
+    const auto propagationMs = timer.elapsed();
+    qDebug() << "DISCOVERY:" << discoveryMs << "ms";
+    qDebug() << "PROPAGATION:" << result << completedFiles << "files in" << propagationMs << "ms,"
+             << (propagationMs > 0 ? completedFiles * 1000LL / propagationMs : qint64{completedFiles}) << "files/s";
+
+    return result && completedFiles == fileCount ? 0 : 1;
+}
@@ -0,0 +1,74 @@
+/*
+ * SPDX-FileCopyrightText: 2026 Nextcloud GmbH and Nextcloud contributors
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * This software is in the public domain, furnished "as is", without technical
+ * support, and with no warranty, express or implied, as to its usefulness for
+ * any purpose.
+ */
+
+#include "syncenginetestutils.h"
+#include <syncengine.h>
+
+using namespace OCC;
+
+namespace {
+
+// Bytes a GET asks for, all of the file without a Range header
+qint64 requestedBytes(const QNetworkRequest &request, qint64 fileSize)
+{
+    static const QRegularExpression bytesPattern(QStringLiteral("^bytes=(\\d+)-(\\d*)$"));
+    const auto match = bytesPattern.match(QString::fromUtf8(request.rawHeader("Range")));
+    if (!match.hasMatch()) {
+        return fileSize;
+    }
+    const auto start = match.captured(1).toLongLong();
+    const auto end = match.captured(2).isEmpty() ? fileSize - 1 : match.captured(2).toLongLong();
+    return end - start + 1;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    // Usage: SegmentedDownloadBench [size in MiB] [latency in ms] [MiB/s per connection]
+    // Every request takes the latency plus its size at the rate of a single
+    // connection, like a TCP stream limited by its window on a long path.
+    const auto args = app.arguments();
+    const auto sizeMiB = args.size() > 1 ? args.at(1).toLongLong() : 256;
+    const auto latencyMs = args.size() > 2 ? args.at(2).toLongLong() : 100;
+    const auto rateMiB = args.size() > 3 ? args.at(3).toLongLong() : 16;
+    const auto size = sizeMiB * 1024 * 1024;
+    qDebug() << "FILE SIZE" << sizeMiB << "MiB LATENCY" << latencyMs << "ms RATE PER CONNECTION" << rateMiB << "MiB/s";
+
+    auto ok = true;
+    for (const auto segments : {1, 2, 4, 8}) {
+        FakeFolder fakeFolder{FileInfo{}};
+        auto options = fakeFolder.syncEngine().syncOptions();
+        options._downloadSegments = segments;
+        options._minSegmentedDownloadSize = 0;
+        fakeFolder.syncEngine().setSyncOptions(options);
+        fakeFolder.remoteModifier().insert(QStringLiteral("big"), size);
+
+        int requests = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op != QNetworkAccessManager::GetOperation) {
+                return nullptr;
+            }
+            ++requests;
+            const auto delayMs = latencyMs + requestedBytes(request, size) * 1000 / (rateMiB * 1024 * 1024);
+            return new DelayedReply<FakeGetReply>(delayMs, fakeFolder.remoteModifier(), op, request, &fakeFolder.syncEngine());
+        });
+
+        QElapsedTimer timer;
+        timer.start();
+        const auto result = fakeFolder.syncOnce();
+        const auto elapsedMs = qMax(qint64(1), timer.elapsed());
+        ok = ok && result && QFileInfo(fakeFolder.localPath() + QStringLiteral("big")).size() == size;
+        qDebug() << "SEGMENTS" << segments << "REQUESTS" << requests << "TOTAL" << elapsedMs << "ms THROUGHPUT" << sizeMiB * 1000 / elapsedMs << "MiB/s";
+    }
+
+    return ok ? 0 : -1;
+}
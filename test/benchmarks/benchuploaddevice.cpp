@@ -0,0 +1,156 @@
+/*
+ * SPDX-FileCopyrightText: 2026 Nextcloud GmbH and Nextcloud contributors
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * This software is in the public domain, furnished "as is", without technical
+ * support, and with no warranty, express or implied, as to its usefulness for
+ * any purpose.
+ */
+
+#include "propagateupload.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QRandomGenerator>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTemporaryDir>
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+using namespace OCC;
+
+namespace {
+
+// Accepts PUTs, drops their bodies and answers each once it is complete
+class MockServer : public QObject
+{
+public:
+    MockServer()
+    {
+        connect(&_server, &QTcpServer::newConnection, this, [this] {
+            auto socket = _server.nextPendingConnection();
+            connect(socket, &QTcpSocket::readyRead, this, [this, socket] { onReadyRead(socket); });
+        });
+        _server.listen(QHostAddress::LocalHost);
+    }
+
+    [[nodiscard]] QUrl url() const { return QUrl(QStringLiteral("http://127.0.0.1:%1/upload").arg(_server.serverPort())); }
+    [[nodiscard]] qint64 received() const { return _received; }
+
+private:
+    void onReadyRead(QTcpSocket *socket)
+    {
+        auto data = socket->readAll();
+        if (!_headersDone) {
+            _headers += data;
+            const auto end = _headers.indexOf("\r\n\r\n");
+            if (end < 0) {
+                return;
+            }
+            _headersDone = true;
+            const auto lengthAt = _headers.toLower().indexOf("content-length:");
+            _expected = _headers.mid(lengthAt + 15, _headers.indexOf("\r\n", lengthAt) - lengthAt - 15).trimmed().toLongLong();
+            data = _headers.mid(end + 4);
+            _headers.clear();
+            _received = 0;
+        }
+        _received += data.size();
+        if (_received >= _expected) {
+            _headersDone = false;
+            socket->write("HTTP/1.1 201 Created\r\nContent-Length: 0\r\n\r\n");
+        }
+    }
+
+    QTcpServer _server;
+    QByteArray _headers;
+    bool _headersDone = false;
+    qint64 _expected = 0;
+    qint64 _received = 0;
+};
+
+bool upload(QNetworkAccessManager &qnam, const QUrl &url, QIODevice *device)
+{
+    QNetworkRequest request(url);
+    request.setHeader(QNetworkRequest::ContentLengthHeader, device->size());
+    request.setHeader(QNetworkRequest::ContentTypeHeader, QByteArrayLiteral("application/octet-stream"));
+    auto reply = qnam.put(request, device);
+    QEventLoop loop;
+    QObject::connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
+    loop.exec();
+    const auto ok = reply->error() == QNetworkReply::NoError;
+    if (!ok) {
+        qWarning() << "Upload failed" << reply->errorString();
+    }
+    reply->deleteLater();
+    return ok;
+}
+
+// User and system time of the whole process, the stand-in server included
+qint64 cpuTimeMs()
+{
+#ifdef Q_OS_UNIX
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    const auto toMs = [](const timeval &time) { return qint64(time.tv_sec) * 1000 + time.tv_usec / 1000; };
+    return toMs(usage.ru_utime) + toMs(usage.ru_stime);
+#else
+    return 0;
+#endif
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    // Usage: UploadDeviceBench [size in MiB] [repetitions]
+    const auto args = app.arguments();
+    const auto sizeMiB = args.size() > 1 ? args.at(1).toLongLong() : 1024;
+    const auto repetitions = args.size() > 2 ? args.at(2).toInt() : 3;
+    const auto size = sizeMiB * 1024 * 1024;
+
+    QTemporaryDir dir;
+    const auto inputPath = dir.filePath(QStringLiteral("input.bin"));
+    {
+        // Real data rather than a sparse file, holes are read without touching the disk
+        QFile input(inputPath);
+        if (!input.open(QIODevice::WriteOnly)) {
+            qWarning() << "Could not create" << inputPath;
+            return -1;
+        }
+        QByteArray block(1024 * 1024, Qt::Uninitialized);
+        QRandomGenerator::global()->fillRange(reinterpret_cast<quint32 *>(block.data()), block.size() / sizeof(quint32));
+        for (qint64 i = 0; i < sizeMiB; ++i) {
+            input.write(block);
+        }
+    }
+    qDebug() << "FILE SIZE" << sizeMiB << "MiB REPETITIONS" << repetitions;
+
+    MockServer server;
+    QNetworkAccessManager qnam;
+    auto ok = true;
+
+    const auto cpuBefore = cpuTimeMs();
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < repetitions; ++i) {
+        UploadDevice device(inputPath, 0, size, nullptr);
+        ok = device.open(QIODevice::ReadOnly) && ok;
+        ok = upload(qnam, server.url(), &device) && server.received() == size && ok;
+    }
+    const auto elapsedMs = qMax(qint64(1), timer.elapsed());
+    const auto cpuMs = cpuTimeMs() - cpuBefore;
+    const auto uploadedGiB = double(size) * repetitions / (1024 * 1024 * 1024);
+    qDebug() << "CPU" << qRound64(cpuMs / uploadedGiB) << "ms/GiB TOTAL" << elapsedMs << "ms THROUGHPUT"
+             << sizeMiB * repetitions * 1000 / elapsedMs << "MiB/s";
+
+    return ok ? 0 : -1;
+}
@@ -67,6 +67,14 @@ QWebSocket *FakeWebSocketServer::authenticateAccount(const OCC::AccountPtr accou
         return nullptr;
     }
 
+    // Once authenticated the ids of changed files are requested
+    if (textMessagesCount() < 3 && !waitForTextMessages()) {
+        return nullptr;
+    }
+    if (textMessage(2) != QStringLiteral("listen notify_file_id")) {
+        return nullptr;
+    }
+
     afterAuthentication();
 
     return socket;
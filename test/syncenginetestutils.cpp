@@ -452,9 +452,18 @@ FakePropfindReply::FakePropfindReply(FileInfo &remoteRootFileInfo, QNetworkAcces
         xml.writeEndElement(); // response
     };
 
+    // "Depth: infinity" lists the whole subtree, anything else just the direct children
+    const auto recursive = request.rawHeader("Depth") == "infinity";
+    std::function<void(const FileInfo &)> writeChildren = [&](const FileInfo &directory) {
+        for (const auto &childFileInfo : directory.children) {
+            writeFileResponse(childFileInfo);
+            if (recursive && childFileInfo.isDir) {
+                writeChildren(childFileInfo);
+            }
+        }
+    };
     writeFileResponse(*fileInfo);
-    foreach (const FileInfo &childFileInfo, fileInfo->children)
-        writeFileResponse(childFileInfo);
+    writeChildren(*fileInfo);
     xml.writeEndElement(); // multistatus
     xml.writeEndDocument();
 
@@ -771,6 +780,32 @@ void FakeMoveReply::respond()
     emit finished();
 }
 
+namespace {
+
+// Reads a "bytes=start-end" or "bytes=start-" Range header, the end is inclusive
+bool parseRangeHeader(const QNetworkRequest &request, qint64 total, qint64 &start, qint64 &end)
+{
+    if (!request.hasRawHeader("Range")) {
+        return false;
+    }
+    static const QRegularExpression bytesPattern(QStringLiteral("^bytes=(?<start>\\d+)-(?<end>\\d*)$"));
+    const auto match = bytesPattern.match(QString::fromUtf8(request.rawHeader("Range")));
+    if (!match.hasMatch()) {
+        return false;
+    }
+    start = match.captured(QStringLiteral("start")).toLongLong();
+    const auto endString = match.captured(QStringLiteral("end"));
+    end = endString.isEmpty() ? total - 1 : qMin(endString.toLongLong(), total - 1);
+    return start <= end;
+}
+
+QByteArray contentRange(qint64 start, qint64 end, qint64 total)
+{
+    return "bytes " + QByteArray::number(start) + '-' + QByteArray::number(end) + '/' + QByteArray::number(total);
+}
+
+}
+
 FakeGetReply::FakeGetReply(FileInfo &remoteRootFileInfo, QNetworkAccessManager::Operation op, const QNetworkRequest &request, QObject *parent)
     : FakeReply { parent }
 {
@@ -806,8 +841,16 @@ void FakeGetReply::respond()
     }
     payload = fileInfo->contentChar;
     size = fileInfo->size;
+    qint64 rangeStart = 0;
+    qint64 rangeEnd = 0;
+    if (parseRangeHeader(request(), size, rangeStart, rangeEnd)) {
+        setAttribute(QNetworkRequest::HttpStatusCodeAttribute, 206);
+        setRawHeader("Content-Range", contentRange(rangeStart, rangeEnd, size));
+        size = static_cast<int>(rangeEnd - rangeStart + 1);
+    } else {
+        setAttribute(QNetworkRequest::HttpStatusCodeAttribute, 200);
+    }
     setHeader(QNetworkRequest::ContentLengthHeader, size);
-    setAttribute(QNetworkRequest::HttpStatusCodeAttribute, 200);
     setRawHeader("OC-ETag", fileInfo->etag);
     setRawHeader("ETag", fileInfo->etag);
     setRawHeader("OC-FileId", fileInfo->fileId);
@@ -852,17 +895,6 @@ FakeGetWithDataReply::FakeGetWithDataReply(FileInfo &remoteRootFileInfo, const Q
     Q_ASSERT(!fileName.isEmpty());
     fileInfo = remoteRootFileInfo.find(fileName);
     QMetaObject::invokeMethod(this, "respond", Qt::QueuedConnection);
-
-    if (request.hasRawHeader("Range")) {
-        const QString range = QString::fromUtf8(request.rawHeader("Range"));
-        const QRegularExpression bytesPattern(QStringLiteral("bytes=(?<start>\\d+)-(?<end>\\d+)"));
-        const QRegularExpressionMatch match = bytesPattern.match(range);
-        if (match.hasMatch()) {
-            const int start = match.captured(QStringLiteral("start")).toInt();
-            const int end = match.captured(QStringLiteral("end")).toInt();
-            payload = payload.mid(start, end - start + 1);
-        }
-    }
 }
 
 void FakeGetWithDataReply::respond()
@@ -873,8 +905,16 @@ void FakeGetWithDataReply::respond()
         emit finished();
         return;
     }
+    qint64 rangeStart = 0;
+    qint64 rangeEnd = 0;
+    if (parseRangeHeader(request(), payload.size(), rangeStart, rangeEnd)) {
+        setAttribute(QNetworkRequest::HttpStatusCodeAttribute, 206);
+        setRawHeader("Content-Range", contentRange(rangeStart, rangeEnd, payload.size()));
+        payload = payload.mid(rangeStart, rangeEnd - rangeStart + 1);
+    } else {
+        setAttribute(QNetworkRequest::HttpStatusCodeAttribute, 200);
+    }
     setHeader(QNetworkRequest::ContentLengthHeader, payload.size());
-    setAttribute(QNetworkRequest::HttpStatusCodeAttribute, 200);
     setRawHeader("OC-ETag", fileInfo->etag);
     setRawHeader("ETag", fileInfo->etag);
     setRawHeader("OC-FileId", fileInfo->fileId);
@@ -1175,6 +1215,16 @@ QNetworkReply *FakeQNAM::createRequest(QNetworkAccessManager::Operation op, cons
             if (request.hasRawHeader(QByteArrayLiteral("X-OC-Mtime")) &&
                     request.rawHeader(QByteArrayLiteral("X-OC-Mtime")).toLongLong() <= 0) {
                 reply = new FakeErrorReply { op, request, this, 500 };
+            } else if (isUpload && request.hasRawHeader(QByteArrayLiteral("OC-Delta-Base-Offset"))) {
+                // The chunk is a range of the current version of the destination
+                const auto base = _remoteRootFileInfo.find(getFilePathFromUrl(QUrl::fromEncoded(request.rawHeader("Destination"))));
+                const auto offset = request.rawHeader(QByteArrayLiteral("OC-Delta-Base-Offset")).toLongLong();
+                const auto length = request.rawHeader(QByteArrayLiteral("OC-Delta-Base-Length")).toLongLong();
+                if (!base || offset < 0 || length <= 0 || offset + length > base->size) {
+                    reply = new FakeErrorReply { op, request, this, 412 };
+                } else {
+                    reply = new FakePutReply { info, op, newRequest, QByteArray(length, base->contentChar), this };
+                }
             } else {
                 reply = new FakePutReply { info, op, newRequest, outgoingData->readAll(), this };
             }
@@ -0,0 +1,309 @@
+/*
+ * SPDX-FileCopyrightText: 2026 Nextcloud GmbH and Nextcloud contributors
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * This software is in the public domain, furnished "as is", without technical
+ * support, and with no warranty, express or implied, as to its usefulness for
+ * any purpose.
+ */
+
+#include <QtTest>
+#include <QTemporaryDir>
+
+#include "account.h"
+#include "bandwidthmanager.h"
+#include "owncloudpropagator.h"
+#include "propagatedownload.h"
+#include "propagateupload.h"
+#include "common/syncjournaldb.h"
+
+#include <algorithm>
+#include <memory>
+#include <numeric>
+#include <vector>
+
+using namespace OCC;
+
+namespace {
+
+constexpr qint64 tickMsec = 100;
+
+// A propagator with the given absolute limits and a BandwidthManager on a simulated clock
+class Limits
+{
+public:
+    Limits(int uploadLimit, int downloadLimit)
+        : _journal(_dir.path() + QStringLiteral("/.sync_test.db"))
+        , _propagator(Account::create(), _dir.path(), QStringLiteral("/"), &_journal, _bulkUploadBlackList)
+    {
+        _propagator._uploadLimit = uploadLimit;
+        _propagator._downloadLimit = downloadLimit;
+        _manager = std::make_unique<BandwidthManager>(&_propagator, [this] { return _now; });
+    }
+
+    // An upload of a local file of the given size, opened like PUTFileJob does
+    std::unique_ptr<UploadDevice> createUpload(qint64 size)
+    {
+        const auto path = _dir.filePath(QStringLiteral("upload%1").arg(++_uploads));
+        QFile file(path);
+        if (!file.open(QIODevice::WriteOnly) || file.write(QByteArray(size, 'x')) != size) {
+            return {};
+        }
+        file.close();
+
+        auto device = std::make_unique<UploadDevice>(path, 0, size, _manager.get());
+        if (!device->open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+            return {};
+        }
+        return device;
+    }
+
+    // The next timer tick of the manager
+    void tick()
+    {
+        _now += tickMsec;
+        _manager->absoluteLimitTimerExpired();
+    }
+
+    void setUploadLimit(int uploadLimit)
+    {
+        _propagator._uploadLimit = uploadLimit;
+        _manager->switchingTimerExpired();
+    }
+
+    void advance(qint64 msec) { _now += msec; }
+    OwncloudPropagator &propagator() { return _propagator; }
+    BandwidthManager &manager() { return *_manager; }
+
+private:
+    QTemporaryDir _dir;
+    SyncJournalDb _journal;
+    QSet<QString> _bulkUploadBlackList;
+    OwncloudPropagator _propagator;
+    qint64 _now = 0;
+    int _uploads = 0;
+    std::unique_ptr<BandwidthManager> _manager;
+};
+
+// Reads what the quota allows, like QNAM does on readyRead
+qint64 send(UploadDevice &device)
+{
+    char buffer[16 * 1024];
+    qint64 sent = 0;
+    while (!device.atEnd()) {
+        const auto read = device.read(buffer, sizeof(buffer));
+        if (read <= 0) {
+            break;
+        }
+        sent += read;
+    }
+    return sent;
+}
+
+}
+
+class TestBandwidthManager : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testNoLimit()
+    {
+        qint64 now = 0;
+        BandwidthBucket bucket([&now] { return now; });
+        now += 1000;
+        QCOMPARE(bucket.takeShares(3), QVector<qint64>({0, 0, 0}));
+        QCOMPARE(bucket.available(), qint64(0));
+        QVERIFY(bucket.takeShares(0).isEmpty());
+    }
+
+    void testIdleBucketOnlyKeepsTheBurst()
+    {
+        qint64 now = 0;
+        BandwidthBucket bucket([&now] { return now; });
+        bucket.setRate(100000);
+        QCOMPARE(bucket.takeShares(1), QVector<qint64>({100000 * BandwidthBucket::burstMsec / 1000}));
+
+        now += 60 * 1000;
+        QCOMPARE(bucket.available(), 100000 * BandwidthBucket::burstMsec / 1000);
+    }
+
+    void testSlowRateKeepsTheRemainder()
+    {
+        qint64 now = 0;
+        BandwidthBucket bucket([&now] { return now; });
+        bucket.setRate(300);
+
+        // 300 bytes per second never makes a whole byte in one millisecond
+        qint64 taken = 0;
+        for (int tick = 0; tick < 10000; ++tick) {
+            ++now;
+            taken += bucket.takeShares(1).first();
+        }
+        QVERIFY(qAbs(taken - (3000 + 300 * BandwidthBucket::burstMsec / 1000)) <= 1);
+    }
+
+    void testRemainderGoesAround()
+    {
+        qint64 now = 0;
+        BandwidthBucket bucket([&now] { return now; });
+        bucket.setRate(10);
+
+        // One byte per 100 ms for five transfers: each gets it in turn
+        QVector<qint64> taken(5, 0);
+        bucket.takeShares(5);
+        for (int tick = 0; tick < 10; ++tick) {
+            now += 100;
+            const auto shares = bucket.takeShares(5);
+            QCOMPARE(std::accumulate(shares.cbegin(), shares.cend(), qint64(0)), qint64(1));
+            for (int i = 0; i < shares.size(); ++i) {
+                taken[i] += shares.at(i);
+            }
+        }
+        QCOMPARE(taken, QVector<qint64>(5, 2));
+    }
+
+    void testAggregateRate()
+    {
+        constexpr qint64 rate = 100000;
+        constexpr auto burst = rate * BandwidthBucket::burstMsec / 1000;
+        Limits limits(rate, 0);
+
+        // Ten seconds of six parallel uploads that could send much faster
+        std::vector<std::unique_ptr<UploadDevice>> devices;
+        std::vector<qint64> sent(6, 0);
+        for (int i = 0; i < 6; ++i) {
+            devices.push_back(limits.createUpload(1000 * 1000));
+            QVERIFY(devices.back());
+            QVERIFY(devices.back()->isBandwidthLimited());
+        }
+        for (int tick = 0; tick < 100; ++tick) {
+            for (size_t i = 0; i < devices.size(); ++i) {
+                sent[i] += send(*devices[i]);
+            }
+            limits.tick();
+        }
+
+        const auto total = std::accumulate(sent.cbegin(), sent.cend(), qint64(0));
+        QVERIFY(total <= 10 * rate + burst);
+        QVERIFY(total >= 10 * rate);
+        // The first one started with the burst, the bytes that don't divide evenly go around
+        const auto [least, most] = std::minmax_element(sent.cbegin(), sent.cend());
+        QVERIFY(*most - *least <= burst + 1);
+    }
+
+    void testFinishedUploadTakesNoShare()
+    {
+        constexpr qint64 rate = 100000;
+        constexpr auto burst = rate * BandwidthBucket::burstMsec / 1000;
+        Limits limits(rate, 0);
+
+        // The first upload takes the whole burst and sends all of it, it is at
+        // its end but stays registered until QNAM reads past it
+        auto finished = limits.createUpload(burst);
+        auto running = limits.createUpload(1000 * 1000);
+        QVERIFY(finished && running);
+        QCOMPARE(finished->bandwidthQuota(), burst);
+        QCOMPARE(running->bandwidthQuota(), qint64(0));
+        QCOMPARE(send(*finished), burst);
+        QVERIFY(finished->atEnd());
+        QCOMPARE(finished->bandwidthQuota(), qint64(0));
+
+        limits.tick();
+        QCOMPARE(finished->bandwidthQuota(), qint64(0));
+        QCOMPARE(running->bandwidthQuota(), rate * tickMsec / 1000);
+    }
+
+    void testNewTransfersStartRightAway()
+    {
+        constexpr qint64 rate = 100000;
+        Limits limits(rate, rate);
+
+        auto first = limits.createUpload(1000 * 1000);
+        QVERIFY(first);
+        QCOMPARE(first->bandwidthQuota(), rate * BandwidthBucket::burstMsec / 1000);
+
+        // Between two ticks, the new upload gets what was gathered since
+        limits.advance(tickMsec / 2);
+        auto second = limits.createUpload(1000 * 1000);
+        QVERIFY(second);
+        QCOMPARE(second->bandwidthQuota(), rate * tickMsec / 2 / 1000);
+
+        GETFileJob job(limits.propagator().account(), QStringLiteral("file"), nullptr, {}, {}, 0);
+        limits.manager().registerDownloadJob(&job);
+        QCOMPARE(job.bandwidthQuota(), rate * BandwidthBucket::burstMsec / 1000);
+    }
+
+    void testMoreTransfersThanBytes()
+    {
+        Limits limits(10, 0);
+
+        std::vector<std::unique_ptr<UploadDevice>> devices;
+        std::vector<qint64> sent(5, 0);
+        for (int i = 0; i < 5; ++i) {
+            devices.push_back(limits.createUpload(1000));
+            QVERIFY(devices.back());
+        }
+        for (int tick = 0; tick < 20; ++tick) {
+            for (size_t i = 0; i < devices.size(); ++i) {
+                sent[i] += send(*devices[i]);
+            }
+            limits.tick();
+        }
+
+        // One byte per tick, but every upload makes progress
+        for (const auto deviceSent : sent) {
+            QVERIFY(deviceSent > 0);
+        }
+        QVERIFY(std::accumulate(sent.cbegin(), sent.cend(), qint64(0)) <= 20 + 2);
+    }
+
+    void testRateChange()
+    {
+        Limits limits(100000, 0);
+        std::vector<std::unique_ptr<UploadDevice>> devices;
+        devices.push_back(limits.createUpload(1000 * 1000));
+        devices.push_back(limits.createUpload(1000 * 1000));
+        QVERIFY(devices[0] && devices[1]);
+        for (int tick = 0; tick < 10; ++tick) {
+            send(*devices[0]);
+            send(*devices[1]);
+            limits.tick();
+        }
+        send(*devices[0]);
+        send(*devices[1]);
+
+        limits.setUploadLimit(10000);
+        qint64 sent = 0;
+        for (int tick = 0; tick < 100; ++tick) {
+            sent += send(*devices[0]) + send(*devices[1]);
+            limits.tick();
+        }
+        QVERIFY(sent <= 10 * 10000 + 10000 * BandwidthBucket::burstMsec / 1000);
+        QVERIFY(sent > 10 * 10000 - 10000 * tickMsec / 1000);
+    }
+
+    void testParallelTransfers()
+    {
+        Limits limits(0, 0);
+        auto options = limits.propagator().syncOptions();
+        options._parallelNetworkJobs = 6;
+        limits.propagator().setSyncOptions(options);
+        QCOMPARE(limits.propagator().maximumActiveTransferJob(), 3);
+
+        // Absolute limits are shared between the transfers
+        limits.propagator()._uploadLimit = 100000;
+        limits.propagator()._downloadLimit = 100000;
+        QCOMPARE(limits.propagator().maximumActiveTransferJob(), 3);
+
+        // Relative ones are measured on one transfer at a time
+        limits.propagator()._uploadLimit = -50;
+        QCOMPARE(limits.propagator().maximumActiveTransferJob(), 1);
+        limits.propagator()._uploadLimit = 100000;
+        limits.propagator()._downloadLimit = -50;
+        QCOMPARE(limits.propagator().maximumActiveTransferJob(), 1);
+    }
+};
+
+QTEST_GUILESS_MAIN(TestBandwidthManager)
+#include "testbandwidthmanager.moc"
@@ -9,9 +9,14 @@
  */
 
 #include <QtTest>
+#include <QBuffer>
 #include <QDir>
 #include <QString>
 
+#ifdef ZLIB_FOUND
+#include <zlib.h>
+#endif
+
 #include "common/checksums.h"
 #include "networkjobs.h"
 #include "common/checksumcalculator.h"
@@ -189,6 +194,71 @@ private slots:
         delete vali;
     }
 
+    void testAdlerCalc_data()
+    {
+        QTest::addColumn<QByteArray>("data");
+
+        // Lengths around the 32 byte vector blocks and the 5552 byte reduction interval
+        for (const auto size : {0, 1, 31, 32, 33, 5551, 5552, 5553, 5552 * 3 + 7, 3 * 1024 * 1024 + 17}) {
+            QByteArray data(size, Qt::Uninitialized);
+            for (int i = 0; i < size; ++i) {
+                data[i] = static_cast<char>(i * 131 + i / 251);
+            }
+            QTest::addRow("%d bytes", size) << data;
+        }
+        // The largest bytes make the sums grow the fastest
+        QTest::newRow("all 0xff") << QByteArray(1024 * 1024 + 3, '\xff');
+    }
+
+    void testAdlerCalc()
+    {
+#ifndef ZLIB_FOUND
+        QSKIP("ZLIB not found.", SkipSingle);
+#else
+        QFETCH(QByteArray, data);
+
+        auto buffer = std::make_unique<QBuffer>();
+        buffer->setData(data);
+        ChecksumCalculator checksumCalculator(std::move(buffer), OCC::checkSumAdlerC);
+
+        const auto expected = adler32(adler32(0L, Z_NULL, 0), reinterpret_cast<const Bytef *>(data.constData()), data.size());
+        QCOMPARE(checksumCalculator.calculate(), QByteArray::number(static_cast<quint32>(expected), 16));
+#endif
+    }
+
+    void testCalculateAll()
+    {
+        const QList<QByteArray> types = {OCC::checkSumSHA1C, OCC::checkSumMD5C, "Klaas32", OCC::checkSumSHA2C, OCC::checkSumSHA3C, OCC::checkSumAdlerC};
+        ChecksumCalculator checksumCalculator(std::make_unique<QFile>(_testfile), types);
+        const auto checksums = checksumCalculator.calculateAll();
+
+        QCOMPARE(checksums.size(), types.size());
+        for (int i = 0; i < types.size(); ++i) {
+            if (types.at(i) == "Klaas32") {
+                // Unknown types do not keep the others from being computed
+                QVERIFY(checksums.at(i).isEmpty());
+                continue;
+            }
+            ChecksumCalculator single(_testfile, types.at(i));
+            QCOMPARE(checksums.at(i), single.calculate());
+        }
+    }
+
+    void testUploadChecksummingSeveralTypes()
+    {
+        ComputeChecksum computeChecksum;
+        computeChecksum.setChecksumTypes({OCC::checkSumSHA1C, OCC::checkSumMD5C});
+        QSignalSpy doneSpy(&computeChecksum, &ComputeChecksum::done);
+        computeChecksum.start(_testfile);
+        QVERIFY(doneSpy.wait());
+
+        // done() reports the first type, the others are read from the same pass
+        QCOMPARE(doneSpy.first().at(0).toByteArray(), QByteArray(OCC::checkSumSHA1C));
+        QCOMPARE(doneSpy.first().at(1).toByteArray(), ComputeChecksum::computeNow(_testfile, OCC::checkSumSHA1C));
+        QCOMPARE(computeChecksum.checksum(OCC::checkSumMD5C), ComputeChecksum::computeNow(_testfile, OCC::checkSumMD5C));
+        QVERIFY(computeChecksum.checksum(OCC::checkSumAdlerC).isEmpty());
+    }
+
     void testDownloadChecksummingAdler() {
 #ifndef ZLIB_FOUND
         QSKIP("ZLIB not found.", SkipSingle);
@@ -10,9 +10,13 @@
 
 #include "syncenginetestutils.h"
 
+#include <bandwidthmanager.h>
 #include <owncloudpropagator.h>
 #include <syncengine.h>
+#include "common/contentdefinedchunker.h"
 
+#include <QBuffer>
+#include <QRandomGenerator>
 #include <QtTest>
 #include <QTextCodec>
 
@@ -56,6 +60,160 @@ static void setChunkSize(SyncEngine &engine, qint64 size)
     engine.setSyncOptions(options);
 }
 
+// Chunks of exactly the given size, without dynamic chunk sizing
+static void setFixedChunkSize(SyncEngine &engine, qint64 size)
+{
+    setChunkSize(engine, size);
+    auto options = engine.syncOptions();
+    options._targetChunkUploadDuration = std::chrono::milliseconds(0);
+    engine.setSyncOptions(options);
+}
+
+// Chunking v2, with up to maxParallelCount chunks of a file uploaded at the same time
+static QVariantMap parallelChunkingCapabilities(int maxParallelCount)
+{
+    return {
+        {"dav", QVariantMap{{"chunking", "1.0"}}},
+        {"files", QVariantMap{{"chunked_upload", QVariantMap{{"max_parallel_count", maxParallelCount}}}}},
+    };
+}
+
+// Chunking v2 with delta uploads, for files from minDeltaUploadSize on
+static void enableDeltaUploads(SyncEngine &engine, qint64 minDeltaUploadSize = 0)
+{
+    engine.account()->setCapabilities({{"dav", QVariantMap{{"chunking", "1.0"}, {"deltaSync", "1.0"}}}});
+    setFixedChunkSize(engine, 1000 * 1000);
+    auto options = engine.syncOptions();
+    options._minDeltaUploadSize = minDeltaUploadSize;
+    options._deltaChunkSize = 64 * 1024;
+    engine.setSyncOptions(options);
+}
+
+static QByteArray randomContent(qint64 size, quint32 seed)
+{
+    QByteArray content(size, Qt::Uninitialized);
+    QRandomGenerator generator(seed);
+    generator.fillRange(reinterpret_cast<quint32 *>(content.data()), size / sizeof(quint32));
+    // The fake server only keeps a fill character, the first byte of the chunks it got
+    content[0] = 'W';
+    return content;
+}
+
+static void writeLocalFile(FakeFolder &fakeFolder, const QString &name, const QByteArray &content, const QDateTime &modTime)
+{
+    QFile file(fakeFolder.localPath() + name);
+    QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    QCOMPARE(file.write(content), qint64(content.size()));
+    file.close();
+    fakeFolder.localModifier().setModTime(name, modTime);
+}
+
+// Keeps the real bytes of chunk uploads, which the fake server drops
+struct DeltaUploadServer
+{
+    QByteArray content; /// of the file on the server
+    QMap<QString, QByteArray> chunks; /// by url path, chunk names sort in upload order
+    qint64 uploadedBytes = 0;
+    int referencedChunks = 0;
+    bool refuseReferences = false;
+
+    void install(FakeFolder &fakeFolder)
+    {
+        fakeFolder.setServerOverride([this, &fakeFolder](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *outgoingData) -> QNetworkReply * {
+            const auto path = request.url().path();
+            if (!path.startsWith(sUploadUrl.path())) {
+                return nullptr;
+            }
+            if (op == QNetworkAccessManager::PutOperation) {
+                QByteArray data;
+                if (request.hasRawHeader("OC-Delta-Base-Offset")) {
+                    if (refuseReferences) {
+                        return new FakeErrorReply(op, request, &fakeFolder.syncEngine(), 501);
+                    }
+                    ++referencedChunks;
+                    data = content.mid(request.rawHeader("OC-Delta-Base-Offset").toLongLong(), request.rawHeader("OC-Delta-Base-Length").toLongLong());
+                } else {
+                    data = outgoingData->readAll();
+                    uploadedBytes += data.size();
+                }
+                chunks[path] = data;
+                return new FakePutReply(fakeFolder.uploadState(), op, request, QByteArray(data.size(), 'W'), &fakeFolder.syncEngine());
+            }
+            if (request.attribute(QNetworkRequest::CustomVerbAttribute).toString() == QLatin1String("MOVE")) {
+                content.clear();
+                for (const auto &chunk : std::as_const(chunks)) {
+                    content += chunk;
+                }
+                chunks.clear();
+            }
+            return nullptr;
+        });
+    }
+
+    void resetCounters()
+    {
+        uploadedBytes = 0;
+        referencedChunks = 0;
+    }
+};
+
+// A chunk PUT that takes the body as the upload device hands it out, like the
+// network does, so that the bandwidth limits apply to it
+class FakeStreamingPutReply : public FakeReply
+{
+    Q_OBJECT
+public:
+    FakeStreamingPutReply(FileInfo &remoteRootFileInfo, QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *outgoingData, QObject *parent)
+        : FakeReply(parent)
+        , _remoteRootFileInfo(remoteRootFileInfo)
+        , _outgoingData(outgoingData)
+    {
+        setRequest(request);
+        setUrl(request.url());
+        setOperation(op);
+        open(QIODevice::ReadOnly);
+        connect(outgoingData, &QIODevice::readyRead, this, &FakeStreamingPutReply::readBody);
+        QMetaObject::invokeMethod(this, &FakeStreamingPutReply::readBody, Qt::QueuedConnection);
+    }
+
+    void readBody()
+    {
+        if (!_outgoingData || _finished) {
+            return;
+        }
+        _payload += _outgoingData->readAll();
+        if (!_outgoingData->atEnd()) {
+            return;
+        }
+
+        _finished = true;
+        const auto fileInfo = FakePutReply::perform(_remoteRootFileInfo, request(), _payload);
+        emit uploadProgress(fileInfo->size, fileInfo->size);
+        setRawHeader("OC-ETag", fileInfo->etag);
+        setRawHeader("ETag", fileInfo->etag);
+        setRawHeader("OC-FileID", fileInfo->fileId);
+        setRawHeader("X-OC-MTime", "accepted");
+        setAttribute(QNetworkRequest::HttpStatusCodeAttribute, 200);
+        emit metaDataChanged();
+        emit finished();
+    }
+
+    void abort() override
+    {
+        _finished = true;
+        setError(OperationCanceledError, QStringLiteral("abort"));
+        emit finished();
+    }
+
+    qint64 readData(char *, qint64) override { return 0; }
+
+private:
+    FileInfo &_remoteRootFileInfo;
+    QPointer<QIODevice> _outgoingData;
+    QByteArray _payload;
+    bool _finished = false;
+};
+
 class TestChunkingNG : public QObject
 {
     Q_OBJECT
@@ -676,7 +834,313 @@ private slots:
         QCOMPARE(fakeFolder.currentRemoteState().find("A/a0")->size, size + 1);
     }
 
+    // Upload the chunks of a file in parallel against a server with some latency
+    void testParallelChunkUpload()
+    {
+        constexpr auto chunkSize = 1000 * 1000;
+        constexpr auto size = 12 * chunkSize;
+        // Long enough for the chunks to overlap
+        constexpr auto latencyMs = 20;
+
+        const auto upload = [&](int maxParallelCount, int &maxInFlight) {
+            FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+            fakeFolder.syncEngine().account()->setCapabilities(parallelChunkingCapabilities(maxParallelCount));
+            setFixedChunkSize(fakeFolder.syncEngine(), chunkSize);
+
+            int inFlight = 0;
+            maxInFlight = 0;
+            fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *outgoingData) -> QNetworkReply * {
+                if (op == QNetworkAccessManager::PutOperation && request.url().path().startsWith(sUploadUrl.path())) {
+                    const auto reply = new DelayedReply<FakePutReply>(latencyMs, fakeFolder.uploadState(), op, request, outgoingData->readAll(), &fakeFolder.syncEngine());
+                    maxInFlight = qMax(maxInFlight, ++inFlight);
+                    QObject::connect(reply, &QNetworkReply::finished, [&inFlight] { --inFlight; });
+                    return reply;
+                }
+                return nullptr;
+            });
 
+            fakeFolder.localModifier().insert("A/a0", size);
+            QVERIFY(fakeFolder.syncOnce());
+            QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+            QCOMPARE(fakeFolder.currentRemoteState().find("A/a0")->size, size);
+        };
+
+        int sequentialInFlight = 0;
+        upload(1, sequentialInFlight);
+        int parallelInFlight = 0;
+        upload(4, parallelInFlight);
+        if (QTest::currentTestFailed()) {
+            return;
+        }
+
+        QCOMPARE(sequentialInFlight, 1);
+        QCOMPARE(parallelInFlight, 4);
+    }
+
+    // An absolute upload limit is shared between the chunks in flight
+    void testParallelChunkUploadWithAbsoluteLimit()
+    {
+        constexpr auto chunkSize = 1000 * 1000;
+        constexpr auto size = 12 * chunkSize;
+        constexpr qint64 uploadLimit = 20 * 1000 * 1000;
+
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+        fakeFolder.syncEngine().account()->setCapabilities(parallelChunkingCapabilities(4));
+        setFixedChunkSize(fakeFolder.syncEngine(), chunkSize);
+        fakeFolder.syncEngine().setNetworkLimits(uploadLimit, 0);
+
+        int inFlight = 0;
+        int maxInFlight = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *outgoingData) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::PutOperation && request.url().path().startsWith(sUploadUrl.path())) {
+                const auto reply = new FakeStreamingPutReply(fakeFolder.uploadState(), op, request, outgoingData, &fakeFolder.syncEngine());
+                maxInFlight = qMax(maxInFlight, ++inFlight);
+                QObject::connect(reply, &QNetworkReply::finished, [&inFlight] { --inFlight; });
+                return reply;
+            }
+            return nullptr;
+        });
+
+        // The limit runs on a simulated clock that moves on a tick whenever the event loop comes by
+        constexpr qint64 tickMsec = 100;
+        qint64 now = 0;
+        QTimer ticker;
+        ticker.setInterval(1);
+        connect(&fakeFolder.syncEngine(), &SyncEngine::started, this, [&] {
+            const auto bandwidthManager = &fakeFolder.syncEngine().getPropagator()->_bandwidthManager;
+            bandwidthManager->setClock([&now] { return now; });
+            connect(&ticker, &QTimer::timeout, bandwidthManager, [&now, bandwidthManager] {
+                now += tickMsec;
+                bandwidthManager->absoluteLimitTimerExpired();
+            });
+            ticker.start();
+        });
+
+        fakeFolder.localModifier().insert("A/a0", size);
+        QVERIFY(fakeFolder.syncOnce());
+        ticker.stop();
+        QCOMPARE(maxInFlight, 4);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(fakeFolder.currentRemoteState().find("A/a0")->size, size);
+
+        // All but the initial burst waited for the limit
+        QVERIFY(now >= (size - uploadLimit * BandwidthBucket::burstMsec / 1000) * 1000 / uploadLimit);
+    }
+
+    // Resume after a chunk in the middle did not arrive while later ones did
+    void testParallelChunkResume()
+    {
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+        fakeFolder.syncEngine().account()->setCapabilities(parallelChunkingCapabilities(3));
+        constexpr auto chunkSize = 1000 * 1000;
+        setFixedChunkSize(fakeFolder.syncEngine(), chunkSize);
+        const int size = 10 * chunkSize;
+        fakeFolder.localModifier().insert("A/a0", size);
+
+        // The third chunk hangs, abort once the fifth one was sent
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::PutOperation) {
+                const auto chunkName = request.url().path().section(QLatin1Char('/'), -1);
+                if (chunkName == QLatin1String("00003")) {
+                    return new FakeHangingReply(op, request, &fakeFolder.syncEngine());
+                }
+                if (chunkName == QLatin1String("00005")) {
+                    QTimer::singleShot(0, &fakeFolder.syncEngine(), [&fakeFolder] { fakeFolder.syncEngine().abort(); });
+                }
+            }
+            return nullptr;
+        });
+        QVERIFY(!fakeFolder.syncOnce());
+
+        QCOMPARE(fakeFolder.uploadState().children.count(), 1);
+        const auto chunkingId = fakeFolder.uploadState().children.first().name;
+        const auto chunkNames = fakeFolder.uploadState().children.first().children.keys();
+        QVERIFY(chunkNames.contains("00001"));
+        QVERIFY(chunkNames.contains("00002"));
+        QVERIFY(!chunkNames.contains("00003"));
+        QVERIFY(chunkNames.contains("00005"));
+
+        QStringList deletedChunks;
+        QList<qint64> sentOffsets;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::PutOperation) {
+                sentOffsets.append(request.rawHeader("OC-Chunk-Offset").toLongLong());
+            } else if (op == QNetworkAccessManager::DeleteOperation) {
+                deletedChunks.append(request.url().path().section(QLatin1Char('/'), -1));
+            }
+            return nullptr;
+        });
+        QVERIFY(fakeFolder.syncOnce());
+
+        // The chunks after the hole were removed, the ones before it were not sent again
+        for (const auto &chunkName : chunkNames) {
+            QCOMPARE(deletedChunks.contains(chunkName), chunkName > QLatin1String("00003"));
+        }
+        QVERIFY(!sentOffsets.isEmpty());
+        QCOMPARE(*std::min_element(sentOffsets.cbegin(), sentOffsets.cend()), 2 * chunkSize);
+
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(fakeFolder.currentRemoteState().find("A/a0")->size, size);
+        // The same chunk id was re-used
+        QCOMPARE(fakeFolder.uploadState().children.count(), 1);
+        QCOMPARE(fakeFolder.uploadState().children.first().name, chunkingId);
+    }
+
+    void testContentDefinedChunker()
+    {
+        constexpr qint64 minSize = 16 * 1024;
+        constexpr qint64 averageSize = 64 * 1024;
+        constexpr qint64 maxSize = 256 * 1024;
+        const auto content = randomContent(4 * 1000 * 1000, 1);
+
+        ContentDefinedChunker chunker(minSize, averageSize, maxSize);
+        // Feeding the data in pieces doesn't change the boundaries
+        for (qint64 offset = 0; offset < content.size(); offset += 12345) {
+            chunker.addData(content.constData() + offset, qMin<qint64>(12345, content.size() - offset));
+        }
+        const auto chunks = chunker.finish();
+        QBuffer buffer;
+        buffer.setData(content);
+        QVERIFY(buffer.open(QIODevice::ReadOnly));
+        QCOMPARE(chunker.chunkDevice(&buffer).value(), chunks);
+
+        qint64 total = 0;
+        for (int i = 0; i < chunks.size(); ++i) {
+            QVERIFY(chunks[i].size <= maxSize);
+            QVERIFY(chunks[i].size >= minSize || i == chunks.size() - 1);
+            total += chunks[i].size;
+        }
+        QCOMPARE(total, qint64(content.size()));
+        QCOMPARE(ContentDefinedChunker::deserialize(ContentDefinedChunker::serialize(chunks)), chunks);
+
+        // Inserting bytes only changes the chunks around the insertion
+        auto edited = content;
+        edited.insert(2 * 1000 * 1000, QByteArray(100, 'x'));
+        ContentDefinedChunker editedChunker(minSize, averageSize, maxSize);
+        editedChunker.addData(edited.constData(), edited.size());
+        const auto editedChunks = editedChunker.finish();
+        int changed = 0;
+        for (const auto &chunk : editedChunks) {
+            changed += chunks.contains(chunk) ? 0 : 1;
+        }
+        QVERIFY(changed >= 1);
+        QVERIFY(changed <= 3);
+    }
+
+    void testDeltaUpload()
+    {
+        FakeFolder fakeFolder{FileInfo{}};
+        enableDeltaUploads(fakeFolder.syncEngine());
+        DeltaUploadServer server;
+        server.install(fakeFolder);
+        const auto size = 6 * 1000 * 1000;
+        auto modTime = QDateTime::currentDateTimeUtc().addDays(-1);
+
+        // New files are uploaded in full, their chunks are remembered
+        const auto content = randomContent(size, 2);
+        writeLocalFile(fakeFolder, QStringLiteral("big"), content, modTime);
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(server.uploadedBytes, qint64(size));
+        QCOMPARE(server.referencedChunks, 0);
+        QCOMPARE(server.content, content);
+        const auto stored = fakeFolder.syncJournal().getDeltaChunks(QStringLiteral("big"));
+        QVERIFY(stored.isValid());
+        QCOMPARE(stored._size, qint64(size));
+        QCOMPARE(stored._etag, fakeFolder.currentRemoteState().find("big")->etag);
+
+        // Only the chunks around the changes are uploaded
+        auto edited = content;
+        edited.insert(3 * 1000 * 1000, QByteArray(1000, 'x'));
+        edited[500 * 1000] = edited[500 * 1000] ^ 1;
+        writeLocalFile(fakeFolder, QStringLiteral("big"), edited, modTime.addSecs(10));
+        server.resetCounters();
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(server.content, edited);
+        QVERIFY(server.referencedChunks > 0);
+        QVERIFY(server.uploadedBytes > 0);
+        QVERIFY(server.uploadedBytes < size / 4);
+        QCOMPARE(fakeFolder.syncJournal().getDeltaChunks(QStringLiteral("big"))._size, qint64(edited.size()));
+    }
+
+    // The default fake server copies the ranges too, for files of a single character
+    void testDeltaUploadFakeServer()
+    {
+        FakeFolder fakeFolder{FileInfo{}};
+        enableDeltaUploads(fakeFolder.syncEngine());
+        const auto size = 3 * 1000 * 1000;
+        fakeFolder.localModifier().insert(QStringLiteral("big"), size);
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        int referencedChunks = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::PutOperation && request.hasRawHeader("OC-Delta-Base-Offset")) {
+                ++referencedChunks;
+            }
+            return nullptr;
+        });
+        fakeFolder.localModifier().appendByte(QStringLiteral("big"));
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(fakeFolder.currentRemoteState().find("big")->size, size + 1);
+        QVERIFY(referencedChunks > 0);
+    }
+
+    void testDeltaUploadUnsupported()
+    {
+        FakeFolder fakeFolder{FileInfo{}};
+        enableDeltaUploads(fakeFolder.syncEngine());
+        DeltaUploadServer server;
+        server.install(fakeFolder);
+        const auto size = 6 * 1000 * 1000;
+        auto modTime = QDateTime::currentDateTimeUtc().addDays(-1);
+
+        const auto content = randomContent(size, 3);
+        writeLocalFile(fakeFolder, QStringLiteral("big"), content, modTime);
+        QVERIFY(fakeFolder.syncOnce());
+        QVERIFY(fakeFolder.syncJournal().getDeltaChunks(QStringLiteral("big")).isValid());
+
+        // Without the capability everything is uploaded again
+        fakeFolder.syncEngine().account()->setCapabilities({{"dav", QVariantMap{{"chunking", "1.0"}}}});
+        auto edited = content;
+        edited[100] = edited[100] ^ 1;
+        writeLocalFile(fakeFolder, QStringLiteral("big"), edited, modTime.addSecs(10));
+        server.resetCounters();
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(server.uploadedBytes, qint64(size));
+        QCOMPARE(server.referencedChunks, 0);
+        QCOMPARE(server.content, edited);
+
+        // Stored chunks of another version than the one on the server are not used
+        enableDeltaUploads(fakeFolder.syncEngine());
+        auto stale = fakeFolder.syncJournal().getDeltaChunks(QStringLiteral("big"));
+        stale._etag = "outdated";
+        fakeFolder.syncJournal().setDeltaChunks(QStringLiteral("big"), stale);
+        writeLocalFile(fakeFolder, QStringLiteral("big"), content, modTime.addSecs(20));
+        server.resetCounters();
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(server.uploadedBytes, qint64(size));
+        QCOMPARE(server.referencedChunks, 0);
+
+        // A server refusing a copied range makes the next attempt upload everything,
+        // resuming after the chunks uploaded before the refusal
+        QVERIFY(fakeFolder.syncJournal().getDeltaChunks(QStringLiteral("big")).isValid());
+        server.refuseReferences = true;
+        server.resetCounters();
+        writeLocalFile(fakeFolder, QStringLiteral("big"), edited, modTime.addSecs(30));
+        QVERIFY(!fakeFolder.syncOnce());
+        QVERIFY(!fakeFolder.syncJournal().getDeltaChunks(QStringLiteral("big")).isValid());
+        QVERIFY(fakeFolder.syncJournal().wipeErrorBlacklist() != -1);
+        server.refuseReferences = false;
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(server.uploadedBytes, qint64(size));
+        QCOMPARE(server.referencedChunks, 0);
+        QCOMPARE(server.content, edited);
+    }
 };
 
 QTEST_GUILESS_MAIN(TestChunkingNG)
@@ -15,6 +15,7 @@
 #include <common/constants.h>
 
 #include "clientsideencryption.h"
+#include "streamingencryptor.h"
 #include "logger.h"
 
 using namespace OCC;
@@ -260,6 +261,101 @@ private slots:
         chunkedOutputDecrypted.close();
     }
 
+    void testStreamingEncryptor_data()
+    {
+        QTest::addColumn<int>("totalBytes");
+
+        QTest::newRow("empty") << 0;
+        QTest::newRow("less than a block") << 15;
+        QTest::newRow("one block") << 16;
+        QTest::newRow("unaligned") << 1000;
+        QTest::newRow("several read buffers") << 3 * 1024 * 1024 + 7;
+    }
+
+    void testStreamingEncryptor()
+    {
+        QFETCH(int, totalBytes);
+
+        QTemporaryFile inputFile;
+        QVERIFY(inputFile.open());
+        QCOMPARE(inputFile.write(EncryptionHelper::generateRandom(totalBytes)), totalBytes);
+        inputFile.close();
+
+        const auto encryptionKey = EncryptionHelper::generateRandom(16);
+        const auto initializationVector = EncryptionHelper::generateRandom(16);
+
+        QTemporaryFile encryptedFile;
+        QByteArray tag;
+        QVERIFY(EncryptionHelper::fileEncryption(encryptionKey, initializationVector, &inputFile, &encryptedFile, tag));
+        inputFile.close();
+        encryptedFile.close();
+        QVERIFY(encryptedFile.open());
+        const auto expected = encryptedFile.readAll();
+        QCOMPARE(expected.size(), totalBytes + OCC::Constants::e2EeTagSize);
+
+        const auto parameters = StreamingEncryptor::prepare(inputFile.fileName(), encryptionKey, initializationVector);
+        QVERIFY(parameters);
+        QCOMPARE(parameters->tag, tag);
+        QCOMPARE(parameters->encryptedSize(), expected.size());
+
+        // The whole file, in one go and in odd sized pieces
+        {
+            StreamingEncryptor encryptor(*parameters);
+            QVERIFY(encryptor.open(QIODevice::ReadOnly));
+            QCOMPARE(encryptor.size(), expected.size());
+            QCOMPARE(encryptor.readAll(), expected);
+
+            QVERIFY(encryptor.seek(0));
+            QByteArray pieces;
+            while (!encryptor.atEnd()) {
+                const auto piece = encryptor.read(1021);
+                QVERIFY(!piece.isEmpty());
+                pieces += piece;
+            }
+            QCOMPARE(pieces, expected);
+        }
+
+        // Ranges, like the chunks of a chunked upload
+        for (const auto chunkSize : {7, 4093, 1024 * 1024}) {
+            if (expected.size() / chunkSize > 1000) {
+                continue;
+            }
+            QByteArray chunks;
+            for (qint64 start = 0; start < expected.size(); start += chunkSize) {
+                StreamingEncryptor chunk(*parameters, start, chunkSize);
+                QVERIFY(chunk.open(QIODevice::ReadOnly));
+                QCOMPARE(chunk.size(), qMin<qint64>(chunkSize, expected.size() - start));
+                chunks += chunk.readAll();
+            }
+            QCOMPARE(chunks, expected);
+        }
+
+        // Seeking backwards and forwards
+        {
+            StreamingEncryptor encryptor(*parameters);
+            QVERIFY(encryptor.open(QIODevice::ReadOnly));
+            auto *random = QRandomGenerator::global();
+            for (int i = 0; i < 50; ++i) {
+                const auto pos = random->bounded(expected.size() + 1);
+                const auto len = random->bounded(expected.size() - pos + 1);
+                QVERIFY(encryptor.seek(pos));
+                QCOMPARE(encryptor.read(len), expected.mid(pos, len));
+            }
+        }
+
+        // The tag is not handed out once the file changed
+        QVERIFY(inputFile.open());
+        QVERIFY(inputFile.seek(totalBytes));
+        QCOMPARE(inputFile.write("x", 1), 1);
+        inputFile.close();
+        {
+            StreamingEncryptor encryptor(*parameters);
+            QVERIFY(encryptor.open(QIODevice::ReadOnly));
+            QVERIFY(encryptor.read(expected.size()).size() < expected.size());
+        }
+        QVERIFY(!StreamingEncryptor::prepare(inputFile.fileName() + QStringLiteral(".missing"), encryptionKey, initializationVector));
+    }
+
     void testGzipThenEncryptDataAndBack()
     {
         const auto metadataKeySize = 16;
@@ -4,6 +4,7 @@
  */
 #include "syncenginetestutils.h"
 #include "clientsideencryption.h"
+#include "discoveryphase.h"
 #include "foldermetadata.h"
 #include <QtTest>
 
@@ -412,6 +413,98 @@ private slots:
         }
         QVERIFY(isFirstUserPresentAndCanDecrypt);
     }
+
+    void testFolderMetadataCacheAvoidsMetadataRequests()
+    {
+        FakeFolder fakeFolder{FileInfo{}};
+        const auto encryptedName = QString::fromUtf8(EncryptionHelper::generateRandomFilename());
+        fakeFolder.remoteModifier().mkdir("encrypted");
+        fakeFolder.remoteModifier().insert("encrypted/" + encryptedName);
+        fakeFolder.remoteModifier().setE2EE("encrypted", true);
+
+        const auto account = fakeFolder.account();
+        account->setCapabilities({{QStringLiteral("end-to-end-encryption"), QVariantMap{{QStringLiteral("enabled"), true}, {QStringLiteral("api-version"), "2.0"}}}});
+        account->e2e()->setCertificate(_account->e2e()->getCertificate());
+        account->e2e()->setPrivateKey(_account->e2e()->getPrivateKey());
+
+        // The metadata the server has for the folder
+        QScopedPointer<FolderMetadata> metadata(new FolderMetadata(account, "/", FolderMetadata::FolderType::Root));
+        QSignalSpy metadataSetupCompleteSpy(metadata.data(), &FolderMetadata::setupComplete);
+        metadataSetupCompleteSpy.wait();
+        QVERIFY(metadata->isValid());
+        FolderMetadata::EncryptedFile encryptedFile;
+        encryptedFile.encryptionKey = EncryptionHelper::generateRandom(16);
+        encryptedFile.encryptedFilename = encryptedName;
+        encryptedFile.originalFilename = QStringLiteral("secret.txt");
+        encryptedFile.mimetype = "text/plain";
+        encryptedFile.initializationVector = EncryptionHelper::generateRandom(16);
+        metadata->addEncryptedFile(encryptedFile);
+        const auto metadataResponse = QJsonDocument(QJsonObject{
+            {QStringLiteral("ocs"), QJsonObject{{QStringLiteral("data"), QJsonObject{{QStringLiteral("meta-data"), QString::fromUtf8(metadata->encryptedMetadata())}}}}},
+        }).toJson(QJsonDocument::Compact);
+        const auto metadataSignature = metadata->metadataSignature();
+        QVERIFY(!metadataSignature.isEmpty());
+
+        auto metadataRequests = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::GetOperation && request.url().path().contains(QStringLiteral("/meta-data/"))) {
+                ++metadataRequests;
+                const auto reply = new FakePayloadReply(op, request, metadataResponse, this);
+                reply->setRawHeader("X-NC-E2EE-SIGNATURE", metadataSignature);
+                return reply;
+            }
+            return nullptr;
+        });
+
+        QVector<RemoteInfo> listing;
+        const auto listEncryptedFolder = [&] {
+            listing.clear();
+            auto done = false;
+            const auto job = new DiscoverySingleDirectoryJob(account, QStringLiteral("encrypted"), QStringLiteral("/"), {QStringLiteral("/encrypted")}, SyncFileItem::EncryptionStatus::NotEncrypted);
+            job->setJournal(&fakeFolder.syncJournal());
+            connect(job, &DiscoverySingleDirectoryJob::finished, this, [&](const HttpResult<QVector<RemoteInfo>> &result) {
+                QVERIFY(result);
+                listing = *result;
+                done = true;
+            });
+            job->start();
+            QTRY_VERIFY(done);
+            QCOMPARE(listing.size(), 1);
+        };
+
+        // Nothing cached: the metadata is fetched and decrypted
+        listEncryptedFolder();
+        QCOMPARE(metadataRequests, 1);
+        QCOMPARE(listing.first().name, QStringLiteral("secret.txt"));
+
+        // The journal only holds the encrypted form
+        const auto folder = fakeFolder.remoteModifier().find("encrypted");
+        const auto stored = fakeFolder.syncJournal().e2EeFolderMetadataCache(folder->fileId, folder->etag);
+        QVERIFY(!stored.isEmpty());
+        QVERIFY(!stored.contains("secret.txt"));
+
+        // Cached for this etag: the names are decrypted without asking the server, again and again
+        listEncryptedFolder();
+        QCOMPARE(metadataRequests, 1);
+        QCOMPARE(listing.first().name, QStringLiteral("secret.txt"));
+        QVERIFY(listing.first()._isE2eEncrypted);
+        QCOMPARE(listing.first().e2eMangledName, QStringLiteral("encrypted/") + encryptedName);
+
+        listEncryptedFolder();
+        QCOMPARE(metadataRequests, 1);
+        QCOMPARE(listing.first().name, QStringLiteral("secret.txt"));
+
+        // The folder changed on the server: the cache no longer applies
+        fakeFolder.remoteModifier().appendByte("encrypted/" + encryptedName);
+        listEncryptedFolder();
+        QCOMPARE(metadataRequests, 2);
+        QCOMPARE(listing.first().name, QStringLiteral("secret.txt"));
+
+        // Resetting the end-to-end encryption forgets it
+        fakeFolder.syncJournal().clearE2EeFolderMetadataCache();
+        listEncryptedFolder();
+        QCOMPARE(metadataRequests, 3);
+    }
 };
 
 QTEST_GUILESS_MAIN(TestClientSideEncryptionV2)
@@ -12,6 +12,14 @@
 #include "syncenginetestutils.h"
 #include <syncengine.h>
 #include <owncloudpropagator.h>
+#include <propagatedownload.h>
+
+#include <QSemaphore>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+#include <memory>
+#include <vector>
 
 using namespace OCC;
 
@@ -43,6 +51,97 @@ public:
 };
 
 
+/* A FakeGetWithDataReply that stops after half of the requested range, with a ContentLength of all of it */
+class TruncatedFakeGetWithDataReply : public FakeGetWithDataReply
+{
+    Q_OBJECT
+public:
+    using FakeGetWithDataReply::FakeGetWithDataReply;
+
+    [[nodiscard]] qint64 bytesAvailable() const override
+    {
+        if (aborted)
+            return 0;
+        return qMax(0LL, qint64(payload.size() / 2) - qint64(offset)) + QIODevice::bytesAvailable();
+    }
+
+    qint64 readData(char *data, qint64 maxlen) override
+    {
+        return FakeGetWithDataReply::readData(data, std::min(maxlen, qMax(0LL, qint64(payload.size() / 2) - qint64(offset))));
+    }
+};
+
+static QByteArray patternedData(qint64 size)
+{
+    QByteArray data(size, Qt::Uninitialized);
+    for (qint64 i = 0; i < size; ++i) {
+        data[i] = static_cast<char>('a' + (i / 7 + i % 13) % 26);
+    }
+    return data;
+}
+
+static void setDownloadSegments(SyncEngine &engine, int segments, qint64 minSize)
+{
+    auto options = engine.syncOptions();
+    options._downloadSegments = segments;
+    options._minSegmentedDownloadSize = minSize;
+    engine.setSyncOptions(options);
+}
+
+static QByteArray localFileContent(FakeFolder &fakeFolder, const QString &path)
+{
+    QFile file(fakeFolder.localPath() + path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return {};
+    }
+    return file.readAll();
+}
+
+/* Answers every GET with the whole body, from its own thread so that it keeps sending while the test's thread is busy */
+class GetServerThread : public QThread
+{
+public:
+    explicit GetServerThread(const QByteArray &body)
+        : _body(body)
+    {
+    }
+
+    QUrl url()
+    {
+        _listening.acquire();
+        _listening.release();
+        return QUrl(QStringLiteral("http://127.0.0.1:%1/file").arg(_port));
+    }
+
+protected:
+    void run() override
+    {
+        QTcpServer server;
+        QObject::connect(&server, &QTcpServer::newConnection, &server, [this, &server] {
+            auto socket = server.nextPendingConnection();
+            QObject::connect(socket, &QTcpSocket::readyRead, socket, [this, socket] {
+                _request += socket->readAll();
+                if (!_request.contains("\r\n\r\n")) {
+                    return;
+                }
+                _request.clear();
+                socket->write("HTTP/1.1 200 OK\r\nContent-Length: " + QByteArray::number(_body.size()) + "\r\n\r\n");
+                socket->write(_body);
+            });
+        });
+        server.listen(QHostAddress::LocalHost);
+        _port = server.serverPort();
+        _listening.release();
+        exec();
+    }
+
+private:
+    QByteArray _body;
+    QByteArray _request;
+    quint16 _port = 0;
+    QSemaphore _listening;
+};
+
 SyncFileItemPtr getItem(const QSignalSpy &spy, const QString &path)
 {
     for (const QList<QVariant> &args : spy) {
@@ -101,6 +200,235 @@ private slots:
         QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
     }
 
+    void testSegmentedDownload()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        fakeFolder.syncEngine().setIgnoreHiddenFiles(true);
+        setDownloadSegments(fakeFolder.syncEngine(), 4, 1000 * 1000);
+        const auto size = 4 * 1000 * 1000;
+        const auto data = patternedData(size);
+        fakeFolder.remoteModifier().insert("A/big", size);
+
+        QByteArrayList ranges;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::GetOperation && request.url().path().endsWith("A/big")) {
+                ranges.append(request.rawHeader("Range"));
+                auto reply = new FakeGetWithDataReply(fakeFolder.remoteModifier(), data, op, request, this);
+                reply->setRawHeader("OC-Checksum", "SHA1:" + QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex());
+                return reply;
+            }
+            return nullptr;
+        });
+
+        QVERIFY(fakeFolder.syncOnce());
+        std::sort(ranges.begin(), ranges.end());
+        QCOMPARE(ranges, QByteArrayList({"bytes=0-999999", "bytes=1000000-1999999", "bytes=2000000-2999999", "bytes=3000000-3999999"}));
+        QCOMPARE(localFileContent(fakeFolder, "A/big"), data);
+        QVERIFY(!fakeFolder.syncJournal().getDownloadInfo("A/big")._valid);
+
+        // Small files still use a single request
+        ranges.clear();
+        fakeFolder.remoteModifier().insert("A/small", 1000);
+        QVERIFY(fakeFolder.syncOnce());
+        QVERIFY(ranges.isEmpty());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
+    void testSegmentedDownloadWithAbsoluteLimit()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        fakeFolder.syncEngine().setIgnoreHiddenFiles(true);
+        setDownloadSegments(fakeFolder.syncEngine(), 4, 1000 * 1000);
+        // The segments share the limit, 10 MB/s
+        fakeFolder.syncEngine().setNetworkLimits(0, 10 * 1000 * 1000);
+        const auto size = 4 * 1000 * 1000;
+        const auto data = patternedData(size);
+        fakeFolder.remoteModifier().insert("A/big", size);
+
+        QByteArrayList ranges;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::GetOperation && request.url().path().endsWith("A/big")) {
+                ranges.append(request.rawHeader("Range"));
+                auto reply = new FakeGetWithDataReply(fakeFolder.remoteModifier(), data, op, request, this);
+                reply->setRawHeader("OC-Checksum", "SHA1:" + QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex());
+                return reply;
+            }
+            return nullptr;
+        });
+
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(ranges.size(), 4);
+        QCOMPARE(localFileContent(fakeFolder, "A/big"), data);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
+    void testSegmentedDownloadChecksumMismatch()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        fakeFolder.syncEngine().setIgnoreHiddenFiles(true);
+        setDownloadSegments(fakeFolder.syncEngine(), 4, 1000 * 1000);
+        QSignalSpy completeSpy(&fakeFolder.syncEngine(), &OCC::SyncEngine::itemCompleted);
+        const auto size = 4 * 1000 * 1000;
+        const auto data = patternedData(size);
+        fakeFolder.remoteModifier().insert("A/big", size);
+
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::GetOperation && request.url().path().endsWith("A/big")) {
+                auto reply = new FakeGetWithDataReply(fakeFolder.remoteModifier(), data, op, request, this);
+                reply->setRawHeader("OC-Checksum", "SHA1:" + QCryptographicHash::hash(data.left(size - 1), QCryptographicHash::Sha1).toHex());
+                return reply;
+            }
+            return nullptr;
+        });
+
+        // The assembled file is checked as a whole
+        QVERIFY(!fakeFolder.syncOnce());
+        QCOMPARE(getItem(completeSpy, "A/big")->_status, SyncFileItem::SoftError);
+        QVERIFY(!QFileInfo::exists(fakeFolder.localPath() + "A/big"));
+    }
+
+    void testSegmentedDownloadResume()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        fakeFolder.syncEngine().setIgnoreHiddenFiles(true);
+        setDownloadSegments(fakeFolder.syncEngine(), 4, 1000 * 1000);
+        QSignalSpy completeSpy(&fakeFolder.syncEngine(), &OCC::SyncEngine::itemCompleted);
+        const auto size = 4 * 1000 * 1000;
+        const auto data = patternedData(size);
+        fakeFolder.remoteModifier().insert("A/big", size);
+
+        // The third segment stops half way
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::GetOperation && request.url().path().endsWith("A/big")) {
+                if (request.rawHeader("Range").startsWith("bytes=2000000-")) {
+                    return new TruncatedFakeGetWithDataReply(fakeFolder.remoteModifier(), data, op, request, this);
+                }
+                return new FakeGetWithDataReply(fakeFolder.remoteModifier(), data, op, request, this);
+            }
+            return nullptr;
+        });
+
+        QVERIFY(!fakeFolder.syncOnce());
+        QCOMPARE(getItem(completeSpy, "A/big")->_status, SyncFileItem::SoftError);
+        QCOMPARE(getItem(completeSpy, "A/big")->_errorString, QStringLiteral("The file could not be downloaded completely."));
+        QVERIFY(fakeFolder.syncEngine().isAnotherSyncNeeded());
+        const auto info = fakeFolder.syncJournal().getDownloadInfo("A/big");
+        QVERIFY(info._valid);
+        QCOMPARE(info._segments.size(), 4);
+        QVERIFY(info._segments.at(0).isComplete());
+        QVERIFY(info._segments.at(1).isComplete());
+        QCOMPARE(info._segments.at(2)._received, 500000);
+
+        // Only what is missing is requested again
+        QByteArrayList ranges;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::GetOperation && request.url().path().endsWith("A/big")) {
+                ranges.append(request.rawHeader("Range"));
+                return new FakeGetWithDataReply(fakeFolder.remoteModifier(), data, op, request, this);
+            }
+            return nullptr;
+        });
+        QVERIFY(fakeFolder.syncOnce());
+        QVERIFY(ranges.contains("bytes=2500000-2999999"));
+        for (const auto &range : std::as_const(ranges)) {
+            QVERIFY(range.mid(6).split('-').first().toLongLong() >= 2500000);
+        }
+        QCOMPARE(localFileContent(fakeFolder, "A/big"), data);
+        QVERIFY(!fakeFolder.syncJournal().getDownloadInfo("A/big")._valid);
+    }
+
+    void testSegmentedDownloadRangesIgnored()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        fakeFolder.syncEngine().setIgnoreHiddenFiles(true);
+        setDownloadSegments(fakeFolder.syncEngine(), 4, 1000 * 1000);
+        const auto size = 4 * 1000 * 1000;
+        const auto data = patternedData(size);
+        fakeFolder.remoteModifier().insert("A/big", size);
+
+        // The server answers every request with the whole file
+        QByteArrayList ranges;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::GetOperation && request.url().path().endsWith("A/big")) {
+                ranges.append(request.rawHeader("Range"));
+                auto withoutRange = request;
+                withoutRange.setRawHeader("Range", QByteArray());
+                return new FakeGetWithDataReply(fakeFolder.remoteModifier(), data, op, withoutRange, this);
+            }
+            return nullptr;
+        });
+
+        QVERIFY(fakeFolder.syncOnce());
+        QVERIFY(ranges.size() > 1);
+        QVERIFY(ranges.last().isEmpty());
+        QCOMPARE(localFileContent(fakeFolder, "A/big"), data);
+    }
+
+    void testDownloadWhileEventLoopBusy()
+    {
+        // A real QNAM, its network thread receives while this thread is busy
+        const auto body = patternedData(16 * 1024 * 1024);
+        GetServerThread server(body);
+        server.start();
+        auto account = Account::create();
+        account->setCredentials(new FakeCredentials{new QNetworkAccessManager});
+
+        QTemporaryFile file;
+        QVERIFY(file.open());
+        auto job = new GETFileJob(account, server.url(), &file, {}, {}, 0);
+        QSignalSpy finishedSpy(job, &GETFileJob::finishedSignal);
+        auto error = QNetworkReply::UnknownNetworkError;
+        connect(job, &GETFileJob::finishedSignal, this, [&error, job] { error = job->reply()->error(); });
+
+        // Every event loop iteration takes 20ms, like a main thread that also renders a slow UI
+        int busyIterations = 0;
+        QTimer busy;
+        busy.setInterval(0);
+        connect(&busy, &QTimer::timeout, this, [&busyIterations] {
+            ++busyIterations;
+            QThread::msleep(20);
+        });
+        busy.start();
+        job->start();
+        QVERIFY(finishedSpy.wait(60000));
+        busy.stop();
+
+        QCOMPARE(error, QNetworkReply::NoError);
+        QVERIFY(file.flush());
+        QCOMPARE(file.size(), body.size());
+        // Reading 16 KiB per iteration would take over a thousand of them
+        QVERIFY2(busyIterations < 100, QByteArray::number(busyIterations).constData());
+
+        server.quit();
+        server.wait();
+    }
+
+    void testReadAheadIsShared()
+    {
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+        QTemporaryFile file;
+        QVERIFY(file.open());
+
+        // Many parallel downloads share the read-ahead instead of each taking 4 MiB
+        std::vector<std::unique_ptr<GETFileJob>> jobs;
+        for (int i = 0; i < 16; ++i) {
+            jobs.push_back(std::make_unique<GETFileJob>(fakeFolder.account(), QStringLiteral("A/a1"), &file, QMap<QByteArray, QByteArray>{}, QByteArray{}, 0));
+            jobs.back()->start();
+        }
+        qint64 total = 0;
+        for (const auto &job : jobs) {
+            QVERIFY(job->reply());
+            total += job->reply()->readBufferSize();
+        }
+        QVERIFY(total <= 16 * 1024 * 1024);
+
+        // Those left get the share of the finished ones
+        const auto shared = jobs.front()->reply()->readBufferSize();
+        jobs.resize(2);
+        QVERIFY(jobs.front()->reply()->readBufferSize() > shared);
+        QCOMPARE(jobs.front()->reply()->readBufferSize(), jobs.back()->reply()->readBufferSize());
+    }
+
     void testErrorMessage () {
         // This test's main goal is to test that the error string from the server is shown in the UI
 
@@ -56,6 +56,12 @@ static auto check_dir_full(const char *path)
     return excludedFiles->fullPatternMatch(path, ItemTypeDirectory);
 }
 
+static QString bnameTraversalFilePatterns(const QString &basePath)
+{
+    const auto &matcher = excludedFiles->_bnameTraversalFile[basePath];
+    return (matcher.exclude.patterns() + matcher.excludeRemove.patterns() + matcher.trigger.patterns()).join(QLatin1Char('|'));
+}
+
 static auto check_file_traversal(const char *path)
 {
     return excludedFiles->traversalPatternMatch(path, ItemTypeFile);
@@ -109,10 +115,10 @@ private slots:
 
         QVERIFY(excludedFiles->_fullRegexFile[QStringLiteral("/")].pattern().contains("csync1"));
         QVERIFY(excludedFiles->_fullTraversalRegexFile[QStringLiteral("/")].pattern().contains("csync1"));
-        QVERIFY(!excludedFiles->_bnameTraversalRegexFile[QStringLiteral("/")].pattern().contains("csync1"));
+        QVERIFY(!bnameTraversalFilePatterns(QStringLiteral("/")).contains("csync1"));
 
         excludedFiles->addManualExclude("foo");
-        QVERIFY(excludedFiles->_bnameTraversalRegexFile[QStringLiteral("/")].pattern().contains("foo"));
+        QVERIFY(bnameTraversalFilePatterns(QStringLiteral("/")).contains("foo"));
         QVERIFY(excludedFiles->_fullRegexFile[QStringLiteral("/")].pattern().contains("foo"));
         QVERIFY(!excludedFiles->_fullTraversalRegexFile[QStringLiteral("/")].pattern().contains("foo"));
     }
@@ -131,7 +137,46 @@ private slots:
         excludedFiles->addManualExclude("foo/bar", "/tmp/check_csync1/");
         QVERIFY(excludedFiles->_fullRegexFile[QStringLiteral("/tmp/check_csync1/")].pattern().contains("bar"));
         QVERIFY(excludedFiles->_fullTraversalRegexFile[QStringLiteral("/tmp/check_csync1/")].pattern().contains("bar"));
-        QVERIFY(!excludedFiles->_bnameTraversalRegexFile[QStringLiteral("/tmp/check_csync1/")].pattern().contains("foo"));
+        QVERIFY(!bnameTraversalFilePatterns(QStringLiteral("/tmp/check_csync1/")).contains("foo"));
+    }
+
+    void check_bname_matcher()
+    {
+        ExcludedFiles::BnameMatcher matcher;
+        matcher.addPattern("Thumbs.db");
+        matcher.addPattern("*.part");
+        matcher.addPattern("~$*");
+        matcher.addPattern("~*.tmp");
+        matcher.addPattern(".*.sw?");
+        matcher.addPattern("[ab]c");
+        matcher.prepare(Qt::CaseSensitive);
+
+        QVERIFY(matcher.matches(u"Thumbs.db"));
+        QVERIFY(!matcher.matches(u"thumbs.db"));
+        QVERIFY(!matcher.matches(u"Thumbs.dbx"));
+        QVERIFY(matcher.matches(u"file.part"));
+        QVERIFY(matcher.matches(u".part"));
+        QVERIFY(!matcher.matches(u"file.parts"));
+        QVERIFY(matcher.matches(u"~$document.docx"));
+        QVERIFY(matcher.matches(u"~.tmp"));
+        QVERIFY(matcher.matches(u"~lock.tmp"));
+        QVERIFY(!matcher.matches(u"~tmp"));
+        QVERIFY(matcher.matches(u".file.swp"));
+        QVERIFY(!matcher.matches(u".file.swpx"));
+        QVERIFY(matcher.matches(u"bc"));
+        QVERIFY(!matcher.matches(u"cc"));
+        QVERIFY(!matcher.matches(u"FILE.PART"));
+
+        matcher.prepare(Qt::CaseInsensitive);
+        QVERIFY(matcher.matches(u"THUMBS.DB"));
+        QVERIFY(matcher.matches(u"FILE.PART"));
+        QVERIFY(matcher.matches(u".FILE.SWP"));
+        QVERIFY(matcher.matches(u"BC"));
+
+        ExcludedFiles::BnameMatcher empty;
+        empty.prepare(Qt::CaseSensitive);
+        QVERIFY(!empty.matches(u"foo"));
+        QVERIFY(!empty.matches(u""));
     }
 
     void check_csync_excluded()
@@ -145,6 +145,9 @@ private slots:
         OCC::Logger::instance()->setLogDebug(true);
 
         QStandardPaths::setTestModeEnabled(true);
+
+        // The folders are registered in the background
+        QTRY_VERIFY(_watcher->isReady());
     }
 
     void init()
@@ -352,6 +355,7 @@ private slots:
 
         _watcher.reset(new FolderWatcher);
         _watcher->init(_rootPath);
+        QTRY_VERIFY(_watcher->isReady());
         _watcher->setShouldWatchForFileUnlocking(true);
         _pathChangedSpy.reset(new QSignalSpy(_watcher.data(), &FolderWatcher::pathChanged));
         QScopedPointer<QSignalSpy> locksImposedSpy(new QSignalSpy(_watcher.data(), &FolderWatcher::filesLockImposed));
@@ -393,6 +397,63 @@ private slots:
             rm(officeLockFile);
         }
     }
+
+#ifdef Q_OS_LINUX
+    void testFanotify()
+    {
+        QTemporaryDir root;
+        const auto rootPath = QDir(root.path()).canonicalPath();
+        QDir(rootPath).mkpath("a/b");
+
+        FolderWatcher watcher;
+        qputenv("OWNCLOUD_ENABLE_FANOTIFY", "1");
+        watcher.init(rootPath);
+        qunsetenv("OWNCLOUD_ENABLE_FANOTIFY");
+        if (!watcher.testLinuxUsesFanotify()) {
+            QSKIP("fanotify needs CAP_SYS_ADMIN and a file system reporting file handles");
+        }
+        QVERIFY(watcher.isReady());
+        QCOMPARE(watcher.testLinuxWatchCount(), 0);
+
+        QSignalSpy spy(&watcher, &FolderWatcher::pathChanged);
+        auto waitFor = [&spy](const QString &path) {
+            return QTest::qWaitFor([&] {
+                return std::any_of(spy.cbegin(), spy.cend(), [&path](const QList<QVariant> &args) { return args.first().toString() == path; });
+            }, 5000);
+        };
+
+        touch(rootPath + "/a/b/file");
+        QVERIFY(waitFor(rootPath + "/a/b/file"));
+
+        // New directories need no registration
+        mkdir(rootPath + "/a/b/c");
+        touch(rootPath + "/a/b/c/file");
+        QVERIFY(waitFor(rootPath + "/a/b/c/file"));
+
+        // Moved directories report their new paths
+        mv(rootPath + "/a/b", rootPath + "/a/moved");
+        QVERIFY(waitFor(rootPath + "/a/moved"));
+        touch(rootPath + "/a/moved/c/other");
+        QVERIFY(waitFor(rootPath + "/a/moved/c/other"));
+
+        // Changes elsewhere on the file system are dropped
+        QTemporaryDir outside(QDir::tempPath() + "/fanotify-outside-XXXXXX");
+        QDir(outside.path()).mkpath("d/e");
+        touch(outside.path() + "/file");
+        touch(outside.path() + "/d/e/file");
+
+        // Until a directory from there is moved into the folder
+        mv(outside.path() + "/d", rootPath + "/a/d");
+        QVERIFY(waitFor(rootPath + "/a/d"));
+        touch(rootPath + "/a/d/e/other");
+        QVERIFY(waitFor(rootPath + "/a/d/e/other"));
+        rm(rootPath + "/a/moved/c/other");
+        QVERIFY(waitFor(rootPath + "/a/moved/c/other"));
+        for (const auto &args : std::as_const(spy)) {
+            QVERIFY(args.first().toString().startsWith(rootPath + '/'));
+        }
+    }
+#endif
 };
 
 #ifdef Q_OS_MACOS
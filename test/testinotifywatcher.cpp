@@ -22,6 +22,18 @@ class TestInotifyWatcher: public FolderWatcherPrivate
 private:
     QString _root;
 
+    // Creates dirPerDir folders in every folder down to maxDepth, returns how many
+    static int createTree(const QString &path, int depth, int maxDepth, int dirPerDir)
+    {
+        int created = 0;
+        for (int dirNum = 1; dirNum <= dirPerDir && depth < maxDepth; ++dirNum) {
+            const QString subPath = path + QStringLiteral("/dir") + QString::number(dirNum);
+            QDir().mkdir(subPath);
+            created += 1 + createTree(subPath, depth + 1, maxDepth, dirPerDir);
+        }
+        return created;
+    }
+
 private slots:
     void initTestCase()
     {
@@ -64,6 +76,109 @@ private slots:
         QVERIFY2(ok, "findFoldersBelow failed.");
     }
 
+    // Ignored folders are skipped together with everything below them
+    void testIgnoredFoldersArePruned()
+    {
+        QStringList dirs;
+        QStringList asked;
+        const auto ok = forEachFolderBelow(_root, [&dirs](const QString &path) {
+            dirs.append(path);
+            return true;
+        }, [&asked, this](const QString &path) {
+            asked.append(path);
+            return path == _root + QStringLiteral("/a1/b1");
+        });
+        QVERIFY(ok);
+        QVERIFY(dirs.contains(_root + QStringLiteral("/a1/b2/c1")));
+        QVERIFY(!dirs.contains(_root + QStringLiteral("/a1/b1")));
+        QVERIFY(!asked.contains(_root + QStringLiteral("/a1/b1/c1")));
+        QCOMPARE(dirs.count(), 8);
+    }
+
+    void testWatchTree()
+    {
+        InotifyWatchTree tree(QStringLiteral("/root"));
+        tree.insert(QStringLiteral("/root"), 1);
+        tree.insert(QStringLiteral("/root/foo"), 2);
+        tree.insert(QStringLiteral("/root/foo/bar"), 3);
+        tree.insert(QStringLiteral("/root/foo bar"), 4);
+        tree.insert(QStringLiteral("/root/foo/bar/baz"), 5);
+        // Outside of the root
+        tree.insert(QStringLiteral("/rootfoo"), 6);
+        QCOMPARE(tree.size(), 5);
+
+        QVERIFY(tree.contains(QStringLiteral("/root/foo/bar")));
+        QVERIFY(!tree.contains(QStringLiteral("/root/fo")));
+        QVERIFY(!tree.contains(QStringLiteral("/rootfoo")));
+        QCOMPARE(tree.path(1), QStringLiteral("/root"));
+        QCOMPARE(tree.path(5), QStringLiteral("/root/foo/bar/baz"));
+        QCOMPARE(tree.path(4), QStringLiteral("/root/foo bar"));
+        QCOMPARE(tree.path(6), QString());
+
+        // Parents that aren't watched themselves
+        tree.insert(QStringLiteral("/root/a/b/c"), 7);
+        QVERIFY(tree.contains(QStringLiteral("/root/a/b/c")));
+        QVERIFY(!tree.contains(QStringLiteral("/root/a/b")));
+        QCOMPARE(tree.path(7), QStringLiteral("/root/a/b/c"));
+
+        // A moved folder gets its descriptor under the new path
+        tree.insert(QStringLiteral("/root/a/moved"), 5);
+        QCOMPARE(tree.path(5), QStringLiteral("/root/a/moved"));
+        QVERIFY(!tree.contains(QStringLiteral("/root/foo/bar/baz")));
+
+        auto removed = tree.removeBelow(QStringLiteral("/root/foo"));
+        std::sort(removed.begin(), removed.end());
+        QCOMPARE(removed, QVector<int>({2, 3}));
+        QVERIFY(tree.contains(QStringLiteral("/root/foo bar")));
+        QVERIFY(!tree.contains(QStringLiteral("/root/foo/bar")));
+        QCOMPARE(tree.path(3), QString());
+        QCOMPARE(tree.size(), 4);
+
+        // Removed entries are reused
+        tree.insert(QStringLiteral("/root/foo/new"), 8);
+        QCOMPARE(tree.path(8), QStringLiteral("/root/foo/new"));
+
+        removed = tree.removeBelow(QStringLiteral("/root"));
+        QCOMPARE(removed.size(), 5);
+        QCOMPARE(tree.size(), 0);
+    }
+
+    // Registers the watches for a deep tree and measures how long the event
+    // loop is blocked meanwhile
+    void benchmarkRegisterDeepTree()
+    {
+        const QString root = _root + QStringLiteral("/deep");
+        QDir().mkpath(root);
+        // 6 levels of 5 folders each: 19530 folders
+        const auto folders = createTree(root, 0, 6, 5);
+
+        FolderWatcher watcher;
+        QSignalSpy progressSpy(&watcher, &FolderWatcher::registrationProgress);
+        qint64 longestStallMs = 0;
+        QElapsedTimer sinceLastTick;
+        QTimer ticker;
+        ticker.setInterval(1);
+        connect(&ticker, &QTimer::timeout, this, [&] {
+            longestStallMs = qMax(longestStallMs, sinceLastTick.restart());
+        });
+
+        QElapsedTimer timer;
+        QBENCHMARK_ONCE {
+            timer.start();
+            sinceLastTick.start();
+            ticker.start();
+            watcher.init(root);
+            QTRY_VERIFY_WITH_TIMEOUT(watcher.isReady(), 120000);
+            ticker.stop();
+        }
+        qInfo() << "FOLDERS" << folders << "READY AFTER" << timer.elapsed() << "ms LONGEST STALL" << longestStallMs << "ms PROGRESS UPDATES" << progressSpy.count();
+
+        QCOMPARE(watcher.testLinuxWatchCount(), folders + 1);
+        QVERIFY(!progressSpy.isEmpty());
+        QCOMPARE(progressSpy.last().at(0).toInt(), folders + 1);
+        QVERIFY(progressSpy.last().at(1).toBool());
+    }
+
     void cleanupTestCase() {
         if( _root.startsWith(QDir::tempPath() )) {
            system( QStringLiteral("rm -rf %1").arg(_root).toLocal8Bit() );
@@ -71,5 +186,5 @@ private slots:
     }
 };
 
-QTEST_APPLESS_MAIN(TestInotifyWatcher)
+QTEST_GUILESS_MAIN(TestInotifyWatcher)
 #include "testinotifywatcher.moc"
@@ -971,6 +971,72 @@ private slots:
         QVERIFY(!fakeFolder.syncOnce());
         QCOMPARE(syncSpy.findItem(fileNameE)->_status, SyncFileItem::Status::Success);
     }
+
+    void testParallelLocalScan_data()
+    {
+        QTest::addColumn<int>("threads");
+        QTest::newRow("one thread") << 1;
+        QTest::newRow("four threads") << 4;
+    }
+
+    void testParallelLocalScan()
+    {
+        QFETCH(int, threads);
+
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+        auto options = fakeFolder.syncEngine().syncOptions();
+        options._parallelLocalScanJobs = threads;
+        fakeFolder.syncEngine().setSyncOptions(options);
+
+        for (const auto &dir : {"A/x", "A/x/y", "A/x/y/z", "B/x", "B/x/y"}) {
+            fakeFolder.localModifier().mkdir(dir);
+        }
+        fakeFolder.localModifier().insert("A/x/y/z/deep");
+        fakeFolder.localModifier().insert("B/x/y/deep");
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QVERIFY(fakeFolder.currentRemoteState().find("A/x/y/z/deep"));
+
+        // Prefetched listings of the subdirectories must not be stale on the next sync
+        ItemCompletedSpy completeSpy(fakeFolder);
+        fakeFolder.localModifier().appendByte("A/x/y/z/deep");
+        fakeFolder.localModifier().remove("B/x/y/deep");
+        fakeFolder.localModifier().insert("C/x");
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(completeSpy.findItem("A/x/y/z/deep")->_instruction, CSYNC_INSTRUCTION_SYNC);
+        QCOMPARE(completeSpy.findItem("B/x/y/deep")->_instruction, CSYNC_INSTRUCTION_REMOVE);
+        QCOMPARE(completeSpy.findItem("C/x")->_instruction, CSYNC_INSTRUCTION_NEW);
+    }
+
+    void testParallelLocalScanSkippedDirectories()
+    {
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+        fakeFolder.syncEngine().excludedFiles().addManualExclude("*.skipped");
+        fakeFolder.syncEngine().journal()->setSelectiveSyncList(SyncJournalDb::SelectiveSyncBlackList, {"B/blacklisted/"});
+
+        // Prefetched, but never listed by a ProcessDirectoryJob
+        for (const auto &dir : {"A/x.skipped", "A/x.skipped/y", "B/blacklisted", "B/blacklisted/y", "C/x", "C/x/y"}) {
+            fakeFolder.localModifier().mkdir(dir);
+        }
+        fakeFolder.localModifier().insert("A/x.skipped/y/file");
+        fakeFolder.localModifier().insert("B/blacklisted/y/file");
+        fakeFolder.localModifier().insert("C/x/y/file");
+        QVERIFY(fakeFolder.syncOnce());
+        QVERIFY(!fakeFolder.currentRemoteState().find("A/x.skipped"));
+        QVERIFY(!fakeFolder.currentRemoteState().find("B/blacklisted"));
+        QVERIFY(fakeFolder.currentRemoteState().find("C/x/y/file"));
+
+        // A renamed directory is listed under its new name only
+        fakeFolder.localModifier().rename("C/x", "C/renamed");
+        fakeFolder.localModifier().insert("C/renamed/y/other");
+        QVERIFY(fakeFolder.syncOnce());
+        QVERIFY(fakeFolder.currentRemoteState().find("C/renamed/y/file"));
+        QVERIFY(fakeFolder.currentRemoteState().find("C/renamed/y/other"));
+        QVERIFY(!fakeFolder.currentRemoteState().find("C/x"));
+        QVERIFY(!fakeFolder.currentRemoteState().find("A/x.skipped"));
+        QVERIFY(!fakeFolder.currentRemoteState().find("B/blacklisted"));
+    }
 };
 
 QTEST_GUILESS_MAIN(TestLocalDiscovery)
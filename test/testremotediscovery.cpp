@@ -221,6 +221,81 @@ private slots:
         QCOMPARE(completeSpy.findItem("unlimited")->_folderQuota.bytesAvailable, -3);
         QCOMPARE(completeSpy.findItem("invalidValue")->_folderQuota.bytesAvailable, -1);
     }
+
+    void testBulkRemoteDiscovery()
+    {
+        FakeFolder fakeFolder{ FileInfo() };
+        auto options = fakeFolder.syncEngine().syncOptions();
+        options._bulkRemoteDiscovery = true;
+        fakeFolder.syncEngine().setSyncOptions(options);
+
+        fakeFolder.remoteModifier().mkdir("A");
+        fakeFolder.remoteModifier().mkdir("A/B");
+        fakeFolder.remoteModifier().insert("A/B/b1");
+        fakeFolder.remoteModifier().mkdir("C");
+        fakeFolder.remoteModifier().insert("C/c1");
+        fakeFolder.remoteModifier().insert("root1");
+
+        int propfindCount = 0;
+        int depthInfinityCount = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation, const QNetworkRequest &req, QIODevice *) -> QNetworkReply * {
+            if (req.attribute(QNetworkRequest::CustomVerbAttribute).toString() == "PROPFIND") {
+                ++propfindCount;
+                if (req.rawHeader("Depth") == "infinity") {
+                    ++depthInfinityCount;
+                }
+            }
+            return nullptr;
+        });
+
+        // The initial sync lists the whole tree at once
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(depthInfinityCount, 1);
+        QCOMPARE(propfindCount, 1);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        // Once the journal is filled, directories are listed one by one again
+        propfindCount = 0;
+        depthInfinityCount = 0;
+        fakeFolder.remoteModifier().appendByte("A/B/b1");
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(depthInfinityCount, 0);
+        QCOMPARE(propfindCount, 3);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
+    void testBulkRemoteDiscoveryRefused()
+    {
+        FakeFolder fakeFolder{ FileInfo() };
+        auto options = fakeFolder.syncEngine().syncOptions();
+        options._bulkRemoteDiscovery = true;
+        fakeFolder.syncEngine().setSyncOptions(options);
+
+        fakeFolder.remoteModifier().mkdir("A");
+        fakeFolder.remoteModifier().mkdir("A/B");
+        fakeFolder.remoteModifier().insert("A/B/b1");
+        fakeFolder.remoteModifier().mkdir("C");
+        fakeFolder.remoteModifier().insert("C/c1");
+
+        int propfindCount = 0;
+        int refusedCount = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &req, QIODevice *) -> QNetworkReply * {
+            if (req.attribute(QNetworkRequest::CustomVerbAttribute).toString() == "PROPFIND") {
+                ++propfindCount;
+                if (req.rawHeader("Depth") == "infinity") {
+                    ++refusedCount;
+                    return new FakeErrorReply(op, req, this, 403);
+                }
+            }
+            return nullptr;
+        });
+
+        // The refused request is followed by one PROPFIND per directory: root, A, A/B and C
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(refusedCount, 1);
+        QCOMPARE(propfindCount, 5);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
 };
 
 QTEST_GUILESS_MAIN(TestRemoteDiscovery)
@@ -19,6 +19,7 @@
 #include "syncengine.h"
 
 #include <QFile>
+#include <QScopeGuard>
 #include <QtTest>
 
 #include <filesystem>
@@ -437,6 +438,66 @@ private slots:
         }
     }
 
+    void testStreamingPropagation()
+    {
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+        auto options = fakeFolder.syncEngine().syncOptions();
+        options._streamingPropagation = true;
+        fakeFolder.syncEngine().setSyncOptions(options);
+
+        SyncFileItemVector earlyItems;
+        auto moreItemsCount = 0;
+        connect(&fakeFolder.syncEngine(), &SyncEngine::aboutToPropagate, this, [&](SyncFileItemVector &items) { earlyItems = items; });
+        connect(&fakeFolder.syncEngine(), &SyncEngine::aboutToPropagateMore, this, [&](SyncFileItemVector &) { ++moreItemsCount; });
+
+        fakeFolder.remoteModifier().mkdir("Y");
+        fakeFolder.remoteModifier().mkdir("Y/Z");
+        fakeFolder.remoteModifier().insert("Y/Z/d0");
+        fakeFolder.remoteModifier().insert("Y/d1");
+        // The directories with a rename or a deletion wait for the end of the discovery
+        fakeFolder.remoteModifier().rename("B/b1", "A/b1");
+        fakeFolder.remoteModifier().insert("A/a3");
+        fakeFolder.localModifier().remove("C/c1");
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        QVERIFY(!earlyItems.isEmpty());
+        QVERIFY(moreItemsCount > 0);
+        for (const auto &item : std::as_const(earlyItems)) {
+            QVERIFY2(item->destination().startsWith(QStringLiteral("Y/")), qPrintable(item->destination()));
+        }
+
+        ItemCompletedSpy completeSpy(fakeFolder);
+        QVERIFY(fakeFolder.syncOnce());
+        QVERIFY(completeSpy.isEmpty());
+    }
+
+    void testStreamingPropagationWithError()
+    {
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+        auto options = fakeFolder.syncEngine().syncOptions();
+        options._streamingPropagation = true;
+        fakeFolder.syncEngine().setSyncOptions(options);
+
+        fakeFolder.remoteModifier().mkdir("Y");
+        fakeFolder.remoteModifier().mkdir("Y/Z");
+        fakeFolder.remoteModifier().insert("Y/Z/d0");
+        fakeFolder.remoteModifier().insert("Y/d1");
+        fakeFolder.serverErrorPaths().append("Y/Z/d0", 503);
+        QVERIFY(!fakeFolder.syncOnce());
+
+        // Y is propagated after its subdirectory failed, it must not store its etag
+        SyncJournalFileRecord rec;
+        QVERIFY(fakeFolder.syncJournal().getFileRecord(QByteArrayLiteral("Y"), &rec) && rec.isValid());
+        QCOMPARE(rec._etag, QByteArrayLiteral("_invalid_"));
+        QVERIFY(fakeFolder.syncJournal().getFileRecord(QByteArrayLiteral("Y/d1"), &rec) && rec.isValid());
+
+        fakeFolder.serverErrorPaths().clear();
+        QVERIFY(fakeFolder.syncJournal().wipeErrorBlacklist() != -1);
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
     void testFakeConflict_data()
     {
         QTest::addColumn<bool>("sameMtime");
@@ -2461,6 +2522,97 @@ private slots:
         const auto directoryItem = fakeFolder.remoteModifier().find("directory");
         QCOMPARE(directoryItem, nullptr);
     }
+
+    void testConcurrentSyncs()
+    {
+        const auto restoreLimits = qScopeGuard([maxConcurrentSyncs = SyncEngine::maxConcurrentSyncs(), budget = SyncEngine::globalNetworkJobBudget()] {
+            SyncEngine::setMaxConcurrentSyncs(maxConcurrentSyncs);
+            SyncEngine::setGlobalNetworkJobBudget(budget);
+        });
+
+        FakeFolder fakeFolderA{FileInfo::A12_B12_C12_S12()};
+        FakeFolder fakeFolderB{FileInfo::A12_B12_C12_S12()};
+        fakeFolderA.remoteModifier().insert("A/newA");
+        fakeFolderB.remoteModifier().insert("B/newB");
+
+        // By default syncs are serialized: the second engine refuses to start
+        QCOMPARE(SyncEngine::maxConcurrentSyncs(), 1);
+        fakeFolderA.scheduleSync();
+        fakeFolderB.scheduleSync();
+        QCoreApplication::processEvents();
+        QVERIFY(fakeFolderA.syncEngine().isSyncRunning());
+        QVERIFY(!fakeFolderB.syncEngine().isSyncRunning());
+        QCOMPARE(SyncEngine::runningSyncCount(), 1);
+        QVERIFY(fakeFolderA.execUntilFinished());
+        QCOMPARE(SyncEngine::runningSyncCount(), 0);
+        QVERIFY(!fakeFolderB.currentLocalState().find("B/newB"));
+
+        // Both engines run at the same time and share the network job budget
+        SyncEngine::setMaxConcurrentSyncs(2);
+        SyncEngine::setGlobalNetworkJobBudget(4);
+        QSignalSpy finishedA(&fakeFolderA.syncEngine(), &SyncEngine::finished);
+        QSignalSpy finishedB(&fakeFolderB.syncEngine(), &SyncEngine::finished);
+        fakeFolderA.remoteModifier().insert("A/newA2");
+        fakeFolderA.scheduleSync();
+        fakeFolderB.scheduleSync();
+        QCoreApplication::processEvents();
+        QCOMPARE(SyncEngine::runningSyncCount(), 2);
+        QCOMPARE(fakeFolderA.syncEngine().parallelNetworkJobs(), 2);
+        QCOMPARE(fakeFolderB.syncEngine().parallelNetworkJobs(), 2);
+        QTRY_VERIFY(!finishedA.isEmpty() && !finishedB.isEmpty());
+        QVERIFY(finishedA.first().first().toBool());
+        QVERIFY(finishedB.first().first().toBool());
+        QCOMPARE(SyncEngine::runningSyncCount(), 0);
+        QCOMPARE(fakeFolderA.currentLocalState(), fakeFolderA.currentRemoteState());
+        QCOMPARE(fakeFolderB.currentLocalState(), fakeFolderB.currentRemoteState());
+
+        // A sync running alone gets the whole budget
+        QVERIFY(fakeFolderB.syncEngine().syncOptions()._parallelNetworkJobs > 4);
+        fakeFolderB.remoteModifier().insert("B/newB2");
+        fakeFolderB.scheduleSync();
+        QCoreApplication::processEvents();
+        QCOMPARE(SyncEngine::runningSyncCount(), 1);
+        QCOMPARE(fakeFolderB.syncEngine().parallelNetworkJobs(), 4);
+        QVERIFY(fakeFolderB.execUntilFinished());
+        QCOMPARE(fakeFolderB.currentLocalState(), fakeFolderB.currentRemoteState());
+    }
+
+    void testJournalSnapshotDiscovery()
+    {
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+        auto options = fakeFolder.syncEngine().syncOptions();
+        options._journalSnapshotDiscovery = true;
+        fakeFolder.syncEngine().setSyncOptions(options);
+
+        // Nothing changed: nothing to do
+        ItemCompletedSpy completeSpy(fakeFolder);
+        QVERIFY(fakeFolder.syncOnce());
+        QVERIFY(completeSpy.isEmpty());
+
+        // Changes on both sides are found like with per-directory journal queries
+        fakeFolder.localModifier().appendByte("A/a1");
+        fakeFolder.localModifier().insert("A/newLocal");
+        fakeFolder.localModifier().rename("B", "B2");
+        fakeFolder.remoteModifier().remove("C/c1");
+        fakeFolder.remoteModifier().mkdir("C/newDir");
+        fakeFolder.remoteModifier().insert("C/newDir/newRemote");
+        // Gone on both sides: the stale journal entries get removed
+        fakeFolder.localModifier().remove("S");
+        fakeFolder.remoteModifier().remove("S");
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QVERIFY(itemDidCompleteSuccessfully(completeSpy, "A/a1"));
+        QVERIFY(itemDidCompleteSuccessfully(completeSpy, "B2"));
+        QVERIFY(itemDidCompleteSuccessfully(completeSpy, "C/newDir/newRemote"));
+        SyncJournalFileRecord record;
+        QVERIFY(fakeFolder.syncJournal().getFileRecord(QByteArrayLiteral("S/s1"), &record));
+        QVERIFY(!record.isValid());
+
+        completeSpy.clear();
+        QVERIFY(fakeFolder.syncOnce());
+        QVERIFY(completeSpy.isEmpty());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
 };
 
 QTEST_GUILESS_MAIN(TestSyncEngine)
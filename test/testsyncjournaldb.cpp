@@ -11,9 +11,12 @@
 #include <QtTest>
 
 #include <sqlite3.h>
+#include <thread>
 
+#include "common/ownsql.h"
 #include "common/syncjournaldb.h"
 #include "common/syncjournalfilerecord.h"
+#include "common/syncjournalsnapshot.h"
 #include "logger.h"
 
 using namespace OCC;
@@ -144,6 +147,178 @@ private slots:
         QVERIFY(_db.hasDefaultValue(quotaBytesAvailable));
     }
 
+    void testParentPhashMigration()
+    {
+        auto makeRecord = [](const QByteArray &path, ItemType type) {
+            SyncJournalFileRecord record;
+            record._path = path;
+            record._type = type;
+            record._etag = "etag";
+            record._remotePerm = RemotePermissions::fromDbValue("RW");
+            record._modtime = QDateTime::currentSecsSinceEpoch();
+            return record;
+        };
+        QVERIFY(_db.setFileRecord(makeRecord("migrate", ItemTypeDirectory)));
+        QVERIFY(_db.setFileRecord(makeRecord("migrate/a", ItemTypeFile)));
+        QVERIFY(_db.setFileRecord(makeRecord("migrate/sub", ItemTypeDirectory)));
+        QVERIFY(_db.setFileRecord(makeRecord("migrate/sub/b", ItemTypeFile)));
+        QVERIFY(_db.setFileRecord(makeRecord("migrate-2", ItemTypeFile)));
+
+        auto listNames = [this](const QByteArray &path) {
+            QByteArrayList names;
+            [&] { QVERIFY(_db.listFilesInPath(path, [&](const SyncJournalFileRecord &rec) { names.append(rec._path); })); }();
+            return names;
+        };
+        auto belowNames = [this](const QByteArray &path) {
+            QByteArrayList names;
+            [&] { QVERIFY(_db.getFilesBelowPath(path, [&](const SyncJournalFileRecord &rec) { names.append(rec._path); })); }();
+            return names;
+        };
+        const QByteArrayList listed = {"migrate/a", "migrate/sub"};
+        const QByteArrayList below = {"migrate/a", "migrate/sub", "migrate/sub/b"};
+        QCOMPARE(listNames("migrate"), listed);
+        QCOMPARE(belowNames("migrate"), below);
+
+        // The stored values match what the old expression index computed
+        QVERIFY(_db.flushPendingWrites());
+        SqlQuery check("SELECT COUNT(*) FROM metadata WHERE parentPhash IS NOT parent_hash(path) OR pathSortKey IS NOT path || '/'", _db._db);
+        QVERIFY(check.next().hasData);
+        QCOMPARE(check.intValue(0), 0);
+
+        // Rows of a journal from before the columns existed are filled in
+        SqlQuery clear("UPDATE metadata SET parentPhash = NULL, pathSortKey = NULL", _db._db);
+        QVERIFY(clear.exec());
+        QVERIFY(_db.updateMetadataTableStructure());
+        QCOMPARE(listNames("migrate"), listed);
+        QCOMPARE(belowNames("migrate"), below);
+
+        // Listings are index range scans in index order, without a per row function
+        auto queryPlan = [this](const QByteArray &sql) {
+            QByteArray plan;
+            SqlQuery query("EXPLAIN QUERY PLAN " + sql, _db._db);
+            while (query.next().hasData) {
+                plan += query.baValue(3) + '\n';
+            }
+            return plan;
+        };
+        const auto listPlan = queryPlan("SELECT path FROM metadata WHERE parentPhash = 1 ORDER BY pathSortKey ASC");
+        QVERIFY2(listPlan.contains("metadata_parent_phash") && !listPlan.contains("TEMP B-TREE"), listPlan.constData());
+        const auto allPlan = queryPlan("SELECT path FROM metadata ORDER BY pathSortKey ASC");
+        QVERIFY2(allPlan.contains("metadata_path_sort_key") && !allPlan.contains("TEMP B-TREE"), allPlan.constData());
+
+        for (const auto path : {"migrate", "migrate/a", "migrate/sub", "migrate/sub/b", "migrate-2"}) {
+            QVERIFY(_db.deleteFileRecord(QString::fromLatin1(path)));
+        }
+    }
+
+    void testQueuedWrites()
+    {
+        auto makeRecord = [](const QByteArray &path) {
+            SyncJournalFileRecord record;
+            record._path = path;
+            record._type = ItemTypeFile;
+            record._etag = "etag";
+            record._fileId = "id";
+            record._remotePerm = RemotePermissions::fromDbValue("RW");
+            record._checksumHeader = "SHA1:abc";
+            record._modtime = QDateTime::currentSecsSinceEpoch();
+            record._fileSize = 10;
+            return record;
+        };
+        auto stored = [this](const QByteArray &path) {
+            SqlQuery query("SELECT COUNT(*) FROM metadata WHERE path = ?1", _db._db);
+            query.bindValue(1, path);
+            [&] { QVERIFY(query.exec() && query.next().hasData); }();
+            return query.intValue(0) > 0;
+        };
+        SyncJournalFileRecord record;
+
+        // Queued writes are seen by getFileRecord() but not executed yet
+        const auto queued = makeRecord("queued/file");
+        QVERIFY(_db.setFileRecord(queued));
+        QVERIFY(!stored("queued/file"));
+        QVERIFY(_db.getFileRecord(QByteArrayLiteral("queued/file"), &record));
+        QVERIFY(record == queued);
+
+        // Local metadata updates apply to queued records and to stored ones
+        SyncJournalFileLockInfo lock;
+        lock._locked = true;
+        lock._lockOwnerId = QStringLiteral("alice");
+        QVERIFY(_db.updateLocalMetadata(QStringLiteral("queued/file"), 1234, 20, 42, lock));
+        QVERIFY(_db.getFileRecord(QByteArrayLiteral("queued/file"), &record));
+        QCOMPARE(record._modtime, qint64(1234));
+        QCOMPARE(record._fileSize, qint64(20));
+        QCOMPARE(record._inode, quint64(42));
+        QCOMPARE(record._etag, QByteArray("etag"));
+
+        _db.commit(QStringLiteral("queued"));
+        QVERIFY(stored("queued/file"));
+        QVERIFY(_db.updateLocalMetadata(QStringLiteral("queued/file"), 5678, 30, 43, lock));
+        QVERIFY(_db.getFileRecord(QByteArrayLiteral("queued/file"), &record));
+        QCOMPARE(record._modtime, qint64(5678));
+        QCOMPARE(record._inode, quint64(43));
+        QVERIFY(record._lockstate._locked);
+        QCOMPARE(record._checksumHeader, QByteArray("SHA1:abc"));
+
+        // A queued delete hides the stored record, other queries execute the queue first
+        QVERIFY(_db.deleteFileRecord(QStringLiteral("queued/file")));
+        QVERIFY(stored("queued/file"));
+        QVERIFY(_db.getFileRecord(QByteArrayLiteral("queued/file"), &record));
+        QVERIFY(!record.isValid());
+        auto listed = 0;
+        QVERIFY(_db.listFilesInPath("queued", [&](const SyncJournalFileRecord &) { ++listed; }));
+        QCOMPARE(listed, 0);
+        QVERIFY(!stored("queued/file"));
+
+        // Many writes are executed in batches and read back as written
+        constexpr auto count = 2503;
+        for (int i = 0; i < count; ++i) {
+            QVERIFY(_db.setFileRecord(makeRecord("queued/many" + QByteArray::number(i))));
+            QVERIFY(_db._pendingWrites.size() < 1000);
+        }
+        for (int i = 0; i < count; i += 2) {
+            QVERIFY(_db.deleteFileRecord(QStringLiteral("queued/many%1").arg(i)));
+        }
+        QVERIFY(_db.listFilesInPath("queued", [&](const SyncJournalFileRecord &rec) {
+            ++listed;
+            QVERIFY(rec._path.startsWith("queued/many"));
+        }));
+        QCOMPARE(listed, count / 2);
+        QVERIFY(_db._pendingWrites.isEmpty());
+        QVERIFY(_db.getFileRecord(QByteArrayLiteral("queued/many1"), &record));
+        QCOMPARE(record._etag, QByteArray("etag"));
+        QCOMPARE(record._checksumHeader, QByteArray("SHA1:abc"));
+
+        // A write that fails is set aside without holding back the others, and tried again with the next commit
+        SqlQuery trigger("CREATE TEMP TRIGGER failing_insert BEFORE INSERT ON metadata WHEN NEW.path = 'queued/failing'"
+                         " BEGIN SELECT RAISE(ABORT, 'simulated failure'); END;", _db._db);
+        QVERIFY(trigger.exec());
+        QVERIFY(_db.setFileRecord(makeRecord("queued/failing")));
+        QVERIFY(_db.setFileRecord(makeRecord("queued/other")));
+        QVERIFY(!_db.commit(QStringLiteral("queued")));
+        QVERIFY(_db._pendingWrites.isEmpty());
+        QCOMPARE(_db._failedWrites.size(), 1);
+        QVERIFY(stored("queued/other"));
+        QVERIFY(!stored("queued/failing"));
+        QVERIFY(_db.getFileRecord(QByteArrayLiteral("queued/failing"), &record));
+        QVERIFY(record.isValid());
+        // It doesn't keep the journal from being read
+        QVERIFY(_db.setFileRecord(makeRecord("queued/later")));
+        QVERIFY(_db.listFilesInPath("queued", [](const SyncJournalFileRecord &) {}));
+        QVERIFY(_db._pendingWrites.isEmpty());
+        QVERIFY(stored("queued/later"));
+        SqlQuery dropTrigger("DROP TRIGGER failing_insert;", _db._db);
+        QVERIFY(dropTrigger.exec());
+        QVERIFY(_db.commit(QStringLiteral("queued")));
+        QVERIFY(_db._pendingWrites.isEmpty());
+        QVERIFY(_db._failedWrites.isEmpty());
+        QVERIFY(stored("queued/failing"));
+        QVERIFY(stored("queued/other"));
+
+        QVERIFY(_db.deleteFileRecord(QStringLiteral("queued"), true));
+        _db.commit(QStringLiteral("queued"));
+    }
+
     void testFileRecordChecksum()
     {
         // Try with and without a checksum
@@ -195,6 +370,14 @@ private slots:
         Info storedRecord = _db.getDownloadInfo("foo");
         QVERIFY(storedRecord == record);
 
+        // A download split into ranged requests
+        record._segments = {{0, 1000, 1000}, {1000, 2000, 17}, {2000, 2500, 0}};
+        _db.setDownloadInfo("foo", record);
+        storedRecord = _db.getDownloadInfo("foo");
+        QVERIFY(storedRecord == record);
+        QVERIFY(storedRecord._segments.at(0).isComplete());
+        QVERIFY(!storedRecord._segments.at(1).isComplete());
+
         _db.setDownloadInfo("foo", Info());
         Info wipedRecord = _db.getDownloadInfo("foo");
         QVERIFY(!wipedRecord._valid);
@@ -222,6 +405,41 @@ private slots:
         QVERIFY(!wipedRecord._valid);
     }
 
+    void testDeltaChunks()
+    {
+        using Chunks = SyncJournalDb::DeltaChunks;
+        QVERIFY(!_db.getDeltaChunks("nonexistent").isValid());
+
+        Chunks chunks;
+        chunks._etag = "etag";
+        chunks._size = 3 * 1024;
+        for (int i = 0; i < 3; ++i) {
+            chunks._chunks.append({1024, QCryptographicHash::hash(QByteArray::number(i), QCryptographicHash::Sha1)});
+        }
+        _db.setDeltaChunks("deltafile", chunks);
+        _db.setDeltaChunks("deltagone", chunks);
+
+        const auto stored = _db.getDeltaChunks("deltafile");
+        QCOMPARE(stored._etag, chunks._etag);
+        QCOMPARE(stored._size, chunks._size);
+        QCOMPARE(stored._chunks, chunks._chunks);
+
+        // Only the chunks of files that are still in the metadata are kept
+        SyncJournalFileRecord record;
+        record._path = "deltafile";
+        record._type = ItemTypeFile;
+        record._etag = "etag";
+        record._fileId = "deltafileid";
+        QVERIFY(_db.setFileRecord(record));
+        _db.deleteStaleDeltaChunks();
+        QVERIFY(_db.getDeltaChunks("deltafile").isValid());
+        QVERIFY(!_db.getDeltaChunks("deltagone").isValid());
+
+        _db.setDeltaChunks("deltafile", Chunks());
+        QVERIFY(!_db.getDeltaChunks("deltafile").isValid());
+        QVERIFY(_db.deleteFileRecord("deltafile"));
+    }
+
     void testNumericId()
     {
         SyncJournalFileRecord record;
@@ -324,6 +542,52 @@ private slots:
         QCOMPARE(getEtag("foodir/sub"), initialEtag);
     }
 
+    void testScheduleFileIdsForRemoteDiscovery()
+    {
+        const auto invalidEtag = QByteArray("_invalid_");
+        const auto initialEtag = QByteArray("etag");
+        auto makeEntry = [&](const QByteArray &path, ItemType type, const QByteArray &fileId) {
+            SyncJournalFileRecord record;
+            record._modtime = QDateTime::currentSecsSinceEpoch();
+            record._path = path;
+            record._type = type;
+            record._etag = initialEtag;
+            record._fileId = fileId;
+            record._remotePerm = RemotePermissions::fromDbValue("RW");
+            QVERIFY(_db.setFileRecord(record));
+        };
+        auto getEtag = [&](const QByteArray &path) {
+            SyncJournalFileRecord record;
+            [[maybe_unused]] const auto result = _db.getFileRecord(path, &record);
+            return record._etag;
+        };
+
+        makeEntry("pushdir", ItemTypeDirectory, "00000010ocinstance");
+        makeEntry("pushdir/sub", ItemTypeDirectory, "00000011ocinstance");
+        makeEntry("pushdir/sub/file", ItemTypeFile, "00000012ocinstance");
+        makeEntry("pushdir/other", ItemTypeDirectory, "00000013ocinstance");
+        makeEntry("pushdir/other/deeper", ItemTypeDirectory, "123456789ocinstance");
+        makeEntry("pushfile", ItemTypeFile, "00000014ocinstance");
+
+        // Nothing known
+        QCOMPARE(_db.scheduleFileIdsForRemoteDiscovery({99, 100}), 0);
+        QCOMPARE(getEtag("pushdir"), initialEtag);
+
+        // A file schedules the folder that contains it
+        QCOMPARE(_db.scheduleFileIdsForRemoteDiscovery({12, 99}), 1);
+        QCOMPARE(getEtag("pushdir/sub"), invalidEtag);
+        QCOMPARE(getEtag("pushdir"), invalidEtag);
+        QCOMPARE(getEtag("pushdir/other"), initialEtag);
+
+        // A folder schedules itself, ids longer than 8 digits aren't padded
+        QCOMPARE(_db.scheduleFileIdsForRemoteDiscovery({123456789}), 1);
+        QCOMPARE(getEtag("pushdir/other/deeper"), invalidEtag);
+        QCOMPARE(getEtag("pushdir/other"), invalidEtag);
+
+        // Files at the top level are in the sync root, which is always listed
+        QCOMPARE(_db.scheduleFileIdsForRemoteDiscovery({14}), 1);
+    }
+
     void testRecursiveDelete()
     {
         auto makeEntry = [&](const QByteArray &path) {
@@ -376,6 +640,37 @@ private slots:
         QVERIFY(checkElements());
     }
 
+    void testE2EeFolderMetadataCache()
+    {
+        auto makeEntry = [&](const QByteArray &path, const QByteArray &fileId) {
+            SyncJournalFileRecord record;
+            record._path = path;
+            record._type = ItemTypeDirectory;
+            record._fileId = fileId;
+            record._remotePerm = RemotePermissions::fromDbValue("RW");
+            record._modtime = QDateTime::currentSecsSinceEpoch();
+            QVERIFY(_db.setFileRecord(record));
+            _db.setE2EeFolderMetadataCache(fileId, "etag", "metadata of " + path);
+        };
+
+        makeEntry("encrypted", "00000020ocinstance");
+        makeEntry("encrypted/sub", "00000021ocinstance");
+        makeEntry("encryptedother", "00000022ocinstance");
+        QCOMPARE(_db.e2EeFolderMetadataCache("00000021ocinstance", "etag"), QByteArray("metadata of encrypted/sub"));
+        QVERIFY(_db.e2EeFolderMetadataCache("00000021ocinstance", "otheretag").isEmpty());
+
+        // Removing a folder forgets it and its subfolders
+        QVERIFY(_db.deleteFileRecord("encrypted", true));
+        QVERIFY(_db.e2EeFolderMetadataCache("00000020ocinstance", "etag").isEmpty());
+        QVERIFY(_db.e2EeFolderMetadataCache("00000021ocinstance", "etag").isEmpty());
+        QCOMPARE(_db.e2EeFolderMetadataCache("00000022ocinstance", "etag"), QByteArray("metadata of encryptedother"));
+
+        // Resetting the end-to-end encryption forgets all of them
+        _db.clearE2EeFolderMetadataCache();
+        QVERIFY(_db.e2EeFolderMetadataCache("00000022ocinstance", "etag").isEmpty());
+        QVERIFY(_db.deleteFileRecord("encryptedother", true));
+    }
+
     void testPinState()
     {
         auto make = [&](const QByteArray &path, PinState state) {
@@ -509,6 +804,192 @@ private slots:
         QCOMPARE(list->size(), 0);
     }
 
+    void testConcurrentReadsWhileWriting()
+    {
+        // Readers on other threads get their own read-only connections and
+        // must neither fail nor see broken records while the writer is busy
+        constexpr auto readerCount = 4;
+        constexpr auto recordCount = 500;
+
+        auto makeRecord = [](const QByteArray &path, ItemType type) {
+            SyncJournalFileRecord record;
+            record._path = path;
+            record._type = type;
+            record._etag = "etag";
+            record._remotePerm = RemotePermissions::fromDbValue("RW");
+            record._modtime = QDateTime::currentSecsSinceEpoch();
+            return record;
+        };
+
+        // The shared connections are opt-in, the default exclusive lock keeps them off
+        SyncJournalDb db(_tempDir.path() + QStringLiteral("/concurrent.db"));
+        db.setReadConnectionsEnabled(true);
+
+        QVERIFY(db.setFileRecord(makeRecord("stress", ItemTypeDirectory)));
+        db.commit(QStringLiteral("stress setup"));
+
+        std::atomic<bool> writerDone{false};
+        std::atomic<int> readErrors{0};
+        std::atomic<int> reads{0};
+        std::vector<std::unique_ptr<QThread>> readers;
+        for (int i = 0; i < readerCount; ++i) {
+            readers.emplace_back(QThread::create([&] {
+                do {
+                    SyncJournalFileRecord record;
+                    if (!db.getFileRecord(QByteArrayLiteral("stress"), &record) || !record.isValid()) {
+                        ++readErrors;
+                    }
+                    const auto checkRecord = [&](const SyncJournalFileRecord &record) {
+                        if (!record.isValid() || !record._path.startsWith("stress/file") || record._etag != "etag") {
+                            ++readErrors;
+                        }
+                    };
+                    if (!db.listFilesInPath("stress", checkRecord)) {
+                        ++readErrors;
+                    }
+                    if (!db.getFilesBelowPath("stress", checkRecord)) {
+                        ++readErrors;
+                    }
+                    ++reads;
+                } while (!writerDone);
+            }));
+            readers.back()->start();
+        }
+
+        auto writeErrors = 0;
+        for (int i = 0; i < recordCount; ++i) {
+            if (!db.setFileRecord(makeRecord("stress/file" + QByteArray::number(i), ItemTypeFile))) {
+                ++writeErrors;
+            }
+            if (i % 50 == 0) {
+                db.commit(QStringLiteral("stress"));
+            }
+        }
+        db.commit(QStringLiteral("stress"));
+        writerDone = true;
+        for (const auto &reader : readers) {
+            QVERIFY(reader->wait());
+        }
+
+        QCOMPARE(writeErrors, 0);
+        QCOMPARE(readErrors.load(), 0);
+        QVERIFY(reads.load() >= readerCount);
+
+        // Once committed, everything is visible to readers
+        auto listed = 0;
+        auto listedOk = false;
+        std::unique_ptr<QThread> reader(QThread::create([&] {
+            listedOk = db.listFilesInPath("stress", [&](const SyncJournalFileRecord &) { ++listed; });
+        }));
+        reader->start();
+        QVERIFY(reader->wait());
+        QVERIFY(listedOk);
+        QCOMPARE(listed, recordCount);
+
+        // Finished threads don't keep their connections, whether they are QThreads or not
+        Qt::HANDLE plainReaderId = nullptr;
+        std::thread plainReader([&] {
+            listedOk = db.listFilesInPath("stress", [](const SyncJournalFileRecord &) {});
+            plainReaderId = QThread::currentThreadId();
+            QMutexLocker locker(&db._readConnections->mutex);
+            listedOk = listedOk && db._readConnections->byThread.contains(plainReaderId);
+        });
+        plainReader.join();
+        QVERIFY(listedOk);
+        QVERIFY(!db._readConnections->byThread.contains(plainReaderId));
+        db.close();
+    }
+
+    void testSnapshot()
+    {
+        auto makeRecord = [](const QByteArray &path, ItemType type) {
+            SyncJournalFileRecord record;
+            record._path = path;
+            record._type = type;
+            record._etag = "etag-" + path;
+            record._fileId = "id-" + path;
+            record._remotePerm = RemotePermissions::fromDbValue("RW");
+            record._modtime = QDateTime::currentSecsSinceEpoch();
+            return record;
+        };
+
+        QVERIFY(_db.setFileRecord(makeRecord("snap", ItemTypeDirectory)));
+        QVERIFY(_db.setFileRecord(makeRecord("snap/file", ItemTypeFile)));
+        // Sorts between "snap" and "snap/..." in the path||'/' order of the metadata table
+        QVERIFY(_db.setFileRecord(makeRecord("snap-2", ItemTypeFile)));
+        QVERIFY(_db.setFileRecord(makeRecord("snap/sub", ItemTypeDirectory)));
+        QVERIFY(_db.setFileRecord(makeRecord("snap/sub/deep", ItemTypeVirtualFile)));
+        QVERIFY(_db.setFileRecord(makeRecord("snap/sub/deeper", ItemTypeDirectory)));
+        QVERIFY(_db.setFileRecord(makeRecord("snap/sub/deeper/file", ItemTypeFile)));
+        // Shares the prefix with "snap/sub" but is not below it
+        QVERIFY(_db.setFileRecord(makeRecord("snap/sub-2", ItemTypeDirectory)));
+        QVERIFY(_db.setFileRecord(makeRecord("snap/sub-2/kept", ItemTypeFile)));
+        auto locked = makeRecord("snap/locked", ItemTypeFile);
+        locked._lockstate._locked = true;
+        locked._lockstate._lockOwnerId = QStringLiteral("alice");
+        locked._lockstate._lockToken = QStringLiteral("token");
+        locked._checksumHeader = "SHA1:abc";
+        locked._isShared = true;
+        QVERIFY(_db.setFileRecord(locked));
+        // Parent not in the journal
+        QVERIFY(_db.setFileRecord(makeRecord("orphan/file", ItemTypeFile)));
+
+        SyncJournalSnapshot snapshot;
+        QVERIFY(snapshot.load(_db));
+        QVERIFY(snapshot.isLoaded());
+        QCOMPARE(snapshot.recordCount(), _db.getFileRecordCount());
+
+        auto listFromDb = [&](const QByteArray &path) {
+            QVector<SyncJournalFileRecord> records;
+            [&] { QVERIFY(_db.listFilesInPath(path, [&](const SyncJournalFileRecord &rec) { records.append(rec); })); }();
+            return records;
+        };
+        auto listFromSnapshot = [&](const QByteArray &path) {
+            QVector<SyncJournalFileRecord> records;
+            snapshot.listFilesInPath(path, [&](const SyncJournalFileRecord &rec) { records.append(rec); });
+            return records;
+        };
+
+        QByteArrayList directories = {QByteArray(), "orphan", "does-not-exist"};
+        QVERIFY(_db.getFilesBelowPath({}, [&](const SyncJournalFileRecord &rec) {
+            if (rec.isDirectory()) {
+                directories.append(rec._path);
+            }
+        }));
+        for (const auto &directory : std::as_const(directories)) {
+            const auto expected = listFromDb(directory);
+            const auto actual = listFromSnapshot(directory);
+            QCOMPARE(actual.size(), expected.size());
+            for (int i = 0; i < expected.size(); ++i) {
+                QCOMPARE(actual[i]._path, expected[i]._path);
+                QVERIFY(actual[i] == expected[i]);
+                QCOMPARE(actual[i]._e2eMangledName, expected[i]._e2eMangledName);
+                QCOMPARE(actual[i]._isShared, expected[i]._isShared);
+                QCOMPARE(actual[i]._lockstate._lockOwnerId, expected[i]._lockstate._lockOwnerId);
+                QCOMPARE(actual[i]._folderQuota.bytesUsed, expected[i]._folderQuota.bytesUsed);
+            }
+        }
+        const auto snapListing = listFromSnapshot("snap");
+        QCOMPARE(snapListing.size(), 4);
+        const auto lockedIt = std::find_if(snapListing.cbegin(), snapListing.cend(), [](const auto &rec) { return rec._path == "snap/locked"; });
+        QVERIFY(lockedIt != snapListing.cend());
+        QVERIFY(lockedIt->_lockstate._locked);
+        QCOMPARE(lockedIt->_lockstate._lockToken, QStringLiteral("token"));
+        QCOMPARE(lockedIt->_checksumHeader, QByteArray("SHA1:abc"));
+
+        // Removing follows deleteFileRecord(path, true)
+        snapshot.removeRecursively("snap/sub");
+        QCOMPARE(listFromSnapshot("snap").size(), 3);
+        QVERIFY(listFromSnapshot("snap/sub").isEmpty());
+        QVERIFY(listFromSnapshot("snap/sub/deeper").isEmpty());
+        QCOMPARE(listFromSnapshot("snap/sub-2").size(), 1);
+        QCOMPARE(listFromSnapshot("").size(), listFromDb("").size());
+
+        snapshot.clear();
+        QVERIFY(!snapshot.isLoaded());
+        QVERIFY(listFromSnapshot("snap").isEmpty());
+    }
+
 private:
     SyncJournalDb _db;
 };
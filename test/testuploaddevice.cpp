@@ -0,0 +1,82 @@
+/*
+ * SPDX-FileCopyrightText: 2026 Nextcloud GmbH and Nextcloud contributors
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * This software is in the public domain, furnished "as is", without technical
+ * support, and with no warranty, express or implied, as to its usefulness for
+ * any purpose.
+ */
+
+#include <QtTest>
+#include <QTemporaryDir>
+
+#include "propagateupload.h"
+
+using namespace OCC;
+
+class TestUploadDevice : public QObject
+{
+    Q_OBJECT
+
+private:
+    QTemporaryDir _dir;
+    QString _path;
+    QByteArray _contents;
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        QVERIFY(_dir.isValid());
+        _path = _dir.filePath(QStringLiteral("big.bin"));
+        _contents.resize(9 * 1024 * 1024 + 123);
+        for (int i = 0; i < _contents.size(); ++i) {
+            _contents[i] = static_cast<char>(i * 7 + i / 4096);
+        }
+        QFile file(_path);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        QCOMPARE(file.write(_contents), qint64(_contents.size()));
+    }
+
+    void testReadRange_data()
+    {
+        QTest::addColumn<qint64>("start");
+        QTest::addColumn<qint64>("size");
+
+        QTest::newRow("small chunk") << qint64(1000) << qint64(64 * 1024);
+        QTest::newRow("unaligned chunk") << qint64(4097) << qint64(5 * 1024 * 1024);
+        QTest::newRow("whole file") << qint64(0) << qint64(_contents.size());
+    }
+
+    void testReadRange()
+    {
+        QFETCH(qint64, start);
+        QFETCH(qint64, size);
+
+        UploadDevice device(_path, start, size, nullptr);
+        QVERIFY(device.open(QIODevice::ReadOnly));
+        QCOMPARE(device.readAll(), _contents.mid(start, size));
+
+        // Rewinding, as a resent request does, reads the same bytes again
+        QVERIFY(device.seek(100));
+        QCOMPARE(device.read(1000), _contents.mid(start + 100, 1000));
+    }
+
+    void testTruncatedWhileReading()
+    {
+        const auto path = _dir.filePath(QStringLiteral("truncated.bin"));
+        QVERIFY(QFile::copy(_path, path));
+
+        UploadDevice device(path, 0, _contents.size(), nullptr);
+        QVERIFY(device.open(QIODevice::ReadOnly));
+        QCOMPARE(device.read(1024), _contents.left(1024));
+
+        // What is left of the file is uploaded, the size check after the upload catches the rest
+        constexpr auto truncatedSize = 3 * 1024 * 1024 + 5;
+        QVERIFY(QFile::resize(path, truncatedSize));
+        QVERIFY(device.seek(0));
+        QCOMPARE(device.readAll(), _contents.left(truncatedSize));
+    }
+};
+
+QTEST_GUILESS_MAIN(TestUploadDevice)
+#include "testuploaddevice.moc"
@@ -626,6 +626,180 @@ private slots:
         QVERIFY(_subdirs.size() == 1);
     }
 
+
+    void testParserIncremental() {
+        const QByteArray testXml = "<?xml version='1.0' encoding='utf-8'?>"
+              "<d:multistatus xmlns:d=\"DAV:\" xmlns:s=\"http://sabredav.org/ns\" xmlns:oc=\"http://owncloud.org/ns\">"
+              "<d:response>"
+              "<d:href>/oc/remote.php/dav/sharefolder/</d:href>"
+              "<d:propstat>"
+              "<d:prop>"
+              "<oc:id>00004213ocobzus5kn6s</oc:id>"
+              "<oc:permissions>RDNVCK</oc:permissions>"
+              "<oc:size>121780</oc:size>"
+              "<d:getetag>\"5527beb0400b0\"</d:getetag>"
+              "<d:resourcetype>"
+              "<d:collection/>"
+              "</d:resourcetype>"
+              "<d:getlastmodified>Fri, 06 Feb 2015 13:49:55 GMT</d:getlastmodified>"
+              "</d:prop>"
+              "<d:status>HTTP/1.1 200 OK</d:status>"
+              "</d:propstat>"
+              "</d:response>"
+              "<d:response>"
+              "<d:href>/oc/remote.php/dav/sharefolder/quitte.pdf</d:href>"
+              "<d:propstat>"
+              "<d:prop>"
+              "<oc:id>00004215ocobzus5kn6s</oc:id>"
+              "<oc:permissions>RDNVW</oc:permissions>"
+              "<d:getetag>\"2fa2f0d9ed49ea0c3e409d49e652dea0\"</d:getetag>"
+              "<d:resourcetype/>"
+              "<d:getlastmodified>Fri, 06 Feb 2015 13:49:55 GMT</d:getlastmodified>"
+              "<d:getcontentlength>121780</d:getcontentlength>"
+              "</d:prop>"
+              "<d:status>HTTP/1.1 200 OK</d:status>"
+              "</d:propstat>"
+              "</d:response>"
+              "</d:multistatus>";
+
+        LsColXMLParser parser;
+
+        connect( &parser, &LsColXMLParser::directoryListingSubfolders,
+                 this, &TestXmlParse::slotDirectoryListingSubFolders );
+        connect( &parser, &LsColXMLParser::directoryListingIterated,
+                 this, &TestXmlParse::slotDirectoryListingIterated );
+        connect( &parser, &LsColXMLParser::finishedWithoutError,
+                 this, &TestXmlParse::slotFinishedSuccessfully );
+
+        QHash <QString, ExtraFolderInfo> sizes;
+        parser.beginParse("/oc/remote.php/dav/sharefolder", &sizes);
+
+        // Feed the reply in small pieces splitting elements and text, like data arriving from the network
+        const auto firstResponseEnd = testXml.indexOf("</d:response>") + qsizetype(strlen("</d:response>"));
+        for (qsizetype pos = 0; pos < testXml.size(); pos += 7) {
+            QVERIFY(parser.addData(testXml.mid(pos, 7)));
+            if (pos + 7 < firstResponseEnd) {
+                QVERIFY(_items.isEmpty());
+            }
+            if (pos >= firstResponseEnd) {
+                // entries are available before the whole reply was received
+                QVERIFY(_items.contains("/oc/remote.php/dav/sharefolder"));
+            }
+        }
+        QVERIFY(!_success);
+        QVERIFY(_subdirs.isEmpty());
+
+        QVERIFY(parser.endParse());
+        QVERIFY(_success);
+        QCOMPARE(sizes.size(), 1);
+        QCOMPARE(sizes.value("/oc/remote.php/dav/sharefolder/").size, 121780);
+
+        QCOMPARE(_items.size(), 2);
+        QVERIFY(_items.contains("/oc/remote.php/dav/sharefolder/quitte.pdf"));
+        QCOMPARE(_subdirs, QStringList{"/oc/remote.php/dav/sharefolder/"});
+    }
+
+    void testParserIncrementalTruncated() {
+        const QByteArray testXml = "<?xml version='1.0' encoding='utf-8'?>"
+              "<d:multistatus xmlns:d=\"DAV:\" xmlns:s=\"http://sabredav.org/ns\" xmlns:oc=\"http://owncloud.org/ns\">"
+              "<d:response>"
+              "<d:href>/oc/remote.php/dav/sharefolder/</d:href>"
+              "<d:propstat>"
+              "<d:prop>"
+              "<oc:id>00004213ocobzus5kn6s</oc:id>"; // connection dropped
+
+        LsColXMLParser parser;
+
+        connect( &parser, &LsColXMLParser::finishedWithoutError,
+                 this, &TestXmlParse::slotFinishedSuccessfully );
+
+        QHash <QString, ExtraFolderInfo> sizes;
+        parser.beginParse("/oc/remote.php/dav/sharefolder", &sizes);
+        QVERIFY(parser.addData(testXml.left(40)));
+        QVERIFY(parser.addData(testXml.mid(40)));
+        QVERIFY(!parser.endParse());
+        QVERIFY(!_success);
+    }
+
+    void testParserTypedProperties() {
+        const QByteArray testXml = "<?xml version='1.0' encoding='utf-8'?>"
+              "<d:multistatus xmlns:d=\"DAV:\" xmlns:s=\"http://sabredav.org/ns\" xmlns:oc=\"http://owncloud.org/ns\" xmlns:x=\"http://example.com/ns\">"
+              "<d:response>"
+              "<d:href>/oc/remote.php/dav/sharefolder/</d:href>"
+              "<d:propstat>"
+              "<d:prop>"
+              "<oc:id>00004213ocobzus5kn6s</oc:id>"
+              "<oc:permissions>RDNVCK</oc:permissions>"
+              "<d:resourcetype><d:collection/></d:resourcetype>"
+              "<x:custom>some value</x:custom>"
+              "</d:prop>"
+              "<d:status>HTTP/1.1 200 OK</d:status>"
+              "</d:propstat>"
+              "</d:response>"
+              "<d:response>"
+              "<d:href>/oc/remote.php/dav/sharefolder/quitte.pdf</d:href>"
+              "<d:propstat>"
+              "<d:prop>"
+              "<oc:id>00004215ocobzus5kn6s</oc:id>"
+              "<d:getetag>\"2fa2f0d9ed49ea0c3e409d49e652dea0\"</d:getetag>"
+              "<d:resourcetype/>"
+              "<d:getcontentlength>121780</d:getcontentlength>"
+              "</d:prop>"
+              "<d:status>HTTP/1.1 200 OK</d:status>"
+              "</d:propstat>"
+              "<d:propstat>"
+              "<d:prop>"
+              "<oc:downloadURL/>"
+              "</d:prop>"
+              "<d:status>HTTP/1.1 404 Not Found</d:status>"
+              "</d:propstat>"
+              "</d:response>"
+              "</d:multistatus>";
+
+        LsColXMLParser parser;
+
+        QVector<DavProperties> typedProperties;
+        QVector<QMap<QString, QString>> mapProperties;
+        connect(&parser, &LsColXMLParser::directoryListingEntry, this, [&](const QString &, const DavProperties &properties) {
+            typedProperties.append(properties);
+        });
+        connect(&parser, &LsColXMLParser::directoryListingIterated, this, [&](const QString &, const QMap<QString, QString> &properties) {
+            mapProperties.append(properties);
+        });
+
+        QHash <QString, ExtraFolderInfo> sizes;
+        QVERIFY(parser.parse(testXml, &sizes, "/oc/remote.php/dav/sharefolder"));
+
+        QCOMPARE(typedProperties.size(), 2);
+        QCOMPARE(mapProperties.size(), 2);
+
+        // The entries kept a copy of the values the parser went on to reuse
+        const auto &folder = typedProperties.at(0);
+        QCOMPARE(folder.value(DavProperties::Id).toString(), QStringLiteral("00004213ocobzus5kn6s"));
+        QCOMPARE(folder.value(DavProperties::Permissions).toString(), QStringLiteral("RDNVCK"));
+        QVERIFY(folder.value(DavProperties::ResourceType).contains(u"collection"));
+        QCOMPARE(folder.value(u"custom").toString(), QStringLiteral("some value"));
+        QVERIFY(!folder.contains(DavProperties::GetEtag));
+        QCOMPARE(folder.toMap(), mapProperties.at(0));
+
+        const auto &file = typedProperties.at(1);
+        QCOMPARE(file.value(DavProperties::GetContentLength).toString(), QStringLiteral("121780"));
+        QVERIFY(file.contains(DavProperties::ResourceType));
+        QVERIFY(file.value(DavProperties::ResourceType).isEmpty());
+        QVERIFY(!file.contains(DavProperties::DownloadUrl)); // from the 404 propstat
+        QVERIFY(!file.contains(u"custom"));
+        QCOMPARE(file.toMap(), mapProperties.at(1));
+
+        RemoteInfo fromTyped;
+        RemoteInfo fromMap;
+        LsColJob::propertiesToRemoteInfo(file, RemotePermissions::MountedPermissionAlgorithm::WildGuessMountedSubProperty, fromTyped);
+        LsColJob::propertyMapToRemoteInfo(mapProperties.at(1), RemotePermissions::MountedPermissionAlgorithm::WildGuessMountedSubProperty, fromMap);
+        QCOMPARE(fromTyped.size, 121780);
+        QCOMPARE(fromTyped.size, fromMap.size);
+        QCOMPARE(fromTyped.etag, fromMap.etag);
+        QCOMPARE(fromTyped.fileId, fromMap.fileId);
+        QCOMPARE(fromTyped.isDirectory, fromMap.isDirectory);
+    }
 };
 
     QTEST_GUILESS_MAIN(TestXmlParse)